@@ -0,0 +1,206 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+/*
+ * Handshake flood: server poller thread accepts flood of full (not resumed)
+ * handshakes while probe connections measure echo round trip latency.
+ * With crypto workers signing and DHE derive leave server poller thread,
+ * so probe p99 latency should stay flat.
+ *
+ * usage: handshake_flood [crypto_workers=0] [flood_clients=16] [seconds=10]
+ * needs ./key.pem ./cert.pem ./cert_chain.pem for SNI_HOSTNAME (as tls_echo_server)
+ */
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <optional>
+#include <algorithm>
+
+#include <libcornet/config.hpp>
+#include <libcornet/poller.hpp>
+#include <libcornet/tls/tls_socket.hpp>
+#include <libcornet/tls/session_ticket.hpp>
+#include <libcornet/tls/crypto/crypto_workers.hpp>
+namespace net = pioneer19::cornet;
+namespace tls = pioneer19::cornet::tls13;
+
+#include <pioneer19_utils/coroutines_utils.hpp>
+using pioneer19::LinkedCoroutine;
+using pioneer19::CommonCoroutine;
+
+using Clock = std::chrono::steady_clock;
+
+constexpr uint16_t SERVER_PORT  = 10001;
+constexpr uint32_t PROBES_COUNT = 4;
+constexpr uint32_t PROBE_MESSAGE_SIZE = 64;
+
+struct BenchmarkState
+{
+    Clock::time_point deadline;
+    std::atomic<uint64_t> handshakes = 0;
+    std::atomic<uint64_t> failed_handshakes = 0;
+    std::vector<uint64_t> probe_latencies_ns;
+    uint32_t running_probes  = 0;
+    uint32_t running_flooders = 0;
+};
+
+LinkedCoroutine echo_session( net::TcpSocket tcp_socket, tls::KeyStore* key_store )
+{
+    std::optional<tls::TlsSocket> session_socket;
+    try
+    {
+        session_socket.emplace( co_await tls::TlsSocket::server_handshake( std::move(tcp_socket), key_store ) );
+        uint8_t buffer[1024];
+        while( true )
+        {
+            auto bytes_read = co_await session_socket->async_read( buffer, sizeof(buffer) );
+            if( bytes_read == 0 )
+                break;
+            co_await session_socket->async_write( buffer, bytes_read );
+        }
+    }
+    catch( const std::exception& )
+    {}
+}
+
+CommonCoroutine run_server( net::Poller& poller, tls::KeyStore* key_store )
+{
+    tls::TlsSocket listener{};
+    listener.bind( "::1", SERVER_PORT );
+    listener.listen( poller );
+
+    LinkedCoroutine::List sessions_list;
+    while( true )
+    {
+        net::TcpSocket client_socket = co_await listener.async_accept_tcp( poller );
+        auto session = echo_session( std::move(client_socket), key_store );
+        session.link_promise( sessions_list );
+        session.start();
+    }
+}
+
+LinkedCoroutine run_flooder( net::Poller& poller, BenchmarkState& state )
+{
+    while( Clock::now() < state.deadline )
+    {
+        tls::TlsSocket tls_socket{};
+        if( co_await tls_socket.async_connect( poller, "::1", SERVER_PORT, SNI_HOSTNAME ) )
+            ++state.handshakes;
+        else
+            ++state.failed_handshakes;
+    }
+    if( --state.running_flooders == 0 )
+        poller.stop();
+}
+
+LinkedCoroutine run_probe( net::Poller& poller, BenchmarkState& state )
+{
+    tls::TlsSocket tls_socket{};
+    if( co_await tls_socket.async_connect( poller, "::1", SERVER_PORT, SNI_HOSTNAME ) )
+    {
+        uint8_t message[PROBE_MESSAGE_SIZE] = {};
+        uint8_t buffer[PROBE_MESSAGE_SIZE];
+        while( Clock::now() < state.deadline )
+        {
+            auto start = Clock::now();
+            co_await tls_socket.async_write( message, sizeof(message) );
+            uint32_t bytes_read = 0;
+            while( bytes_read < sizeof(buffer) )
+                bytes_read += co_await tls_socket.async_read( buffer + bytes_read, sizeof(buffer) - bytes_read );
+            state.probe_latencies_ns.push_back(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>( Clock::now() - start ).count() );
+        }
+    }
+    else
+        printf( "probe failed connect server\n" );
+
+    if( --state.running_probes == 0 )
+        poller.stop();
+}
+
+static uint64_t percentile( const std::vector<uint64_t>& sorted_values, double percent )
+{
+    if( sorted_values.empty() )
+        return 0;
+    auto index = static_cast<size_t>( percent/100.0 * (sorted_values.size()-1) );
+    return sorted_values[index];
+}
+
+int main( int argc, char* argv[] )
+{
+    uint32_t crypto_workers = argc > 1 ? std::stoul( argv[1] ) : 0;
+    uint32_t flood_clients  = argc > 2 ? std::stoul( argv[2] ) : 16;
+    uint32_t seconds        = argc > 3 ? std::stoul( argv[3] ) : 10;
+
+    printf( "handshake flood: %u crypto workers, %u flood clients, %u seconds\n"
+            , crypto_workers, flood_clients, seconds );
+
+    // every flood handshake must be full handshake with signing
+    tls::SessionTicketKeys::instance().set_issue_tickets( false );
+    if( crypto_workers > 0 )
+        tls::crypto::CryptoWorkers::instance().start( crypto_workers );
+
+    std::thread server_thread( [](){
+        tls::SingleDomainKeyStore key_store{ SNI_HOSTNAME, "./key.pem", "./cert.pem", "./cert_chain.pem" };
+        net::Poller poller;
+        auto server = run_server( poller, &key_store );
+        poller.run();
+    } );
+    // server is stopped by process exit
+    server_thread.detach();
+    std::this_thread::sleep_for( std::chrono::milliseconds(100) );
+
+    BenchmarkState state;
+    state.deadline = Clock::now() + std::chrono::seconds( seconds );
+
+    std::thread flood_thread( [&state,flood_clients](){
+        net::Poller poller;
+        LinkedCoroutine::List flooders_list;
+        state.running_flooders = flood_clients;
+        for( uint32_t i = 0; i < flood_clients; ++i )
+        {
+            auto flooder = run_flooder( poller, state );
+            flooder.link_promise( flooders_list );
+            flooder.start();
+        }
+        if( flood_clients > 0 )
+            poller.run();
+    } );
+
+    net::Poller poller;
+    LinkedCoroutine::List probes_list;
+    state.running_probes = PROBES_COUNT;
+    for( uint32_t i = 0; i < PROBES_COUNT; ++i )
+    {
+        auto probe = run_probe( poller, state );
+        probe.link_promise( probes_list );
+        probe.start();
+    }
+    poller.run();
+
+    flood_thread.join();
+
+    auto& latencies = state.probe_latencies_ns;
+    std::sort( latencies.begin(), latencies.end() );
+    printf( "handshakes %lu (%.1f/sec), failed %lu\n"
+            , state.handshakes.load(), double(state.handshakes.load())/seconds, state.failed_handshakes.load() );
+    printf( "probe round trips %lu, latency us: p50 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n"
+            , latencies.size()
+            , percentile( latencies, 50 )/1000.0, percentile( latencies, 99 )/1000.0
+            , percentile( latencies, 99.9 )/1000.0, percentile( latencies, 100 )/1000.0 );
+    fflush( stdout );
+
+    // server thread still runs, exit without destructors
+    ::_exit( EXIT_SUCCESS );
+}
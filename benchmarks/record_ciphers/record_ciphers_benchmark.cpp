@@ -0,0 +1,76 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+/*
+ * TlsCipherSuite::encrypt_records() throughput of full size (16 KB) records
+ * in batches of 16 for every supported cipher suite.
+ *
+ * usage: record_ciphers_benchmark [batches=1024]
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#include <libcornet/tls/types.hpp>
+#include <libcornet/tls/crypto/record_ciphers.hpp>
+namespace record     = pioneer19::cornet::tls13::record;
+namespace tls_crypto = pioneer19::cornet::tls13::crypto;
+
+static void benchmark_encrypt_records( record::CipherSuite cipher_suite, const char* name, uint32_t batches_count )
+{
+    constexpr uint32_t RECORD_SIZE = 16*1024;
+    constexpr uint32_t BATCH_SIZE  = 16;
+
+    tls_crypto::TlsCipherSuite tls_cipher_suite;
+    tls_cipher_suite.set_cipher_suite( cipher_suite );
+    std::fill_n( tls_cipher_suite.sender_key_data(), tls_cipher_suite.key_size(), 0x42 );
+    std::fill_n( tls_cipher_suite.sender_iv_data(), tls_cipher_suite.iv_size(), 0x24 );
+
+    std::vector<uint8_t> plaintext( RECORD_SIZE, 'a' );
+    std::vector<uint8_t> ciphertext( BATCH_SIZE*(RECORD_SIZE+1) );
+    std::vector<uint8_t> tags( BATCH_SIZE*16 );
+    const uint8_t tail[] = { 0x17 };
+    const uint8_t aad[5] = { 0x17, 0x03, 0x03, 0x40, 0x11 };
+
+    tls_crypto::RecordIn  records_in [BATCH_SIZE];
+    tls_crypto::RecordOut records_out[BATCH_SIZE];
+    for( uint32_t i = 0; i < BATCH_SIZE; ++i )
+    {
+        records_in[i]  = { plaintext.data(), RECORD_SIZE, tail, sizeof(tail), aad, sizeof(aad) };
+        records_out[i] = { ciphertext.data() + i*(RECORD_SIZE+1), tags.data() + i*16, 0 };
+    }
+
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t bytes_encrypted = 0;
+    for( uint32_t batch = 0; batch < batches_count; ++batch )
+    {
+        auto encrypted_count = tls_cipher_suite.encrypt_records( records_in, records_out );
+        for( uint32_t i = 0; i < encrypted_count; ++i )
+            bytes_encrypted += records_out[i].ciphertext_size;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::chrono::duration<double> seconds = end - begin;
+    printf( "%s encrypt_records %lu MB in %.3f s, %.2f GB/s\n", name
+            , static_cast<unsigned long>( bytes_encrypted/(1024*1024) )
+            , seconds.count(), bytes_encrypted/seconds.count()/1e9 );
+}
+
+int main( int argc, char* argv[] )
+{
+    uint32_t batches_count = argc > 1 ? std::max( std::stoul( argv[1] ), 1ul ) : 1024;
+
+    benchmark_encrypt_records( record::TLS_AES_128_GCM_SHA256, "TLS_AES_128_GCM_SHA256", batches_count );
+    benchmark_encrypt_records( record::TLS_AES_256_GCM_SHA384, "TLS_AES_256_GCM_SHA384", batches_count );
+    benchmark_encrypt_records( record::TLS_CHACHA20_POLY1305_SHA256, "TLS_CHACHA20_POLY1305_SHA256", batches_count );
+
+    return 0;
+}
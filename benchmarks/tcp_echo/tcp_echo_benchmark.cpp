@@ -0,0 +1,418 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+/*
+ * TCP echo load generator: N connections (split between client threads,
+ * every thread has own Poller) send fixed size messages to echo server and
+ * measure requests/sec and latency percentiles (HDR histogram).
+ *
+ * closed loop (rate 0): every connection keeps pipeline_depth requests in flight
+ * open loop (rate > 0): requests are sent on constant rate schedule, latency
+ *   is measured from scheduled send time, so server stalls are not hidden by
+ *   client waiting for responses (coordinated omission). pipeline_depth limits
+ *   requests in flight, late requests still count from scheduled time.
+ *
+ * Targets: tcp_echo_server built with epoll, tcp_echo_server built with
+ * io_uring (USE_IO_URING in libcornet/config.hpp) and blocking
+ * examples/reference_server (port 10000 on 127.0.0.1).
+ *
+ * usage: tcp_echo_benchmark [-h host] [-p port] [-c connections] [-d pipeline_depth]
+ *            [-s message_size] [-r total_rate] [-t seconds] [-w warmup_seconds]
+ *            [-T threads] [-l target_label] [-j json_file]
+ */
+
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include <csignal>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+#include <system_error>
+#include <experimental/coroutine>
+
+#include <libcornet/config.hpp>
+#include <libcornet/poller.hpp>
+#include <libcornet/tcp_socket.hpp>
+#include <libcornet/async_file.hpp>
+namespace net = pioneer19::cornet;
+
+#include <pioneer19_utils/coroutines_utils.hpp>
+using pioneer19::LinkedCoroutine;
+using pioneer19::CommonCoroutine;
+
+#include "../utils/hdr_histogram.hpp"
+using pioneer19::cornet::benchmarks::HdrHistogram;
+
+struct Options
+{
+    std::string host = "127.0.0.1";
+    uint16_t port = 10000;
+    uint32_t connections = 16;
+    uint32_t pipeline_depth = 1;
+    uint32_t message_size = 64;
+    uint64_t rate = 0;  ///< total requests/sec, 0 - closed loop
+    uint32_t seconds = 10;
+    uint32_t warmup_seconds = 1;
+    uint32_t threads = 1;
+    std::string label = "echo_server";
+    const char* json_file_name = nullptr;
+};
+
+struct ThreadStats
+{
+    HdrHistogram latency_ns;
+    uint64_t responses = 0; ///< responses for requests sent in measure interval
+    uint64_t errors = 0;
+};
+
+struct Connection
+{
+    net::TcpSocket socket;
+    std::vector<uint64_t> send_times_ns; ///< ring of pipeline_depth scheduled send times
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    uint64_t first_send_ns = 0;
+    bool     sender_done = false;
+    bool     finished = false;
+    std::experimental::coroutine_handle<> waiting_sender;
+};
+
+struct ThreadContext
+{
+    const Options* options = nullptr;
+    net::Poller* poller = nullptr;
+    uint32_t connections_count = 0;
+    uint32_t connection_index_base = 0;
+    uint32_t running_connections = 0;
+    uint64_t measure_begin_ns = 0;
+    uint64_t measure_end_ns = 0;
+    std::vector<std::unique_ptr<Connection>>* connections = nullptr;
+    LinkedCoroutine::List* coroutines_list = nullptr;
+    ThreadStats stats;
+};
+
+static uint64_t now_ns()
+{
+    // steady_clock is CLOCK_MONOTONIC, same clock is used by timerfd
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+/**
+ * suspend sender while pipeline_depth requests are in flight, receiver resumes it
+ */
+struct PipelineWindow
+{
+    Connection& connection;
+    uint32_t pipeline_depth;
+
+    bool await_ready() const noexcept { return connection.sent - connection.received < pipeline_depth; }
+    void await_suspend( std::experimental::coroutine_handle<> coro_handle ) noexcept
+    { connection.waiting_sender = coro_handle; }
+    void await_resume() noexcept {}
+};
+
+static void connection_finished( Connection& connection, ThreadContext& context )
+{
+    if( connection.finished )
+        return;
+    connection.finished = true;
+    if( --context.running_connections == 0 )
+        context.poller->stop();
+}
+
+static int create_timer()
+{
+    int timer_fd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC );
+    if( timer_fd == -1 )
+        throw std::system_error( errno, std::system_category(), "failed timerfd_create" );
+    return timer_fd;
+}
+
+static void arm_timer( int timer_fd, uint64_t expire_ns )
+{
+    itimerspec timer_spec{};
+    timer_spec.it_value.tv_sec  = expire_ns / 1'000'000'000;
+    timer_spec.it_value.tv_nsec = expire_ns % 1'000'000'000;
+    if( timerfd_settime( timer_fd, TFD_TIMER_ABSTIME, &timer_spec, nullptr ) == -1 )
+        throw std::system_error( errno, std::system_category(), "failed timerfd_settime" );
+}
+
+LinkedCoroutine run_sender( Connection& connection, ThreadContext& context, int timer_fd, net::AsyncFile* timer )
+{
+    const Options& options = *context.options;
+    std::vector<uint8_t> message( options.message_size, 'x' );
+    // open loop: connections share total rate, send times are spread over interval
+    uint64_t interval_ns = options.rate ? options.connections * 1'000'000'000ull / options.rate : 0;
+    uint64_t scheduled_ns = connection.first_send_ns;
+    try
+    {
+        while( true )
+        {
+            if( interval_ns )
+            {
+                if( scheduled_ns >= context.measure_end_ns )
+                    break;
+                if( now_ns() < scheduled_ns )
+                {
+                    uint64_t expirations;
+                    arm_timer( timer_fd, scheduled_ns );
+                    co_await timer->async_read( reinterpret_cast<char*>(&expirations), sizeof(expirations) );
+                }
+            }
+            co_await PipelineWindow{ connection, options.pipeline_depth };
+
+            uint64_t send_ns = interval_ns ? scheduled_ns : now_ns();
+            if( send_ns >= context.measure_end_ns )
+                break;
+            connection.send_times_ns[connection.sent % options.pipeline_depth] = send_ns;
+            ++connection.sent;
+            uint32_t bytes_sent = 0;
+            while( bytes_sent < message.size() )
+            {
+                auto res = co_await connection.socket.async_write(
+                        message.data() + bytes_sent, message.size() - bytes_sent );
+                if( res <= 0 )
+                    throw std::runtime_error( "connection closed by server" );
+                bytes_sent += res;
+            }
+            scheduled_ns += interval_ns;
+        }
+    }
+    catch( const std::exception& ex )
+    {
+        printf( "sender failed: %s\n", ex.what() );
+        ++context.stats.errors;
+        connection_finished( connection, context );
+    }
+    connection.sender_done = true;
+    if( connection.sent == connection.received )
+        connection_finished( connection, context );
+}
+
+LinkedCoroutine run_receiver( Connection& connection, ThreadContext& context )
+{
+    const Options& options = *context.options;
+    std::vector<uint8_t> buffer( options.message_size );
+    try
+    {
+        while( true )
+        {
+            auto bytes_read = co_await connection.socket.async_read(
+                    buffer.data(), buffer.size(), buffer.size() );
+            if( bytes_read < static_cast<ssize_t>( buffer.size() ) )
+                throw std::runtime_error( "connection closed by server" );
+
+            uint64_t receive_ns = now_ns();
+            uint64_t send_ns = connection.send_times_ns[connection.received % options.pipeline_depth];
+            ++connection.received;
+            if( send_ns >= context.measure_begin_ns )
+            {
+                context.stats.latency_ns.record( receive_ns - send_ns );
+                ++context.stats.responses;
+            }
+
+            if( connection.sender_done && connection.sent == connection.received )
+                break;
+            if( connection.waiting_sender )
+                std::exchange( connection.waiting_sender, nullptr ).resume();
+        }
+    }
+    catch( const std::exception& ex )
+    {
+        printf( "receiver failed: %s\n", ex.what() );
+        ++context.stats.errors;
+    }
+    connection_finished( connection, context );
+}
+
+/**
+ * connect all thread connections, then start senders and receivers
+ */
+CommonCoroutine run_client( net::Poller& poller, ThreadContext& context, std::vector<net::AsyncFile>& timers )
+{
+    const Options& options = *context.options;
+    for( uint32_t i = 0; i < context.connections_count; ++i )
+    {
+        auto connection = std::make_unique<Connection>();
+        connection->send_times_ns.resize( options.pipeline_depth );
+        if( !co_await connection->socket.async_connect( poller, options.host.c_str(), options.port ) )
+        {
+            printf( "failed connect to %s:%u\n", options.host.c_str(), options.port );
+            ++context.stats.errors;
+            poller.stop();
+            co_return;
+        }
+        context.connections->push_back( std::move(connection) );
+    }
+
+    uint64_t start_ns = now_ns();
+    context.measure_begin_ns = start_ns + options.warmup_seconds * 1'000'000'000ull;
+    context.measure_end_ns = context.measure_begin_ns + options.seconds * 1'000'000'000ull;
+    uint64_t interval_ns = options.rate ? options.connections * 1'000'000'000ull / options.rate : 0;
+    context.running_connections = context.connections_count;
+    for( uint32_t i = 0; i < context.connections_count; ++i )
+    {
+        Connection& connection = *(*context.connections)[i];
+        uint32_t connection_index = context.connection_index_base + i;
+        connection.first_send_ns = start_ns + interval_ns * connection_index / options.connections;
+
+        net::AsyncFile* timer = nullptr;
+        int timer_fd = -1;
+        if( interval_ns )
+        {
+            timer_fd = create_timer();
+            timers.emplace_back( timer_fd, &poller );
+            timer = &timers.back();
+        }
+        auto receiver = run_receiver( connection, context );
+        receiver.link_promise( *context.coroutines_list );
+        receiver.start();
+        auto sender = run_sender( connection, context, timer_fd, timer );
+        sender.link_promise( *context.coroutines_list );
+        sender.start();
+    }
+}
+
+static void run_thread( ThreadContext& context )
+{
+    // destroyed in reverse order: coroutines, then connections and timers, then poller
+    net::Poller poller;
+    std::vector<std::unique_ptr<Connection>> connections;
+    std::vector<net::AsyncFile> timers;
+    timers.reserve( context.connections_count );
+    LinkedCoroutine::List coroutines_list;
+    context.poller = &poller;
+    context.connections = &connections;
+    context.coroutines_list = &coroutines_list;
+
+    auto client = run_client( poller, context, timers );
+    poller.run();
+}
+
+static void print_usage( const char* name )
+{
+    printf( "usage: %s [-h host] [-p port] [-c connections] [-d pipeline_depth]\n"
+            "           [-s message_size] [-r total_rate] [-t seconds] [-w warmup_seconds]\n"
+            "           [-T threads] [-l target_label] [-j json_file]\n", name );
+}
+
+static Options parse_options( int argc, char* argv[] )
+{
+    Options options;
+    int opt;
+    while( (opt = getopt( argc, argv, "h:p:c:d:s:r:t:w:T:l:j:" )) != -1 )
+    {
+        switch( opt )
+        {
+            case 'h': options.host = optarg; break;
+            case 'p': options.port = std::stoul( optarg ); break;
+            case 'c': options.connections = std::stoul( optarg ); break;
+            case 'd': options.pipeline_depth = std::stoul( optarg ); break;
+            case 's': options.message_size = std::stoul( optarg ); break;
+            case 'r': options.rate = std::stoull( optarg ); break;
+            case 't': options.seconds = std::stoul( optarg ); break;
+            case 'w': options.warmup_seconds = std::stoul( optarg ); break;
+            case 'T': options.threads = std::stoul( optarg ); break;
+            case 'l': options.label = optarg; break;
+            case 'j': options.json_file_name = optarg; break;
+            default:
+                print_usage( argv[0] );
+                exit( EXIT_FAILURE );
+        }
+    }
+    if( options.connections == 0 || options.pipeline_depth == 0 || options.message_size == 0
+        || options.threads == 0 || options.seconds == 0 )
+    {
+        print_usage( argv[0] );
+        exit( EXIT_FAILURE );
+    }
+    options.threads = std::min( options.threads, options.connections );
+
+    return options;
+}
+
+int main( int argc, char* argv[] )
+{
+    Options options = parse_options( argc, argv );
+    signal( SIGPIPE, SIG_IGN );
+
+#if defined(USE_IO_URING)
+    const char* client_backend = "io_uring";
+#else
+    const char* client_backend = "epoll";
+#endif
+    printf( "%s:%u target %s, %u connections, %u threads (%s), depth %u, message %u bytes, %s\n"
+            , options.host.c_str(), options.port, options.label.c_str(), options.connections
+            , options.threads, client_backend, options.pipeline_depth, options.message_size
+            , options.rate ? ("open loop " + std::to_string( options.rate ) + " req/s").c_str() : "closed loop" );
+
+    std::vector<ThreadContext> contexts( options.threads );
+    uint32_t connection_index = 0;
+    for( uint32_t i = 0; i < options.threads; ++i )
+    {
+        contexts[i].options = &options;
+        contexts[i].connections_count = options.connections / options.threads
+                                        + (i < options.connections % options.threads ? 1 : 0);
+        contexts[i].connection_index_base = connection_index;
+        connection_index += contexts[i].connections_count;
+    }
+    std::vector<std::thread> threads;
+    for( auto& context : contexts )
+        threads.emplace_back( run_thread, std::ref( context ) );
+    for( auto& thread : threads )
+        thread.join();
+
+    ThreadStats total;
+    for( auto& context : contexts )
+    {
+        total.latency_ns.merge( context.stats.latency_ns );
+        total.responses += context.stats.responses;
+        total.errors += context.stats.errors;
+    }
+    double rps = static_cast<double>( total.responses ) / options.seconds;
+    auto& latency = total.latency_ns;
+    printf( "requests %lu, %.1f req/s, errors %lu\n", total.responses, rps, total.errors );
+    printf( "latency us: p50 %.1f p90 %.1f p99 %.1f p99.9 %.1f p99.99 %.1f max %.1f mean %.1f\n"
+            , latency.value_at_percentile( 50 ) / 1e3, latency.value_at_percentile( 90 ) / 1e3
+            , latency.value_at_percentile( 99 ) / 1e3, latency.value_at_percentile( 99.9 ) / 1e3
+            , latency.value_at_percentile( 99.99 ) / 1e3, latency.max() / 1e3, latency.mean() / 1e3 );
+
+    if( options.json_file_name )
+    {
+        FILE* json = fopen( options.json_file_name, "w" );
+        if( json == nullptr )
+        {
+            perror( "fopen json file" );
+            return EXIT_FAILURE;
+        }
+        fprintf( json, "{\n  \"benchmark\": \"tcp_echo\",\n  \"target\": \"%s\",\n  \"client_backend\": \"%s\""
+                       ",\n  \"connections\": %u,\n  \"threads\": %u,\n  \"pipeline_depth\": %u"
+                       ",\n  \"message_size\": %u,\n  \"rate\": %lu,\n  \"seconds\": %u"
+                       ",\n  \"requests\": %lu,\n  \"requests_per_sec\": %.1f,\n  \"errors\": %lu"
+                       ",\n  \"latency_us\": {\"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"p99_9\": %.1f"
+                       ", \"p99_99\": %.1f, \"max\": %.1f, \"mean\": %.1f}\n}\n"
+                 , options.label.c_str(), client_backend, options.connections, options.threads
+                 , options.pipeline_depth, options.message_size, options.rate, options.seconds
+                 , total.responses, rps, total.errors
+                 , latency.value_at_percentile( 50 ) / 1e3, latency.value_at_percentile( 90 ) / 1e3
+                 , latency.value_at_percentile( 99 ) / 1e3, latency.value_at_percentile( 99.9 ) / 1e3
+                 , latency.value_at_percentile( 99.99 ) / 1e3, latency.max() / 1e3, latency.mean() / 1e3 );
+        fclose( json );
+    }
+
+    return total.errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+/*
+ * Single thread libcornet echo server for tcp_echo_benchmark. Echoes every
+ * connection until peer closes it. Network backend is selected at library
+ * build time (USE_IO_URING in libcornet/config.hpp): build once with epoll
+ * and once with io_uring to compare them.
+ *
+ * usage: tcp_echo_server [port=10000]
+ */
+
+#include <csignal>
+#include <cstdio>
+#include <cstdint>
+#include <string>
+
+#include <libcornet/config.hpp>
+#include <libcornet/poller.hpp>
+#include <libcornet/tcp_socket.hpp>
+namespace net = pioneer19::cornet;
+
+#include <pioneer19_utils/coroutines_utils.hpp>
+using pioneer19::LinkedCoroutine;
+using pioneer19::CommonCoroutine;
+
+constexpr uint32_t BUFFER_SIZE = 16*1024;
+
+LinkedCoroutine echo_session( net::TcpSocket tcp_socket )
+{
+    uint8_t buffer[BUFFER_SIZE];
+    try
+    {
+        while( true )
+        {
+            auto bytes_read = co_await tcp_socket.async_read( buffer, sizeof(buffer) );
+            if( bytes_read <= 0 )
+                break;
+            ssize_t bytes_sent = 0;
+            while( bytes_sent < bytes_read )
+            {
+                auto res = co_await tcp_socket.async_write( buffer + bytes_sent, bytes_read - bytes_sent );
+                if( res <= 0 )
+                    co_return;
+                bytes_sent += res;
+            }
+        }
+    }
+    catch( const std::exception& ex )
+    {
+        printf( "echo session failed: %s\n", ex.what() );
+    }
+}
+
+CommonCoroutine run_server( net::Poller& poller, uint16_t port )
+{
+    net::TcpSocket tcp_socket{};
+    tcp_socket.bind( "::", port );
+    tcp_socket.listen( poller );
+
+    LinkedCoroutine::List sessions_list;
+    while( true )
+    {
+        net::TcpSocket client_socket = co_await tcp_socket.async_accept( poller, nullptr );
+        auto session = echo_session( std::move( client_socket ) );
+        session.link_promise( sessions_list );
+        session.start();
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    uint16_t port = argc > 1 ? std::stoul( argv[1] ) : 10000;
+#if defined(USE_IO_URING)
+    printf( "libcornet echo server (io_uring) on port %u\n", port );
+#else
+    printf( "libcornet echo server (epoll) on port %u\n", port );
+#endif
+
+    net::Poller poller;
+    auto coro = run_server( poller, port );
+
+    poller.run_on_signal( SIGINT, [&coro,&poller](){ coro.stop(); poller.stop();} );
+    poller.run_on_signal( SIGTERM, [&coro,&poller](){ coro.stop(); poller.stop();} );
+    poller.run();
+
+    return 0;
+}
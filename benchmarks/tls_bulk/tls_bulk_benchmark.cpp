@@ -0,0 +1,368 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+/*
+ * TLS bulk transfer benchmark: in process TlsSocket clients stream messages
+ * to TlsSocket server sessions over loopback (one poller thread) for every
+ * cipher suite and message sizes from 64 bytes to 1 MB.
+ *
+ * Reported per run:
+ *   GB/s          - payload bytes / transfer time (handshakes excluded)
+ *   syscalls/MB   - send/recv/read/write/epoll_wait... calls of both sides
+ *                   (io_uring submissions are not counted)
+ *   allocs/MB     - operator new calls of both sides
+ *   latency       - per message, from client async_write() start to message
+ *                   fully read by server (HDR histogram percentiles)
+ *
+ * usage: tls_bulk_benchmark [connections=1] [mbytes_per_run=64] [json_file]
+ */
+
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+#include <new>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+#include <libcornet/poller.hpp>
+#include <libcornet/tls/tls_socket.hpp>
+#include <libcornet/tls/key_store.hpp>
+#include <libcornet/tls/session_ticket.hpp>
+namespace net    = pioneer19::cornet;
+namespace tls    = pioneer19::cornet::tls13;
+
+#include <pioneer19_utils/coroutines_utils.hpp>
+using pioneer19::LinkedCoroutine;
+using pioneer19::CommonCoroutine;
+
+#include "../utils/hdr_histogram.hpp"
+#include "../utils/cipher_suites.hpp"
+#include "../utils/self_signed_certs.hpp"
+using pioneer19::cornet::benchmarks::SUITES;
+using pioneer19::cornet::benchmarks::HdrHistogram;
+using pioneer19::cornet::benchmarks::SelfSignedCerts;
+using pioneer19::cornet::benchmarks::set_preferred_suite;
+
+using Clock = std::chrono::steady_clock;
+
+constexpr const char* SERVER_NAME = "localhost";
+constexpr uint16_t BASE_PORT = 10200;
+constexpr uint32_t READ_BUFFER_SIZE = 64*1024;
+constexpr uint32_t MIN_MESSAGES = 16;
+constexpr uint32_t MESSAGE_SIZES[] = { 64, 256, 1024, 4*1024, 16*1024, 64*1024, 256*1024, 1024*1024 };
+
+/*
+ * allocation and syscall counters. Benchmark executable replaces global
+ * operator new and interposes libc socket calls (libcornet calls resolve to
+ * this definitions), real calls are found with dlsym( RTLD_NEXT ).
+ */
+static std::atomic<uint64_t> g_allocations = 0;
+static std::atomic<uint64_t> g_syscalls = 0;
+
+void* operator new( size_t size )
+{
+    g_allocations.fetch_add( 1, std::memory_order_relaxed );
+    void* ptr = malloc( size ? size : 1 );
+    if( ptr == nullptr )
+        throw std::bad_alloc();
+    return ptr;
+}
+void operator delete( void* ptr ) noexcept { free( ptr ); }
+void operator delete( void* ptr, size_t ) noexcept { free( ptr ); }
+
+template< typename FUNC >
+static FUNC next_symbol( const char* name )
+{
+    static_assert( sizeof(FUNC) == sizeof(void*) );
+    return reinterpret_cast<FUNC>( dlsym( RTLD_NEXT, name ) );
+}
+#define COUNTED_CALL( func, ... ) \
+    static auto real_func = next_symbol<decltype(&::func)>( #func ); \
+    g_syscalls.fetch_add( 1, std::memory_order_relaxed ); \
+    return real_func( __VA_ARGS__ )
+
+extern "C"
+{
+ssize_t send( int fd, const void* buf, size_t len, int flags )
+{ COUNTED_CALL( send, fd, buf, len, flags ); }
+ssize_t recv( int fd, void* buf, size_t len, int flags )
+{ COUNTED_CALL( recv, fd, buf, len, flags ); }
+ssize_t sendmsg( int fd, const struct msghdr* msg, int flags )
+{ COUNTED_CALL( sendmsg, fd, msg, flags ); }
+ssize_t recvmsg( int fd, struct msghdr* msg, int flags )
+{ COUNTED_CALL( recvmsg, fd, msg, flags ); }
+ssize_t read( int fd, void* buf, size_t count )
+{ COUNTED_CALL( read, fd, buf, count ); }
+ssize_t write( int fd, const void* buf, size_t count )
+{ COUNTED_CALL( write, fd, buf, count ); }
+ssize_t readv( int fd, const struct iovec* iov, int iovcnt )
+{ COUNTED_CALL( readv, fd, iov, iovcnt ); }
+ssize_t writev( int fd, const struct iovec* iov, int iovcnt )
+{ COUNTED_CALL( writev, fd, iov, iovcnt ); }
+int epoll_wait( int epfd, struct epoll_event* events, int maxevents, int timeout )
+{ COUNTED_CALL( epoll_wait, epfd, events, maxevents, timeout ); }
+}
+
+static uint64_t now_ns()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now().time_since_epoch() ).count();
+}
+
+struct RunResult
+{
+    uint64_t bytes = 0;
+    uint64_t messages = 0;
+    double   seconds = 0;
+    uint64_t syscalls = 0;
+    uint64_t allocations = 0;
+    HdrHistogram latency_ns;
+    bool     failed = false;
+};
+
+struct RunState
+{
+    net::Poller*   poller = nullptr;
+    tls::KeyStore* key_store = nullptr;
+    uint16_t port = 0;
+    uint32_t connections = 0;
+    uint32_t message_size = 0;
+    uint64_t messages_per_connection = 0;
+    uint32_t running_writers = 0;
+    LinkedCoroutine::List writers_list;
+
+    uint64_t syscalls_begin = 0;
+    uint64_t allocations_begin = 0;
+    Clock::time_point time_begin;
+    RunResult result;
+};
+
+/**
+ * server session reads stream of messages, first 8 bytes of every message
+ * are client send time. When all messages received sends 1 byte ack.
+ */
+LinkedCoroutine server_session( net::TcpSocket tcp_socket, RunState& state )
+{
+    try
+    {
+        auto tls_socket = co_await tls::TlsSocket::server_handshake( std::move(tcp_socket), state.key_store );
+        std::vector<uint8_t> buffer( READ_BUFFER_SIZE );
+        uint64_t bytes_expected = state.messages_per_connection * state.message_size;
+        uint64_t bytes_received = 0;
+        uint32_t message_offset = 0;
+        uint8_t  message_header[sizeof(uint64_t)];
+        while( bytes_received < bytes_expected )
+        {
+            uint32_t bytes_read = co_await tls_socket.async_read( buffer.data(), buffer.size() );
+            if( bytes_read == 0 )
+                break;
+            bytes_received += bytes_read;
+            uint32_t pos = 0;
+            while( pos < bytes_read )
+            {
+                uint32_t chunk_size = std::min( bytes_read - pos, state.message_size - message_offset );
+                if( message_offset < sizeof(message_header) )
+                {
+                    uint32_t header_part = std::min<uint32_t>( chunk_size, sizeof(message_header) - message_offset );
+                    std::memcpy( message_header + message_offset, buffer.data() + pos, header_part );
+                }
+                message_offset += chunk_size;
+                pos += chunk_size;
+                if( message_offset == state.message_size )
+                {
+                    uint64_t send_time_ns;
+                    std::memcpy( &send_time_ns, message_header, sizeof(send_time_ns) );
+                    state.result.latency_ns.record( now_ns() - send_time_ns );
+                    ++state.result.messages;
+                    message_offset = 0;
+                }
+            }
+        }
+        state.result.bytes += bytes_received;
+        uint8_t ack = 1;
+        co_await tls_socket.async_write( &ack, sizeof(ack) );
+    }
+    catch( const std::exception& ex )
+    {
+        printf( "server session failed: %s\n", ex.what() );
+    }
+}
+
+CommonCoroutine run_acceptor( net::Poller& poller, RunState& state )
+{
+    tls::TlsSocket listener{};
+    listener.bind( "::1", state.port );
+    listener.listen( poller );
+
+    LinkedCoroutine::List sessions_list;
+    while( true )
+    {
+        net::TcpSocket client_socket = co_await listener.async_accept_tcp( poller );
+        auto session = server_session( std::move(client_socket), state );
+        session.link_promise( sessions_list );
+        session.start();
+    }
+}
+
+static void finish_run( RunState& state )
+{
+    auto& result = state.result;
+    result.seconds = std::chrono::duration<double>( Clock::now() - state.time_begin ).count();
+    result.syscalls = g_syscalls.load( std::memory_order_relaxed ) - state.syscalls_begin;
+    result.allocations = g_allocations.load( std::memory_order_relaxed ) - state.allocations_begin;
+    state.poller->stop();
+}
+
+LinkedCoroutine run_writer( tls::TlsSocket& tls_socket, RunState& state )
+{
+    try
+    {
+        std::vector<uint8_t> message( state.message_size, 0x5a );
+        for( uint64_t i = 0; i < state.messages_per_connection; ++i )
+        {
+            uint64_t send_time_ns = now_ns();
+            std::memcpy( message.data(), &send_time_ns, sizeof(send_time_ns) );
+            co_await tls_socket.async_write( message.data(), message.size() );
+        }
+        // wait server got everything before socket is closed
+        uint8_t ack;
+        co_await tls_socket.async_read( &ack, sizeof(ack) );
+    }
+    catch( const std::exception& ex )
+    {
+        printf( "client writer failed: %s\n", ex.what() );
+        state.result.failed = true;
+    }
+    if( --state.running_writers == 0 )
+        finish_run( state );
+}
+
+/**
+ * connect all clients first, so transfer time and counters do not include handshakes
+ */
+CommonCoroutine run_clients( net::Poller& poller, RunState& state, std::vector<tls::TlsSocket>& sockets )
+{
+    for( auto& tls_socket : sockets )
+    {
+        if( !co_await tls_socket.async_connect( poller, "::1", state.port, SERVER_NAME ) )
+        {
+            printf( "client failed connect to [::1]:%u\n", state.port );
+            state.result.failed = true;
+            poller.stop();
+            co_return;
+        }
+    }
+
+    state.time_begin = Clock::now();
+    state.syscalls_begin = g_syscalls.load( std::memory_order_relaxed );
+    state.allocations_begin = g_allocations.load( std::memory_order_relaxed );
+    state.running_writers = sockets.size();
+    for( auto& tls_socket : sockets )
+    {
+        auto writer = run_writer( tls_socket, state );
+        writer.link_promise( state.writers_list );
+        writer.start();
+    }
+}
+
+static RunResult run_bulk( tls::KeyStore* key_store, uint16_t port
+        , uint32_t connections, uint32_t message_size, uint64_t bytes_per_run )
+{
+    net::Poller poller;
+    RunState state;
+    state.poller = &poller;
+    state.key_store = key_store;
+    state.port = port;
+    state.connections = connections;
+    state.message_size = message_size;
+    state.messages_per_connection = std::max<uint64_t>(
+            bytes_per_run / (uint64_t{message_size} * connections), MIN_MESSAGES );
+
+    auto acceptor = run_acceptor( poller, state );
+    std::vector<tls::TlsSocket> sockets( connections );
+    auto clients = run_clients( poller, state, sockets );
+    poller.run();
+    acceptor.stop();
+
+    return std::move( state.result );
+}
+
+int main( int argc, char* argv[] )
+{
+    uint32_t connections = argc > 1 ? std::max( std::stoul( argv[1] ), 1ul ) : 1;
+    uint64_t bytes_per_run = (argc > 2 ? std::stoull( argv[2] ) : 64) * 1024*1024;
+    const char* json_file_name = argc > 3 ? argv[3] : nullptr;
+
+    tls::SessionTicketKeys::instance().set_issue_tickets( false );
+    SelfSignedCerts certs;
+    auto key_store = certs.create_key_store( SERVER_NAME, "ecdsa", EVP_PKEY_EC );
+
+    FILE* json = json_file_name ? fopen( json_file_name, "w" ) : nullptr;
+    if( json )
+        fprintf( json, "{\n  \"benchmark\": \"tls_bulk\",\n  \"connections\": %u,\n  \"results\": [", connections );
+
+    printf( "connections %u\n", connections );
+    printf( "%-30s %8s %8s %12s %9s %10s %8s %8s %8s %8s %8s\n", "cipher_suite", "msg_size", "GB/s"
+            , "syscalls/MB", "allocs/MB", "messages", "p50 us", "p90 us", "p99 us", "p99.9 us", "max us" );
+    bool first = true;
+    uint16_t port = BASE_PORT;
+    for( auto& suite : SUITES )
+    {
+        set_preferred_suite( suite.cipher_suite );
+        for( auto message_size : MESSAGE_SIZES )
+        {
+            RunResult result = run_bulk( key_store.get(), port++, connections, message_size, bytes_per_run );
+            if( result.failed )
+            {
+                printf( "%-30s %8u failed\n", suite.name, message_size );
+                continue;
+            }
+
+            double mbytes = result.bytes / (1024.0*1024.0);
+            double gbytes_per_sec = result.bytes / result.seconds / 1e9;
+            double syscalls_per_mb = result.syscalls / mbytes;
+            double allocs_per_mb = result.allocations / mbytes;
+            auto& latency = result.latency_ns;
+            printf( "%-30s %8u %8.3f %12.1f %9.1f %10lu %8.1f %8.1f %8.1f %8.1f %8.1f\n"
+                    , suite.name, message_size, gbytes_per_sec, syscalls_per_mb, allocs_per_mb, result.messages
+                    , latency.value_at_percentile( 50 ) / 1e3, latency.value_at_percentile( 90 ) / 1e3
+                    , latency.value_at_percentile( 99 ) / 1e3, latency.value_at_percentile( 99.9 ) / 1e3
+                    , latency.max() / 1e3 );
+            if( json )
+            {
+                fprintf( json, "%s\n    {\"cipher_suite\": \"%s\", \"message_size\": %u, \"messages\": %lu"
+                               ", \"bytes\": %lu, \"seconds\": %.6f, \"gbytes_per_sec\": %.4f"
+                               ", \"syscalls_per_mb\": %.2f, \"allocations_per_mb\": %.2f"
+                               ", \"latency_us\": {\"p50\": %.1f, \"p90\": %.1f, \"p99\": %.1f, \"p99_9\": %.1f"
+                               ", \"max\": %.1f, \"mean\": %.1f}}"
+                         , first ? "" : ",", suite.name, message_size, result.messages, result.bytes
+                         , result.seconds, gbytes_per_sec, syscalls_per_mb, allocs_per_mb
+                         , latency.value_at_percentile( 50 ) / 1e3, latency.value_at_percentile( 90 ) / 1e3
+                         , latency.value_at_percentile( 99 ) / 1e3, latency.value_at_percentile( 99.9 ) / 1e3
+                         , latency.max() / 1e3, latency.mean() / 1e3 );
+            }
+            first = false;
+        }
+    }
+    if( json )
+    {
+        fprintf( json, "\n  ]\n}\n" );
+        fclose( json );
+    }
+
+    return 0;
+}
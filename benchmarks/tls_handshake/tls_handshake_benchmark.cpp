@@ -0,0 +1,368 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+/*
+ * TLS 1.3 handshake benchmark for every CipherSuite x NamedGroup x signature.
+ *
+ * phases: crypto of single handshake without sockets, rdtsc cycles of
+ *   client_hello  - client key pair and ClientHello record
+ *   parse         - server parse of ClientHello
+ *   key_share     - server key pair and DHE derive
+ *   signing       - CertificateVerify signature
+ *   finished      - handshake traffic secrets and both Finished verify_data
+ * handshakes: TlsSocket client and server in one poller over loopback,
+ *   handshakes/sec, cycles, encrypted records and bytes sent per handshake
+ *   (client + server)
+ *
+ * Keys and self signed certificates are generated at start, DHE key pool is
+ * disabled, so key generation is measured too.
+ *
+ * usage: tls_handshake_benchmark [iterations=500] [json_file]
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <stdexcept>
+
+#include <openssl/evp.h>
+
+#include <libcornet/poller.hpp>
+#include <libcornet/metrics.hpp>
+#include <libcornet/tls/parser.hpp>
+#include <libcornet/tls/tls_socket.hpp>
+#include <libcornet/tls/key_store.hpp>
+#include <libcornet/tls/record_helpers.hpp>
+#include <libcornet/tls/session_ticket.hpp>
+#include <libcornet/tls/crypto/dhe_key_pool.hpp>
+#include <libcornet/tls/crypto/tls_handshake.hpp>
+#include <libcornet/tls/crypto/record_cryptor.hpp>
+namespace net    = pioneer19::cornet;
+namespace tls    = pioneer19::cornet::tls13;
+namespace record = pioneer19::cornet::tls13::record;
+
+#include <pioneer19_utils/coroutines_utils.hpp>
+using pioneer19::LinkedCoroutine;
+using pioneer19::CommonCoroutine;
+
+#include "../utils/cipher_suites.hpp"
+#include "../utils/self_signed_certs.hpp"
+using pioneer19::cornet::benchmarks::SUITES;
+using pioneer19::cornet::benchmarks::SuiteInfo;
+using pioneer19::cornet::benchmarks::SelfSignedCerts;
+using pioneer19::cornet::benchmarks::set_preferred_suite;
+
+inline uint64_t rdtsc()
+{
+    uint32_t tickl, tickh;
+    __asm__ __volatile__("rdtsc":"=a"(tickl),"=d"(tickh));
+    return ( static_cast<uint64_t>(tickh) << 32u) | tickl;
+}
+
+constexpr const char* SERVER_NAME = "localhost";
+constexpr uint16_t BASE_PORT = 10100;
+constexpr uint32_t CLIENTS_CONCURRENCY = 8;
+
+struct GroupInfo
+{
+    const char* name;
+    record::NamedGroup named_group;
+};
+constexpr GroupInfo GROUPS[] = {
+        { "x25519", record::NamedGroup::X25519 }
+        ,{ "x448", record::NamedGroup::X448 }
+        ,{ "secp256r1", record::NamedGroup::SECP256R1 }
+        ,{ "secp384r1", record::NamedGroup::SECP384R1 }
+        ,{ "secp521r1", record::NamedGroup::SECP521R1 } };
+
+struct SignatureInfo
+{
+    const char* name;
+    record::SignatureScheme signature_scheme;
+    int key_type;
+};
+const SignatureInfo SIGNATURES[] = {
+        { "rsa_pss_rsae_sha256", record::SIGNATURE_SCHEME_RSA_PSS_RSAE_SHA256, EVP_PKEY_RSA }
+        ,{ "ecdsa_secp256r1_sha256", record::SIGNATURES_SCHEME_ECDSA_SECP256R1_SHA256, EVP_PKEY_EC }
+        ,{ "ed25519", record::SIGNATURE_SCHEME_ED25519, EVP_PKEY_ED25519 } };
+
+struct PhaseCycles
+{
+    uint64_t client_hello = 0;
+    uint64_t parse        = 0;
+    uint64_t key_share    = 0;
+    uint64_t signing      = 0;
+    uint64_t finished     = 0;
+};
+
+struct HandshakeResult
+{
+    uint64_t handshakes = 0;
+    uint64_t failed     = 0;
+    double   handshakes_per_sec   = 0;
+    uint64_t cycles_per_handshake = 0;
+    double   records_per_handshake = 0; ///< encrypted records
+    double   bytes_per_handshake   = 0; ///< bytes sent
+};
+
+struct KeyShareHook : public record::EmptyHook
+{
+    void key_share_entry( record::NamedGroup named_group, const uint8_t* data, uint16_t data_size )
+    {
+        key_group = named_group;
+        key_data = data;
+        key_size = data_size;
+    }
+    record::NamedGroup key_group = record::NamedGroup::TLS_PRIVATE_NAMED_GROUP;
+    const uint8_t* key_data = nullptr;
+    uint16_t key_size = 0;
+};
+
+static PhaseCycles measure_phases( const SuiteInfo& suite, const GroupInfo& group
+        , const SignatureInfo& signature, tls::DomainKeys* domain_keys, uint32_t iterations )
+{
+    set_preferred_suite( suite.cipher_suite );
+    PhaseCycles cycles;
+    uint8_t client_hello[2048];
+    uint8_t verify_data[EVP_MAX_MD_SIZE];
+    std::string server_name;
+    record::Parser parser;
+
+    for( uint32_t i = 0; i < iterations; ++i )
+    {
+        uint64_t tsc_begin = rdtsc();
+        tls::crypto::RecordCryptor client_cryptor;
+        tls::crypto::TlsHandshake client_handshake{ client_cryptor, SERVER_NAME, group.named_group };
+        client_handshake.m_hello_type = tls::crypto::TlsHandshake::HelloType::ClientHello;
+        uint32_t client_hello_size = tls::RecordHelpers::create_client_hello_record( client_handshake, client_hello );
+        uint64_t tsc_client_hello = rdtsc();
+
+        KeyShareHook hook;
+        auto [bytes_parsed, err] = parser.parse_net_record( &hook, client_hello, client_hello_size );
+        if( err || hook.key_data == nullptr )
+            throw std::runtime_error( "measure_phases() failed parse ClientHello" );
+        uint64_t tsc_parse = rdtsc();
+
+        tls::crypto::RecordCryptor server_cryptor;
+        tls::crypto::TlsHandshake server_handshake{ server_cryptor, server_name };
+        server_handshake.m_hello_type = tls::crypto::TlsHandshake::HelloType::ServerHello;
+        server_handshake.set_tls_cipher_suite( suite.cipher_suite );
+        server_handshake.add_message( record::handshake_message( client_hello )
+                                      ,record::record_content_size( client_hello ) );
+        server_handshake.set_named_group( hook.key_group );
+        server_handshake.set_handshake_hello_key_share( hook.key_group, hook.key_data, hook.key_size );
+        uint64_t tsc_key_share = rdtsc();
+
+        server_handshake.domain_keys = domain_keys;
+        server_handshake.cert_signature_scheme = signature.signature_scheme;
+        server_handshake.prepare_certificate_verify_signature();
+        uint64_t tsc_signing = rdtsc();
+
+        server_handshake.derive_client_server_traffic_secrets( false );
+        server_handshake.handshake_finished_create_verify_data( verify_data, true );
+        server_handshake.handshake_finished_create_verify_data( verify_data, false );
+        uint64_t tsc_finished = rdtsc();
+
+        cycles.client_hello += tsc_client_hello - tsc_begin;
+        cycles.parse        += tsc_parse - tsc_client_hello;
+        cycles.key_share    += tsc_key_share - tsc_parse;
+        cycles.signing      += tsc_signing - tsc_key_share;
+        cycles.finished     += tsc_finished - tsc_signing;
+    }
+    cycles.client_hello /= iterations;
+    cycles.parse        /= iterations;
+    cycles.key_share    /= iterations;
+    cycles.signing      /= iterations;
+    cycles.finished     /= iterations;
+
+    return cycles;
+}
+
+struct HandshakeState
+{
+    tls::KeyStore* key_store = nullptr;
+    uint16_t port = 0;
+    uint32_t handshakes_limit = 0;
+    uint32_t started = 0;
+    uint32_t running_clients = 0;
+    HandshakeResult result;
+};
+
+LinkedCoroutine server_session( net::TcpSocket tcp_socket, tls::KeyStore* key_store )
+{
+    try
+    {
+        co_await tls::TlsSocket::server_handshake( std::move(tcp_socket), key_store );
+    }
+    catch( const std::exception& ex )
+    {
+        printf( "server handshake failed: %s\n", ex.what() );
+    }
+}
+
+CommonCoroutine run_acceptor( net::Poller& poller, HandshakeState& state )
+{
+    tls::TlsSocket listener{};
+    listener.bind( "::1", state.port );
+    listener.listen( poller );
+
+    LinkedCoroutine::List sessions_list;
+    while( true )
+    {
+        net::TcpSocket client_socket = co_await listener.async_accept_tcp( poller );
+        auto session = server_session( std::move(client_socket), state.key_store );
+        session.link_promise( sessions_list );
+        session.start();
+    }
+}
+
+LinkedCoroutine run_client( net::Poller& poller, HandshakeState& state )
+{
+    while( state.started < state.handshakes_limit )
+    {
+        ++state.started;
+        tls::TlsSocket tls_socket{};
+        if( co_await tls_socket.async_connect( poller, "::1", state.port, SERVER_NAME ) )
+            ++state.result.handshakes;
+        else
+            ++state.result.failed;
+    }
+    if( --state.running_clients == 0 )
+        poller.stop();
+}
+
+static HandshakeResult measure_handshakes( const SuiteInfo& suite, tls::KeyStore* key_store
+        , uint16_t port, uint32_t handshakes )
+{
+    set_preferred_suite( suite.cipher_suite );
+
+    net::Poller poller;
+    HandshakeState state;
+    state.key_store = key_store;
+    state.port = port;
+    state.handshakes_limit = handshakes;
+    auto acceptor = run_acceptor( poller, state );
+
+    auto metrics_begin = net::MetricsRegistry::instance().collect();
+    auto time_begin = std::chrono::steady_clock::now();
+    uint64_t tsc_begin = rdtsc();
+    LinkedCoroutine::List clients_list;
+    state.running_clients = CLIENTS_CONCURRENCY;
+    for( uint32_t i = 0; i < CLIENTS_CONCURRENCY; ++i )
+    {
+        auto client = run_client( poller, state );
+        client.link_promise( clients_list );
+        client.start();
+    }
+    poller.run();
+    uint64_t tsc_end = rdtsc();
+    auto time_end = std::chrono::steady_clock::now();
+    auto metrics_end = net::MetricsRegistry::instance().collect();
+    acceptor.stop();
+
+    HandshakeResult& result = state.result;
+    double seconds = std::chrono::duration<double>( time_end - time_begin ).count();
+    if( result.handshakes > 0 )
+    {
+        result.handshakes_per_sec = result.handshakes / seconds;
+        result.cycles_per_handshake = (tsc_end - tsc_begin) / result.handshakes;
+        result.records_per_handshake = static_cast<double>(
+                metrics_end.counter( net::Counter::RECORDS_ENCRYPTED )
+                - metrics_begin.counter( net::Counter::RECORDS_ENCRYPTED ) ) / result.handshakes;
+        result.bytes_per_handshake = static_cast<double>(
+                metrics_end.counter( net::Counter::BYTES_OUT )
+                - metrics_begin.counter( net::Counter::BYTES_OUT ) ) / result.handshakes;
+    }
+    return result;
+}
+
+int main( int argc, char* argv[] )
+{
+    uint32_t iterations = argc > 1 ? std::max( std::stoul( argv[1] ), 1ul ) : 500;
+    const char* json_file_name = argc > 2 ? argv[2] : nullptr;
+
+    // measure full handshakes with key generation
+    tls::SessionTicketKeys::instance().set_issue_tickets( false );
+    tls::crypto::DheKeyPool::instance().set_pool_size( 0 );
+
+    SelfSignedCerts certs;
+    std::vector<std::unique_ptr<tls::SingleDomainKeyStore>> key_stores;
+    for( auto& signature : SIGNATURES )
+        key_stores.push_back( certs.create_key_store( SERVER_NAME, signature.name, signature.key_type ) );
+
+    FILE* json = json_file_name ? fopen( json_file_name, "w" ) : nullptr;
+    if( json )
+        fprintf( json, "{\n  \"benchmark\": \"tls_handshake\",\n  \"iterations\": %u,\n  \"phases\": [", iterations );
+
+    printf( "%-30s %-10s %-24s %12s %8s %10s %8s %9s\n", "cipher_suite", "group", "signature"
+            , "client_hello", "parse", "key_share", "signing", "finished" );
+    bool first = true;
+    for( auto& suite : SUITES )
+    {
+        for( auto& group : GROUPS )
+        {
+            for( uint32_t s = 0; s < std::size(SIGNATURES); ++s )
+            {
+                auto& signature = SIGNATURES[s];
+                auto* domain_keys = key_stores[s]->find( SERVER_NAME );
+                PhaseCycles cycles = measure_phases( suite, group, signature, domain_keys, iterations );
+                printf( "%-30s %-10s %-24s %12lu %8lu %10lu %8lu %9lu\n"
+                        , suite.name, group.name, signature.name, cycles.client_hello
+                        , cycles.parse, cycles.key_share, cycles.signing, cycles.finished );
+                if( json )
+                {
+                    fprintf( json, "%s\n    {\"cipher_suite\": \"%s\", \"named_group\": \"%s\", \"signature\": \"%s\""
+                                   ", \"client_hello_cycles\": %lu, \"parse_cycles\": %lu, \"key_share_cycles\": %lu"
+                                   ", \"signing_cycles\": %lu, \"finished_cycles\": %lu}"
+                             , first ? "" : ",", suite.name, group.name, signature.name
+                             , cycles.client_hello, cycles.parse, cycles.key_share, cycles.signing, cycles.finished );
+                }
+                first = false;
+            }
+        }
+    }
+
+    // TlsSocket client always offers x25519 key share
+    if( json )
+        fprintf( json, "\n  ],\n  \"handshakes\": [" );
+    printf( "\n%-30s %-10s %-24s %14s %12s %8s %8s %8s\n", "cipher_suite", "group", "signature"
+            , "handshakes/sec", "cycles", "records", "bytes", "failed" );
+    first = true;
+    uint16_t port = BASE_PORT;
+    for( auto& suite : SUITES )
+    {
+        for( uint32_t s = 0; s < std::size(SIGNATURES); ++s )
+        {
+            auto& signature = SIGNATURES[s];
+            HandshakeResult result = measure_handshakes( suite, key_stores[s].get(), port++, iterations );
+            printf( "%-30s %-10s %-24s %14.1f %12lu %8.2f %8.0f %8lu\n", suite.name, "x25519", signature.name
+                    , result.handshakes_per_sec, result.cycles_per_handshake
+                    , result.records_per_handshake, result.bytes_per_handshake, result.failed );
+            if( json )
+            {
+                fprintf( json, "%s\n    {\"cipher_suite\": \"%s\", \"named_group\": \"x25519\", \"signature\": \"%s\""
+                               ", \"handshakes\": %lu, \"failed\": %lu, \"handshakes_per_sec\": %.1f"
+                               ", \"cycles_per_handshake\": %lu, \"records_per_handshake\": %.2f"
+                               ", \"bytes_per_handshake\": %.0f}"
+                         , first ? "" : ",", suite.name, signature.name, result.handshakes, result.failed
+                         , result.handshakes_per_sec, result.cycles_per_handshake
+                         , result.records_per_handshake, result.bytes_per_handshake );
+            }
+            first = false;
+        }
+    }
+    if( json )
+    {
+        fprintf( json, "\n  ]\n}\n" );
+        fclose( json );
+    }
+
+    return 0;
+}
@@ -0,0 +1,44 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <libcornet/tls/types.hpp>
+#include <libcornet/tls/crypto/cipher_preference.hpp>
+
+namespace pioneer19::cornet::benchmarks
+{
+
+struct SuiteInfo
+{
+    const char* name;
+    tls13::record::CipherSuite cipher_suite;
+};
+constexpr SuiteInfo SUITES[] = {
+        { "TLS_AES_128_GCM_SHA256", tls13::record::TLS_AES_128_GCM_SHA256 }
+        ,{ "TLS_AES_256_GCM_SHA384", tls13::record::TLS_AES_256_GCM_SHA384 }
+        ,{ "TLS_CHACHA20_POLY1305_SHA256", tls13::record::TLS_CHACHA20_POLY1305_SHA256 } };
+
+/**
+ * make cipher_suite most preferred, so server selects it for any client
+ */
+inline void set_preferred_suite( tls13::record::CipherSuite cipher_suite )
+{
+    tls13::record::CipherSuite order[tls13::crypto::CipherSuitePreference::SUITES_COUNT];
+    uint32_t count = 0;
+    order[count++] = cipher_suite;
+    for( auto& suite : SUITES )
+    {
+        if( !(suite.cipher_suite == cipher_suite) )
+            order[count++] = suite.cipher_suite;
+    }
+    tls13::crypto::CipherSuitePreference::instance().set_order( order );
+}
+
+}
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <array>
+#include <limits>
+
+namespace pioneer19::cornet::benchmarks
+{
+
+/**
+ * @brief fixed memory log-linear histogram (HDR like) for latencies
+ *
+ * Values below SUB_BUCKETS are exact, bigger values are bucketed with
+ * SUB_BUCKETS/2 buckets per power of two, so relative error is below
+ * 2/SUB_BUCKETS (1.6%) for whole uint64_t range. record() is O(1) and
+ * does not allocate.
+ */
+class HdrHistogram
+{
+public:
+    static constexpr uint32_t SUB_BUCKET_BITS = 7;
+    static constexpr uint32_t SUB_BUCKETS = 1u << SUB_BUCKET_BITS;
+    static constexpr uint32_t HALF_SUB_BUCKETS = SUB_BUCKETS / 2;
+    static constexpr uint32_t BUCKETS_COUNT = (64 - SUB_BUCKET_BITS + 1) * HALF_SUB_BUCKETS + SUB_BUCKETS;
+
+    void record( uint64_t value ) noexcept
+    {
+        ++m_counts[bucket_index( value )];
+        ++m_total_count;
+        m_sum += value;
+        if( value < m_min ) m_min = value;
+        if( value > m_max ) m_max = value;
+    }
+    void merge( const HdrHistogram& other ) noexcept
+    {
+        for( uint32_t i = 0; i < BUCKETS_COUNT; ++i )
+            m_counts[i] += other.m_counts[i];
+        m_total_count += other.m_total_count;
+        m_sum += other.m_sum;
+        if( other.m_min < m_min ) m_min = other.m_min;
+        if( other.m_max > m_max ) m_max = other.m_max;
+    }
+    void reset() noexcept
+    {
+        m_counts.fill( 0 );
+        m_total_count = 0;
+        m_sum = 0;
+        m_min = std::numeric_limits<uint64_t>::max();
+        m_max = 0;
+    }
+
+    [[nodiscard]]
+    uint64_t count() const noexcept { return m_total_count; }
+    [[nodiscard]]
+    uint64_t min() const noexcept { return m_total_count ? m_min : 0; }
+    [[nodiscard]]
+    uint64_t max() const noexcept { return m_max; }
+    [[nodiscard]]
+    double mean() const noexcept { return m_total_count ? double(m_sum) / m_total_count : 0; }
+    /**
+     * @param percentile in range [0,100]
+     * @return highest value equivalent to value at percentile (clamped to max)
+     */
+    [[nodiscard]]
+    uint64_t value_at_percentile( double percentile ) const noexcept
+    {
+        if( m_total_count == 0 )
+            return 0;
+        auto count_at_percentile = static_cast<uint64_t>( percentile / 100.0 * m_total_count + 0.5 );
+        if( count_at_percentile == 0 )
+            count_at_percentile = 1;
+        uint64_t counted = 0;
+        for( uint32_t i = 0; i < BUCKETS_COUNT; ++i )
+        {
+            counted += m_counts[i];
+            if( counted >= count_at_percentile )
+            {
+                uint64_t value = highest_equivalent_value( i );
+                return value < m_max ? value : m_max;
+            }
+        }
+        return m_max;
+    }
+
+private:
+    static uint32_t bucket_index( uint64_t value ) noexcept
+    {
+        if( value < SUB_BUCKETS )
+            return static_cast<uint32_t>( value );
+        uint32_t shift = 63 - __builtin_clzll( value ) - (SUB_BUCKET_BITS - 1);
+        return shift * HALF_SUB_BUCKETS + static_cast<uint32_t>( value >> shift );
+    }
+    static uint64_t highest_equivalent_value( uint32_t index ) noexcept
+    {
+        if( index < SUB_BUCKETS )
+            return index;
+        uint32_t shift = index / HALF_SUB_BUCKETS - 1;
+        uint64_t sub_bucket = index % HALF_SUB_BUCKETS + HALF_SUB_BUCKETS;
+        return (sub_bucket << shift) + ((uint64_t{1} << shift) - 1);
+    }
+
+    std::array<uint64_t,BUCKETS_COUNT> m_counts = {};
+    uint64_t m_total_count = 0;
+    uint64_t m_sum = 0;
+    uint64_t m_min = std::numeric_limits<uint64_t>::max();
+    uint64_t m_max = 0;
+};
+
+}
@@ -0,0 +1,145 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+#include <openssl/evp.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+#include <openssl/rsa.h>
+#include <openssl/ec.h>
+
+#include <libcornet/tls/key_store.hpp>
+#include <libcornet/tls/tls_trusted_certs.hpp>
+
+namespace pioneer19::cornet::benchmarks
+{
+
+/**
+ * @brief self signed keys and certificates in temporary directory
+ *
+ * Benchmarks do not depend on key files in current directory: key and
+ * certificate are generated, written to temporary directory (removed in
+ * destructor) and certificate is added to trusted store of calling thread.
+ */
+class SelfSignedCerts
+{
+public:
+    SelfSignedCerts();
+    ~SelfSignedCerts();
+
+    /**
+     * @param key_type EVP_PKEY_RSA (2048 bits), EVP_PKEY_EC (P-256) or EVP_PKEY_ED25519
+     */
+    std::unique_ptr<tls13::SingleDomainKeyStore> create_key_store(
+            const char* domain_name, const char* name, int key_type );
+
+    SelfSignedCerts( const SelfSignedCerts& ) = delete;
+    SelfSignedCerts( SelfSignedCerts&& )      = delete;
+    SelfSignedCerts& operator=( const SelfSignedCerts& ) = delete;
+    SelfSignedCerts& operator=( SelfSignedCerts&& )      = delete;
+
+private:
+    static EVP_PKEY* generate_key( int key_type );
+    static X509* create_certificate( EVP_PKEY* key, const char* domain_name );
+
+    std::string m_dir;
+    std::vector<std::string> m_files;
+};
+
+inline SelfSignedCerts::SelfSignedCerts()
+{
+    char dir_template[] = "/tmp/libcornet_benchmark.XXXXXX";
+    if( mkdtemp( dir_template ) == nullptr )
+        throw std::runtime_error( "SelfSignedCerts failed create temporary directory" );
+    m_dir = dir_template;
+}
+
+inline SelfSignedCerts::~SelfSignedCerts()
+{
+    for( auto& file_name : m_files )
+        unlink( file_name.c_str() );
+    rmdir( m_dir.c_str() );
+}
+
+inline EVP_PKEY* SelfSignedCerts::generate_key( int key_type )
+{
+    EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id( key_type, nullptr );
+    EVP_PKEY* key = nullptr;
+    if( pctx == nullptr || EVP_PKEY_keygen_init( pctx ) != 1 )
+        throw std::runtime_error( "SelfSignedCerts::generate_key failed init keygen" );
+    if( key_type == EVP_PKEY_RSA )
+        EVP_PKEY_CTX_set_rsa_keygen_bits( pctx, 2048 );
+    if( key_type == EVP_PKEY_EC )
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid( pctx, NID_X9_62_prime256v1 );
+    int res = EVP_PKEY_keygen( pctx, &key );
+    EVP_PKEY_CTX_free( pctx );
+    if( res != 1 )
+        throw std::runtime_error( "SelfSignedCerts::generate_key failed keygen" );
+
+    return key;
+}
+
+inline X509* SelfSignedCerts::create_certificate( EVP_PKEY* key, const char* domain_name )
+{
+    X509* cert = X509_new();
+    X509_set_version( cert, 2 );
+    ASN1_INTEGER_set( X509_get_serialNumber( cert ), 1 );
+    X509_gmtime_adj( X509_getm_notBefore( cert ), -3600 );
+    X509_gmtime_adj( X509_getm_notAfter( cert ), 24*3600 );
+    X509_set_pubkey( cert, key );
+    X509_NAME* name = X509_get_subject_name( cert );
+    X509_NAME_add_entry_by_txt( name, "CN", MBSTRING_ASC
+                                , reinterpret_cast<const unsigned char*>(domain_name), -1, -1, 0 );
+    X509_set_issuer_name( cert, name );
+    std::string alt_name = std::string( "DNS:" ) + domain_name;
+    X509_EXTENSION* san = X509V3_EXT_conf_nid( nullptr, nullptr, NID_subject_alt_name, alt_name.data() );
+    X509_add_ext( cert, san, -1 );
+    X509_EXTENSION_free( san );
+
+    // ed25519 signs without separate digest
+    const EVP_MD* md = EVP_PKEY_id( key ) == EVP_PKEY_ED25519 ? nullptr : EVP_sha256();
+    if( X509_sign( cert, key, md ) == 0 )
+        throw std::runtime_error( "SelfSignedCerts::create_certificate failed sign certificate" );
+
+    return cert;
+}
+
+inline std::unique_ptr<tls13::SingleDomainKeyStore> SelfSignedCerts::create_key_store(
+        const char* domain_name, const char* name, int key_type )
+{
+    EVP_PKEY* key = generate_key( key_type );
+    X509* cert = create_certificate( key, domain_name );
+
+    std::string key_file  = m_dir + "/" + name + "_key.pem";
+    std::string cert_file = m_dir + "/" + name + "_cert.pem";
+    m_files.push_back( key_file );
+    m_files.push_back( cert_file );
+    FILE* file = fopen( key_file.c_str(), "w" );
+    PEM_write_PrivateKey( file, key, nullptr, nullptr, 0, nullptr, nullptr );
+    fclose( file );
+    file = fopen( cert_file.c_str(), "w" );
+    PEM_write_X509( file, cert );
+    fclose( file );
+
+    X509_STORE_add_cert( tls13::TlsTrustedCerts::store_instance(), cert );
+    X509_free( cert );
+    EVP_PKEY_free( key );
+
+    return std::make_unique<tls13::SingleDomainKeyStore>( domain_name, key_file.c_str(), cert_file.c_str() );
+}
+
+}
@@ -10,12 +10,44 @@
 
 #include <cstring>
 #include <unistd.h>
+#include <thread>
 #include <system_error>
 #include <iostream>
 
+/**
+ * blocking echo of one connection until peer closes it
+ */
+static void echo_session( int client_fd )
+{
+    char buff[16*1024];
+    while( true )
+    {
+        ssize_t bytes_read = recv( client_fd, buff, sizeof( buff ), 0 );
+        if( bytes_read <= 0 )
+        {
+            if( bytes_read == -1 )
+                std::cerr << "recv failed " << strerror(errno) << "\n";
+            break;
+        }
+        ssize_t bytes_sent = 0;
+        while( bytes_sent < bytes_read )
+        {
+            ssize_t res = send( client_fd, buff + bytes_sent, bytes_read - bytes_sent, MSG_NOSIGNAL );
+            if( res == -1 )
+            {
+                std::cerr << "send failed " << strerror(errno) << "\n";
+                close( client_fd );
+                return;
+            }
+            bytes_sent += res;
+        }
+    }
+    close( client_fd );
+}
+
 int main()
 {
-    std::cout << "Single thread echo server\n";
+    std::cout << "Blocking echo server (thread per connection)\n";
 
     int server_fd = socket( AF_INET, SOCK_STREAM, 0 );
     if( server_fd == -1 )
@@ -44,23 +76,7 @@ int main()
         if( client_fd == -1 )
             throw std::system_error(errno, std::system_category(), "accept failed" );
 
-        char buff[1024];
-        ssize_t net_io_res = recv( client_fd, buff, sizeof( buff ), 0 );
-        if( net_io_res == -1 )
-        {
-            std::cerr << "recv failed" << strerror(errno) << "\n";
-            close( client_fd );
-            continue;
-        }
-        net_io_res = send( client_fd, buff, net_io_res, MSG_NOSIGNAL );
-        if( net_io_res == -1 )
-        {
-            std::cerr << "send failed" << strerror(errno) << "\n";
-            close( client_fd );
-            continue;
-        }
-        std::cout << "sent back " << net_io_res << " bytes" << std::endl;
-        close( client_fd );
+        std::thread( echo_session, client_fd ).detach();
     }
 
     return 0;
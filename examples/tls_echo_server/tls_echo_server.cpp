@@ -8,10 +8,14 @@
 #include <unistd.h>
 
 #include <cstdio>
+#include <chrono>
 #include <string>
 #include <memory>
+#include <optional>
 
 #include <libcornet/tls/tls_socket.hpp>
+#include <libcornet/tls/connection_drainer.hpp>
+#include <libcornet/tls/crypto/cipher_preference.hpp>
 #include <libcornet/poller.hpp>
 namespace net = pioneer19::cornet;
 
@@ -19,37 +23,87 @@ namespace net = pioneer19::cornet;
 using pioneer19::LinkedCoroutine;
 using pioneer19::CommonCoroutine;
 
-LinkedCoroutine create_session( net::tls13::TlsSocket tls_socket )
-{
-    uint8_t buffer[1024];
-    auto bytes_read = co_await tls_socket.async_read( buffer, sizeof(buffer) );
-    printf( "tls server read %u bytes from client socket\n", bytes_read );
-    co_await tls_socket.async_write( buffer, bytes_read );
-}
+constexpr std::chrono::milliseconds DRAIN_TIMEOUT{ 5000 };
 
-CommonCoroutine run_server( net::Poller& poller, const char* ip_address, size_t session_count )
+LinkedCoroutine create_session( net::TcpSocket tcp_socket, net::tls13::KeyStore* key_store
+                                , net::tls13::ConnectionDrainer& drainer )
 {
-    net::tls13::TlsSocket tls_socket{};
-    tls_socket.bind( ip_address, 10000 );
-    tls_socket.listen( poller );
-    printf( "Tls server listening\n" );
-
-    LinkedCoroutine::List tls_sessions_list;
-    std::unique_ptr<net::tls13::SingleDomainKeyStore> key_store { new net::tls13::SingleDomainKeyStore(
-            SNI_HOSTNAME, "./key.pem", "./cert.pem", "./cert_chain.pem" ) };
-
-    for( size_t i = 0; session_count==0 || i < session_count; ++i ) // infinite for session_count == 0
+    // session is counted by drainer from accept, so shutdown waits for handshakes too
+    net::tls13::ConnectionDrainer::Session drain_session{ drainer };
+    // handshake runs in session coroutine, so slow client does not block accept loop
+    std::optional<net::tls13::TlsSocket> session_socket;
+    try
     {
-        net::tls13::TlsSocket client_socket = co_await tls_socket.async_accept(
-                poller, nullptr, key_store.get() );
-        printf( "tls server got connected socket, (count=%lu)\n", i );
+        session_socket.emplace( co_await net::tls13::TlsSocket::server_handshake(
+                std::move( tcp_socket ), key_store ) );
+    }
+    catch( const std::exception& ex )
+    {
+        printf( "tls server handshake failed: %s\n", ex.what() );
+        co_return;
+    }
+    net::tls13::TlsSocket& tls_socket = *session_socket;
+    drain_session.set_socket( &tls_socket );
 
-        auto session = create_session( std::move( client_socket ) );
-        session.link_promise( tls_sessions_list );
-        session.start();
+    try
+    {
+        uint8_t buffer[1024];
+        drain_session.set_idle( true );
+        auto bytes_read = co_await tls_socket.async_read( buffer, sizeof(buffer) );
+        drain_session.set_idle( false );
+        if( bytes_read > 0 )
+        {
+            printf( "tls server read %u bytes from client socket\n", bytes_read );
+            co_await tls_socket.async_write( buffer, bytes_read );
+        }
+        co_await tls_socket.async_close_notify();
+    }
+    catch( const std::exception& ex )
+    {
+        printf( "tls server session failed: %s\n", ex.what() );
     }
-    // FIXME: close server socket and co_await while tls_session_list become empty
+}
 
+CommonCoroutine run_server( net::Poller& poller, const char* ip_address, size_t session_count
+                            , net::tls13::KeyStore* key_store, net::tls13::ConnectionDrainer& drainer
+                            , LinkedCoroutine::List& tls_sessions_list )
+{
+    {
+        net::tls13::TlsSocket tls_socket{};
+        tls_socket.bind( ip_address, 10000 );
+        tls_socket.listen( poller );
+        printf( "Tls server listening\n" );
+
+        for( size_t i = 0; session_count==0 || i < session_count; ++i ) // infinite for session_count == 0
+        {
+            net::TcpSocket client_socket = co_await tls_socket.async_accept_tcp( poller );
+            printf( "tls server got connected socket, (count=%lu)\n", i );
+
+            auto session = create_session( std::move( client_socket ), key_store, drainer );
+            session.link_promise( tls_sessions_list );
+            session.start();
+        }
+    } // server socket closed
+
+    co_await drainer.wait_finished( poller );
+    poller.stop();
+}
+
+/**
+ * graceful shutdown: stop accepting, close idle sessions with close_notify,
+ * wait in-flight sessions until DRAIN_TIMEOUT, then stop poller
+ */
+LinkedCoroutine shutdown_server( net::Poller& poller, CommonCoroutine& server_coro
+                                 , net::tls13::ConnectionDrainer& drainer )
+{
+    server_coro.stop();
+    printf( "tls server draining %zu sessions\n", drainer.sessions_count() );
+
+    bool drained = co_await drainer.drain( poller, DRAIN_TIMEOUT );
+    if( drained )
+        printf( "tls server drained\n" );
+    else
+        printf( "tls server drain timeout, %zu sessions dropped\n", drainer.sessions_count() );
     poller.stop();
 }
 
@@ -69,14 +123,28 @@ int main( int argc, char *argv[] )
     }
 
     printf( "Polling tls echo server (single thread)\n" );
+    // order server cipher suites by measured on this cpu encryption speed
+    net::tls13::crypto::CipherSuitePreference::instance().measure_throughput();
 
     net::Poller poller;
-
-    auto coro = run_server( poller, "::1", session_limit );
-
-    poller.run_on_signal( SIGINT, [&coro,&poller](){ coro.stop(); poller.stop();} );
-    poller.run_on_signal( SIGHUP, [&coro,&poller](){ coro.stop(); poller.stop();} );
-    //poller.run_on_signal( SIGINT, [](){puts("SIGQUIT");} );
+    std::unique_ptr<net::tls13::SingleDomainKeyStore> key_store { new net::tls13::SingleDomainKeyStore(
+            SNI_HOSTNAME, "./key.pem", "./cert.pem", "./cert_chain.pem" ) };
+    // drainer and sessions must outlive poller loop
+    net::tls13::ConnectionDrainer drainer;
+    LinkedCoroutine::List tls_sessions_list;
+    LinkedCoroutine::List shutdown_list;
+
+    auto coro = run_server( poller, "::1", session_limit, key_store.get(), drainer, tls_sessions_list );
+
+    auto graceful_shutdown = [&coro,&poller,&drainer,&shutdown_list](){
+        if( drainer.draining() )
+            return;
+        auto shutdown = shutdown_server( poller, coro, drainer );
+        shutdown.link_promise( shutdown_list );
+        shutdown.start();
+    };
+    poller.run_on_signal( SIGINT,  graceful_shutdown );
+    poller.run_on_signal( SIGTERM, graceful_shutdown );
     poller.run();
 
     return 0;
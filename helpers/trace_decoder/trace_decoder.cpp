@@ -0,0 +1,134 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <cinttypes>
+#include <ctime>
+
+#include <vector>
+
+#include <libcornet/trace.hpp>
+
+namespace net = pioneer19::cornet;
+
+const char* content_type_name( uint8_t content_type )
+{
+    switch( content_type )
+    {
+        case 0:  return "-";
+        case 20: return "change_cipher_spec";
+        case 21: return "alert";
+        case 22: return "handshake";
+        case 23: return "application_data";
+        default: return "unknown";
+    }
+}
+
+const char* handshake_type_name( uint8_t handshake_type )
+{
+    switch( handshake_type )
+    {
+        case 1:   return "client_hello";
+        case 2:   return "server_hello";
+        case 4:   return "new_session_ticket";
+        case 5:   return "end_of_early_data";
+        case 8:   return "encrypted_extensions";
+        case 11:  return "certificate";
+        case 13:  return "certificate_request";
+        case 15:  return "certificate_verify";
+        case 20:  return "finished";
+        case 24:  return "key_update";
+        case 254: return "message_hash";
+        default:  return "unknown";
+    }
+}
+
+bool print_dump( const char* file_name )
+{
+    FILE* file = fopen( file_name, "rb" );
+    if( file == nullptr )
+    {
+        fprintf( stderr, "%s: can't open: %s\n", file_name, strerror( errno ) );
+        return false;
+    }
+
+    net::TraceFileHeader header{};
+    if( fread( &header, sizeof(header), 1, file ) != 1
+        || memcmp( header.magic, net::TraceFileHeader::MAGIC, sizeof(header.magic) ) != 0 )
+    {
+        fprintf( stderr, "%s: not a libcornet trace dump\n", file_name );
+        fclose( file );
+        return false;
+    }
+    if( header.version != net::TraceFileHeader::VERSION || header.record_size != sizeof(net::TraceRecord) )
+    {
+        fprintf( stderr, "%s: unsupported trace version %" PRIu32 " record size %" PRIu32 "\n"
+                 , file_name, header.version, header.record_size );
+        fclose( file );
+        return false;
+    }
+
+    std::vector<net::TraceRecord> records( header.records_count );
+    size_t records_read = fread( records.data(), sizeof(net::TraceRecord), records.size(), file );
+    fclose( file );
+    if( records_read != records.size() )
+        fprintf( stderr, "%s: truncated, read %zu records of %zu\n", file_name, records_read, records.size() );
+    records.resize( records_read );
+
+    printf( "%s: thread %" PRIu32 " records %zu lost %" PRIu64 "\n"
+            , file_name, header.thread_index, records.size(), header.lost_count );
+    if( records.empty() )
+        return true;
+
+    uint64_t first_tsc = records.front().tsc;
+    for( const auto& record : records )
+    {
+        // tsc -> wall clock through dump time point
+        auto ns_before_dump = static_cast<int64_t>( (header.dump_tsc - record.tsc) * header.ns_per_cycle );
+        int64_t realtime_ns = header.dump_realtime_ns - ns_before_dump;
+        time_t seconds = realtime_ns / 1'000'000'000;
+        struct tm tm_time{};
+        gmtime_r( &seconds, &tm_time );
+        char time_string[32];
+        strftime( time_string, sizeof(time_string), "%H:%M:%S", &tm_time );
+
+        double relative_us = static_cast<double>( record.tsc - first_tsc ) * header.ns_per_cycle / 1000.0;
+
+        printf( "%s.%09" PRId64 " +%12.3f us  conn %5" PRIu64 ":%-8" PRIu64 " %-20s"
+                , time_string, realtime_ns % 1'000'000'000, relative_us
+                , record.connection_id >> 48u, record.connection_id & ((uint64_t{1} << 48u) - 1)
+                , net::trace_event_name( record.event ) );
+        if( record.content_type != 0 )
+        {
+            printf( " %s", content_type_name( record.content_type ) );
+            if( record.handshake_type != 0 )
+                printf( "/%s", handshake_type_name( record.handshake_type ) );
+        }
+        printf( " size %" PRIu32 " extra %" PRIu32 "\n", record.size, record.extra );
+    }
+
+    return true;
+}
+
+int main( int argc, char* argv[] )
+{
+    if( argc < 2 )
+    {
+        fprintf( stderr, "usage: %s <trace dump file>...\n", argv[0] );
+        return 1;
+    }
+
+    int res = 0;
+    for( int i = 1; i < argc; ++i )
+    {
+        if( !print_dump( argv[i] ) )
+            res = 1;
+    }
+
+    return res;
+}
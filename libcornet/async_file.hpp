@@ -81,6 +81,7 @@ inline bool AsyncFile::ReadAwaiter::await_ready()
 inline void AsyncFile::ReadAwaiter::await_suspend( std::experimental::coroutine_handle<> coro_handle )
 {
     m_poller_cb.reader_coro_handle = coro_handle;
+    m_poller_cb.reader_site = "AsyncFile::async_read";
 }
 
 inline ssize_t AsyncFile::ReadAwaiter::await_resume()
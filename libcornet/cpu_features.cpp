@@ -0,0 +1,78 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/cpu_features.hpp>
+
+#include <cstdint>
+
+namespace pioneer19::cornet
+{
+
+#if defined(__i386) || defined(__x86_64__)
+// EAX:ECX used to specify CPUID leaf:subleaf
+static inline void cpuidx( uint32_t& eax, uint32_t& ebx, uint32_t& ecx, uint32_t& edx )
+{
+    __asm__ __volatile__ ( "cpuid"
+    : "+a" (eax), "=b" (ebx), "+c" (ecx), "=d" (edx) );
+}
+// read extended control register (XCR0 for ecx=0), needs OSXSAVE
+static inline uint64_t xgetbv( uint32_t ecx )
+{
+    uint32_t eax, edx;
+    __asm__ __volatile__ ( "xgetbv" : "=a" (eax), "=d" (edx) : "c" (ecx) );
+    return ( static_cast<uint64_t>(edx) << 32 ) | eax;
+}
+
+CpuFeatures CpuFeatures::detect() noexcept
+{
+    CpuFeatures features;
+
+    uint32_t eax = 0, ebx = 0, ecx = 0, edx = 0;
+    cpuidx( eax, ebx, ecx, edx );
+    uint32_t max_leaf = eax;
+    if( max_leaf < 1 )
+        return features;
+
+    eax = 1; ecx = 0;
+    cpuidx( eax, ebx, ecx, edx );
+    features.pclmulqdq = ecx & (1u << 1);
+    features.aes_ni    = ecx & (1u << 25);
+    bool osxsave       = ecx & (1u << 27);
+    bool avx_cpu       = ecx & (1u << 28);
+
+    // ymm (bits 1,2) and zmm (bits 5,6,7) state must be saved by OS
+    uint64_t xcr0 = osxsave ? xgetbv( 0 ) : 0;
+    bool ymm_enabled = (xcr0 & 0x06) == 0x06;
+    bool zmm_enabled = (xcr0 & 0xe6) == 0xe6;
+    features.avx = avx_cpu && ymm_enabled;
+
+    if( max_leaf < 7 )
+        return features;
+
+    eax = 7; ecx = 0;
+    cpuidx( eax, ebx, ecx, edx );
+    features.avx2       = features.avx && (ebx & (1u << 5));
+    features.avx512f    = zmm_enabled  && (ebx & (1u << 16));
+    features.vaes       = features.avx && (ecx & (1u << 9));
+    features.vpclmulqdq = features.avx && (ecx & (1u << 10));
+
+    return features;
+}
+#else
+CpuFeatures CpuFeatures::detect() noexcept
+{
+    return CpuFeatures{};
+}
+#endif
+
+const CpuFeatures& CpuFeatures::instance() noexcept
+{
+    static const CpuFeatures features = detect();
+    return features;
+}
+
+}
@@ -0,0 +1,39 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+namespace pioneer19::cornet
+{
+
+/**
+ * @brief x86 cpu features used to choose record cipher (all false on other cpus)
+ */
+struct CpuFeatures
+{
+    bool aes_ni     = false; ///< AES round instructions
+    bool pclmulqdq  = false; ///< carry-less multiplication for GHASH
+    bool avx        = false; ///< AVX with OS saved ymm state
+    bool avx2       = false;
+    bool avx512f    = false; ///< AVX-512 with OS saved zmm state
+    bool vaes       = false; ///< AES on ymm/zmm registers
+    bool vpclmulqdq = false; ///< carry-less multiplication on ymm/zmm registers
+
+    /// AES-GCM runs in hardware
+    [[nodiscard]]
+    bool fast_aes_gcm() const noexcept { return aes_ni && pclmulqdq; }
+    /// AES-GCM runs several blocks per instruction (VAES with AVX2 or AVX-512)
+    [[nodiscard]]
+    bool wide_aes_gcm() const noexcept
+    { return fast_aes_gcm() && vaes && vpclmulqdq && ( avx2 || avx512f ); }
+
+    /// features of current cpu, detected once per process
+    static const CpuFeatures& instance() noexcept;
+    static CpuFeatures detect() noexcept;
+};
+
+}
@@ -0,0 +1,74 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/loop_profiler.hpp>
+
+#include <cinttypes>
+#include <thread>
+#include <algorithm>
+
+namespace pioneer19::cornet
+{
+
+LoopProfiler& LoopProfiler::instance()
+{
+    static thread_local LoopProfiler loop_profiler;
+
+    return loop_profiler;
+}
+
+LoopProfiler::LoopProfiler()
+    :m_metrics{ ThreadMetrics::instance() }
+    ,m_ns_per_cycle{ ns_per_cycle() }
+{
+    set_stall_threshold( DEFAULT_STALL_THRESHOLD );
+}
+
+double LoopProfiler::ns_per_cycle()
+{
+    static const double ns_per_cycle = [](){
+        auto begin_time = std::chrono::steady_clock::now();
+        uint64_t begin_tsc = rdtsc();
+        std::this_thread::sleep_for( std::chrono::milliseconds{10} );
+        uint64_t end_tsc = rdtsc();
+        auto end_time = std::chrono::steady_clock::now();
+
+        auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>( end_time - begin_time );
+        return static_cast<double>( duration.count() ) / static_cast<double>( end_tsc - begin_tsc );
+    }();
+
+    return ns_per_cycle;
+}
+
+void LoopProfiler::set_stall_threshold( std::chrono::nanoseconds threshold ) noexcept
+{
+    m_stall_threshold_cycles = static_cast<uint64_t>( threshold.count() / m_ns_per_cycle );
+}
+
+std::vector<CoroutineStall> LoopProfiler::stalls() const
+{
+    std::vector<CoroutineStall> stalls;
+    uint64_t stalls_kept = std::min( m_stalls_count, uint64_t{STALLS_CAPACITY} );
+    stalls.reserve( stalls_kept );
+    for( uint64_t i = m_stalls_count - stalls_kept; i < m_stalls_count; ++i )
+        stalls.push_back( m_stalls[i % STALLS_CAPACITY] );
+
+    return stalls;
+}
+
+void LoopProfiler::print_stalls( FILE* out ) const
+{
+    fprintf( out, "coroutine stalls %" PRIu64 "\n", m_stalls_count );
+    for( const auto& stall : stalls() )
+    {
+        fprintf( out, "  %10.3f ms site %s tag %s\n"
+                 , static_cast<double>( stall.duration_ns ) / 1e6
+                 , stall.site ? stall.site : "-", stall.tag ? stall.tag : "-" );
+    }
+}
+
+}
@@ -0,0 +1,127 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+#include <chrono>
+#include <vector>
+#include <experimental/coroutine>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <libcornet/log_level.hpp>
+#include <libcornet/metrics.hpp>
+
+namespace pioneer19::cornet
+{
+
+/**
+ * Poller::run<LOG_LEVEL>() with this or higher level is compiled with loop profiler,
+ * lower levels have no profiling code at all
+ */
+constexpr LogLevel LOOP_PROFILER_LOG_LEVEL = LogLevel::INFO;
+
+inline uint64_t rdtsc() noexcept
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+/**
+ * @brief coroutine resumed by poller and run longer than stall threshold
+ */
+struct CoroutineStall
+{
+    uint64_t duration_ns;
+    uint64_t resume_tsc;
+    const char* site; ///< function where coroutine waited for event
+    const char* tag;  ///< tag set by TcpSocket::set_profile_tag() or nullptr
+};
+
+/**
+ * @brief per thread event loop lag and coroutine stall profiler
+ *
+ * Loop iteration time (without epoll_wait) and delay from epoll readiness
+ * event to coroutine resume go to ThreadMetrics histograms, coroutines
+ * run longer than threshold are kept in ring of last STALLS_CAPACITY stalls.
+ */
+class LoopProfiler
+{
+public:
+    static constexpr uint32_t STALLS_CAPACITY = 64;
+    static constexpr std::chrono::nanoseconds DEFAULT_STALL_THRESHOLD = std::chrono::milliseconds{1};
+
+    static LoopProfiler& instance();
+
+    void set_stall_threshold( std::chrono::nanoseconds threshold ) noexcept;
+
+    void loop_iteration( uint64_t begin_tsc, uint64_t end_tsc ) noexcept
+    { m_metrics.observe( Histogram::LOOP_ITERATION_DURATION, cycles_to_ns( end_tsc - begin_tsc ) ); }
+    void resume( std::experimental::coroutine_handle<> coro_handle, uint64_t ready_tsc
+                 , const char* site, const char* tag );
+
+    /**
+     * last stalls, oldest first
+     */
+    [[nodiscard]]
+    std::vector<CoroutineStall> stalls() const;
+    [[nodiscard]]
+    uint64_t stalls_count() const noexcept { return m_stalls_count; }
+    void clear_stalls() noexcept { m_stalls_count = 0; }
+    void print_stalls( FILE* out ) const;
+
+    /**
+     * tsc rate measured once per process against steady_clock
+     */
+    static double ns_per_cycle();
+    [[nodiscard]]
+    uint64_t cycles_to_ns( uint64_t cycles ) const noexcept
+    { return static_cast<uint64_t>( cycles * m_ns_per_cycle ); }
+
+    LoopProfiler( const LoopProfiler& ) = delete;
+    LoopProfiler( LoopProfiler&& )      = delete;
+    LoopProfiler& operator=( const LoopProfiler& ) = delete;
+    LoopProfiler& operator=( LoopProfiler&& )      = delete;
+
+private:
+    LoopProfiler();
+    ~LoopProfiler() = default;
+
+    ThreadMetrics& m_metrics;
+    double   m_ns_per_cycle;
+    uint64_t m_stall_threshold_cycles = 0;
+    uint64_t m_stalls_count = 0;
+    CoroutineStall m_stalls[STALLS_CAPACITY] = {};
+};
+
+inline void LoopProfiler::resume( std::experimental::coroutine_handle<> coro_handle, uint64_t ready_tsc
+                                  , const char* site, const char* tag )
+{
+    uint64_t resume_tsc = rdtsc();
+    m_metrics.observe( Histogram::EVENT_RESUME_DELAY, cycles_to_ns( resume_tsc - ready_tsc ) );
+
+    coro_handle.resume();
+
+    uint64_t run_cycles = rdtsc() - resume_tsc;
+    if( run_cycles >= m_stall_threshold_cycles )
+    {
+        m_stalls[m_stalls_count % STALLS_CAPACITY] =
+                CoroutineStall{ cycles_to_ns( run_cycles ), resume_tsc, site, tag };
+        ++m_stalls_count;
+        m_metrics.add( Counter::COROUTINE_STALLS );
+    }
+}
+
+}
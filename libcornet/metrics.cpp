@@ -0,0 +1,296 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/metrics.hpp>
+
+#include <cstdio>
+#include <bit>
+#include <iterator>
+#include <algorithm>
+#include <string_view>
+
+namespace pioneer19::cornet
+{
+
+static const MetricInfo counter_infos[] = {
+        { "cornet_epoll_wakeups_total", "", "epoll_wait calls returned events" },
+        { "cornet_epoll_events_total", "", "events returned by epoll_wait" },
+        { "cornet_accepts_total", "", "accepted tcp connections" },
+        { "cornet_bytes_total", "direction=\"in\"", "bytes received from or sent to tcp sockets" },
+        { "cornet_bytes_total", "direction=\"out\"", "bytes received from or sent to tcp sockets" },
+        { "cornet_tls_records_total", "op=\"encrypt\"", "tls records encrypted or decrypted" },
+        { "cornet_tls_records_total", "op=\"decrypt\"", "tls records encrypted or decrypted" },
+        { "cornet_tls_handshakes_total", "side=\"server\"", "completed tls handshakes" },
+        { "cornet_tls_handshakes_total", "side=\"client\"", "completed tls handshakes" },
+        { "cornet_tls_handshake_failures_total", "side=\"server\",reason=\"io\""
+          , "failed tls handshakes by reason" },
+        { "cornet_tls_handshake_failures_total", "side=\"server\",reason=\"protocol\""
+          , "failed tls handshakes by reason" },
+        { "cornet_tls_handshake_failures_total", "side=\"client\",reason=\"connect\""
+          , "failed tls handshakes by reason" },
+        { "cornet_tls_handshake_failures_total", "side=\"client\",reason=\"io\""
+          , "failed tls handshakes by reason" },
+        { "cornet_tls_handshake_failures_total", "side=\"client\",reason=\"protocol\""
+          , "failed tls handshakes by reason" },
+        { "cornet_tls_hello_retry_requests_total", "side=\"server\""
+          , "HelloRetryRequest sent by server or received by client" },
+        { "cornet_tls_hello_retry_requests_total", "side=\"client\""
+          , "HelloRetryRequest sent by server or received by client" },
+        { "cornet_tls_cert_verify_cache_total", "result=\"hit\""
+          , "client certificate chain verifications found in cache or not" },
+        { "cornet_tls_cert_verify_cache_total", "result=\"miss\""
+          , "client certificate chain verifications found in cache or not" },
+        { "cornet_tls_ocsp_staple_rejections_total", "", "stapled OCSP responses rejected by client" },
+        { "cornet_tls_cert_verify_failures_total", "", "server certificates rejected by client" },
+        { "cornet_coroutine_stalls_total", "", "coroutines run longer than loop profiler threshold" },
+};
+static_assert( std::size(counter_infos) == static_cast<uint32_t>(Counter::COUNT) );
+
+static const MetricInfo gauge_infos[] = {
+        { "cornet_active_connections", "", "open accepted and connected tcp sockets" },
+        { "cornet_uring_sq_depth", "", "io_uring requests waiting for submission" },
+        { "cornet_uring_cq_depth", "", "io_uring completions found by last poll" },
+};
+static_assert( std::size(gauge_infos) == static_cast<uint32_t>(Gauge::COUNT) );
+
+static const MetricInfo histogram_infos[] = {
+        { "cornet_epoll_events_per_wakeup", "", "events returned by one epoll_wait call" },
+        { "cornet_tls_handshake_duration_seconds", "side=\"server\""
+          , "tls handshake duration", 1e-6 },
+        { "cornet_tls_handshake_duration_seconds", "side=\"client\""
+          , "tls handshake duration", 1e-6 },
+        { "cornet_loop_iteration_duration_seconds", ""
+          , "event loop iteration time without epoll_wait", 1e-9 },
+        { "cornet_event_resume_delay_seconds", ""
+          , "time from epoll readiness event to coroutine resume", 1e-9 },
+};
+static_assert( std::size(histogram_infos) == static_cast<uint32_t>(Histogram::COUNT) );
+
+const MetricInfo& metric_info( Counter counter ) noexcept
+{
+    return counter_infos[static_cast<uint32_t>(counter)];
+}
+
+const MetricInfo& metric_info( Gauge gauge ) noexcept
+{
+    return gauge_infos[static_cast<uint32_t>(gauge)];
+}
+
+const MetricInfo& metric_info( Histogram histogram ) noexcept
+{
+    return histogram_infos[static_cast<uint32_t>(histogram)];
+}
+
+uint64_t HistogramSnapshot::count() const noexcept
+{
+    uint64_t total = 0;
+    for( auto bucket_count : buckets )
+        total += bucket_count;
+    return total;
+}
+
+ThreadMetrics::ThreadMetrics()
+{
+    MetricsRegistry::instance().register_thread( this );
+}
+
+ThreadMetrics::~ThreadMetrics()
+{
+    MetricsRegistry::instance().unregister_thread( this );
+}
+
+void ThreadMetrics::observe( Histogram histogram, uint64_t value ) noexcept
+{
+    auto& data = m_histograms[static_cast<uint32_t>(histogram)];
+    uint32_t bucket = std::min( static_cast<uint32_t>(std::bit_width( value )), HISTOGRAM_BUCKETS-1 );
+    increment( data.buckets[bucket], uint64_t{1} );
+    increment( data.sum, value );
+}
+
+void ThreadMetrics::handshake_completed( bool server, std::chrono::microseconds duration ) noexcept
+{
+    if( server )
+    {
+        add( Counter::SERVER_HANDSHAKES );
+        observe( Histogram::SERVER_HANDSHAKE_DURATION, duration.count() );
+    }
+    else
+    {
+        add( Counter::CLIENT_HANDSHAKES );
+        observe( Histogram::CLIENT_HANDSHAKE_DURATION, duration.count() );
+    }
+}
+
+void ThreadMetrics::handshake_failed( bool server, HandshakeFailure reason ) noexcept
+{
+    switch( reason )
+    {
+        case HandshakeFailure::CONNECT:
+            add( Counter::CLIENT_HANDSHAKE_FAILURES_CONNECT );
+            break;
+        case HandshakeFailure::IO:
+            add( server ? Counter::SERVER_HANDSHAKE_FAILURES_IO : Counter::CLIENT_HANDSHAKE_FAILURES_IO );
+            break;
+        case HandshakeFailure::PROTOCOL:
+            add( server ? Counter::SERVER_HANDSHAKE_FAILURES_PROTOCOL
+                        : Counter::CLIENT_HANDSHAKE_FAILURES_PROTOCOL );
+            break;
+    }
+}
+
+void ThreadMetrics::add_to( MetricsSnapshot& snapshot ) const noexcept
+{
+    for( uint32_t i = 0; i < static_cast<uint32_t>(Counter::COUNT); ++i )
+        snapshot.counters[i] += m_counters[i].load( std::memory_order_relaxed );
+    for( uint32_t i = 0; i < static_cast<uint32_t>(Gauge::COUNT); ++i )
+        snapshot.gauges[i] += m_gauges[i].load( std::memory_order_relaxed );
+    for( uint32_t i = 0; i < static_cast<uint32_t>(Histogram::COUNT); ++i )
+    {
+        auto& histogram = snapshot.histograms[i];
+        for( uint32_t bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket )
+            histogram.buckets[bucket] += m_histograms[i].buckets[bucket].load( std::memory_order_relaxed );
+        histogram.sum += m_histograms[i].sum.load( std::memory_order_relaxed );
+    }
+}
+
+MetricsRegistry& MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+
+    return registry;
+}
+
+void MetricsRegistry::register_thread( ThreadMetrics* thread_metrics )
+{
+    std::lock_guard lock( m_mutex );
+    m_threads.push_back( thread_metrics );
+}
+
+void MetricsRegistry::unregister_thread( ThreadMetrics* thread_metrics )
+{
+    std::lock_guard lock( m_mutex );
+    thread_metrics->add_to( m_retired );
+    // gauges are levels, thread resources are already released
+    std::fill( std::begin(m_retired.gauges), std::end(m_retired.gauges), 0 );
+    m_threads.erase( std::remove( m_threads.begin(), m_threads.end(), thread_metrics ), m_threads.end() );
+}
+
+MetricsSnapshot MetricsRegistry::collect()
+{
+    std::lock_guard lock( m_mutex );
+    MetricsSnapshot snapshot = m_retired;
+    for( auto* thread_metrics : m_threads )
+        thread_metrics->add_to( snapshot );
+
+    return snapshot;
+}
+
+template< typename Metric >
+static void append_header( std::string& text, const MetricInfo& info, const char* type, Metric metric )
+{   // HELP and TYPE lines are written once per family
+    if( static_cast<uint32_t>(metric) > 0
+        && std::string_view{metric_info( static_cast<Metric>(static_cast<uint32_t>(metric)-1) ).name} == info.name )
+        return;
+    text += "# HELP ";
+    text += info.name;
+    text += ' ';
+    text += info.help;
+    text += "\n# TYPE ";
+    text += info.name;
+    text += ' ';
+    text += type;
+    text += '\n';
+}
+
+static void append_labels( std::string& text, const char* labels, const char* extra_label = nullptr )
+{
+    bool has_labels = labels[0] != '\0';
+    if( !has_labels && extra_label == nullptr )
+        return;
+    text += '{';
+    text += labels;
+    if( extra_label )
+    {
+        if( has_labels )
+            text += ',';
+        text += extra_label;
+    }
+    text += '}';
+}
+
+static void append_number( std::string& text, double value )
+{
+    char buffer[32];
+    snprintf( buffer, sizeof(buffer), "%.9g", value );
+    text += buffer;
+}
+
+void PrometheusTextSink::export_metrics( const MetricsSnapshot& snapshot )
+{
+    m_text.clear();
+    for( uint32_t i = 0; i < static_cast<uint32_t>(Counter::COUNT); ++i )
+    {
+        const auto& info = metric_info( static_cast<Counter>(i) );
+        append_header( m_text, info, "counter", static_cast<Counter>(i) );
+        m_text += info.name;
+        append_labels( m_text, info.labels );
+        m_text += ' ';
+        m_text += std::to_string( snapshot.counters[i] );
+        m_text += '\n';
+    }
+    for( uint32_t i = 0; i < static_cast<uint32_t>(Gauge::COUNT); ++i )
+    {
+        const auto& info = metric_info( static_cast<Gauge>(i) );
+        append_header( m_text, info, "gauge", static_cast<Gauge>(i) );
+        m_text += info.name;
+        append_labels( m_text, info.labels );
+        m_text += ' ';
+        m_text += std::to_string( snapshot.gauges[i] );
+        m_text += '\n';
+    }
+    for( uint32_t i = 0; i < static_cast<uint32_t>(Histogram::COUNT); ++i )
+    {
+        const auto& info = metric_info( static_cast<Histogram>(i) );
+        const auto& histogram = snapshot.histograms[i];
+        append_header( m_text, info, "histogram", static_cast<Histogram>(i) );
+
+        std::string name = info.name;
+        uint64_t cumulative_count = 0;
+        for( uint32_t bucket = 0; bucket < HISTOGRAM_BUCKETS; ++bucket )
+        {
+            cumulative_count += histogram.buckets[bucket];
+            std::string le = "le=\"";
+            if( bucket == HISTOGRAM_BUCKETS-1 )
+                le += "+Inf";
+            else
+                append_number( le, HistogramSnapshot::bucket_upper_bound( bucket ) * info.scale );
+            le += '"';
+
+            m_text += name;
+            m_text += "_bucket";
+            append_labels( m_text, info.labels, le.c_str() );
+            m_text += ' ';
+            m_text += std::to_string( cumulative_count );
+            m_text += '\n';
+        }
+        m_text += name;
+        m_text += "_sum";
+        append_labels( m_text, info.labels );
+        m_text += ' ';
+        append_number( m_text, histogram.sum * info.scale );
+        m_text += '\n';
+
+        m_text += name;
+        m_text += "_count";
+        append_labels( m_text, info.labels );
+        m_text += ' ';
+        m_text += std::to_string( cumulative_count );
+        m_text += '\n';
+    }
+}
+
+}
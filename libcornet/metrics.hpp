@@ -0,0 +1,241 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <chrono>
+
+namespace pioneer19::cornet
+{
+
+enum class Counter : uint32_t
+{
+    EPOLL_WAKEUPS = 0,
+    EPOLL_EVENTS,
+    ACCEPTS,
+    BYTES_IN,
+    BYTES_OUT,
+    RECORDS_ENCRYPTED,
+    RECORDS_DECRYPTED,
+    SERVER_HANDSHAKES,
+    CLIENT_HANDSHAKES,
+    SERVER_HANDSHAKE_FAILURES_IO,
+    SERVER_HANDSHAKE_FAILURES_PROTOCOL,
+    CLIENT_HANDSHAKE_FAILURES_CONNECT,
+    CLIENT_HANDSHAKE_FAILURES_IO,
+    CLIENT_HANDSHAKE_FAILURES_PROTOCOL,
+    SERVER_HELLO_RETRY_REQUESTS, ///< sent
+    CLIENT_HELLO_RETRY_REQUESTS, ///< received
+    CERT_VERIFY_CACHE_HITS,
+    CERT_VERIFY_CACHE_MISSES,
+    OCSP_STAPLE_REJECTIONS, ///< revoked, stale or not verified staple received by client
+    CERT_VERIFY_FAILURES, ///< server certificate chain or hostname rejected by client
+    COROUTINE_STALLS, ///< filled by LoopProfiler only
+    COUNT
+};
+
+enum class Gauge : uint32_t
+{
+    ACTIVE_CONNECTIONS = 0,
+    URING_SQ_DEPTH,
+    URING_CQ_DEPTH,
+    COUNT
+};
+
+enum class Histogram : uint32_t
+{
+    EVENTS_PER_WAKEUP = 0,
+    SERVER_HANDSHAKE_DURATION, ///< microseconds
+    CLIENT_HANDSHAKE_DURATION, ///< microseconds
+    LOOP_ITERATION_DURATION,   ///< nanoseconds, filled by LoopProfiler only
+    EVENT_RESUME_DELAY,        ///< nanoseconds, filled by LoopProfiler only
+    COUNT
+};
+
+enum class HandshakeFailure : uint32_t
+{
+    CONNECT,  ///< tcp connect failed (client only)
+    IO,       ///< socket error (std::system_error)
+    PROTOCOL, ///< unexpected/malformed record, alert, verification failure
+};
+
+/**
+ * @brief static description of metric used by exporters
+ *
+ * Metrics with the same name are one family differing by labels.
+ */
+struct MetricInfo
+{
+    const char* name;
+    const char* labels; ///< "key=\"value\",..." or empty string
+    const char* help;
+    double scale = 1.0; ///< histogram value multiplier on export (to seconds)
+};
+
+const MetricInfo& metric_info( Counter counter ) noexcept;
+const MetricInfo& metric_info( Gauge gauge ) noexcept;
+const MetricInfo& metric_info( Histogram histogram ) noexcept;
+
+/**
+ * log2 histogram: bucket i holds values with bit width i (0, 1, 2-3, 4-7 ...),
+ * last bucket holds all values not fitting in previous buckets
+ */
+constexpr uint32_t HISTOGRAM_BUCKETS = 28;
+
+struct HistogramSnapshot
+{
+    uint64_t buckets[HISTOGRAM_BUCKETS] = {};
+    uint64_t sum = 0;
+
+    [[nodiscard]]
+    uint64_t count() const noexcept;
+    /**
+     * @return max value fitting in bucket (inclusive upper bound)
+     */
+    static uint64_t bucket_upper_bound( uint32_t bucket ) noexcept
+    { return (uint64_t{1} << bucket) - 1; }
+};
+
+struct MetricsSnapshot
+{
+    uint64_t counters[static_cast<uint32_t>(Counter::COUNT)] = {};
+    int64_t  gauges[static_cast<uint32_t>(Gauge::COUNT)] = {};
+    HistogramSnapshot histograms[static_cast<uint32_t>(Histogram::COUNT)];
+
+    [[nodiscard]]
+    uint64_t counter( Counter c ) const noexcept { return counters[static_cast<uint32_t>(c)]; }
+    [[nodiscard]]
+    int64_t gauge( Gauge g ) const noexcept { return gauges[static_cast<uint32_t>(g)]; }
+    [[nodiscard]]
+    const HistogramSnapshot& histogram( Histogram h ) const noexcept
+    { return histograms[static_cast<uint32_t>(h)]; }
+};
+
+/**
+ * @brief per thread metric values
+ *
+ * Values are written by owner thread only (plain load + store, no locked
+ * instructions) and each thread has own block, so hot path never writes
+ * shared cache lines. Atomics are only to let MetricsRegistry::collect()
+ * read values from other thread.
+ */
+class alignas(64) ThreadMetrics
+{
+public:
+    static ThreadMetrics& instance();
+
+    void add( Counter counter, uint64_t value = 1 ) noexcept
+    { increment( m_counters[static_cast<uint32_t>(counter)], value ); }
+    void add( Gauge gauge, int64_t value ) noexcept
+    { increment( m_gauges[static_cast<uint32_t>(gauge)], value ); }
+    void set( Gauge gauge, int64_t value ) noexcept
+    { m_gauges[static_cast<uint32_t>(gauge)].store( value, std::memory_order_relaxed ); }
+    void observe( Histogram histogram, uint64_t value ) noexcept;
+
+    void handshake_completed( bool server, std::chrono::microseconds duration ) noexcept;
+    void handshake_failed( bool server, HandshakeFailure reason ) noexcept;
+
+    /**
+     * add own values to snapshot, may be called from any thread
+     */
+    void add_to( MetricsSnapshot& snapshot ) const noexcept;
+
+    ThreadMetrics();
+    ~ThreadMetrics();
+
+    ThreadMetrics( const ThreadMetrics& ) = delete;
+    ThreadMetrics( ThreadMetrics&& )      = delete;
+    ThreadMetrics& operator=( const ThreadMetrics& ) = delete;
+    ThreadMetrics& operator=( ThreadMetrics&& )      = delete;
+
+private:
+    template< typename T >
+    static void increment( std::atomic<T>& value, T delta ) noexcept
+    { value.store( value.load( std::memory_order_relaxed ) + delta, std::memory_order_relaxed ); }
+
+    struct HistogramData
+    {
+        std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS] = {};
+        std::atomic<uint64_t> sum = 0;
+    };
+
+    std::atomic<uint64_t> m_counters[static_cast<uint32_t>(Counter::COUNT)] = {};
+    std::atomic<int64_t>  m_gauges[static_cast<uint32_t>(Gauge::COUNT)] = {};
+    HistogramData m_histograms[static_cast<uint32_t>(Histogram::COUNT)];
+};
+
+/**
+ * @brief exporter of aggregated metrics
+ */
+class MetricsSink
+{
+public:
+    virtual ~MetricsSink() = default;
+    virtual void export_metrics( const MetricsSnapshot& snapshot ) = 0;
+};
+
+/**
+ * @brief Prometheus text exposition format (version 0.0.4)
+ */
+class PrometheusTextSink : public MetricsSink
+{
+public:
+    void export_metrics( const MetricsSnapshot& snapshot ) override;
+
+    [[nodiscard]]
+    const std::string& text() const noexcept { return m_text; }
+
+private:
+    std::string m_text;
+};
+
+/**
+ * @brief registry of all ThreadMetrics, aggregates them on demand
+ *
+ * Values of exited threads are kept, so counters never go back.
+ */
+class MetricsRegistry
+{
+public:
+    static MetricsRegistry& instance();
+
+    [[nodiscard]]
+    MetricsSnapshot collect();
+    void export_to( MetricsSink& sink ) { sink.export_metrics( collect() ); }
+
+    MetricsRegistry() = default;
+    ~MetricsRegistry() = default;
+
+    MetricsRegistry( const MetricsRegistry& ) = delete;
+    MetricsRegistry( MetricsRegistry&& )      = delete;
+    MetricsRegistry& operator=( const MetricsRegistry& ) = delete;
+    MetricsRegistry& operator=( MetricsRegistry&& )      = delete;
+
+private:
+    friend class ThreadMetrics;
+    void register_thread( ThreadMetrics* thread_metrics );
+    void unregister_thread( ThreadMetrics* thread_metrics );
+
+    std::mutex m_mutex;
+    std::vector<ThreadMetrics*> m_threads;
+    MetricsSnapshot m_retired; ///< values of exited threads
+};
+
+inline ThreadMetrics& ThreadMetrics::instance()
+{
+    static thread_local ThreadMetrics thread_metrics;
+
+    return thread_metrics;
+}
+
+}
@@ -21,6 +21,7 @@
 #include <system_error>
 
 #include <libcornet/io_uring_syscalls.hpp>
+#include <libcornet/metrics.hpp>
 
 namespace pioneer19::cornet
 {
@@ -327,11 +328,16 @@ uint32_t NetUring::process_requests()
         submit_queue();
         process_completed_events();
     }
+    ThreadMetrics::instance().set( Gauge::URING_SQ_DEPTH, m_ready_counter + m_extra_requests.size() );
     return m_ready_counter;
 }
 
 void NetUring::process_completed_events()
 {
+    uint32_t cq_depth = m_comp_queue.tail->load( std::memory_order_acquire )
+                        - m_comp_queue.head->load( std::memory_order_relaxed );
+    ThreadMetrics::instance().set( Gauge::URING_CQ_DEPTH, cq_depth );
+
     io_uring_cqe* cqe = nullptr;
     while( (cqe = next_cqe(m_comp_queue) ) != nullptr )
     {
@@ -17,9 +17,13 @@
 #include <libcornet/tcp_socket.hpp>
 #include <libcornet/async_file.hpp>
 #include <libcornet/net_uring.hpp>
+#include <libcornet/metrics.hpp>
+#include <libcornet/loop_profiler.hpp>
 
 namespace pioneer19::cornet {
 
+static thread_local Poller* current_poller = nullptr;
+
 Poller::Poller()
 {
     m_poller_fd = epoll_create1( EPOLL_CLOEXEC );
@@ -54,9 +58,18 @@ void Poller::close()
     m_poller_fd = -1;
 }
 
+template< LogLevel LOG_LEVEL >
 void Poller::run()
 {
+    struct CurrentPollerGuard
+    {
+        explicit CurrentPollerGuard( Poller* poller ) : m_prev{current_poller} { current_poller = poller; }
+        ~CurrentPollerGuard() { current_poller = m_prev; }
+        Poller* m_prev;
+    } current_poller_guard{ this };
+
     int timeout_ms = -1; // -1 is infinite timeout for epoll_wait
+    ThreadMetrics& metrics = ThreadMetrics::instance();
 
     while( true)
     {
@@ -65,6 +78,9 @@ void Poller::run()
         if( m_stop )
             break;
         int res = epoll_wait( m_poller_fd, events, EVENT_BATCH_SIZE, timeout_ms );
+        [[maybe_unused]] uint64_t ready_tsc = 0;
+        if constexpr( LOG_LEVEL >= LOOP_PROFILER_LOG_LEVEL )
+            ready_tsc = rdtsc();
         timeout_ms = -1;
         if( m_stop )
             break;
@@ -77,6 +93,9 @@ void Poller::run()
                                     , std::string( "failed epoll_wait on epoll socket " )
                                       + std::to_string( m_poller_fd ));
         }
+        metrics.add( Counter::EPOLL_WAKEUPS );
+        metrics.add( Counter::EPOLL_EVENTS, res );
+        metrics.observe( Histogram::EVENTS_PER_WAKEUP, res );
 
         for( uint32_t i = 0; i < static_cast<uint32_t>(res); ++i )
         {
@@ -99,7 +118,7 @@ void Poller::run()
             if( curr_event.data.ptr == nullptr )
                 continue;
             auto poller_cb = reinterpret_cast<PollerCb*>( curr_event.data.ptr );
-            poller_cb->process_event();
+            poller_cb->process_event<LOG_LEVEL>( ready_tsc );
 
             PollerCb::rm_reference( poller_cb );
         }
@@ -108,9 +127,21 @@ void Poller::run()
         if( queue_size != 0 )
             timeout_ms = 0;
 #endif
+        if( static_cast<uint32_t>(res) < EVENT_BATCH_SIZE && run_idle_tasks() )
+            timeout_ms = 0;
+        if constexpr( LOG_LEVEL >= LOOP_PROFILER_LOG_LEVEL )
+            LoopProfiler::instance().loop_iteration( ready_tsc, rdtsc() );
     }
 }
 
+template void Poller::run<LogLevel::NONE>();
+template void Poller::run<LogLevel::CRITICAL>();
+template void Poller::run<LogLevel::ERROR>();
+template void Poller::run<LogLevel::WARNING>();
+template void Poller::run<LogLevel::NOTICE>();
+template void Poller::run<LogLevel::INFO>();
+template void Poller::run<LogLevel::DEBUG>();
+
 int Poller::add_fd( int fd, PollerCb* poller_cb, uint32_t mask )
 {
     epoll_event event = {};
@@ -166,6 +197,33 @@ std::string Poller::events_string( uint32_t events_mask )
     return events_string;
 }
 
+void Poller::run_on_idle( std::function<bool()> func )
+{
+    m_idle_tasks.push_back( std::move(func) );
+}
+
+bool Poller::run_idle_tasks()
+{
+    bool more_work = false;
+    for( auto& idle_task : m_idle_tasks )
+        more_work |= idle_task();
+
+    return more_work;
+}
+
+Poller* Poller::current() noexcept
+{
+    return current_poller;
+}
+
+ResumeQueue& Poller::resume_queue()
+{
+    if( !m_resume_queue )
+        m_resume_queue = std::make_unique<ResumeQueue>( *this );
+
+    return *m_resume_queue;
+}
+
 void Poller::run_on_signal( int signum, std::function<void()> func )
 {
     if( !m_signal_processor )
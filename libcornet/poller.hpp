@@ -11,10 +11,13 @@
 #include <csignal>
 #include <cstdint>
 #include <memory>
+#include <vector>
 #include <functional>
 
 #include <libcornet/signal_processor.hpp>
+#include <libcornet/resume_queue.hpp>
 #include <libcornet/poller_cb.hpp>
+#include <libcornet/log_level.hpp>
 
 namespace pioneer19::cornet
 {
@@ -31,17 +34,39 @@ public:
     Poller( const Poller& ) = delete;
     Poller& operator=( const Poller& ) = delete;
 
+    /**
+     * run event loop until stop(). With LOG_LEVEL >= LOOP_PROFILER_LOG_LEVEL
+     * loop is profiled by LoopProfiler of current thread
+     */
+    template< LogLevel LOG_LEVEL = LogLevel::NONE >
     void run();
     void stop() noexcept { m_stop = true; }
     void run_on_signal( int signum, std::function<void()> func );
+    /**
+     * func is called in loop iterations, when event batch was not full (loop
+     * is not saturated). func returns true if it has more work, then poller
+     * does not block in epoll_wait. func must do small piece of work per call.
+     */
+    void run_on_idle( std::function<bool()> func );
     void add_socket( const TcpSocket& socket, PollerCb* poller_cb
             ,uint32_t mask = EPOLLIN|EPOLLOUT|EPOLLRDHUP|EPOLLPRI|EPOLLET );
     void add_file( const AsyncFile& async_file, PollerCb* poller_cb
             ,uint32_t mask = EPOLLIN|EPOLLRDHUP|EPOLLPRI|EPOLLET );
 
     static std::string events_string( uint32_t events_mask );
+    /**
+     * poller running in current thread or nullptr
+     */
+    static Poller* current() noexcept;
+    /**
+     * queue to resume coroutines of this poller from other threads,
+     * created on first call (must be called from poller thread)
+     */
+    ResumeQueue& resume_queue();
 
 private:
+    [[nodiscard]]
+    bool run_idle_tasks();
     int add_fd( int fd, PollerCb* poller_cb
             ,uint32_t mask = EPOLLIN|EPOLLOUT|EPOLLRDHUP|EPOLLPRI|EPOLLET );
     void close();
@@ -49,6 +74,8 @@ private:
     int m_poller_fd = -1;
     bool m_stop = false;
     std::unique_ptr<SignalProcessor> m_signal_processor;
+    std::unique_ptr<ResumeQueue>     m_resume_queue;
+    std::vector<std::function<bool()>> m_idle_tasks;
 };
 
 }
@@ -10,6 +10,9 @@
 #include <cstdint>
 #include <experimental/coroutine>
 
+#include <libcornet/log_level.hpp>
+#include <libcornet/loop_profiler.hpp>
+
 namespace pioneer19::cornet
 {
 
@@ -26,12 +29,26 @@ struct PollerCb : private RefCounted
     uint32_t events_mask = 0;
     std::experimental::coroutine_handle<> reader_coro_handle;
     std::experimental::coroutine_handle<> writer_coro_handle;
+    const char* reader_site = nullptr; ///< function waiting for read event (for LoopProfiler)
+    const char* writer_site = nullptr; ///< function waiting for write event (for LoopProfiler)
+    const char* profile_tag = nullptr;
 
     void reset_bits( uint32_t bits_to_clear )
     { events_mask &= (~bits_to_clear); }
 
-    void process_event();
-    void clean() { reader_coro_handle = nullptr; writer_coro_handle = nullptr; events_mask = 0; }
+    /**
+     * resume coroutines waiting for events
+     * @param ready_tsc rdtsc() when event was got from epoll (used with loop profiler only)
+     */
+    template< LogLevel LOG_LEVEL = LogLevel::NONE >
+    void process_event( uint64_t ready_tsc = 0 );
+    void clean()
+    {
+        reader_coro_handle = nullptr;
+        writer_coro_handle = nullptr;
+        events_mask = 0;
+        profile_tag = nullptr;
+    }
     static void rm_reference( PollerCb* poller_cb );
     using RefCounted::add_reference;
 
@@ -45,13 +62,24 @@ inline void PollerCb::rm_reference( PollerCb* poller_cb )
         delete poller_cb;
 }
 
-inline void PollerCb::process_event()
+template< LogLevel LOG_LEVEL >
+inline void PollerCb::process_event( [[maybe_unused]] uint64_t ready_tsc )
 {
     if( (events_mask & EPOLLOUT) && writer_coro_handle )
-        writer_coro_handle.resume();
+    {
+        if constexpr( LOG_LEVEL >= LOOP_PROFILER_LOG_LEVEL )
+            LoopProfiler::instance().resume( writer_coro_handle, ready_tsc, writer_site, profile_tag );
+        else
+            writer_coro_handle.resume();
+    }
 
     if( (events_mask & EPOLLIN) && reader_coro_handle )
-        reader_coro_handle.resume();
+    {
+        if constexpr( LOG_LEVEL >= LOOP_PROFILER_LOG_LEVEL )
+            LoopProfiler::instance().resume( reader_coro_handle, ready_tsc, reader_site, profile_tag );
+        else
+            reader_coro_handle.resume();
+    }
 }
 
 }
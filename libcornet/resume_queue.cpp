@@ -0,0 +1,89 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/resume_queue.hpp>
+
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <cstdint>
+#include <algorithm>
+#include <system_error>
+
+#include <libcornet/poller.hpp>
+
+namespace pioneer19::cornet
+{
+
+ResumeQueue::ResumeQueue( Poller& poller )
+{
+    m_event_fd = eventfd( 0, EFD_NONBLOCK|EFD_CLOEXEC );
+    if( m_event_fd == -1 )
+    {
+        throw std::system_error(errno, std::system_category()
+                                , "ResumeQueue() failed create eventfd" );
+    }
+    m_async_file = AsyncFile( m_event_fd, &poller );
+    m_runner = create_queue_runner();
+}
+
+ResumeQueue::QueueRunner ResumeQueue::create_queue_runner()
+{
+    while( true )
+    {
+        uint64_t counter = 0;
+        auto bytes_read = co_await m_async_file.async_read(
+                reinterpret_cast<char*>(&counter), sizeof(counter) );
+        if( bytes_read != sizeof(counter) )
+            continue;
+
+        resume_posted();
+    }
+}
+
+void ResumeQueue::resume_posted()
+{
+    {
+        std::lock_guard lock{ m_mutex };
+        m_resuming.swap( m_posted );
+    }
+    // resumed coroutine can cancel following ones
+    for( auto coro_handle : m_resuming )
+    {
+        if( coro_handle )
+            coro_handle.resume();
+    }
+    m_resuming.clear();
+}
+
+void ResumeQueue::cancel( std::experimental::coroutine_handle<> coro_handle ) noexcept
+{
+    {
+        std::lock_guard lock{ m_mutex };
+        m_posted.erase( std::remove( m_posted.begin(), m_posted.end(), coro_handle ), m_posted.end() );
+    }
+    std::replace( m_resuming.begin(), m_resuming.end(), coro_handle, std::experimental::coroutine_handle<>{} );
+}
+
+void ResumeQueue::post( std::experimental::coroutine_handle<> coro_handle )
+{
+    bool need_wakeup = false;
+    {
+        std::lock_guard lock{ m_mutex };
+        // poller is already woken up if queue is not empty
+        need_wakeup = m_posted.empty();
+        m_posted.push_back( coro_handle );
+    }
+    if( !need_wakeup )
+        return;
+
+    uint64_t counter = 1;
+    while( ::write( m_event_fd, &counter, sizeof(counter) ) == -1 && errno == EINTR )
+    {}
+}
+
+}
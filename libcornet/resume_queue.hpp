@@ -0,0 +1,94 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <mutex>
+#include <vector>
+#include <exception>
+#include <experimental/coroutine>
+
+#include <libcornet/async_file.hpp>
+
+namespace pioneer19::cornet
+{
+
+class Poller;
+
+/**
+ * @brief resume coroutines in poller thread by request from other threads
+ *
+ * Other thread posts handle of suspended coroutine, eventfd wakes poller
+ * and coroutine is resumed in poller thread (its home thread).
+ */
+class ResumeQueue
+{
+public:
+    explicit ResumeQueue( Poller& poller );
+    ~ResumeQueue() = default;
+
+    /**
+     * thread safe, coroutine will be resumed by poller thread
+     */
+    void post( std::experimental::coroutine_handle<> coro_handle );
+    /**
+     * posted and not resumed coroutine will not be resumed (it is going to be destroyed),
+     * called in poller thread only
+     */
+    void cancel( std::experimental::coroutine_handle<> coro_handle ) noexcept;
+
+    ResumeQueue( const ResumeQueue& ) = delete;
+    ResumeQueue( ResumeQueue&& )      = delete;
+    ResumeQueue& operator=( const ResumeQueue& ) = delete;
+    ResumeQueue& operator=( ResumeQueue&& )      = delete;
+
+private:
+    struct QueueRunner
+    {
+        struct promise_type;
+        using coro_handler = std::experimental::coroutine_handle<promise_type>;
+
+        struct promise_type
+        {
+            std::experimental::suspend_never initial_suspend() { return {}; }
+            std::experimental::suspend_never final_suspend() noexcept { return {}; }
+            QueueRunner get_return_object()
+            {
+                return QueueRunner{coro_handler::from_promise(*this)};
+            }
+            void unhandled_exception() { std::terminate(); }
+            void return_void() {}
+        };
+
+        QueueRunner() = default;
+        explicit QueueRunner( coro_handler coro ) noexcept
+            :coro( coro )
+        {}
+        QueueRunner( QueueRunner&& other ) noexcept
+            : coro(std::move(other.coro) ){ other.coro = nullptr; }
+        QueueRunner& operator=( QueueRunner&& other ) noexcept
+        { if( this != &other) { std::swap( coro, other.coro); } return *this; }
+
+        QueueRunner( const QueueRunner& ) = delete;
+        QueueRunner& operator=( const QueueRunner& ) = delete;
+        ~QueueRunner() { if( coro ) coro.destroy(); }
+
+        coro_handler coro;
+    };
+
+    QueueRunner create_queue_runner();
+    void resume_posted();
+
+    std::mutex m_mutex;
+    std::vector<std::experimental::coroutine_handle<>> m_posted;
+    std::vector<std::experimental::coroutine_handle<>> m_resuming;
+    int         m_event_fd = -1; ///< owned by m_async_file
+    AsyncFile   m_async_file;
+    QueueRunner m_runner;
+};
+
+}
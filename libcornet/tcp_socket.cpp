@@ -20,6 +20,8 @@
 #include <system_error>
 
 #include <libcornet/peer_resolver.hpp>
+#include <libcornet/metrics.hpp>
+#include <libcornet/trace.hpp>
 
 namespace pioneer19::cornet
 {
@@ -40,8 +42,12 @@ void TcpSocket::create_socket()
 TcpSocket::TcpSocket( TcpSocket&& other ) noexcept
     :m_poller_cb( std::move(other.m_poller_cb) )
     ,m_socket_fd( other.m_socket_fd )
+    ,m_connection_id( other.m_connection_id )
+    ,m_connected( other.m_connected )
 {
     other.m_socket_fd = -1;
+    other.m_connection_id = 0;
+    other.m_connected = false;
 }
 
 TcpSocket& TcpSocket::operator=( TcpSocket&& other ) noexcept
@@ -51,6 +57,8 @@ TcpSocket& TcpSocket::operator=( TcpSocket&& other ) noexcept
         close();
         std::swap( m_socket_fd, other.m_socket_fd );
         std::swap( m_poller_cb, other.m_poller_cb );
+        std::swap( m_connection_id, other.m_connection_id );
+        std::swap( m_connected, other.m_connected );
     }
     return *this;
 }
@@ -58,7 +66,13 @@ TcpSocket& TcpSocket::operator=( TcpSocket&& other ) noexcept
 TcpSocket::TcpSocket( int socket_fd, Poller* poller )
         :m_poller_cb( new PollerCb )
         ,m_socket_fd( socket_fd )
+        ,m_connection_id( TraceRing::next_connection_id() )
+        ,m_connected( true )
 {
+    auto& metrics = ThreadMetrics::instance();
+    metrics.add( Counter::ACCEPTS );
+    metrics.add( Gauge::ACTIVE_CONNECTIONS, 1 );
+    TraceRing::instance().add( TraceEvent::CONNECTION_ACCEPTED, m_connection_id );
     if( poller )
         poller->add_socket( *this, m_poller_cb );
 }
@@ -119,6 +133,7 @@ ssize_t TcpSocket::read( char* buff, size_t buff_size )
     ssize_t read_size = ::recv( m_socket_fd, buff, buff_size, 0 );
     if( read_size == -1 )
         throw std::system_error(errno, std::system_category(), "socket read failed" );
+    ThreadMetrics::instance().add( Counter::BYTES_IN, read_size );
 
     return read_size;
 }
@@ -128,6 +143,7 @@ ssize_t TcpSocket::write( const char* buff, size_t buff_size )
     ssize_t wrote_size = ::send( m_socket_fd, buff, buff_size, MSG_NOSIGNAL );
     if( wrote_size == -1 )
         throw std::system_error(errno, std::system_category(), "socket write failed" );
+    ThreadMetrics::instance().add( Counter::BYTES_OUT, wrote_size );
 
     return wrote_size;
 }
@@ -139,6 +155,12 @@ void TcpSocket::close()
 
     ::close( m_socket_fd );
     m_socket_fd = -1;
+    if( m_connected )
+    {
+        ThreadMetrics::instance().add( Gauge::ACTIVE_CONNECTIONS, -1 );
+        TraceRing::instance().add( TraceEvent::CONNECTION_CLOSED, m_connection_id );
+        m_connected = false;
+    }
 
     m_poller_cb->clean();
     PollerCb::rm_reference( m_poller_cb );
@@ -162,6 +184,23 @@ int TcpSocket::fd() const
     return m_socket_fd;
 }
 
+void TcpSocket::set_profile_tag( const char* tag ) noexcept
+{
+    if( m_poller_cb )
+        m_poller_cb->profile_tag = tag;
+}
+
+void TcpSocket::set_connected() noexcept
+{
+    if( !m_connected )
+    {
+        ThreadMetrics::instance().add( Gauge::ACTIVE_CONNECTIONS, 1 );
+        m_connection_id = TraceRing::next_connection_id();
+        TraceRing::instance().add( TraceEvent::CONNECTION_CONNECTED, m_connection_id );
+        m_connected = true;
+    }
+}
+
 ssize_t TcpSocket::ReadVAwaiter::read_socket()
 {
     struct msghdr msg = { nullptr, 0,
@@ -186,36 +225,45 @@ ssize_t TcpSocket::ReadVAwaiter::read_socket()
         }
         if( static_cast<size_t>(bytes_read) < m_total_size )
             m_poller_cb.reset_bits( EPOLLIN );
+        ThreadMetrics::instance().add( Counter::BYTES_IN, bytes_read );
 
         return bytes_read;
     }
 }
 
-auto TcpSocket::ready_read()
+auto TcpSocket::ready_read( const char* site )
 {
     struct Awaiter
     {
         PollerCb& poller_cb;
+        const char* site;
 
         static bool await_ready() {return false;}
         void await_suspend( std::experimental::coroutine_handle<> coro_handle )
-        { poller_cb.reader_coro_handle = coro_handle; }
+        {
+            poller_cb.reader_coro_handle = coro_handle;
+            poller_cb.reader_site = site;
+        }
         void await_resume() { poller_cb.reader_coro_handle = nullptr; }
     };
-    return Awaiter{*m_poller_cb};
+    return Awaiter{*m_poller_cb, site};
 }
-auto TcpSocket::poll_write_event()
+auto TcpSocket::poll_write_event( const char* site )
 {
     struct Awaiter
     {
         PollerCb& poller_cb;
+        const char* site;
 
         static bool await_ready() { return false; }
         void await_suspend( std::experimental::coroutine_handle<> coro_handle )
-        { poller_cb.writer_coro_handle = coro_handle; }
+        {
+            poller_cb.writer_coro_handle = coro_handle;
+            poller_cb.writer_site = site;
+        }
         void await_resume() { poller_cb.writer_coro_handle = nullptr; }
     };
-    return Awaiter{*m_poller_cb};
+    return Awaiter{*m_poller_cb, site};
 }
 
 CoroutineAwaiter<ssize_t> TcpSocket::try_async_read( void* buffer, uint32_t buffer_size )
@@ -226,7 +274,7 @@ CoroutineAwaiter<ssize_t> TcpSocket::try_async_read( void* buffer, uint32_t buff
 #if defined(USE_IO_URING)
         bytes_read = co_await NetUring::instance().async_read( m_socket_fd, buffer, buffer_size );
 #else
-        ssize_t bytes_read = ::recv( m_socket_fd, buffer, buffer_size, MSG_DONTWAIT );
+        bytes_read = ::recv( m_socket_fd, buffer, buffer_size, MSG_DONTWAIT );
         if( bytes_read == -1 )
             bytes_read = -errno;
 #endif
@@ -236,6 +284,8 @@ CoroutineAwaiter<ssize_t> TcpSocket::try_async_read( void* buffer, uint32_t buff
     }
     if( bytes_read < buffer_size )
         m_poller_cb->reset_bits( EPOLLIN );
+    if( bytes_read > 0 )
+        ThreadMetrics::instance().add( Counter::BYTES_IN, bytes_read );
 
     co_return bytes_read;
 }
@@ -288,6 +338,32 @@ CoroutineAwaiter<ssize_t> TcpSocket::async_read(
     co_return total_read;
 }
 
+CoroutineAwaiter<ssize_t> TcpSocket::async_recvmsg( msghdr* message )
+{
+    if( !(m_poller_cb->events_mask & EPOLLIN) )
+        co_await ready_read();
+    while( true )
+    {
+        // one recvmsg() may stop before end of received data (kTLS returns one
+        // not application_data record per call), so EPOLLIN is reset only by EAGAIN
+        ssize_t bytes_read = ::recvmsg( m_socket_fd, message, MSG_DONTWAIT );
+        if( bytes_read == -1 )
+            bytes_read = -errno;
+        if( bytes_read == -EINTR )
+            continue;
+        if( bytes_read == -EAGAIN || bytes_read == -EWOULDBLOCK )
+        {
+            m_poller_cb->reset_bits( EPOLLIN );
+            co_await ready_read();
+            continue;
+        }
+        if( bytes_read > 0 )
+            ThreadMetrics::instance().add( Counter::BYTES_IN, bytes_read );
+
+        co_return bytes_read;
+    }
+}
+
 CoroutineAwaiter<ssize_t> TcpSocket::try_async_write( const void* buffer, size_t buffer_size )
 {
 #if defined(USE_IO_URING)
@@ -309,6 +385,8 @@ CoroutineAwaiter<ssize_t> TcpSocket::try_async_write( const void* buffer, size_t
     }
     if( bytes_wrote > 0 && static_cast<size_t>(bytes_wrote) < buffer_size )
         m_poller_cb->reset_bits( EPOLLOUT );
+    if( bytes_wrote > 0 )
+        ThreadMetrics::instance().add( Counter::BYTES_OUT, bytes_wrote );
 
     co_return bytes_wrote;
 }
@@ -395,7 +473,10 @@ CoroutineAwaiter<bool> TcpSocket::async_connect( Poller& poller, const sockaddr_
                 socklen_t error_len = sizeof(error);
                 getsockopt( m_socket_fd, SOL_SOCKET, SO_ERROR, &error, &error_len );
                 if( !error )
+                {
+                    set_connected();
                     co_return true;
+                }
 
                 errno = error;
                 co_return false;
@@ -405,6 +486,7 @@ CoroutineAwaiter<bool> TcpSocket::async_connect( Poller& poller, const sockaddr_
 
             co_return false;
         }
+        set_connected();
         co_return true;
     }
 }
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <sys/socket.h>
 #include <netinet/in.h>
 #include <sys/uio.h>
 
@@ -68,11 +69,31 @@ public:
      */
     CoroutineAwaiter<ssize_t> async_read( void* buffer, uint32_t buffer_size
             , uint32_t min_threshold = 1 );
+    /**
+     * receive once with recvmsg(), waits for socket become readable if no data
+     * (socket with kTLS rx returns record type in message control data)
+     * @return received data size, 0 on connection end or -errno
+     */
+    CoroutineAwaiter<ssize_t> async_recvmsg( msghdr* message );
     CoroutineAwaiter<ssize_t> async_write( const void* buffer, uint32_t buffer_size );
     TcpSocket::ReadVAwaiter async_readv( iovec *iov, uint32_t iovcnt );
 
     void close();
     void shutdown( int how = SHUT_RDWR );
+    /**
+     * socket file descriptor for setsockopt()/sendfile(), ownership is not changed
+     */
+    [[nodiscard]]
+    int native_handle() const noexcept { return m_socket_fd; }
+    /**
+     * tag (static string) reported by LoopProfiler for coroutines resumed by this socket events
+     */
+    void set_profile_tag( const char* tag ) noexcept;
+    /**
+     * process unique id of accepted or connected socket used in trace events, 0 for other sockets
+     */
+    [[nodiscard]]
+    uint64_t connection_id() const noexcept { return m_connection_id; }
 
 private:
     friend class Poller;
@@ -81,22 +102,30 @@ private:
     void create_socket();
     [[nodiscard]]
     int fd() const;
+    /**
+     * count socket in active connections metric, close() will uncount it
+     */
+    void set_connected() noexcept;
     /**
      * co_await ready_read() will wait for socket become readable
+     * @param site waiting function name reported by LoopProfiler
      * @return Awaiter for co_await
      */
-    auto ready_read();
+    auto ready_read( const char* site = __builtin_FUNCTION() );
     /**
      * co_await poll_write_event() will wait for socket get EPOLLOUT
+     * @param site waiting function name reported by LoopProfiler
      * @return Awaiter for co_await
      */
-    auto poll_write_event();
+    auto poll_write_event( const char* site = __builtin_FUNCTION() );
     CoroutineAwaiter<int>     try_async_accept(  sockaddr_in6* peer_addr );
     CoroutineAwaiter<ssize_t> try_async_read(  void* buffer, uint32_t buffer_size );
     CoroutineAwaiter<ssize_t> try_async_write( const void* buffer, size_t buffer_size );
 
     PollerCb* m_poller_cb = nullptr;
     int m_socket_fd = -1;
+    uint64_t m_connection_id = 0;
+    bool m_connected = false; ///< accepted or connected, counted in active connections
 };
 
 struct TcpSocket::ReadVAwaiter
@@ -148,6 +177,7 @@ inline bool TcpSocket::ReadVAwaiter::await_ready()
 inline void TcpSocket::ReadVAwaiter::await_suspend( std::experimental::coroutine_handle<> coro_handle )
 {
     m_poller_cb.reader_coro_handle = coro_handle;
+    m_poller_cb.reader_site = "async_readv";
 }
 
 inline ssize_t TcpSocket::ReadVAwaiter::await_resume()
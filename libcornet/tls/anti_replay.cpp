@@ -0,0 +1,92 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/tls/anti_replay.hpp>
+
+#include <cstring>
+#include <algorithm>
+
+namespace pioneer19::cornet::tls13
+{
+
+EarlyDataAntiReplay::EarlyDataAntiReplay( uint32_t window_ms, uint32_t bloom_bits )
+        : m_current( (bloom_bits+63)/64, 0 )
+          ,m_previous( (bloom_bits+63)/64, 0 )
+          ,m_window_ms{window_ms}
+          ,m_bloom_bits{ static_cast<uint32_t>(m_current.size()*64) }
+{}
+
+EarlyDataAntiReplay& EarlyDataAntiReplay::instance()
+{
+    static EarlyDataAntiReplay anti_replay;
+    return anti_replay;
+}
+
+void EarlyDataAntiReplay::advance_window( uint64_t now_ms )
+{
+    if( now_ms < m_window_start_ms + m_window_ms )
+        return;
+
+    if( now_ms < m_window_start_ms + 2*uint64_t{m_window_ms} )
+    {
+        m_previous.swap( m_current );
+        m_window_start_ms += m_window_ms;
+    }
+    else
+    {
+        std::fill( m_previous.begin(), m_previous.end(), 0 );
+        m_window_start_ms = now_ms;
+    }
+    std::fill( m_current.begin(), m_current.end(), 0 );
+}
+
+bool EarlyDataAntiReplay::test_bits( const std::vector<uint64_t>& filter, const uint32_t* bits ) noexcept
+{
+    for( uint32_t i = 0; i < BLOOM_HASHES; ++i )
+    {
+        if( (filter[bits[i]/64] & (uint64_t{1} << (bits[i]%64))) == 0 )
+            return false;
+    }
+    return true;
+}
+
+bool EarlyDataAntiReplay::check_and_insert(
+        const uint8_t* client_hello_hash, uint32_t hash_size, uint64_t now_ms )
+{
+    // transcript hash is uniformly distributed, its words are used as bloom hashes
+    uint32_t bits[BLOOM_HASHES] = {};
+    std::memcpy( bits, client_hello_hash, std::min<uint32_t>( hash_size, sizeof(bits) ) );
+    for( auto& bit : bits )
+        bit %= m_bloom_bits;
+
+    std::lock_guard lock{ m_mutex };
+    advance_window( now_ms );
+    if( test_bits( m_current, bits ) || test_bits( m_previous, bits ) )
+        return false;
+
+    for( auto bit : bits )
+        m_current[bit/64] |= uint64_t{1} << (bit%64);
+
+    return true;
+}
+
+bool EarlyDataAntiReplay::fresh_ticket_age(
+        uint32_t client_ticket_age_ms, uint64_t issue_time_ms, uint64_t now_ms ) const noexcept
+{
+    if( now_ms < issue_time_ms )
+        return false;
+    uint64_t server_ticket_age_ms = now_ms - issue_time_ms;
+    uint64_t age_skew = server_ticket_age_ms > client_ticket_age_ms
+            ? server_ticket_age_ms - client_ticket_age_ms
+            : client_ticket_age_ms - server_ticket_age_ms;
+
+    // replayed ClientHello skew grows with time, with half window tolerance it
+    // becomes stale before its hash leaves bloom filters (kept at least one window)
+    return age_skew <= m_window_ms/2;
+}
+
+}
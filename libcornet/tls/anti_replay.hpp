@@ -0,0 +1,72 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <mutex>
+#include <vector>
+
+namespace pioneer19::cornet::tls13
+{
+
+/**
+ * @brief 0-RTT anti-replay store shared by all server threads (RFC 8446 8.2, 8.3)
+ *
+ * ClientHello hashes are remembered in bloom filter of current time window,
+ * filter of previous window is still checked, older filters are dropped.
+ * ClientHello older than window is rejected by ticket age freshness check,
+ * so bounded memory is enough. False positive only rejects early data,
+ * handshake continues as 1-RTT.
+ */
+class EarlyDataAntiReplay
+{
+public:
+    static constexpr uint32_t DEFAULT_WINDOW_MS  = 10'000;
+    static constexpr uint32_t DEFAULT_BLOOM_BITS = 1U << 20;
+    static constexpr uint32_t BLOOM_HASHES = 4;
+
+    explicit EarlyDataAntiReplay( uint32_t window_ms = DEFAULT_WINDOW_MS
+                                  ,uint32_t bloom_bits = DEFAULT_BLOOM_BITS );
+    ~EarlyDataAntiReplay() = default;
+
+    static EarlyDataAntiReplay& instance();
+
+    /**
+     * remember ClientHello hash
+     * @return false if hash (probably) seen in current or previous window
+     */
+    bool check_and_insert( const uint8_t* client_hello_hash, uint32_t hash_size, uint64_t now_ms );
+    /**
+     * client ticket age (obfuscated_ticket_age - ticket_age_add) must differ from
+     * time passed since ticket issue less than half of window
+     */
+    [[nodiscard]]
+    bool fresh_ticket_age( uint32_t client_ticket_age_ms, uint64_t issue_time_ms, uint64_t now_ms ) const noexcept;
+    [[nodiscard]]
+    uint32_t window_ms() const noexcept { return m_window_ms; }
+
+    EarlyDataAntiReplay( const EarlyDataAntiReplay& ) = delete;
+    EarlyDataAntiReplay( EarlyDataAntiReplay&& )      = delete;
+    EarlyDataAntiReplay& operator=( const EarlyDataAntiReplay& ) = delete;
+    EarlyDataAntiReplay& operator=( EarlyDataAntiReplay&& )      = delete;
+
+private:
+    void advance_window( uint64_t now_ms );
+    [[nodiscard]]
+    static bool test_bits( const std::vector<uint64_t>& filter, const uint32_t* bits ) noexcept;
+
+    std::mutex m_mutex;
+    std::vector<uint64_t> m_current;
+    std::vector<uint64_t> m_previous;
+    uint64_t m_window_start_ms = 0;
+    uint32_t m_window_ms;
+    uint32_t m_bloom_bits;
+};
+
+}
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/tls/certificate_compression.hpp>
+
+#include <algorithm>
+
+#if defined(USE_ZLIB)
+#include <zlib.h>
+#endif
+#if defined(USE_BROTLI)
+#include <brotli/encode.h>
+#include <brotli/decode.h>
+#endif
+
+namespace pioneer19::cornet::tls13
+{
+
+static constexpr record::CertificateCompressionAlgorithm COMPILED_ALGORITHMS[] = {
+#if defined(USE_BROTLI)
+        record::CertificateCompressionAlgorithm::BROTLI,
+#endif
+#if defined(USE_ZLIB)
+        record::CertificateCompressionAlgorithm::ZLIB,
+#endif
+        record::CertificateCompressionAlgorithm::NONE
+};
+
+std::span<const record::CertificateCompressionAlgorithm> CertificateCompression::algorithms() noexcept
+{
+    // last NONE element only keeps array not empty
+    return { COMPILED_ALGORITHMS, std::size(COMPILED_ALGORITHMS) - 1 };
+}
+
+bool CertificateCompression::is_supported( record::CertificateCompressionAlgorithm algorithm ) noexcept
+{
+    auto compiled = algorithms();
+    return std::find( compiled.begin(), compiled.end(), algorithm ) != compiled.end();
+}
+
+std::vector<uint8_t> CertificateCompression::compress( record::CertificateCompressionAlgorithm algorithm
+        , [[maybe_unused]] const uint8_t* data, [[maybe_unused]] uint32_t data_size )
+{
+    std::vector<uint8_t> compressed;
+    switch( algorithm )
+    {
+#if defined(USE_ZLIB)
+        case record::CertificateCompressionAlgorithm::ZLIB:
+        {
+            uLongf compressed_size = compressBound( data_size );
+            compressed.resize( compressed_size );
+            if( compress2( compressed.data(), &compressed_size, data, data_size, Z_BEST_COMPRESSION ) != Z_OK )
+                return {};
+            compressed.resize( compressed_size );
+            break;
+        }
+#endif
+#if defined(USE_BROTLI)
+        case record::CertificateCompressionAlgorithm::BROTLI:
+        {
+            size_t compressed_size = BrotliEncoderMaxCompressedSize( data_size );
+            compressed.resize( compressed_size );
+            if( !BrotliEncoderCompress( BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC
+                                        , data_size, data, &compressed_size, compressed.data() ) )
+            {
+                return {};
+            }
+            compressed.resize( compressed_size );
+            break;
+        }
+#endif
+        default:
+            break;
+    }
+
+    return compressed;
+}
+
+bool CertificateCompression::decompress( record::CertificateCompressionAlgorithm algorithm
+        , [[maybe_unused]] const uint8_t* data, [[maybe_unused]] uint32_t data_size
+        , [[maybe_unused]] uint8_t* out_buffer, [[maybe_unused]] uint32_t out_size ) noexcept
+{
+    switch( algorithm )
+    {
+#if defined(USE_ZLIB)
+        case record::CertificateCompressionAlgorithm::ZLIB:
+        {
+            uLongf decompressed_size = out_size;
+            return uncompress( out_buffer, &decompressed_size, data, data_size ) == Z_OK
+                   && decompressed_size == out_size;
+        }
+#endif
+#if defined(USE_BROTLI)
+        case record::CertificateCompressionAlgorithm::BROTLI:
+        {
+            size_t decompressed_size = out_size;
+            return BrotliDecoderDecompress( data_size, data, &decompressed_size, out_buffer )
+                   == BROTLI_DECODER_RESULT_SUCCESS && decompressed_size == out_size;
+        }
+#endif
+        default:
+            return false;
+    }
+}
+
+}
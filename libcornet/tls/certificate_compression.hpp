@@ -0,0 +1,49 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <span>
+#include <vector>
+
+#include <libcornet/tls/types.hpp>
+
+namespace pioneer19::cornet::tls13
+{
+
+/**
+ * @brief RFC 8879 certificate compression algorithms
+ *
+ * Algorithms are compiled in by USE_BROTLI (link brotlienc, brotlidec)
+ * and USE_ZLIB (link z), defined by config.libcornet.brotli=true and
+ * config.libcornet.zlib=true. Without them certificate is never compressed.
+ */
+struct CertificateCompression
+{
+    /// decompressed Certificate message is parsed as single record
+    static constexpr uint32_t MAX_UNCOMPRESSED_SIZE = UINT16_MAX - sizeof(record::Handshake);
+
+    /// compiled in algorithms, most preferred first
+    static std::span<const record::CertificateCompressionAlgorithm> algorithms() noexcept;
+    static bool is_supported( record::CertificateCompressionAlgorithm algorithm ) noexcept;
+    /**
+     * compression is slow (max compression level), it is done once on certificate load
+     * @return compressed data, empty if algorithm not supported or failed
+     */
+    static std::vector<uint8_t> compress( record::CertificateCompressionAlgorithm algorithm
+                                          , const uint8_t* data, uint32_t data_size );
+    /**
+     * @return true if data decompressed to exactly out_size bytes
+     */
+    static bool decompress( record::CertificateCompressionAlgorithm algorithm
+                            , const uint8_t* data, uint32_t data_size
+                            , uint8_t* out_buffer, uint32_t out_size ) noexcept;
+};
+
+}
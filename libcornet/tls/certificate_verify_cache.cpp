@@ -0,0 +1,144 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/tls/certificate_verify_cache.hpp>
+
+#include <endian.h>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+
+#include <openssl/evp.h>
+#include <openssl/asn1.h>
+
+namespace pioneer19::cornet::tls13
+{
+
+CertificateVerifyCache& CertificateVerifyCache::instance()
+{
+    static CertificateVerifyCache verify_cache;
+    return verify_cache;
+}
+
+size_t CertificateVerifyCache::KeyHash::operator()( const Key& key ) const noexcept
+{
+    // key is cryptographic hash already
+    size_t hash;
+    std::memcpy( &hash, key.data(), sizeof(hash) );
+    return hash;
+}
+
+CertificateVerifyCache::Key CertificateVerifyCache::chain_key(
+        const std::string& hostname, std::span<const DerCert> der_certs )
+{
+    EVP_MD_CTX* md_ctx = EVP_MD_CTX_new();
+    if( md_ctx == nullptr || EVP_DigestInit_ex( md_ctx, EVP_sha256(), nullptr ) != 1 )
+    {
+        EVP_MD_CTX_free( md_ctx );
+        throw std::runtime_error( "CertificateVerifyCache::chain_key() failed init digest" );
+    }
+    // sizes separate fields, so different splits of the same bytes differ
+    auto digest_field = [md_ctx]( const void* data, uint32_t size ) {
+        uint32_t be_size = htobe32( size );
+        EVP_DigestUpdate( md_ctx, &be_size, sizeof(be_size) );
+        EVP_DigestUpdate( md_ctx, data, size );
+    };
+    digest_field( hostname.data(), hostname.size() );
+    for( auto& [der_cert, der_size] : der_certs )
+        digest_field( der_cert, der_size );
+
+    Key key;
+    unsigned int key_size = 0;
+    int res = EVP_DigestFinal_ex( md_ctx, key.data(), &key_size );
+    EVP_MD_CTX_free( md_ctx );
+    if( res != 1 || key_size != key.size() )
+        throw std::runtime_error( "CertificateVerifyCache::chain_key() failed finalize digest" );
+
+    return key;
+}
+
+CertificateVerifyCache::IssuerPtr CertificateVerifyCache::chain_issuer( STACK_OF(X509)* verified_chain )
+{
+    int chain_size = sk_X509_num( verified_chain );
+    if( chain_size <= 0 )
+        return nullptr;
+
+    X509* issuer = sk_X509_value( verified_chain, chain_size > 1 ? 1 : 0 );
+    X509_up_ref( issuer );
+    return IssuerPtr{ issuer, X509_free };
+}
+
+bool CertificateVerifyCache::find( const Key& key, time_t now, IssuerPtr* issuer )
+{
+    std::lock_guard lock{ m_mutex };
+    auto it = m_chains.find( key );
+    if( it == m_chains.end() )
+        return false;
+    if( now >= it->second->expire_time )
+    {
+        m_lru.erase( it->second );
+        m_chains.erase( it );
+        return false;
+    }
+    m_lru.splice( m_lru.begin(), m_lru, it->second );
+    if( issuer != nullptr )
+        *issuer = it->second->issuer;
+
+    return true;
+}
+
+void CertificateVerifyCache::store( const Key& key, STACK_OF(X509)* verified_chain, time_t now )
+{
+    time_t expire_time = now + m_max_ttl_sec;
+    for( int i = 0; i < sk_X509_num( verified_chain ); ++i )
+    {
+        tm not_after_tm = {};
+        if( ASN1_TIME_to_tm( X509_get0_notAfter( sk_X509_value( verified_chain, i ) ), &not_after_tm ) != 1 )
+            return;
+        expire_time = std::min( expire_time, timegm( &not_after_tm ) );
+    }
+    if( expire_time > now )
+        store( key, expire_time, chain_issuer( verified_chain ) );
+}
+
+void CertificateVerifyCache::store( const Key& key, time_t expire_time, IssuerPtr issuer )
+{
+    std::lock_guard lock{ m_mutex };
+    auto it = m_chains.find( key );
+    if( it != m_chains.end() )
+    {
+        it->second->expire_time = expire_time;
+        it->second->issuer = std::move( issuer );
+        m_lru.splice( m_lru.begin(), m_lru, it->second );
+        return;
+    }
+    if( m_capacity == 0 )
+        return;
+
+    m_lru.push_front( Entry{ key, expire_time, std::move(issuer) } );
+    m_chains.emplace( key, m_lru.begin() );
+    if( m_chains.size() > m_capacity )
+    {
+        m_chains.erase( m_lru.back().key );
+        m_lru.pop_back();
+    }
+}
+
+size_t CertificateVerifyCache::size()
+{
+    std::lock_guard lock{ m_mutex };
+    return m_chains.size();
+}
+
+void CertificateVerifyCache::clear()
+{
+    std::lock_guard lock{ m_mutex };
+    m_chains.clear();
+    m_lru.clear();
+}
+
+}
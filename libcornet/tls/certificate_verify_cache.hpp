@@ -0,0 +1,107 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <ctime>
+
+#include <list>
+#include <span>
+#include <array>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <utility>
+#include <unordered_map>
+
+#include <openssl/sha.h>
+#include <openssl/x509.h>
+
+namespace pioneer19::cornet::tls13
+{
+
+/**
+ * @brief client cache of verified server certificate chains (LRU), shared by all threads
+ *
+ * Key is SHA-256 of host name and DER certificates presented by server, so
+ * repeated handshake with the same upstream skips chain building and
+ * signatures verification. Only successful verification is cached (trusted
+ * store only grows, so it stays successful), entry expires with first expired
+ * certificate of verified chain or after max_ttl (to see CA or intermediate
+ * revocation eventually), whichever comes first. Entry keeps issuer of host
+ * certificate to check OCSP staple without chain building.
+ */
+class CertificateVerifyCache
+{
+public:
+    using Key = std::array<uint8_t,SHA256_DIGEST_LENGTH>;
+    using DerCert = std::pair<const uint8_t*,uint32_t>;
+    using IssuerPtr = std::shared_ptr<X509>;
+
+    static constexpr uint32_t DEFAULT_CAPACITY    = 1024; ///< chains count
+    static constexpr uint32_t DEFAULT_MAX_TTL_SEC = 3600;
+
+    explicit CertificateVerifyCache( uint32_t capacity = DEFAULT_CAPACITY
+                                     , uint32_t max_ttl_sec = DEFAULT_MAX_TTL_SEC )
+        :m_capacity{ capacity }, m_max_ttl_sec{ max_ttl_sec }
+    {}
+    ~CertificateVerifyCache() = default;
+
+    static CertificateVerifyCache& instance();
+
+    /**
+     * @param der_certs server certificate first, then chain as presented
+     */
+    static Key chain_key( const std::string& hostname, std::span<const DerCert> der_certs );
+    /**
+     * issuer of host certificate in verified chain, self signed host certificate
+     * is its own issuer
+     */
+    static IssuerPtr chain_issuer( STACK_OF(X509)* verified_chain );
+    /**
+     * @param issuer if not nullptr, gets issuer of host certificate stored with chain
+     * @return true if chain was verified and entry not expired (expired entry is removed)
+     */
+    bool find( const Key& key, time_t now, IssuerPtr* issuer = nullptr );
+    /**
+     * store successful verification of chain
+     * @param verified_chain chain built by X509_verify_cert (X509_STORE_CTX_get0_chain)
+     */
+    void store( const Key& key, STACK_OF(X509)* verified_chain, time_t now );
+    void store( const Key& key, time_t expire_time, IssuerPtr issuer = nullptr );
+
+    [[nodiscard]]
+    size_t size();
+    void clear();
+
+    CertificateVerifyCache( const CertificateVerifyCache& ) = delete;
+    CertificateVerifyCache( CertificateVerifyCache&& )      = delete;
+    CertificateVerifyCache& operator=( const CertificateVerifyCache& ) = delete;
+    CertificateVerifyCache& operator=( CertificateVerifyCache&& )      = delete;
+
+private:
+    struct KeyHash
+    {
+        size_t operator()( const Key& key ) const noexcept;
+    };
+    struct Entry
+    {
+        Key       key;
+        time_t    expire_time;
+        IssuerPtr issuer;
+    };
+    using LruList = std::list<Entry>;
+
+    std::mutex m_mutex;
+    LruList    m_lru; ///< most recently used chain first
+    std::unordered_map<Key,LruList::iterator,KeyHash> m_chains;
+    uint32_t   m_capacity;
+    uint32_t   m_max_ttl_sec;
+};
+
+}
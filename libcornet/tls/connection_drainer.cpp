@@ -0,0 +1,130 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/tls/connection_drainer.hpp>
+
+#include <sys/timerfd.h>
+
+#include <cerrno>
+#include <system_error>
+
+#include <libcornet/poller.hpp>
+#include <libcornet/async_file.hpp>
+#include <libcornet/tls/tls_socket.hpp>
+#include <pioneer19_utils/guards.hpp>
+
+namespace pioneer19::cornet::tls13
+{
+
+static void arm_timer( int timer_fd, std::chrono::nanoseconds timeout ) noexcept
+{
+    // zero it_value disarms timer, so minimal timeout is 1 ns
+    if( timeout.count() <= 0 )
+        timeout = std::chrono::nanoseconds{1};
+
+    itimerspec timer_spec{};
+    timer_spec.it_value.tv_sec  = timeout.count() / 1'000'000'000;
+    timer_spec.it_value.tv_nsec = timeout.count() % 1'000'000'000;
+    timerfd_settime( timer_fd, 0, &timer_spec, nullptr );
+}
+
+ConnectionDrainer::Session::Session( ConnectionDrainer& drainer )
+    :m_drainer{ &drainer }
+{
+    m_drainer->add_session( this );
+}
+
+ConnectionDrainer::Session::~Session()
+{
+    if( m_drainer )
+        m_drainer->remove_session( this );
+}
+
+void ConnectionDrainer::Session::set_idle( bool idle ) noexcept
+{
+    m_idle = idle;
+    if( m_idle && m_drainer && m_drainer->draining() )
+        close_idle_session( this );
+}
+
+ConnectionDrainer::~ConnectionDrainer()
+{
+    for( auto* session : m_sessions )
+        session->m_drainer = nullptr;
+}
+
+void ConnectionDrainer::add_session( Session* session )
+{
+    session->m_index = m_sessions.size();
+    m_sessions.push_back( session );
+}
+
+void ConnectionDrainer::remove_session( Session* session ) noexcept
+{
+    Session* last_session = m_sessions.back();
+    last_session->m_index = session->m_index;
+    m_sessions[session->m_index] = last_session;
+    m_sessions.pop_back();
+
+    if( m_sessions.empty() && m_timer_fd != -1 )
+        arm_timer( m_timer_fd, std::chrono::nanoseconds{0} );
+}
+
+void ConnectionDrainer::close_idle_session( Session* session ) noexcept
+{
+    if( session->m_tls_socket && session->m_idle && !session->m_tls_socket->write_in_progress() )
+        session->m_tls_socket->try_close_notify();
+}
+
+CoroutineAwaiter<bool> ConnectionDrainer::drain( Poller& poller, std::chrono::milliseconds timeout )
+{
+    m_draining = true;
+    for( auto* session : m_sessions )
+        close_idle_session( session );
+
+    co_return co_await wait_finished( poller, timeout );
+}
+
+CoroutineAwaiter<bool> ConnectionDrainer::wait_finished( Poller& poller, std::chrono::milliseconds timeout )
+{
+    if( m_sessions.empty() )
+        co_return true;
+
+    int timer_fd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC );
+    if( timer_fd == -1 )
+        throw std::system_error( errno, std::system_category()
+                                 , "ConnectionDrainer::wait_finished() timerfd_create failed" );
+    AsyncFile timer{ timer_fd, &poller };
+    m_timer_fd = timer_fd;
+    auto timer_guard = make_scope_guard( [this](){ m_timer_fd = -1; } );
+
+    // without timeout timer is armed by last finished session only
+    bool has_deadline = timeout != std::chrono::milliseconds::max();
+    auto deadline = std::chrono::steady_clock::now();
+    if( has_deadline )
+    {
+        deadline += timeout;
+        arm_timer( timer_fd, timeout );
+    }
+    while( !m_sessions.empty() )
+    {
+        uint64_t expirations = 0;
+        co_await timer.async_read( reinterpret_cast<char*>(&expirations), sizeof(expirations) );
+        if( !has_deadline )
+            continue;
+
+        auto now = std::chrono::steady_clock::now();
+        if( now >= deadline )
+            break;
+        if( !m_sessions.empty() )
+            arm_timer( timer_fd, deadline - now );
+    }
+
+    co_return m_sessions.empty();
+}
+
+}
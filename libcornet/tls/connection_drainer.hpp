@@ -0,0 +1,106 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include <chrono>
+#include <vector>
+
+#include <pioneer19_utils/coroutines_utils.hpp>
+
+namespace pioneer19::cornet
+{
+class Poller;
+}
+
+namespace pioneer19::cornet::tls13
+{
+class TlsSocket;
+
+/**
+ * @brief graceful shutdown of tls server sessions
+ *
+ * Every server session coroutine keeps ConnectionDrainer::Session in its frame
+ * (from accept until session end). On shutdown application stops accept loop and
+ * co_awaits drain(): idle sessions (waiting for next request) get close_notify
+ * at once, busy sessions must check draining() after response and close
+ * connection by TlsSocket::async_close_notify(). drain() returns when all
+ * sessions finished or timeout expired, then poller can be stopped.
+ *
+ * ConnectionDrainer must outlive sessions, works in one poller thread.
+ */
+class ConnectionDrainer
+{
+public:
+    class Session
+    {
+    public:
+        explicit Session( ConnectionDrainer& drainer );
+        ~Session();
+
+        /**
+         * socket of session after handshake, it gets close_notify on drain if session is idle
+         */
+        void set_socket( TlsSocket* tls_socket ) noexcept { m_tls_socket = tls_socket; }
+        /**
+         * session waits for next request (nothing in flight), drain can close it now.
+         * If drain started, socket is closed by this call
+         */
+        void set_idle( bool idle ) noexcept;
+
+        Session( const Session& ) = delete;
+        Session( Session&& )      = delete;
+        Session& operator=( const Session& ) = delete;
+        Session& operator=( Session&& )      = delete;
+
+    private:
+        friend class ConnectionDrainer;
+
+        ConnectionDrainer* m_drainer;
+        TlsSocket* m_tls_socket = nullptr;
+        size_t m_index;
+        bool   m_idle = false;
+    };
+
+    ConnectionDrainer() = default;
+    ~ConnectionDrainer();
+
+    [[nodiscard]]
+    bool draining() const noexcept { return m_draining; }
+    [[nodiscard]]
+    size_t sessions_count() const noexcept { return m_sessions.size(); }
+    /**
+     * start drain (new sessions are still counted, but see draining() == true)
+     * and wait for all sessions finished
+     * @return true if all sessions finished before timeout
+     */
+    CoroutineAwaiter<bool> drain( Poller& poller, std::chrono::milliseconds timeout );
+    /**
+     * wait for all sessions finished without closing them, milliseconds::max() waits without timeout
+     * @return true if all sessions finished before timeout
+     */
+    CoroutineAwaiter<bool> wait_finished(
+            Poller& poller, std::chrono::milliseconds timeout = std::chrono::milliseconds::max() );
+
+    ConnectionDrainer( const ConnectionDrainer& ) = delete;
+    ConnectionDrainer( ConnectionDrainer&& )      = delete;
+    ConnectionDrainer& operator=( const ConnectionDrainer& ) = delete;
+    ConnectionDrainer& operator=( ConnectionDrainer&& )      = delete;
+
+private:
+    void add_session( Session* session );
+    void remove_session( Session* session ) noexcept;
+    static void close_idle_session( Session* session ) noexcept;
+
+    std::vector<Session*> m_sessions;
+    int  m_timer_fd = -1; ///< wait_finished() timer, fired at once when last session finished
+    bool m_draining = false;
+};
+
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/tls/crypto/cipher_preference.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <utility>
+
+#include <libcornet/tls/crypto/record_ciphers.hpp>
+
+namespace pioneer19::cornet::tls13::crypto
+{
+
+CipherSuitePreference::CipherSuitePreference( const CpuFeatures& cpu_features ) noexcept
+{
+    if( cpu_features.fast_aes_gcm() )
+    {
+        m_order[0] = record::TLS_AES_128_GCM_SHA256;
+        if( !cpu_features.wide_aes_gcm() && cpu_features.avx512f )
+        {   // AVX-512 ChaCha20 outruns AES-256-GCM working one block per instruction
+            m_order[1] = record::TLS_CHACHA20_POLY1305_SHA256;
+            m_order[2] = record::TLS_AES_256_GCM_SHA384;
+        }
+        else
+        {
+            m_order[1] = record::TLS_AES_256_GCM_SHA384;
+            m_order[2] = record::TLS_CHACHA20_POLY1305_SHA256;
+        }
+    }
+    else
+    {   // software AES is slow and not constant time
+        m_order[0] = record::TLS_CHACHA20_POLY1305_SHA256;
+        m_order[1] = record::TLS_AES_128_GCM_SHA256;
+        m_order[2] = record::TLS_AES_256_GCM_SHA384;
+    }
+}
+
+CipherSuitePreference& CipherSuitePreference::instance() noexcept
+{
+    static CipherSuitePreference preference{ CpuFeatures::instance() };
+    return preference;
+}
+
+void CipherSuitePreference::set_order( const record::CipherSuite (&order)[SUITES_COUNT] ) noexcept
+{
+    std::copy_n( order, SUITES_COUNT, m_order );
+}
+
+uint32_t CipherSuitePreference::rank( record::CipherSuite cipher_suite ) const noexcept
+{
+    return std::find( m_order, m_order + SUITES_COUNT, cipher_suite ) - m_order;
+}
+
+record::CipherSuite CipherSuitePreference::select(
+        const record::CipherSuite* client_suites, uint32_t count ) const noexcept
+{
+    record::CipherSuite selected = record::TLS_PRIVATE_CIPHER_SUITE;
+    uint32_t selected_rank = SUITES_COUNT;
+    for( uint32_t i = 0; i < count; ++i )
+    {
+        uint32_t suite_rank = rank( client_suites[i] );
+        if( suite_rank == SUITES_COUNT )
+            continue;
+        if( selected_rank == SUITES_COUNT
+            && client_suites[i] == record::TLS_CHACHA20_POLY1305_SHA256 )
+        {
+            return client_suites[i];
+        }
+        if( suite_rank < selected_rank )
+        {
+            selected = client_suites[i];
+            selected_rank = suite_rank;
+        }
+    }
+
+    return selected;
+}
+
+static double encrypt_throughput( record::CipherSuite cipher_suite, uint32_t records_count )
+{
+    constexpr uint32_t RECORD_SIZE = 16*1024;
+
+    TlsCipherSuite tls_cipher_suite;
+    tls_cipher_suite.set_cipher_suite( cipher_suite );
+    std::fill_n( tls_cipher_suite.sender_key_data(), tls_cipher_suite.key_size(), 0x42 );
+    std::fill_n( tls_cipher_suite.sender_iv_data(), tls_cipher_suite.iv_size(), 0x24 );
+
+    std::unique_ptr<uint8_t[]> plaintext{ new uint8_t[RECORD_SIZE]{} };
+    std::unique_ptr<uint8_t[]> ciphertext{ new uint8_t[RECORD_SIZE+1] };
+    uint8_t tag[16];
+    const uint8_t tail[] = { static_cast<uint8_t>(record::ContentType::APPLICATION_DATA) };
+    const uint8_t aad[5] = { 0x17, 0x03, 0x03, 0x40, 0x11 };
+
+    RecordIn  record_in { plaintext.get(), RECORD_SIZE, tail, sizeof(tail), aad, sizeof(aad) };
+    RecordOut record_out{ ciphertext.get(), tag, 0 };
+    // first record warms up cipher context
+    tls_cipher_suite.encrypt_records( {&record_in, 1}, {&record_out, 1} );
+
+    auto begin = std::chrono::steady_clock::now();
+    for( uint32_t i = 0; i < records_count; ++i )
+        tls_cipher_suite.encrypt_records( {&record_in, 1}, {&record_out, 1} );
+    std::chrono::duration<double> seconds = std::chrono::steady_clock::now() - begin;
+
+    return records_count * double(RECORD_SIZE) / seconds.count();
+}
+
+void CipherSuitePreference::measure_throughput( uint32_t records_count )
+{
+    std::pair<double, record::CipherSuite> results[SUITES_COUNT];
+    for( uint32_t i = 0; i < SUITES_COUNT; ++i )
+        results[i] = { encrypt_throughput( m_order[i], records_count ), m_order[i] };
+
+    std::stable_sort( results, results + SUITES_COUNT
+                      , []( const auto& a, const auto& b ){ return a.first > b.first; } );
+    for( uint32_t i = 0; i < SUITES_COUNT; ++i )
+        m_order[i] = results[i].second;
+}
+
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <libcornet/cpu_features.hpp>
+#include <libcornet/tls/types.hpp>
+
+namespace pioneer19::cornet::tls13::crypto
+{
+
+/**
+ * @brief local cipher suites order, fastest on this cpu first
+ *
+ * Used by server to select cipher suite from ClientHello and by client
+ * to order ClientHello cipher_suites. Process wide instance() is created
+ * from CpuFeatures and can be refined by measure_throughput() at startup
+ * (before pollers threads started, instance is not synchronized).
+ */
+class CipherSuitePreference
+{
+public:
+    static constexpr uint32_t SUITES_COUNT = 3;
+
+    explicit CipherSuitePreference( const CpuFeatures& cpu_features ) noexcept;
+
+    static CipherSuitePreference& instance() noexcept;
+
+    /**
+     * encrypt records_count 16KB records with every suite and order suites by throughput
+     */
+    void measure_throughput( uint32_t records_count = 64 );
+    void set_order( const record::CipherSuite (&order)[SUITES_COUNT] ) noexcept;
+    /**
+     * select cipher suite for ClientHello cipher_suites. Client, which most preferred
+     * supported suite is ChaCha20, probably has no AES hardware and gets ChaCha20,
+     * otherwise best ranked by this preference suite is selected
+     * @return TLS_PRIVATE_CIPHER_SUITE if no supported suite found
+     */
+    [[nodiscard]]
+    record::CipherSuite select( const record::CipherSuite* client_suites, uint32_t count ) const noexcept;
+    /// position in preference order (0 is best), SUITES_COUNT for unsupported suite
+    [[nodiscard]]
+    uint32_t rank( record::CipherSuite cipher_suite ) const noexcept;
+    [[nodiscard]]
+    const record::CipherSuite* order() const noexcept { return m_order; }
+
+private:
+    record::CipherSuite m_order[SUITES_COUNT];
+};
+
+}
@@ -0,0 +1,83 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/tls/crypto/crypto_workers.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace pioneer19::cornet::tls13::crypto
+{
+
+CryptoWorkers::~CryptoWorkers()
+{
+    stop();
+}
+
+CryptoWorkers& CryptoWorkers::instance()
+{
+    static CryptoWorkers crypto_workers;
+    return crypto_workers;
+}
+
+void CryptoWorkers::start( uint32_t threads_count )
+{
+    std::lock_guard lock{ m_mutex };
+    if( !m_threads.empty() )
+        throw std::runtime_error( "CryptoWorkers::start() workers already started" );
+
+    if( threads_count == 0 )
+        threads_count = std::max( 1U, std::thread::hardware_concurrency() );
+    m_stop = false;
+    for( uint32_t i = 0; i < threads_count; ++i )
+        m_threads.emplace_back( &CryptoWorkers::worker_loop, this );
+
+    m_started.store( true, std::memory_order_release );
+}
+
+void CryptoWorkers::stop()
+{
+    std::vector<std::thread> threads;
+    {
+        std::lock_guard lock{ m_mutex };
+        m_started.store( false, std::memory_order_release );
+        m_stop = true;
+        threads.swap( m_threads );
+    }
+    m_jobs_cv.notify_all();
+    for( auto& thread : threads )
+        thread.join();
+}
+
+void CryptoWorkers::submit( std::function<void()> job )
+{
+    {
+        std::lock_guard lock{ m_mutex };
+        m_jobs.push_back( std::move(job) );
+    }
+    m_jobs_cv.notify_one();
+}
+
+void CryptoWorkers::worker_loop()
+{
+    while( true )
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock lock{ m_mutex };
+            m_jobs_cv.wait( lock, [this]{ return m_stop || !m_jobs.empty(); } );
+            // queued jobs are finished before stop, their coroutines wait for resume
+            if( m_jobs.empty() )
+                return;
+            job = std::move( m_jobs.front() );
+            m_jobs.pop_front();
+        }
+        job();
+    }
+}
+
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <mutex>
+#include <deque>
+#include <memory>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+#include <experimental/coroutine>
+
+#include <libcornet/poller.hpp>
+
+namespace pioneer19::cornet::tls13::crypto
+{
+
+/**
+ * @brief optional worker threads for expensive handshake crypto
+ *
+ * Signing and DHE derive take up to milliseconds, with started workers
+ * handshake coroutine is suspended, job runs in worker thread and coroutine
+ * is resumed in its home poller thread by Poller::resume_queue(). Without
+ * started workers (default) or outside of Poller::run() job runs inline.
+ */
+class CryptoWorkers
+{
+public:
+    template< typename FUNC >
+    struct OffloadAwaiter;
+
+    CryptoWorkers() = default;
+    ~CryptoWorkers();
+
+    static CryptoWorkers& instance();
+
+    /**
+     * start threads_count worker threads, 0 means hardware concurrency
+     */
+    void start( uint32_t threads_count = 0 );
+    /**
+     * finish queued jobs and join workers, must be called after pollers stopped
+     */
+    void stop();
+    [[nodiscard]]
+    bool started() const noexcept { return m_started.load( std::memory_order_acquire ); }
+    void submit( std::function<void()> job );
+
+    /**
+     * co_await CryptoWorkers::offload( func ) runs void func() in worker thread
+     * and rethrows its exception in coroutine
+     */
+    template< typename FUNC >
+    static OffloadAwaiter<FUNC> offload( FUNC func ) { return OffloadAwaiter<FUNC>{ std::move(func) }; }
+
+    CryptoWorkers( const CryptoWorkers& ) = delete;
+    CryptoWorkers( CryptoWorkers&& )      = delete;
+    CryptoWorkers& operator=( const CryptoWorkers& ) = delete;
+    CryptoWorkers& operator=( CryptoWorkers&& )      = delete;
+
+private:
+    void worker_loop();
+
+    std::mutex m_mutex;
+    std::condition_variable m_jobs_cv;
+    std::deque<std::function<void()>> m_jobs;
+    std::vector<std::thread> m_threads;
+    bool m_stop = false;
+    std::atomic<bool> m_started = false;
+};
+
+/**
+ * Job state is shared by awaiter and worker. Destroyed suspended coroutine (awaiter
+ * is destroyed with its frame) cancels not started job and posted resume, running
+ * job can use coroutine frame, so destruction waits for its end.
+ */
+template< typename FUNC >
+struct CryptoWorkers::OffloadAwaiter
+{
+    explicit OffloadAwaiter( FUNC func ) : m_func{ std::move(func) } {}
+    ~OffloadAwaiter() { cancel(); }
+
+    bool await_ready()
+    {
+        m_poller = Poller::current();
+        return m_poller == nullptr || !CryptoWorkers::instance().started();
+    }
+    void await_suspend( std::experimental::coroutine_handle<> coro_handle )
+    {
+        m_job = std::make_shared<Job>( std::move(m_func), coro_handle, &m_poller->resume_queue() );
+        CryptoWorkers::instance().submit( [job=m_job](){ job->run_in_worker(); } );
+    }
+    void await_resume()
+    {
+        if( !m_job )
+        {   // not suspended, job runs inline
+            m_func();
+            return;
+        }
+        // resumed after job is done, nothing to cancel
+        auto job = std::move( m_job );
+        if( job->exception )
+            std::rethrow_exception( job->exception );
+    }
+
+    OffloadAwaiter( const OffloadAwaiter& ) = delete;
+    OffloadAwaiter( OffloadAwaiter&& )      = delete;
+    OffloadAwaiter& operator=( const OffloadAwaiter& ) = delete;
+    OffloadAwaiter& operator=( OffloadAwaiter&& )      = delete;
+
+private:
+    enum class JobState { PENDING, RUNNING, DONE, CANCELLED };
+
+    struct Job
+    {
+        Job( FUNC job_func, std::experimental::coroutine_handle<> coro_handle, ResumeQueue* queue )
+            :func{ std::move(job_func) }, coro{ coro_handle }, resume_queue{ queue }
+        {}
+
+        void run_in_worker() noexcept
+        {
+            {
+                std::lock_guard lock{ mutex };
+                if( state == JobState::CANCELLED )
+                    return;
+                state = JobState::RUNNING;
+            }
+            try
+            {
+                func();
+            }
+            catch( ... )
+            {
+                exception = std::current_exception();
+            }
+            std::lock_guard lock{ mutex };
+            if( state == JobState::RUNNING )
+                resume_queue->post( coro );
+            state = JobState::DONE;
+            done_cv.notify_all();
+        }
+
+        FUNC func;
+        std::exception_ptr exception;
+        std::experimental::coroutine_handle<> coro;
+        ResumeQueue* resume_queue;
+        std::mutex mutex;
+        std::condition_variable done_cv;
+        JobState state = JobState::PENDING;
+    };
+
+    void cancel() noexcept
+    {
+        if( !m_job )
+            return;
+        std::unique_lock lock{ m_job->mutex };
+        if( m_job->state == JobState::DONE )
+        {   // resume is posted, but coroutine is destroyed
+            m_job->resume_queue->cancel( m_job->coro );
+            return;
+        }
+        bool running = m_job->state == JobState::RUNNING;
+        m_job->state = JobState::CANCELLED;
+        if( running )
+            m_job->done_cv.wait( lock, [this]{ return m_job->state == JobState::DONE; } );
+    }
+
+    FUNC    m_func;
+    Poller* m_poller = nullptr;
+    std::shared_ptr<Job> m_job;
+};
+
+}
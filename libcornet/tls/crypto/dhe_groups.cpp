@@ -6,9 +6,11 @@
  */
 
 #include <libcornet/tls/crypto/dhe_groups.hpp>
+#include <libcornet/tls/crypto/dhe_key_pool.hpp>
 
 #include <charconv>
 #include <string>
+#include <utility>
 #include <stdexcept>
 
 #include <openssl/ec.h>
@@ -42,6 +44,13 @@ void DheGroup::set_dhe_group( record::NamedGroup named_group )
 
 void DheGroup::create_key( record::NamedGroup named_group )
 {
+    // ephemeral key is pregenerated by per thread pool
+    m_key_pair = DheKeyPool::instance().take( named_group );
+}
+
+EVP_PKEY* DheGroup::generate_key( record::NamedGroup named_group )
+{
+    EVP_PKEY* key_pair = nullptr;
     EVP_PKEY_CTX* pctx = nullptr;
     switch( named_group )
     {
@@ -91,17 +100,19 @@ void DheGroup::create_key( record::NamedGroup named_group )
         default:
             char buff[4];
             std::to_chars(buff, buff+sizeof(buff), static_cast<uint16_t>(named_group),16);
-            throw std::out_of_range("DheGroup::create_key got unknown/unimplemented group 0x"
+            throw std::out_of_range("DheGroup::generate_key got unknown/unimplemented group 0x"
                                     +std::string(buff, sizeof(buff)) );
     }
-    if( EVP_PKEY_keygen( pctx, &m_key_pair ) != 1 )
+    if( EVP_PKEY_keygen( pctx, &key_pair ) != 1 )
     {
         printf( "EVP_PKEY_keygen failed\n" );
         ERR_print_errors_fp( stderr );
     }
     EVP_PKEY_CTX_free( pctx );
-    if( pctx == nullptr || m_key_pair == nullptr )
+    if( pctx == nullptr || key_pair == nullptr )
         ERR_print_errors_fp( stderr );
+
+    return key_pair;
 }
 
 uint32_t DheGroup::derive_secret( record::NamedGroup named_group
@@ -231,6 +242,12 @@ uint32_t DheGroup::public_key_size() const noexcept
     }
 }
 
+void DheGroup::swap( DheGroup& other ) noexcept
+{
+    std::swap( m_key_pair, other.m_key_pair );
+    std::swap( m_named_group, other.m_named_group );
+}
+
 bool DheGroup::is_supported( record::NamedGroup named_group ) noexcept
 {
     switch( named_group )
@@ -23,6 +23,10 @@ public:
 
     void set_dhe_group( record::NamedGroup named_group=record::NamedGroup::X25519 );
     static bool is_supported( record::NamedGroup ) noexcept;
+    /**
+     * generate new key pair (caller owns it), used by DheKeyPool
+     */
+    static EVP_PKEY* generate_key( record::NamedGroup named_group );
     [[nodiscard]]
     record::NamedGroup named_group() const noexcept { return m_named_group; }
 
@@ -31,6 +35,7 @@ public:
     uint32_t copy_public_key( uint8_t* dst ) noexcept;
     [[nodiscard]]
     uint32_t public_key_size() const noexcept;
+    void swap( DheGroup& other ) noexcept;
 
     DheGroup( DheGroup&& )            = delete;
     DheGroup& operator=( DheGroup&& ) = delete;
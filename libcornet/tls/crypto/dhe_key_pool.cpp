@@ -0,0 +1,118 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/tls/crypto/dhe_key_pool.hpp>
+
+#include <libcornet/poller.hpp>
+#include <libcornet/tls/crypto/dhe_groups.hpp>
+
+namespace pioneer19::cornet::tls13::crypto
+{
+
+DheKeyPool::DheKeyPool( uint32_t pool_size ) noexcept
+        : m_groups{ GroupKeys{record::NamedGroup::X25519}, GroupKeys{record::NamedGroup::X448}
+                    ,GroupKeys{record::NamedGroup::SECP256R1}, GroupKeys{record::NamedGroup::SECP384R1}
+                    ,GroupKeys{record::NamedGroup::SECP521R1} }
+          ,m_pool_size{ pool_size }
+{}
+
+DheKeyPool::~DheKeyPool() noexcept
+{
+    for( auto& group : m_groups )
+    {
+        for( auto* key_pair : group.keys )
+            EVP_PKEY_free( key_pair );
+    }
+}
+
+DheKeyPool& DheKeyPool::instance()
+{
+    static thread_local DheKeyPool key_pool;
+    return key_pool;
+}
+
+DheKeyPool::GroupKeys* DheKeyPool::find_group( record::NamedGroup named_group ) noexcept
+{
+    for( auto& group : m_groups )
+    {
+        if( group.named_group == named_group )
+            return &group;
+    }
+    return nullptr;
+}
+
+EVP_PKEY* DheKeyPool::take( record::NamedGroup named_group )
+{
+    GroupKeys* group = find_group( named_group );
+    if( group == nullptr || m_pool_size == 0 )
+        return DheGroup::generate_key( named_group );
+
+    group->active = true;
+    register_idle_refill();
+    if( group->keys.empty() )
+        return DheGroup::generate_key( named_group );
+
+    EVP_PKEY* key_pair = group->keys.back();
+    group->keys.pop_back();
+
+    return key_pair;
+}
+
+uint32_t DheKeyPool::refill( uint32_t max_keys )
+{
+    uint32_t generated = 0;
+    for( auto& group : m_groups )
+    {
+        while( group.active && group.keys.size() < m_pool_size && generated < max_keys )
+        {
+            EVP_PKEY* key_pair = DheGroup::generate_key( group.named_group );
+            if( key_pair == nullptr )
+                return generated;
+            group.keys.push_back( key_pair );
+            ++generated;
+        }
+    }
+    return generated;
+}
+
+void DheKeyPool::fill( record::NamedGroup named_group )
+{
+    GroupKeys* group = find_group( named_group );
+    if( group == nullptr )
+        return;
+
+    group->active = true;
+    while( group->keys.size() < m_pool_size )
+    {
+        EVP_PKEY* key_pair = DheGroup::generate_key( named_group );
+        if( key_pair == nullptr )
+            return;
+        group->keys.push_back( key_pair );
+    }
+}
+
+uint32_t DheKeyPool::size( record::NamedGroup named_group ) const noexcept
+{
+    for( auto& group : m_groups )
+    {
+        if( group.named_group == named_group )
+            return group.keys.size();
+    }
+    return 0;
+}
+
+void DheKeyPool::register_idle_refill()
+{
+    Poller* poller = Poller::current();
+    if( poller == nullptr || poller == m_idle_poller )
+        return;
+
+    m_idle_poller = poller;
+    poller->run_on_idle( [this](){ return refill( REFILL_BATCH_SIZE ) == REFILL_BATCH_SIZE; } );
+}
+
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <array>
+#include <vector>
+
+#include <openssl/evp.h>
+
+#include <libcornet/tls/types.hpp>
+
+namespace pioneer19::cornet
+{
+class Poller;
+}
+
+namespace pioneer19::cornet::tls13::crypto
+{
+
+/**
+ * @brief per thread pool of pregenerated ephemeral DHE key pairs
+ *
+ * Handshake takes key pair from pool instead of EVP_PKEY_keygen on critical
+ * path. Group pool is activated by first take() and refilled in idle
+ * iterations of poller running in this thread (or by explicit refill()).
+ * Empty pool generates key inline.
+ */
+class DheKeyPool
+{
+public:
+    static constexpr uint32_t DEFAULT_POOL_SIZE = 32; ///< keys per group
+    static constexpr uint32_t REFILL_BATCH_SIZE = 4;  ///< keys per idle iteration
+
+    explicit DheKeyPool( uint32_t pool_size = DEFAULT_POOL_SIZE ) noexcept;
+    ~DheKeyPool() noexcept;
+
+    static DheKeyPool& instance();
+
+    /**
+     * @return key pair owned by caller
+     */
+    EVP_PKEY* take( record::NamedGroup named_group );
+    /**
+     * generate up to max_keys keys for active groups
+     * @return generated keys count
+     */
+    uint32_t refill( uint32_t max_keys );
+    /**
+     * activate group and fill its pool completely (warm up before start)
+     */
+    void fill( record::NamedGroup named_group );
+    [[nodiscard]]
+    uint32_t size( record::NamedGroup named_group ) const noexcept;
+    [[nodiscard]]
+    uint32_t pool_size() const noexcept { return m_pool_size; }
+    void set_pool_size( uint32_t pool_size ) noexcept { m_pool_size = pool_size; }
+
+    DheKeyPool( const DheKeyPool& ) = delete;
+    DheKeyPool( DheKeyPool&& )      = delete;
+    DheKeyPool& operator=( const DheKeyPool& ) = delete;
+    DheKeyPool& operator=( DheKeyPool&& )      = delete;
+
+private:
+    struct GroupKeys
+    {
+        explicit GroupKeys( record::NamedGroup group ) noexcept : named_group{ group } {}
+
+        record::NamedGroup named_group;
+        bool active = false;
+        std::vector<EVP_PKEY*> keys;
+    };
+    [[nodiscard]]
+    GroupKeys* find_group( record::NamedGroup named_group ) noexcept;
+    void register_idle_refill();
+
+    std::array<GroupKeys,5> m_groups;
+    uint32_t m_pool_size;
+    Poller*  m_idle_poller = nullptr;
+};
+
+}
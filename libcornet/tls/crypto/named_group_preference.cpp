@@ -0,0 +1,85 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/tls/crypto/named_group_preference.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <libcornet/tls/crypto/dhe_groups.hpp>
+
+namespace pioneer19::cornet::tls13::crypto
+{
+
+NamedGroupPreference::NamedGroupPreference() noexcept
+        :m_groups{ record::NamedGroup::X25519, record::NamedGroup::SECP256R1, record::NamedGroup::X448
+                   , record::NamedGroup::SECP384R1, record::NamedGroup::SECP521R1 }
+        ,m_key_shares{ record::NamedGroup::X25519 }
+        ,m_groups_count{ MAX_GROUPS }
+        ,m_key_shares_count{ 1 }
+{}
+
+NamedGroupPreference& NamedGroupPreference::instance() noexcept
+{
+    static NamedGroupPreference preference;
+    return preference;
+}
+
+bool NamedGroupPreference::is_enabled( record::NamedGroup named_group ) const noexcept
+{
+    return std::find( m_groups, m_groups + m_groups_count, named_group ) != m_groups + m_groups_count;
+}
+
+void NamedGroupPreference::set_groups( std::span<const record::NamedGroup> groups )
+{
+    record::NamedGroup new_groups[MAX_GROUPS];
+    uint32_t new_groups_count = 0;
+    for( auto named_group : groups )
+    {
+        if( new_groups_count == MAX_GROUPS || !DheGroup::is_supported( named_group )
+            || std::find( new_groups, new_groups + new_groups_count, named_group ) != new_groups + new_groups_count )
+        {
+            continue;
+        }
+        new_groups[new_groups_count++] = named_group;
+    }
+    if( new_groups_count == 0 )
+        throw std::invalid_argument( "NamedGroupPreference::set_groups() no supported group" );
+
+    std::copy_n( new_groups, new_groups_count, m_groups );
+    m_groups_count = new_groups_count;
+
+    auto key_shares_end = std::remove_if( m_key_shares, m_key_shares + m_key_shares_count
+            ,[this]( record::NamedGroup named_group ){ return !is_enabled( named_group ); } );
+    m_key_shares_count = key_shares_end - m_key_shares;
+    // client always sends at least one key share
+    if( m_key_shares_count == 0 )
+        m_key_shares[m_key_shares_count++] = m_groups[0];
+}
+
+void NamedGroupPreference::set_key_shares( std::span<const record::NamedGroup> key_shares )
+{
+    record::NamedGroup new_key_shares[MAX_GROUPS];
+    uint32_t new_key_shares_count = 0;
+    for( auto named_group : key_shares )
+    {
+        if( new_key_shares_count == MAX_GROUPS || !is_enabled( named_group )
+            || std::find( new_key_shares, new_key_shares + new_key_shares_count, named_group )
+               != new_key_shares + new_key_shares_count )
+        {
+            continue;
+        }
+        new_key_shares[new_key_shares_count++] = named_group;
+    }
+    if( new_key_shares_count == 0 )
+        throw std::invalid_argument( "NamedGroupPreference::set_key_shares() no enabled group" );
+
+    std::copy_n( new_key_shares, new_key_shares_count, m_key_shares );
+    m_key_shares_count = new_key_shares_count;
+}
+
+}
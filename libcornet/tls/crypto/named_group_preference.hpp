@@ -0,0 +1,64 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <span>
+
+#include <libcornet/tls/types.hpp>
+
+namespace pioneer19::cornet::tls13::crypto
+{
+
+/**
+ * @brief local (EC)DHE groups and ClientHello key_share strategy
+ *
+ * groups() are sent by client in supported_groups and accepted by server.
+ * Client generates key share for every key_shares() group: several shares
+ * avoid HelloRetryRequest round trip if server does not support first group,
+ * single share saves key generation. Process wide instance() is configured
+ * at startup (before pollers threads started, instance is not synchronized).
+ */
+class NamedGroupPreference
+{
+public:
+    static constexpr uint32_t MAX_GROUPS = 5;
+
+    NamedGroupPreference() noexcept;
+
+    static NamedGroupPreference& instance() noexcept;
+
+    /**
+     * set supported groups, most preferred first (unsupported groups are skipped),
+     * key shares of not supported groups are removed
+     * @throw std::invalid_argument if no supported group
+     */
+    void set_groups( std::span<const record::NamedGroup> groups );
+    /**
+     * set ClientHello key_share groups (not in groups() are skipped)
+     * @throw std::invalid_argument if no group in groups()
+     */
+    void set_key_shares( std::span<const record::NamedGroup> key_shares );
+
+    [[nodiscard]]
+    std::span<const record::NamedGroup> groups() const noexcept { return { m_groups, m_groups_count }; }
+    [[nodiscard]]
+    std::span<const record::NamedGroup> key_shares() const noexcept
+    { return { m_key_shares, m_key_shares_count }; }
+    [[nodiscard]]
+    bool is_enabled( record::NamedGroup named_group ) const noexcept;
+
+private:
+    record::NamedGroup m_groups[MAX_GROUPS];
+    record::NamedGroup m_key_shares[MAX_GROUPS];
+    uint32_t m_groups_count = 0;
+    uint32_t m_key_shares_count = 0;
+};
+
+}
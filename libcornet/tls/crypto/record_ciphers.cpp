@@ -19,13 +19,16 @@
 namespace pioneer19::cornet::tls13::crypto
 {
 
+/*
+ * ctx must be already keyed (init_sender_context/init_receiver_context),
+ * every record only sets new nonce, key schedule is not recalculated
+ */
 static uint32_t aead_encrypt( const uint8_t* plaintext, uint32_t plaintext_size
-        ,const uint8_t* aad, uint32_t aad_size
-        ,const uint8_t* key, const uint8_t* iv
-        ,uint8_t* ciphertext, uint8_t* tag, const EVP_CIPHER* cipher, EVP_CIPHER_CTX* ctx )
+        ,const uint8_t* aad, uint32_t aad_size, const uint8_t* nonce
+        ,uint8_t* ciphertext, uint8_t* tag, EVP_CIPHER_CTX* ctx )
 {
-    /* Set cipher type and mode */
-    EVP_EncryptInit_ex( ctx, cipher, nullptr, key, iv );
+    /* Set nonce, cipher and key are kept in ctx */
+    EVP_EncryptInit_ex( ctx, nullptr, nullptr, nullptr, nonce );
     /* Zero or more calls to specify any AAD */
     int length;
     EVP_EncryptUpdate( ctx, nullptr, &length, aad, aad_size );
@@ -37,19 +40,16 @@ static uint32_t aead_encrypt( const uint8_t* plaintext, uint32_t plaintext_size
     /* Get tag */
     EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_AEAD_GET_TAG, 16, tag );
 
-    EVP_CIPHER_CTX_reset( ctx );
-
     return ciphertext_size;
 }
 
 static uint32_t aead_encrypt2( const uint8_t* plaintext, uint32_t plaintext_size
         ,const uint8_t* plaintext_tail, uint32_t tail_size
-        ,const uint8_t* aad, uint32_t aad_size
-        ,const uint8_t* key, const uint8_t* iv
-        ,uint8_t* ciphertext, uint8_t* tag, const EVP_CIPHER* cipher, EVP_CIPHER_CTX* ctx )
+        ,const uint8_t* aad, uint32_t aad_size, const uint8_t* nonce
+        ,uint8_t* ciphertext, uint8_t* tag, EVP_CIPHER_CTX* ctx )
 {
-    /* Set cipher type and mode */
-    EVP_EncryptInit_ex( ctx, cipher, nullptr, key, iv );
+    /* Set nonce, cipher and key are kept in ctx */
+    EVP_EncryptInit_ex( ctx, nullptr, nullptr, nullptr, nonce );
     /* Zero or more calls to specify any AAD */
     int length = 0;
     EVP_EncryptUpdate( ctx, nullptr, &length, aad, aad_size );
@@ -63,18 +63,15 @@ static uint32_t aead_encrypt2( const uint8_t* plaintext, uint32_t plaintext_size
     /* Get tag */
     EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_AEAD_GET_TAG, 16, tag );
 
-    EVP_CIPHER_CTX_reset( ctx );
-
     return ciphertext_size;
 }
 
 static uint32_t aead_decrypt( const uint8_t* ciphertext, uint32_t ciphertext_size
-        ,const uint8_t* aad, uint32_t aad_size, const uint8_t* tag
-        ,const uint8_t* key, const uint8_t* iv
-        ,uint8_t* plaintext, const EVP_CIPHER* cipher, EVP_CIPHER_CTX* ctx )
+        ,const uint8_t* aad, uint32_t aad_size, const uint8_t* tag, const uint8_t* nonce
+        ,uint8_t* plaintext, EVP_CIPHER_CTX* ctx )
 {
-    /* Initialise the decryption operation. */
-    EVP_DecryptInit_ex( ctx, cipher, nullptr, key, iv );
+    /* Set nonce, cipher and key are kept in ctx */
+    EVP_DecryptInit_ex( ctx, nullptr, nullptr, nullptr, nonce );
     // AAD data. This can be called zero or more times as
     int len;
     EVP_DecryptUpdate( ctx, nullptr, &len, aad, aad_size );
@@ -90,8 +87,6 @@ static uint32_t aead_decrypt( const uint8_t* ciphertext, uint32_t ciphertext_siz
     int ret = EVP_DecryptFinal_ex( ctx, plaintext + len, &len );
     plaintext_size += len;
 
-    EVP_CIPHER_CTX_reset( ctx );
-
     if( ret > 0 )
         return static_cast<uint32_t>( plaintext_size );
     else
@@ -110,19 +105,29 @@ static void fill_nonce(
 }
 
 TlsCipherSuite::TlsCipherSuite() noexcept
-        :m_ctx{ EVP_CIPHER_CTX_new() }
+        :m_encrypt_ctx{ EVP_CIPHER_CTX_new() }
+        ,m_decrypt_ctx{ EVP_CIPHER_CTX_new() }
 {}
 
 TlsCipherSuite::~TlsCipherSuite() noexcept
 {
-    if( m_ctx != nullptr )
-        EVP_CIPHER_CTX_free( m_ctx );
+    free_contexts();
+}
+
+void TlsCipherSuite::free_contexts() noexcept
+{
+    if( m_encrypt_ctx != nullptr )
+        EVP_CIPHER_CTX_free( m_encrypt_ctx );
+    if( m_decrypt_ctx != nullptr )
+        EVP_CIPHER_CTX_free( m_decrypt_ctx );
 }
 
 void TlsCipherSuite::copy_instance_data( TlsCipherSuite& other )
 {
-    m_ctx    = other.m_ctx;
+    m_encrypt_ctx = other.m_encrypt_ctx;
+    m_decrypt_ctx = other.m_decrypt_ctx;
     m_cipher = other.m_cipher;
+    m_cipher_suite = other.m_cipher_suite;
     std::copy_n( other.m_sender_key  , sizeof(m_sender_key)  , m_sender_key );
     std::copy_n( other.m_sender_iv   , sizeof(m_sender_iv   ), m_sender_iv   );
     std::copy_n( other.m_receiver_key, sizeof(m_receiver_key), m_receiver_key);
@@ -132,19 +137,24 @@ void TlsCipherSuite::copy_instance_data( TlsCipherSuite& other )
     m_digest      = other.m_digest;
     m_key_size    = other.m_key_size;
     m_digest_size = other.m_digest_size;
+    m_sender_keyed   = other.m_sender_keyed;
+    m_receiver_keyed = other.m_receiver_keyed;
 }
 TlsCipherSuite::TlsCipherSuite( TlsCipherSuite&& other ) noexcept
 {
     copy_instance_data( other );
-    other.m_ctx = nullptr;
+    other.m_encrypt_ctx = nullptr;
+    other.m_decrypt_ctx = nullptr;
 }
 TlsCipherSuite& TlsCipherSuite::operator=( TlsCipherSuite&& other ) noexcept
 {
     if( &other == this )
         return *this;
 
+    free_contexts();
     copy_instance_data( other );
-    other.m_ctx = nullptr;
+    other.m_encrypt_ctx = nullptr;
+    other.m_decrypt_ctx = nullptr;
 
     return *this;
 }
@@ -190,17 +200,34 @@ void TlsCipherSuite::set_cipher_suite( record::CipherSuite cipher_suite )
             throw std::out_of_range("TlsCipherSuite not defined for "
                                     +std::string(buff, sizeof(buff)) );
     }
+    m_cipher_suite   = cipher_suite;
+    m_sender_keyed   = false;
+    m_receiver_keyed = false;
+}
+
+void TlsCipherSuite::init_sender_context() noexcept
+{
+    EVP_EncryptInit_ex( m_encrypt_ctx, m_cipher, nullptr, m_sender_key, nullptr );
+    m_sender_keyed = true;
+}
+
+void TlsCipherSuite::init_receiver_context() noexcept
+{
+    EVP_DecryptInit_ex( m_decrypt_ctx, m_cipher, nullptr, m_receiver_key, nullptr );
+    m_receiver_keyed = true;
 }
 
 uint32_t TlsCipherSuite::encrypt(
         const uint8_t* plaintext, uint32_t plaintext_size, const uint8_t* aad, uint32_t aad_size,
         uint8_t* ciphertext, uint8_t* tag ) noexcept
 {
+    if( !m_sender_keyed )
+        init_sender_context();
     uint8_t nonce[EVP_MAX_IV_LENGTH];
     fill_nonce( nonce, m_sender_iv, m_sender_counter, iv_size() );
 
-    return aead_encrypt( plaintext, plaintext_size, aad, aad_size, m_sender_key, nonce
-                         ,ciphertext, tag, m_cipher, m_ctx );
+    return aead_encrypt( plaintext, plaintext_size, aad, aad_size, nonce
+                         ,ciphertext, tag, m_encrypt_ctx );
 }
 
 uint32_t TlsCipherSuite::encrypt2(
@@ -208,23 +235,68 @@ uint32_t TlsCipherSuite::encrypt2(
         const uint8_t* plaintext_tail, uint32_t tail_size,
         const uint8_t* aad, uint32_t aad_size, uint8_t* ciphertext, uint8_t* tag ) noexcept
 {
+    if( !m_sender_keyed )
+        init_sender_context();
     uint8_t nonce[EVP_MAX_IV_LENGTH];
     fill_nonce( nonce, m_sender_iv, m_sender_counter, iv_size() );
 
     return aead_encrypt2( plaintext, plaintext_size, plaintext_tail, tail_size
-                          , aad, aad_size, m_sender_key, nonce
-                          , ciphertext, tag, m_cipher, m_ctx );
+                          , aad, aad_size, nonce
+                          , ciphertext, tag, m_encrypt_ctx );
+}
+
+uint32_t TlsCipherSuite::encrypt_records(
+        std::span<const RecordIn> records, std::span<RecordOut> out ) noexcept
+{
+    if( !m_sender_keyed )
+        init_sender_context();
+
+    auto records_count = static_cast<uint32_t>( std::min( records.size(), out.size() ));
+    uint8_t nonce[EVP_MAX_IV_LENGTH];
+    for( uint32_t i = 0; i < records_count; ++i )
+    {
+        const RecordIn& in = records[i];
+        fill_nonce( nonce, m_sender_iv, m_sender_counter, iv_size() );
+        out[i].ciphertext_size = aead_encrypt2( in.plaintext, in.plaintext_size
+                , in.plaintext_tail, in.tail_size, in.aad, in.aad_size, nonce
+                , out[i].ciphertext, out[i].tag, m_encrypt_ctx );
+    }
+
+    return records_count;
+}
+
+uint32_t TlsCipherSuite::decrypt_records(
+        std::span<const CiphertextIn> records, std::span<PlaintextOut> out ) noexcept
+{
+    if( !m_receiver_keyed )
+        init_receiver_context();
+
+    auto records_count = static_cast<uint32_t>( std::min( records.size(), out.size() ));
+    uint8_t nonce[EVP_MAX_IV_LENGTH];
+    for( uint32_t i = 0; i < records_count; ++i )
+    {
+        const CiphertextIn& in = records[i];
+        fill_nonce( nonce, m_receiver_iv, m_receiver_counter, iv_size() );
+        out[i].plaintext_size = aead_decrypt( in.ciphertext, in.ciphertext_size
+                , in.aad, in.aad_size, in.tag, nonce, out[i].plaintext, m_decrypt_ctx );
+        if( out[i].plaintext_size == 0 && in.ciphertext_size != 0 )
+            return i;
+    }
+
+    return records_count;
 }
 
 uint32_t TlsCipherSuite::decrypt(
         const uint8_t* ciphertext, uint32_t ciphertext_size,
         const uint8_t* aad, uint32_t aad_size, const uint8_t* tag, uint8_t* plaintext ) noexcept
 {
+    if( !m_receiver_keyed )
+        init_receiver_context();
     uint8_t nonce[EVP_MAX_IV_LENGTH];
     fill_nonce( nonce, m_receiver_iv, m_receiver_counter, iv_size() );
 
-    return aead_decrypt( ciphertext, ciphertext_size, aad, aad_size, tag, m_receiver_key, nonce
-                         , plaintext, m_cipher, m_ctx );
+    return aead_decrypt( ciphertext, ciphertext_size, aad, aad_size, tag, nonce
+                         , plaintext, m_decrypt_ctx );
 }
 
 }
@@ -9,6 +9,7 @@
 
 #include <cstdint>
 #include <memory>
+#include <span>
 #include <openssl/sha.h>
 #include <openssl/evp.h>
 
@@ -17,6 +18,46 @@
 namespace pioneer19::cornet::tls13::crypto
 {
 
+/**
+ * one record for TlsCipherSuite::encrypt_records(), plaintext is
+ * encrypted as plaintext+plaintext_tail (same as encrypt2)
+ */
+struct RecordIn
+{
+    const uint8_t* plaintext;
+    uint32_t       plaintext_size;
+    const uint8_t* plaintext_tail;
+    uint32_t       tail_size;
+    const uint8_t* aad;
+    uint32_t       aad_size;
+};
+
+struct RecordOut
+{
+    uint8_t* ciphertext;
+    uint8_t* tag;
+    uint32_t ciphertext_size; ///< filled by encrypt_records()
+};
+
+/**
+ * one record for TlsCipherSuite::decrypt_records(), plaintext
+ * can be at ciphertext (decrypted in place)
+ */
+struct CiphertextIn
+{
+    const uint8_t* ciphertext;
+    uint32_t       ciphertext_size;
+    const uint8_t* aad;
+    uint32_t       aad_size;
+    const uint8_t* tag;
+};
+
+struct PlaintextOut
+{
+    uint8_t* plaintext;
+    uint32_t plaintext_size; ///< filled by decrypt_records()
+};
+
 class TlsCipherSuite
 {
 public:
@@ -42,18 +83,60 @@ public:
     uint32_t decrypt( const uint8_t* ciphertext, uint32_t ciphertext_size
             ,const uint8_t* aad, uint32_t aad_size, const uint8_t* tag
             ,uint8_t* plaintext) noexcept;
-    void reset_key_counters() noexcept { m_sender_counter = 0; m_receiver_counter = 0; }
+    /**
+     * encrypt records with sequential nonces, cipher context
+     * keyed once and only nonce changed per record
+     * @return number of encrypted records: min( records.size(), out.size() )
+     */
+    uint32_t encrypt_records( std::span<const RecordIn> records, std::span<RecordOut> out ) noexcept;
+    /**
+     * decrypt records with sequential nonces, receiver counterpart of encrypt_records()
+     * @return number of decrypted records, stops at first record failed authentication
+     */
+    uint32_t decrypt_records( std::span<const CiphertextIn> records, std::span<PlaintextOut> out ) noexcept;
+    /**
+     * must be called after new keys written to sender_key_data()/receiver_key_data(),
+     * cipher contexts will be rekeyed on next use
+     */
+    void reset_key_counters() noexcept
+    {
+        m_sender_counter = 0; m_receiver_counter = 0;
+        m_sender_keyed = false; m_receiver_keyed = false;
+    }
+    /**
+     * new keys written for one direction only (0-RTT early data keys),
+     * counter is sequence number of next record protected by this key
+     */
+    void reset_sender_key( uint64_t counter = 0 ) noexcept
+    { m_sender_counter = counter; m_sender_keyed = false; }
+    void reset_receiver_key( uint64_t counter = 0 ) noexcept
+    { m_receiver_counter = counter; m_receiver_keyed = false; }
+    void set_receiver_counter( uint64_t counter ) noexcept { m_receiver_counter = counter; }
     [[nodiscard]]
     uint8_t* sender_key_data() noexcept { return m_sender_key; }
     [[nodiscard]]
     uint8_t* receiver_key_data() noexcept { return m_receiver_key; }
     [[nodiscard]]
+    const uint8_t* sender_key_data() const noexcept { return m_sender_key; }
+    [[nodiscard]]
+    const uint8_t* receiver_key_data() const noexcept { return m_receiver_key; }
+    [[nodiscard]]
     uint32_t key_size() const noexcept { return m_key_size; }
     [[nodiscard]]
     uint8_t* sender_iv_data() noexcept { return m_sender_iv; }
     [[nodiscard]]
     uint8_t* receiver_iv_data() noexcept { return m_receiver_iv; }
     [[nodiscard]]
+    const uint8_t* sender_iv_data() const noexcept { return m_sender_iv; }
+    [[nodiscard]]
+    const uint8_t* receiver_iv_data() const noexcept { return m_receiver_iv; }
+    [[nodiscard]]
+    uint64_t sender_counter() const noexcept { return m_sender_counter; }
+    [[nodiscard]]
+    uint64_t receiver_counter() const noexcept { return m_receiver_counter; }
+    [[nodiscard]]
+    record::CipherSuite cipher_suite() const noexcept { return m_cipher_suite; }
+    [[nodiscard]]
     static uint32_t iv_size()  noexcept { return 12; }
     [[nodiscard]]
     static uint32_t tag_size() noexcept { return 16; }
@@ -64,9 +147,14 @@ public:
 
 private:
     void copy_instance_data( TlsCipherSuite& other );
+    void free_contexts() noexcept;
+    void init_sender_context() noexcept;
+    void init_receiver_context() noexcept;
 
-    EVP_CIPHER_CTX*   m_ctx    = nullptr;
+    EVP_CIPHER_CTX*   m_encrypt_ctx = nullptr;
+    EVP_CIPHER_CTX*   m_decrypt_ctx = nullptr;
     const EVP_CIPHER* m_cipher = nullptr;
+    record::CipherSuite m_cipher_suite = record::TLS_PRIVATE_CIPHER_SUITE;
     uint8_t m_sender_key  [32]; // max key size for aes128, aes256, chacha20_poly1305
     uint8_t m_sender_iv   [EVP_MAX_IV_LENGTH];
     uint8_t m_receiver_key[32];
@@ -76,6 +164,8 @@ private:
     const EVP_MD* m_digest = nullptr;
     uint32_t m_key_size    = 0;
     uint32_t m_digest_size = 0;
+    bool m_sender_keyed   = false;
+    bool m_receiver_keyed = false;
 };
 
 }
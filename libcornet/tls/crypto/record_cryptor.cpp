@@ -9,12 +9,14 @@
 #include <libcornet/tls/crypto/record_cryptor.hpp>
 
 #include <utility>
+#include <algorithm>
 
 #include <openssl/evp.h>
 #include <openssl/sha.h>
 
 #include <libcornet/tls/crypto/hkdf.hpp>
 #include <libcornet/tls/crypto/tls_handshake.hpp>
+#include <libcornet/metrics.hpp>
 
 namespace pioneer19::cornet::tls13::crypto
 {
@@ -171,6 +173,19 @@ void RecordCryptor::set_application_traffic_secrets( TlsHandshake& tls_handshake
     m_tls_cipher_suite.reset_key_counters();
 }
 
+uint32_t RecordCryptor::resumption_psk(
+        const uint8_t* ticket_nonce, uint8_t nonce_size, uint8_t* psk ) const noexcept
+{
+    const uint8_t resumption_label[] = "resumption";
+    hkdf_expand_label( m_tls_cipher_suite.digest()
+                       ,m_resumption_master_secret, m_tls_cipher_suite.digest_size()
+                       ,resumption_label, sizeof(resumption_label) - 1
+                       ,ticket_nonce, nonce_size
+                       ,psk, m_tls_cipher_suite.digest_size() );
+
+    return m_tls_cipher_suite.digest_size();
+}
+
 uint32_t RecordCryptor::decrypt_record( const uint8_t* record, uint8_t* out_buffer ) noexcept
 {
     auto* encrypted_record = reinterpret_cast<const record::TLSCiphertext*>(record);
@@ -179,10 +194,52 @@ uint32_t RecordCryptor::decrypt_record( const uint8_t* record, uint8_t* out_buff
     auto* encrypted_data = record + sizeof(record::TLSCiphertext);
     const uint8_t* tag = encrypted_data + encrypted_data_size - m_tls_cipher_suite.tag_size();
 
-    return m_tls_cipher_suite.decrypt(
+    uint32_t bytes_decrypted = m_tls_cipher_suite.decrypt(
             encrypted_data, encrypted_data_size - m_tls_cipher_suite.tag_size()
             ,record, sizeof(record::TLSCiphertext), tag,
             out_buffer );
+    if( bytes_decrypted != 0 )
+        ThreadMetrics::instance().add( Counter::RECORDS_DECRYPTED );
+
+    return bytes_decrypted;
+}
+
+uint32_t RecordCryptor::decrypt_records( uint8_t* records, std::span<const uint32_t> record_sizes
+                                         , std::span<uint32_t> decrypted_sizes ) noexcept
+{
+    auto records_count = static_cast<uint32_t>(
+            std::min( { record_sizes.size(), decrypted_sizes.size(), size_t{MAX_BATCH_RECORDS} } ));
+    CiphertextIn records_in [MAX_BATCH_RECORDS];
+    PlaintextOut records_out[MAX_BATCH_RECORDS];
+    uint8_t* record = records;
+    for( uint32_t i = 0; i < records_count; ++i )
+    {
+        uint8_t* encrypted_data = record + sizeof(record::TLSCiphertext);
+        uint32_t encrypted_data_size = record_sizes[i] - sizeof(record::TLSCiphertext)
+                                       - m_tls_cipher_suite.tag_size();
+        records_in[i]  = { encrypted_data, encrypted_data_size, record, sizeof(record::TLSCiphertext)
+                           , encrypted_data + encrypted_data_size };
+        records_out[i] = { encrypted_data, 0 };
+        record += record_sizes[i];
+    }
+
+    uint32_t decrypted_count = m_tls_cipher_suite.decrypt_records(
+            std::span( records_in, records_count ), std::span( records_out, records_count ));
+    for( uint32_t i = 0; i < decrypted_count; ++i )
+        decrypted_sizes[i] = records_out[i].plaintext_size;
+    ThreadMetrics::instance().add( Counter::RECORDS_DECRYPTED, decrypted_count );
+
+    return decrypted_count;
+}
+
+uint32_t RecordCryptor::try_decrypt_record( uint8_t* record ) noexcept
+{
+    uint64_t receiver_counter = m_tls_cipher_suite.receiver_counter();
+    uint32_t bytes_decrypted = decrypt_record( record, record + sizeof(record::TLSCiphertext) );
+    if( bytes_decrypted == 0 )
+        m_tls_cipher_suite.set_receiver_counter( receiver_counter );
+
+    return bytes_decrypted;
 }
 
 uint32_t RecordCryptor::encrypt_record( uint8_t* record, const uint8_t* data, uint32_t data_size ) noexcept
@@ -210,6 +267,7 @@ uint32_t RecordCryptor::encrypt_record( uint8_t* record, const uint8_t* data, ui
             encrypted_data + data_size, tail_size
             ,record, sizeof(record::TLSCiphertext)
             ,encrypted_data, tag );
+    ThreadMetrics::instance().add( Counter::RECORDS_ENCRYPTED );
 
     return sizeof(record::TLSCiphertext) + res + m_tls_cipher_suite.tag_size();
 }
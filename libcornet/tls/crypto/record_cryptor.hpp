@@ -9,6 +9,8 @@
 
 #include <cstdint>
 
+#include <span>
+
 #include <libcornet/tls/crypto/record_ciphers.hpp>
 
 namespace pioneer19::cornet::tls13::crypto
@@ -24,15 +26,41 @@ public:
     RecordCryptor( RecordCryptor&& ) noexcept;
     RecordCryptor& operator=( RecordCryptor&& ) noexcept;
 
+    /// records decrypted by one decrypt_records() call
+    static constexpr uint32_t MAX_BATCH_RECORDS = 32;
+
     uint32_t decrypt_record( const uint8_t* record, uint8_t* out_buffer ) noexcept;
+    /**
+     * decrypt in place records following each other from records,
+     * record length must be bigger than tag size
+     * @param record_sizes full record sizes (at most MAX_BATCH_RECORDS are decrypted)
+     * @param decrypted_sizes TLSInnerPlaintext size of each decrypted record
+     * @return number of decrypted records, stops at first failed record
+     */
+    uint32_t decrypt_records( uint8_t* records, std::span<const uint32_t> record_sizes
+                              , std::span<uint32_t> decrypted_sizes ) noexcept;
+    /**
+     * trial decryption of record in place, receiver sequence number is not
+     * advanced if record is not protected by current key (rejected 0-RTT data)
+     * @return decrypted size or 0
+     */
+    uint32_t try_decrypt_record( uint8_t* record ) noexcept;
     uint32_t encrypt_record( uint8_t* record, const uint8_t* data, uint32_t data_size ) noexcept;
     [[nodiscard]]
     uint32_t digest_size() const noexcept { return m_tls_cipher_suite.digest_size(); }
+    [[nodiscard]]
+    const TlsCipherSuite& cipher_suite() const noexcept { return m_tls_cipher_suite; }
 
     void set_application_traffic_secrets( TlsHandshake& tls_handshake
             , const uint8_t* server_finished_transcript_hash
             , const uint8_t* client_finished_transcript_hash
             , bool sender_is_server ) noexcept;
+    /**
+     * PSK associated with NewSessionTicket
+     * HKDF-Expand-Label(resumption_master_secret, "resumption", ticket_nonce, Hash.length)
+     * @return psk size (Hash.length)
+     */
+    uint32_t resumption_psk( const uint8_t* ticket_nonce, uint8_t nonce_size, uint8_t* psk ) const noexcept;
 
     RecordCryptor( const RecordCryptor& ) = delete;
     RecordCryptor& operator=( const RecordCryptor& ) = delete;
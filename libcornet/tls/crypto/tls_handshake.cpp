@@ -10,11 +10,13 @@
 
 #include <cassert>
 #include <algorithm>
+#include <stdexcept>
 
 #include <openssl/ec.h>
 #include <openssl/evp.h>
 #include <openssl/sha.h>
 #include <openssl/x509.h>
+#include <openssl/hmac.h>
 
 #include <libcornet/tls/crypto/hkdf.hpp>
 #include <libcornet/tls/crypto/record_cryptor.hpp>
@@ -43,9 +45,50 @@ void TlsHandshake::set_handshake_hello_key_share(
     assert( dhe_shared_secret_size < sizeof(dhe_shared_secret) );
 }
 
+void TlsHandshake::add_key_share( record::NamedGroup named_group )
+{
+    if( m_extra_key_shares_count == m_extra_key_shares.size() )
+        throw std::length_error( "TlsHandshake::add_key_share() too many key shares" );
+    m_extra_key_shares[m_extra_key_shares_count++].set_dhe_group( named_group );
+}
+
+bool TlsHandshake::select_key_share( record::NamedGroup named_group ) noexcept
+{
+    if( m_named_group.named_group() == named_group )
+        return true;
+    for( uint32_t i = 0; i < m_extra_key_shares_count; ++i )
+    {
+        if( m_extra_key_shares[i].named_group() == named_group )
+        {
+            m_named_group.swap( m_extra_key_shares[i] );
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * message_hash handshake message is
+ *     Handshake{ msg_type = message_hash(254), length = Hash.length } Hash(ClientHello1)
+ */
+void TlsHandshake::add_message_hash( const uint8_t* client_hello, size_t size )
+{
+    const EVP_MD* digest = m_record_cryptor.m_tls_cipher_suite.digest();
+    uint32_t digest_size = EVP_MD_size( digest );
+
+    uint8_t message_hash[sizeof(record::Handshake) + EVP_MAX_MD_SIZE];
+    auto* handshake = reinterpret_cast<record::Handshake*>( message_hash );
+    handshake->init( record::HandshakeType::MESSAGE_HASH );
+    handshake->finalize( digest_size );
+    EVP_Digest( client_hello, size, message_hash + sizeof(record::Handshake), nullptr, digest, nullptr );
+
+    add_message( message_hash, sizeof(record::Handshake) + digest_size );
+}
+
 void TlsHandshake::derive_client_server_traffic_secrets( bool from_server ) noexcept
 {
-    const uint8_t* early_secret = empty_early_secret( m_record_cryptor.m_tls_cipher_suite.digest() );
+    const uint8_t* early_secret = psk_resumed
+            ? m_early_secret : empty_early_secret( m_record_cryptor.m_tls_cipher_suite.digest() );
 
     init_handshake_stage_data();
 
@@ -166,6 +209,132 @@ const uint8_t* TlsHandshake::empty_early_secret( const EVP_MD* md ) noexcept
     return early_secret;
 }
 
+const EVP_MD* TlsHandshake::cipher_suite_digest( record::CipherSuite cipher_suite ) noexcept
+{
+    if( cipher_suite == record::TLS_AES_256_GCM_SHA384 )
+        return EVP_sha384();
+    return EVP_sha256();
+}
+
+/**
+ * Early secret with resumption PSK
+ * HKDF-Extract(0, PSK) = Early Secret
+ */
+void TlsHandshake::set_resumption_psk(
+        record::CipherSuite cipher_suite, const uint8_t* psk, uint32_t psk_size ) noexcept
+{
+    static const uint8_t zeros_size_of_hash_len[EVP_MAX_MD_SIZE] = {0};
+
+    m_psk_digest = cipher_suite_digest( cipher_suite );
+    hkdf_extract( m_psk_digest, zeros_size_of_hash_len, EVP_MD_size( m_psk_digest )
+                  ,psk, psk_size, m_early_secret );
+}
+
+/**
+ * binder_key   = Derive-Secret(Early Secret, "res binder", "")
+ * finished_key = HKDF-Expand-Label(binder_key, "finished", "", Hash.length)
+ * binder       = HMAC(finished_key, Transcript-Hash(Truncate(ClientHello)))
+ * @return binder size (Hash.length)
+ */
+uint32_t TlsHandshake::psk_binder(
+        const uint8_t* truncated_hello, uint32_t hello_size, uint8_t* binder ) const noexcept
+{
+    assert( m_psk_digest != nullptr );
+    uint32_t digest_size = EVP_MD_size( m_psk_digest );
+
+    uint8_t binder_key[EVP_MAX_MD_SIZE];
+    const uint8_t res_binder_label[] = "res binder";
+    derive_secret( m_psk_digest, m_early_secret, digest_size
+                   ,res_binder_label, sizeof(res_binder_label)-1, nullptr, 0
+                   ,binder_key );
+    uint8_t finished_key[EVP_MAX_MD_SIZE];
+    const uint8_t finished_label[] = "finished";
+    hkdf_expand_label( m_psk_digest, binder_key, digest_size
+                       ,finished_label, sizeof(finished_label)-1, nullptr, 0
+                       ,finished_key, digest_size );
+
+    uint8_t transcript_hash[EVP_MAX_MD_SIZE];
+    if( hello_retried() )
+    {   // Transcript-Hash(ClientHello1, HelloRetryRequest, Truncate(ClientHello2)),
+        // transcript digest is psk digest (HelloRetryRequest cipher suite has psk hash)
+        EVP_MD_CTX* transcript_ctx = EVP_MD_CTX_new();
+        EVP_MD_CTX_copy( transcript_ctx, m_messages_digest );
+        EVP_DigestUpdate( transcript_ctx, truncated_hello, hello_size );
+        EVP_DigestFinal_ex( transcript_ctx, transcript_hash, nullptr );
+        EVP_MD_CTX_free( transcript_ctx );
+    }
+    else
+        EVP_Digest( truncated_hello, hello_size, transcript_hash, nullptr, m_psk_digest, nullptr );
+
+    unsigned binder_size = 0;
+    HMAC( m_psk_digest, finished_key, digest_size, transcript_hash, digest_size, binder, &binder_size );
+
+    return binder_size;
+}
+
+/**
+ * client_early_traffic_secret = Derive-Secret(Early Secret, "c e traffic", ClientHello)
+ * @param client_hello_hash Transcript-Hash(ClientHello) with resumption psk hash
+ */
+void TlsHandshake::derive_client_early_traffic_secret( const uint8_t* client_hello_hash ) noexcept
+{
+    assert( m_psk_digest != nullptr );
+    uint32_t digest_size = EVP_MD_size( m_psk_digest );
+
+    const uint8_t c_e_traffic_label[] = "c e traffic";
+    hkdf_expand_label( m_psk_digest, m_early_secret, digest_size
+                       ,c_e_traffic_label, sizeof(c_e_traffic_label)-1
+                       ,client_hello_hash, digest_size
+                       ,m_client_early_traffic_secret, digest_size );
+}
+
+/**
+ * protect client records (early data and EndOfEarlyData) with early traffic keys
+ * @param record_sequence sequence number of next record with early keys
+ */
+void TlsHandshake::set_early_data_traffic_keys( bool from_server, uint64_t record_sequence ) noexcept
+{
+    set_client_traffic_keys( m_client_early_traffic_secret, from_server, record_sequence );
+}
+
+/**
+ * return to client handshake traffic keys after EndOfEarlyData
+ */
+void TlsHandshake::set_client_handshake_traffic_keys( bool from_server ) noexcept
+{
+    set_client_traffic_keys( m_client_handshake_traffic_secret, from_server, 0 );
+}
+
+void TlsHandshake::set_client_traffic_keys(
+        const uint8_t* traffic_secret, bool from_server, uint64_t record_sequence ) noexcept
+{
+    TlsCipherSuite& cipher_suite = m_record_cryptor.m_tls_cipher_suite;
+    uint8_t* key = from_server ? cipher_suite.sender_key_data() : cipher_suite.receiver_key_data();
+    uint8_t* iv  = from_server ? cipher_suite.sender_iv_data()  : cipher_suite.receiver_iv_data();
+
+    const uint8_t key_label[] = "key";
+    const uint8_t iv_label[]  = "iv";
+    hkdf_expand_label( cipher_suite.digest(), traffic_secret, cipher_suite.digest_size()
+                       ,key_label, sizeof(key_label)-1, nullptr, 0
+                       ,key, cipher_suite.key_size() );
+    hkdf_expand_label( cipher_suite.digest(), traffic_secret, cipher_suite.digest_size()
+                       ,iv_label, sizeof(iv_label)-1, nullptr, 0
+                       ,iv, cipher_suite.iv_size() );
+    if( from_server )
+        cipher_suite.reset_sender_key( record_sequence );
+    else
+        cipher_suite.reset_receiver_key( record_sequence );
+}
+
+/**
+ * psk_ke mode has no (EC)DHE, Handshake Secret extracted from 0 of Hash.length
+ */
+void TlsHandshake::set_psk_ke_shared_secret() noexcept
+{
+    dhe_shared_secret_size = m_record_cryptor.digest_size();
+    std::fill_n( dhe_shared_secret, dhe_shared_secret_size, 0 );
+}
+
 void TlsHandshake::set_tls_cipher_suite( record::CipherSuite cipher_suite )
 {
     m_record_cryptor.m_tls_cipher_suite.set_cipher_suite( cipher_suite );
@@ -216,17 +385,21 @@ uint32_t TlsHandshake::handshake_finished_create_verify_data( uint8_t* hmac_data
     uint8_t transcript_hash[EVP_MAX_MD_SIZE];
     current_transcript_hash( transcript_hash );
 
-    EVP_MD_CTX* md_ctx = EVP_MD_CTX_new();
     EVP_PKEY* pkey = EVP_PKEY_new_raw_private_key( EVP_PKEY_HMAC, nullptr, finished_key, digest_size );
     if( pkey == nullptr )
     {
         ERR_print_errors_fp( stderr );
         return 0;
     }
+    EVP_MD_CTX* md_ctx = EVP_MD_CTX_new();
     EVP_DigestSignInit( md_ctx, nullptr, digest, nullptr, pkey );
     EVP_DigestSignUpdate( md_ctx, transcript_hash, digest_size );
-    size_t calculated_size = 0;
-    if( EVP_DigestSignFinal( md_ctx, hmac_data, &calculated_size ) != 1 )
+    // HMAC output is digest size, OpenSSL 3 checks output buffer size
+    size_t calculated_size = digest_size;
+    int res = EVP_DigestSignFinal( md_ctx, hmac_data, &calculated_size );
+    EVP_MD_CTX_free( md_ctx );
+    EVP_PKEY_free( pkey );
+    if( res != 1 )
     {
         ERR_print_errors_fp( stderr );
         return 0;
@@ -400,9 +573,24 @@ bool TlsHandshake::handshake_certificate_verify_do_verify_signature(
     return signature_verified;
 }
 
+void TlsHandshake::prepare_certificate_verify_signature( bool from_server )
+{
+    m_prepared_signature_size = 0;
+    m_prepared_signature_size = handshake_certificate_verify_create_signature(
+            m_prepared_signature, sizeof(m_prepared_signature), from_server );
+}
+
 uint32_t TlsHandshake::handshake_certificate_verify_create_signature(
         uint8_t* signature, uint32_t signature_size, bool from_server )
 {
+    if( m_prepared_signature_size != 0 )
+    {
+        if( m_prepared_signature_size > signature_size )
+            return 0;
+        std::copy_n( m_prepared_signature, m_prepared_signature_size, signature );
+        return m_prepared_signature_size;
+    }
+
     uint8_t  signed_data[64+sizeof("TLS 1.3, server CertificateVerify")+EVP_MAX_MD_SIZE];
     uint32_t signed_data_size = handshake_certificate_verify_create_signed_data( signed_data, from_server );
 
@@ -10,6 +10,8 @@
 #include <cstdint>
 #include <utility>
 #include <string>
+#include <array>
+#include <vector>
 
 #include <openssl/ec.h>
 #include <openssl/evp.h>
@@ -17,10 +19,16 @@
 
 #include <libcornet/tls/types.hpp>
 #include <libcornet/tls/crypto/dhe_groups.hpp>
+#include <libcornet/tls/crypto/named_group_preference.hpp>
 #include <libcornet/tls/crypto/record_ciphers.hpp>
 #include <libcornet/tls/crypto/record_cryptor.hpp>
 #include <libcornet/tls/key_store.hpp>
 
+namespace pioneer19::cornet::tls13
+{
+struct ClientTicket;
+}
+
 namespace pioneer19::cornet::tls13::crypto
 {
 
@@ -39,10 +47,44 @@ public:
     void set_handshake_hello_key_share( record::NamedGroup named_group, const uint8_t* public_key,
                                         uint16_t key_size ) noexcept;
     void derive_client_server_traffic_secrets( bool from_server ) noexcept;
+    // psk resumption methods
+    void set_resumption_psk( record::CipherSuite cipher_suite, const uint8_t* psk, uint32_t psk_size ) noexcept;
+    uint32_t psk_binder( const uint8_t* truncated_hello, uint32_t hello_size, uint8_t* binder ) const noexcept;
+    void set_psk_ke_shared_secret() noexcept;
+    static const EVP_MD* cipher_suite_digest( record::CipherSuite cipher_suite ) noexcept;
+    // 0-RTT methods, client traffic direction is sender on client (from_server) and receiver on server
+    void derive_client_early_traffic_secret( const uint8_t* client_hello_hash ) noexcept;
+    void set_early_data_traffic_keys( bool from_server, uint64_t record_sequence = 0 ) noexcept;
+    void set_client_handshake_traffic_keys( bool from_server ) noexcept;
+    // HelloRetryRequest methods
+    /**
+     * replace ClientHello1 in transcript by message_hash (RFC 8446 4.4.1),
+     * cipher suite must be set
+     */
+    void add_message_hash( const uint8_t* client_hello, size_t size );
+    [[nodiscard]]
+    bool hello_retried() const noexcept
+    { return hello_retry_group != record::NamedGroup::TLS_PRIVATE_NAMED_GROUP; }
     // client methods
+    /**
+     * add ClientHello key share (first one is created by constructor)
+     */
+    void add_key_share( record::NamedGroup named_group );
+    [[nodiscard]]
+    uint32_t key_shares_count() const noexcept { return m_extra_key_shares_count + 1; }
+    DheGroup& key_share( uint32_t index ) noexcept
+    { return index == 0 ? m_named_group : m_extra_key_shares[index-1]; }
+    /**
+     * make offered key share of server selected group dhe_group()
+     * @return false if group was not offered
+     */
+    bool select_key_share( record::NamedGroup named_group ) noexcept;
     // server methods
 
     DheGroup& dhe_group() noexcept { return m_named_group; }
+    /**
+     * single key share of named_group (client drops other shares after HelloRetryRequest)
+     */
     void set_named_group( record::NamedGroup named_group );
 
     [[nodiscard]]
@@ -56,6 +98,11 @@ public:
     void handshake_set_certificate( X509* cert );
     uint32_t handshake_certificate_verify_create_signature( uint8_t* signature, uint32_t signature_size
             , bool from_server=true );
+    /**
+     * sign current transcript in advance (expensive, can run in CryptoWorkers),
+     * handshake_certificate_verify_create_signature() returns prepared signature
+     */
+    void prepare_certificate_verify_signature( bool from_server=true );
 
     uint32_t handshake_finished_create_verify_data( uint8_t* hmac_data, bool from_server = true );
 
@@ -84,8 +131,26 @@ public:
         ServerHello,
         HelloRetry,
     } m_hello_type = HelloType::ClientHello;
+    // psk_resumed become true, when server accepted psk, so Certificate and CertificateVerify skipped
+    bool psk_resumed = false;
+    record::PskKeyExchangeMode psk_mode = record::PskKeyExchangeMode::PSK_DHE_KE;
+    // early_data_offered: client sends 0-RTT data or server got early_data extension
+    bool early_data_offered  = false;
+    bool early_data_accepted = false;
+    uint32_t max_early_data_size = 0;
+    // server sends CompressedCertificate if client offered algorithm of domain compressed message
+    record::CertificateCompressionAlgorithm certificate_compression = record::CertificateCompressionAlgorithm::NONE;
+    // server staples OCSP response of domain certificate if client sent status_request
+    bool ocsp_status_requested = false;
+    // group selected by server in HelloRetryRequest
+    record::NamedGroup hello_retry_group = record::NamedGroup::TLS_PRIVATE_NAMED_GROUP;
+    uint64_t connection_id = 0; ///< TcpSocket::connection_id() for trace events
+    // client data
+    const ClientTicket* psk_ticket = nullptr;
+    std::vector<uint8_t> hello_retry_cookie; ///< echoed in second ClientHello
     // server data
     DomainKeys* domain_keys = nullptr;
+    KeyStoreSnapshotRef domain_keys_ref; ///< keeps domain_keys of reloadable KeyStore
 
     record::SignatureScheme cert_signature_scheme;
 
@@ -100,6 +165,8 @@ private:
     X509*    m_certificate = nullptr;
     void init_handshake_stage_data();
 
+    void set_client_traffic_keys( const uint8_t* traffic_secret, bool from_server
+            , uint64_t record_sequence ) noexcept;
     uint32_t handshake_certificate_verify_create_signed_data( uint8_t* signed_data, bool from_server );
     bool handshake_check_signed_data(
             const uint8_t* signature, uint32_t signature_size
@@ -120,7 +187,14 @@ private:
             , EVP_PKEY* pkey, int nid, const EVP_MD* md = nullptr );
 
     EVP_MD_CTX* m_messages_digest = nullptr;
+    const EVP_MD* m_psk_digest = nullptr;
+    uint8_t     m_early_secret[EVP_MAX_MD_SIZE];
+    uint8_t     m_client_early_traffic_secret[EVP_MAX_MD_SIZE];
+    uint32_t    m_prepared_signature_size = 0;
+    uint8_t     m_prepared_signature[1024];
     DheGroup    m_named_group;
+    std::array<DheGroup,NamedGroupPreference::MAX_GROUPS-1> m_extra_key_shares;
+    uint32_t    m_extra_key_shares_count = 0;
     record::CipherSuite m_cipher_suite = record::TLS_PRIVATE_CIPHER_SUITE;
 };
 
@@ -146,6 +220,7 @@ inline void TlsHandshake::init_handshake_stage_data()
 inline void TlsHandshake::set_named_group( record::NamedGroup named_group )
 {
     m_named_group.set_dhe_group( named_group );
+    m_extra_key_shares_count = 0;
 }
 
 inline record::CipherSuite TlsHandshake::cipher_suite() const noexcept
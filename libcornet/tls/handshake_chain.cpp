@@ -0,0 +1,94 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/tls/handshake_chain.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <libcornet/tls/types.hpp>
+
+namespace pioneer19::cornet::tls13
+{
+
+void HandshakeChain::append( TlsReadBuffer&& read_buffer, const uint8_t* data, uint32_t size )
+{
+    m_buffers.push_back( std::move(read_buffer) );
+    append( data, size );
+}
+
+void HandshakeChain::append( const uint8_t* data, uint32_t size )
+{
+    if( m_size + size > MAX_MESSAGE_SIZE )
+        throw std::runtime_error( "HandshakeChain::append() handshake message is too big" );
+
+    m_fragments.push_back( Fragment{ data, size } );
+    m_size += size;
+}
+
+void HandshakeChain::clear() noexcept
+{
+    m_fragments.clear();
+    m_buffers.clear();
+    m_copies.clear();
+    m_size = 0;
+}
+
+const uint8_t* HandshakeChain::contiguous( uint32_t offset, uint32_t size )
+{
+    if( offset > m_size || size > m_size - offset )
+        return nullptr;
+
+    uint32_t fragment_offset = 0;
+    for( const auto& fragment : m_fragments )
+    {
+        if( offset < fragment_offset + fragment.size || fragment_offset + fragment.size == m_size )
+        {
+            if( offset + size <= fragment_offset + fragment.size )
+                return fragment.data + (offset - fragment_offset);
+            break;
+        }
+        fragment_offset += fragment.size;
+    }
+
+    auto& data_copy = m_copies.emplace_back( new uint8_t[size] );
+    copy( offset, data_copy.get(), size );
+
+    return data_copy.get();
+}
+
+uint32_t HandshakeChain::message_size() const noexcept
+{
+    if( m_size < sizeof(record::Handshake) )
+        return 0;
+
+    record::Handshake handshake;
+    copy( 0, reinterpret_cast<uint8_t*>( &handshake ), sizeof(handshake) );
+
+    return sizeof(record::Handshake) + handshake.host_length();
+}
+
+void HandshakeChain::copy( uint32_t offset, uint8_t* dest, uint32_t size ) const noexcept
+{
+    for( const auto& fragment : m_fragments )
+    {
+        if( size == 0 )
+            break;
+        if( offset >= fragment.size )
+        {
+            offset -= fragment.size;
+            continue;
+        }
+        uint32_t part = std::min( size, fragment.size - offset );
+        std::copy_n( fragment.data + offset, part, dest );
+        dest   += part;
+        size   -= part;
+        offset  = 0;
+    }
+}
+
+}
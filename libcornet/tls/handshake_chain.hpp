@@ -0,0 +1,82 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <span>
+#include <memory>
+#include <vector>
+
+#include <libcornet/tls/tls_read_buffer.hpp>
+
+namespace pioneer19::cornet::tls13
+{
+
+/**
+ * @brief handshake message received in several records
+ *
+ * Decrypted fragments stay in read buffers they were received in (buffer is
+ * moved to chain), message is not reassembled to contiguous copy. Only data
+ * requested by contiguous() across fragments border is copied.
+ */
+class HandshakeChain
+{
+public:
+    /// Certificate with long chain is the biggest message, limits memory used by peer
+    static constexpr uint32_t MAX_MESSAGE_SIZE = 256*1024;
+
+    struct Fragment
+    {
+        const uint8_t* data;
+        uint32_t size;
+    };
+
+    HandshakeChain() = default;
+    HandshakeChain( HandshakeChain&& ) noexcept = default;
+    HandshakeChain& operator=( HandshakeChain&& ) noexcept = default;
+
+    /// add fragment owned by read_buffer
+    void append( TlsReadBuffer&& read_buffer, const uint8_t* data, uint32_t size );
+    /// add fragment which lives longer than chain use (last fragment in current read buffer)
+    void append( const uint8_t* data, uint32_t size );
+    void clear() noexcept;
+
+    [[nodiscard]]
+    bool empty() const noexcept { return m_fragments.empty(); }
+    [[nodiscard]]
+    uint32_t size() const noexcept { return m_size; }
+    [[nodiscard]]
+    std::span<const Fragment> fragments() const noexcept { return m_fragments; }
+    /**
+     * pointer to size bytes at offset: inside fragment or copy owned by chain
+     * if bytes are in several fragments (valid until clear())
+     * @return nullptr if chain has no such bytes
+     */
+    [[nodiscard]]
+    const uint8_t* contiguous( uint32_t offset, uint32_t size );
+    /**
+     * Handshake message size (with header) from its first bytes
+     * @return 0 if header is not received yet
+     */
+    [[nodiscard]]
+    uint32_t message_size() const noexcept;
+    /// copy size bytes at offset (caller checks offset + size <= size())
+    void copy( uint32_t offset, uint8_t* dest, uint32_t size ) const noexcept;
+
+    HandshakeChain( const HandshakeChain& ) = delete;
+    HandshakeChain& operator=( const HandshakeChain& ) = delete;
+
+private:
+    std::vector<Fragment> m_fragments;
+    std::vector<TlsReadBuffer> m_buffers;
+    std::vector<std::unique_ptr<uint8_t[]>> m_copies;
+    uint32_t m_size = 0;
+};
+
+}
@@ -5,8 +5,13 @@
  * This file is part of libcornet (https://github.com/pioneer19/libcornet).
  */
 
+#include <dirent.h>
+#include <unistd.h>
+
 #include <cstdio>
 #include <cassert>
+#include <cstring>
+#include <memory>
 #include <system_error>
 
 #include <openssl/pem.h>
@@ -14,6 +19,9 @@
 #include <openssl/err.h>
 
 #include <libcornet/tls/key_store.hpp>
+#include <libcornet/tls/record_helpers.hpp>
+#include <libcornet/tls/certificate_compression.hpp>
+#include <libcornet/tls/ocsp_stapling.hpp>
 #include <pioneer19_utils/guards.hpp>
 
 namespace pioneer19::cornet::tls13
@@ -112,43 +120,19 @@ static const char* subject_alternative_name( const X509 *server_cert )
 }
 
 SingleDomainKeyStore::SingleDomainKeyStore(
-        const char* domain_name, const char* key_file, const char* cert_file, const char* cert_chain )
+        const char* domain_name, const char* key_file, const char* cert_file, const char* cert_chain
+        , const char* ocsp_response_file )
         :m_domain_name{domain_name}
 {
     assert( domain_name != nullptr );
-    assert( key_file    != nullptr );
-    assert( cert_file   != nullptr );
 
-    m_keys.key = load_key( key_file );
-    if( m_keys.key != nullptr )
-        printf( "key loaded\n" );
-
-    m_keys.domain_cert = load_cert( cert_file );
-    int res = i2d_X509( m_keys.domain_cert, &m_keys.der_domain_cert );
-    if( res < 0 )
-    {
-        char err_buffer[1024];
-        std::string err_string{ ERR_error_string( ERR_get_error(), err_buffer ) };
-        throw std::runtime_error( "i2d_X509 for cert failed" + err_string );
-    }
-    m_keys.der_cert_size = res;
-    m_keys.signature_schemes = signature_scheme_for_cert( m_keys.domain_cert );
+    load_domain_keys( m_keys, key_file, cert_file, cert_chain, ocsp_response_file );
+    printf( "key loaded\n" );
 
     printf( "loaded cert subject CN \"%s\"\n", subject_common_name( m_keys.domain_cert) );
     subject_alternative_name( m_keys.domain_cert );
-
-    if( cert_chain != nullptr )
+    if( m_keys.cert_chain != nullptr )
     {
-        m_keys.cert_chain = load_cert( cert_chain );
-        res = i2d_X509( m_keys.cert_chain, &m_keys.der_cert_chain );
-        if( res < 0 )
-        {
-            char err_buffer[1024];
-            std::string err_string{ERR_error_string( ERR_get_error(), err_buffer )};
-            throw std::runtime_error( "i2d_X509 for cert chain failed" + err_string );
-        }
-        m_keys.der_chain_size = res;
-
         printf( "loaded cert chain subject CN \"%s\"\n", subject_common_name( m_keys.cert_chain ));
         subject_alternative_name( m_keys.cert_chain );
     }
@@ -156,14 +140,7 @@ SingleDomainKeyStore::SingleDomainKeyStore(
 
 SingleDomainKeyStore::~SingleDomainKeyStore()
 {
-    OPENSSL_free( m_keys.der_domain_cert );
-    OPENSSL_free( m_keys.der_cert_chain );
-    if( m_keys.key != nullptr )
-        EVP_PKEY_free( m_keys.key );
-    if( m_keys.cert_chain != nullptr )
-        X509_free( m_keys.cert_chain );
-    if( m_keys.domain_cert != nullptr )
-        X509_free( m_keys.domain_cert );
+    free_domain_keys( m_keys );
 }
 
 
@@ -175,6 +152,474 @@ DomainKeys* SingleDomainKeyStore::find( const char* domain_name ) noexcept
     return nullptr;
 }
 
+static std::vector<uint8_t> load_ocsp_response( const DomainKeys& domain_keys, const char* ocsp_response_file )
+{
+    // not readable or stale response must not be stapled, handshake goes on without it
+    std::vector<uint8_t> response;
+    try
+    {
+        response = OcspStapling::load_response( ocsp_response_file );
+    }
+    catch( const std::exception& ex )
+    {
+        fprintf( stderr, "OCSP response \"%s\" is not stapled: %s\n", ocsp_response_file, ex.what() );
+        return {};
+    }
+    if( response.empty() )
+        return response;
+    auto error = OcspStapling::check_response( response.data(), response.size()
+                                               , domain_keys.domain_cert, domain_keys.cert_chain );
+    if( !error.empty() )
+    {
+        fprintf( stderr, "OCSP response \"%s\" is not stapled: %s\n", ocsp_response_file, error.c_str() );
+        response.clear();
+    }
+
+    return response;
+}
+
+void KeyStore::load_domain_keys( DomainKeys& domain_keys, const char* key_file
+        , const char* cert_file, const char* cert_chain, const char* ocsp_response_file )
+{
+    assert( key_file    != nullptr );
+    assert( cert_file   != nullptr );
+
+    try
+    {
+        domain_keys.key = load_key( key_file );
+
+        domain_keys.domain_cert = load_cert( cert_file );
+        int res = i2d_X509( domain_keys.domain_cert, &domain_keys.der_domain_cert );
+        if( res < 0 )
+        {
+            char err_buffer[1024];
+            std::string err_string{ ERR_error_string( ERR_get_error(), err_buffer ) };
+            throw std::runtime_error( "i2d_X509 for cert failed" + err_string );
+        }
+        domain_keys.der_cert_size = res;
+        domain_keys.signature_schemes = signature_scheme_for_cert( domain_keys.domain_cert );
+        // key and certificate files are replaced one by one on certificate rotation
+        if( X509_check_private_key( domain_keys.domain_cert, domain_keys.key ) != 1 )
+        {
+            ERR_clear_error();
+            throw std::runtime_error( std::string("key file \"")+key_file
+                                      +"\" does not match certificate \""+cert_file+"\"" );
+        }
+
+        if( cert_chain != nullptr )
+        {
+            domain_keys.cert_chain = load_cert( cert_chain );
+            res = i2d_X509( domain_keys.cert_chain, &domain_keys.der_cert_chain );
+            if( res < 0 )
+            {
+                char err_buffer[1024];
+                std::string err_string{ERR_error_string( ERR_get_error(), err_buffer )};
+                throw std::runtime_error( "i2d_X509 for cert chain failed" + err_string );
+            }
+            domain_keys.der_chain_size = res;
+        }
+        if( ocsp_response_file != nullptr )
+            domain_keys.ocsp_response = load_ocsp_response( domain_keys, ocsp_response_file );
+        prepare_certificate_messages( domain_keys );
+    }
+    catch( ... )
+    {
+        free_domain_keys( domain_keys );
+        throw;
+    }
+}
+
+void KeyStore::free_domain_keys( DomainKeys& domain_keys ) noexcept
+{
+    OPENSSL_free( domain_keys.der_domain_cert );
+    OPENSSL_free( domain_keys.der_cert_chain );
+    if( domain_keys.key != nullptr )
+        EVP_PKEY_free( domain_keys.key );
+    if( domain_keys.cert_chain != nullptr )
+        X509_free( domain_keys.cert_chain );
+    if( domain_keys.domain_cert != nullptr )
+        X509_free( domain_keys.domain_cert );
+    domain_keys = DomainKeys{};
+}
+
+// RFC 1035 2.3.4 (without trailing dot)
+static constexpr uint32_t MAX_DOMAIN_NAME_SIZE = 253;
+static constexpr char CERT_FILE_SUFFIX[]  = ".cert.pem";
+static constexpr char KEY_FILE_SUFFIX[]   = ".key.pem";
+static constexpr char CHAIN_FILE_SUFFIX[] = ".chain.pem";
+static constexpr char OCSP_FILE_SUFFIX[]  = ".ocsp.der";
+
+static inline char ascii_lower( char c ) noexcept
+{
+    return ( c >= 'A' && c <= 'Z' ) ? static_cast<char>( c - 'A' + 'a' ) : c;
+}
+
+/// FNV-1a of lower case name
+static uint32_t name_hash( const char* name, uint32_t name_size, uint32_t seed = 2166136261u ) noexcept
+{
+    uint32_t hash = seed;
+    for( uint32_t i = 0; i < name_size; ++i )
+    {
+        hash ^= static_cast<uint8_t>( ascii_lower( name[i] ) );
+        hash *= 16777619u;
+    }
+    return hash;
+}
+static inline uint32_t edge_hash( uint32_t parent, const char* label, uint32_t label_size ) noexcept
+{
+    return name_hash( label, label_size, 2166136261u ^ (parent * 0x9e3779b9u) );
+}
+
+template<typename Table, typename Equal>
+static uint32_t table_find( const Table& table, uint32_t hash, Equal equal ) noexcept
+{
+    if( table.slots.empty() )
+        return UINT32_MAX;
+
+    uint32_t mask = table.slots.size() - 1;
+    for( uint32_t pos = hash & mask; ; pos = (pos + 1) & mask )
+    {
+        auto& slot = table.slots[pos];
+        if( slot.index == UINT32_MAX )
+            return UINT32_MAX;
+        if( slot.hash == hash && equal( slot.index ) )
+            return slot.index;
+    }
+}
+template<typename Table>
+static void table_insert( Table& table, uint32_t hash, uint32_t index )
+{
+    // load factor is kept below 3/4, table size is power of 2
+    if( (table.size + 1) * 4 > table.slots.size() * 3 )
+    {
+        auto old_slots = std::move( table.slots );
+        table.slots.clear();
+        table.slots.resize( old_slots.empty() ? 16 : old_slots.size() * 2 );
+        table.size = 0;
+        for( auto& slot : old_slots )
+        {
+            if( slot.index != UINT32_MAX )
+                table_insert( table, slot.hash, slot.index );
+        }
+    }
+    uint32_t mask = table.slots.size() - 1;
+    uint32_t pos = hash & mask;
+    while( table.slots[pos].index != UINT32_MAX )
+        pos = (pos + 1) & mask;
+    table.slots[pos].hash  = hash;
+    table.slots[pos].index = index;
+    ++table.size;
+}
+
+MultiDomainKeyStore::MultiDomainKeyStore( const char* directory )
+{
+    scan_directory( directory );
+}
+
+MultiDomainKeyStore::~MultiDomainKeyStore()
+{
+    for( auto& domain : m_domains )
+    {
+        DomainKeys* keys = domain.keys.load( std::memory_order_relaxed );
+        if( keys != nullptr )
+        {
+            free_domain_keys( *keys );
+            delete keys;
+        }
+    }
+}
+
+void MultiDomainKeyStore::add_domain( const char* domain_name, const char* key_file
+        , const char* cert_file, const char* cert_chain, const char* ocsp_response_file )
+{
+    assert( key_file    != nullptr );
+    assert( cert_file   != nullptr );
+
+    m_domain_files.push_back( DomainFiles{ key_file, cert_file, cert_chain ? cert_chain : ""
+                                           , ocsp_response_file ? ocsp_response_file : "" } );
+    try
+    {
+        add_name( domain_name, 0, m_domain_files.size() - 1 );
+    }
+    catch( ... )
+    {
+        m_domain_files.pop_back();
+        throw;
+    }
+}
+
+uint32_t MultiDomainKeyStore::scan_directory( const char* directory )
+{
+    DIR* dir = opendir( directory );
+    if( dir == nullptr )
+        throw std::system_error( errno, std::system_category(),
+                                 std::string("opendir() key store directory \"")+directory+"\"" );
+    auto dir_close_guard = make_scope_guard( [dir](){ closedir( dir ); } );
+
+    if( m_directories.size() > UINT16_MAX )
+        throw std::runtime_error( "MultiDomainKeyStore::scan_directory() too many directories" );
+    m_directories.emplace_back( directory );
+    auto directory_index = static_cast<uint16_t>( m_directories.size() - 1 );
+
+    constexpr uint32_t suffix_size = sizeof(CERT_FILE_SUFFIX) - 1;
+    uint32_t added = 0;
+    while( dirent* entry = readdir( dir ) )
+    {
+        std::string_view file_name{ entry->d_name };
+        if( file_name.size() <= suffix_size
+            || file_name.substr( file_name.size() - suffix_size ) != CERT_FILE_SUFFIX )
+        {
+            continue;
+        }
+        std::string domain_name{ file_name.substr( 0, file_name.size() - suffix_size ) };
+        if( domain_name.size() > 2 && domain_name[0] == '_' && domain_name[1] == '.' )
+            domain_name[0] = '*';
+
+        add_name( domain_name, directory_index, NONE );
+        ++added;
+    }
+
+    return added;
+}
+
+void MultiDomainKeyStore::load_all()
+{
+    for( auto& domain : m_domains )
+    {
+        if( domain.keys.load( std::memory_order_acquire ) == nullptr && load_domain( domain ) == nullptr )
+        {
+            throw std::runtime_error( "MultiDomainKeyStore::load_all() failed load domain \""
+                                      + m_names.substr( domain.name_offset, domain.name_size ) + "\"" );
+        }
+    }
+}
+
+DomainKeys* MultiDomainKeyStore::find( const char* domain_name ) noexcept
+{
+    uint32_t index = find_domain( domain_name );
+    if( index == NONE )
+        return nullptr;
+
+    Domain& domain = m_domains[index];
+    DomainKeys* keys = domain.keys.load( std::memory_order_acquire );
+    if( keys != nullptr )
+        return keys;
+
+    try
+    {
+        return load_domain( domain );
+    }
+    catch( const std::exception& ex )
+    {
+        fprintf( stderr, "MultiDomainKeyStore failed load domain \"%.*s\": %s\n"
+                 , domain.name_size, m_names.data() + domain.name_offset, ex.what() );
+        return nullptr;
+    }
+}
+
+DomainKeys* MultiDomainKeyStore::load_domain( Domain& domain )
+{
+    std::lock_guard lock( m_load_mutex );
+    // loaded by other thread while waiting for lock
+    DomainKeys* keys = domain.keys.load( std::memory_order_relaxed );
+    if( keys != nullptr )
+        return keys;
+    // failed domain is not reloaded (and reported) on every handshake
+    if( domain.load_failed )
+        return nullptr;
+
+    std::string key_file;
+    std::string cert_file;
+    std::string cert_chain;
+    std::string ocsp_response;
+    if( domain.files != NONE )
+    {
+        auto& files = m_domain_files[domain.files];
+        key_file   = files.key_file;
+        cert_file  = files.cert_file;
+        cert_chain = files.cert_chain;
+        ocsp_response = files.ocsp_response;
+    }
+    else
+    {
+        std::string file_name = m_names.substr( domain.name_offset, domain.name_size );
+        if( file_name[0] == '*' )
+            file_name[0] = '_';
+        std::string file_base = m_directories[domain.directory] + "/" + file_name;
+        key_file  = file_base + KEY_FILE_SUFFIX;
+        cert_file = file_base + CERT_FILE_SUFFIX;
+        if( access( (file_base + CHAIN_FILE_SUFFIX).c_str(), R_OK ) == 0 )
+            cert_chain = file_base + CHAIN_FILE_SUFFIX;
+        // missing response file is not stapled
+        ocsp_response = file_base + OCSP_FILE_SUFFIX;
+    }
+
+    auto domain_keys = std::make_unique<DomainKeys>();
+    try
+    {
+        load_domain_keys( *domain_keys, key_file.c_str(), cert_file.c_str()
+                          , cert_chain.empty() ? nullptr : cert_chain.c_str()
+                          , ocsp_response.empty() ? nullptr : ocsp_response.c_str() );
+    }
+    catch( ... )
+    {
+        domain.load_failed = true;
+        throw;
+    }
+    domain.keys.store( domain_keys.get(), std::memory_order_release );
+
+    return domain_keys.release();
+}
+
+bool MultiDomainKeyStore::name_equal(
+        uint32_t offset, uint32_t size, const char* name, uint32_t name_size ) const noexcept
+{
+    if( size != name_size )
+        return false;
+    const char* stored_name = m_names.data() + offset;
+    for( uint32_t i = 0; i < size; ++i )
+    {
+        if( stored_name[i] != ascii_lower( name[i] ) )
+            return false;
+    }
+    return true;
+}
+
+uint32_t MultiDomainKeyStore::find_edge(
+        uint32_t parent, const char* label, uint32_t label_size, uint32_t hash ) const noexcept
+{
+    return table_find( m_trie_edges, hash, [&]( uint32_t node_index ){
+        auto& node = m_trie_nodes[node_index];
+        return node.parent == parent && name_equal( node.label_offset, node.label_size, label, label_size );
+    } );
+}
+
+uint32_t MultiDomainKeyStore::find_domain( const char* domain_name ) const noexcept
+{
+    uint32_t name_size = strnlen( domain_name, MAX_DOMAIN_NAME_SIZE + 2 );
+    if( name_size > 0 && domain_name[name_size-1] == '.' )
+        --name_size;
+    if( name_size == 0 || name_size > MAX_DOMAIN_NAME_SIZE )
+        return NONE;
+
+    uint32_t index = table_find( m_exact_names, name_hash( domain_name, name_size )
+            , [&]( uint32_t domain_index ){
+                auto& domain = m_domains[domain_index];
+                return name_equal( domain.name_offset, domain.name_size, domain_name, name_size );
+            } );
+    if( index != NONE )
+        return index;
+
+    // wildcard replaces left most label, it is not walked in trie
+    auto* first_dot = static_cast<const char*>( memchr( domain_name, '.', name_size ) );
+    if( first_dot == nullptr || first_dot == domain_name )
+        return NONE;
+    uint32_t labels_begin = first_dot - domain_name + 1;
+
+    uint32_t node = 0;
+    uint32_t label_end = name_size;
+    while( label_end > labels_begin )
+    {
+        uint32_t label_begin = label_end;
+        while( domain_name[label_begin-1] != '.' )
+            --label_begin;
+        uint32_t label_size = label_end - label_begin;
+        node = find_edge( node, domain_name + label_begin, label_size
+                          , edge_hash( node, domain_name + label_begin, label_size ) );
+        if( node == NONE )
+            return NONE;
+        label_end = label_begin - 1;
+    }
+
+    return m_trie_nodes[node].wildcard_domain;
+}
+
+uint32_t MultiDomainKeyStore::add_name( std::string_view domain_name, uint16_t directory, uint32_t files )
+{
+    if( !domain_name.empty() && domain_name.back() == '.' )
+        domain_name.remove_suffix( 1 );
+    if( domain_name.empty() || domain_name.size() > MAX_DOMAIN_NAME_SIZE )
+        throw std::runtime_error( "MultiDomainKeyStore wrong domain name size \"" + std::string(domain_name) +"\"" );
+    bool wildcard = domain_name.size() > 2 && domain_name[0] == '*' && domain_name[1] == '.';
+    if( domain_name.find( '*', wildcard ? 1 : 0 ) != std::string_view::npos
+        || domain_name.find( ".." ) != std::string_view::npos
+        || domain_name[wildcard ? 2 : 0] == '.'
+        || (wildcard && domain_name.find( '.', 2 ) == std::string_view::npos) )
+    {
+        throw std::runtime_error( "MultiDomainKeyStore wrong domain name \"" + std::string(domain_name) +"\"" );
+    }
+    if( m_domains.size() >= NONE - 1 || m_names.size() + domain_name.size() >= NONE )
+        throw std::runtime_error( "MultiDomainKeyStore is full" );
+
+    auto name_offset = static_cast<uint32_t>( m_names.size() );
+    auto name_size   = static_cast<uint32_t>( domain_name.size() );
+    for( char c : domain_name )
+        m_names.push_back( ascii_lower( c ) );
+    auto domain_index = static_cast<uint32_t>( m_domains.size() );
+
+    try
+    {
+        add_name_index( name_offset, name_size, wildcard, domain_index );
+    }
+    catch( ... )
+    {
+        m_names.resize( name_offset );
+        throw;
+    }
+
+    auto& domain = m_domains.emplace_back();
+    domain.name_offset = name_offset;
+    domain.name_size   = static_cast<uint16_t>( name_size );
+    domain.directory   = directory;
+    domain.files       = files;
+
+    return domain_index;
+}
+
+void MultiDomainKeyStore::add_name_index( uint32_t name_offset, uint32_t name_size, bool wildcard
+        , uint32_t domain_index )
+{
+    const char* name = m_names.data() + name_offset;
+    if( !wildcard )
+    {
+        uint32_t hash = name_hash( name, name_size );
+        uint32_t index = table_find( m_exact_names, hash, [&]( uint32_t i ){
+            return name_equal( m_domains[i].name_offset, m_domains[i].name_size, name, name_size );
+        } );
+        if( index != NONE )
+            throw std::runtime_error( "MultiDomainKeyStore duplicate domain \"" + std::string( name, name_size ) +"\"" );
+        table_insert( m_exact_names, hash, domain_index );
+    }
+    else
+    {
+        // labels of "*.www.example.com" are added as com -> example -> www,
+        // trie node label points into stored name
+        uint32_t node = 0;
+        uint32_t label_end = name_size;
+        while( label_end > 2 )
+        {
+            uint32_t label_begin = label_end;
+            while( name[label_begin-1] != '.' )
+                --label_begin;
+            uint32_t label_size = label_end - label_begin;
+            uint32_t hash = edge_hash( node, name + label_begin, label_size );
+            uint32_t child = find_edge( node, name + label_begin, label_size, hash );
+            if( child == NONE )
+            {
+                child = static_cast<uint32_t>( m_trie_nodes.size() );
+                m_trie_nodes.push_back( TrieNode{ name_offset + label_begin
+                                                  , static_cast<uint16_t>( label_size ), node } );
+                table_insert( m_trie_edges, hash, child );
+            }
+            node = child;
+            label_end = label_begin - 1;
+        }
+        if( m_trie_nodes[node].wildcard_domain != NONE )
+            throw std::runtime_error( "MultiDomainKeyStore duplicate domain \"" + std::string( name, name_size ) +"\"" );
+        m_trie_nodes[node].wildcard_domain = domain_index;
+    }
+}
+
 CertificateSignatureSchemes KeyStore::signature_scheme_for_cert( X509* cert )
 {
     assert( cert != nullptr );
@@ -210,6 +655,48 @@ CertificateSignatureSchemes KeyStore::signature_scheme_for_cert( X509* cert )
     }
 }
 
+static void prepare_certificate_message_pair( const DomainKeys& domain_keys, bool ocsp_staple
+        , std::vector<uint8_t>& certificate_message, std::vector<uint8_t>& compressed_certificate_message
+        , record::CertificateCompressionAlgorithm& certificate_compression )
+{
+    certificate_message.resize( RecordHelpers::certificate_message_size( domain_keys, ocsp_staple ) );
+    RecordHelpers::create_certificate_message( domain_keys, certificate_message.data(), ocsp_staple );
+
+    compressed_certificate_message.clear();
+    certificate_compression = record::CertificateCompressionAlgorithm::NONE;
+    auto algorithms = CertificateCompression::algorithms();
+    uint32_t uncompressed_size = certificate_message.size() - sizeof(record::Handshake);
+    if( algorithms.empty() || uncompressed_size > CertificateCompression::MAX_UNCOMPRESSED_SIZE )
+        return;
+
+    // Certificate message body is compressed (without handshake header)
+    auto compressed_data = CertificateCompression::compress( algorithms.front()
+            , certificate_message.data() + sizeof(record::Handshake), uncompressed_size );
+    if( compressed_data.empty() || compressed_data.size() >= uncompressed_size )
+        return;
+
+    compressed_certificate_message.resize( RecordHelpers::compressed_certificate_message_size(
+            compressed_data.size() ) );
+    RecordHelpers::create_compressed_certificate_message( algorithms.front(), uncompressed_size
+            , compressed_data.data(), compressed_data.size(), compressed_certificate_message.data() );
+    certificate_compression = algorithms.front();
+}
+
+void KeyStore::prepare_certificate_messages( DomainKeys& domain_keys )
+{
+    prepare_certificate_message_pair( domain_keys, false, domain_keys.certificate_message
+            , domain_keys.compressed_certificate_message, domain_keys.certificate_compression );
+
+    domain_keys.stapled_certificate_message.clear();
+    domain_keys.stapled_compressed_certificate_message.clear();
+    if( domain_keys.ocsp_response.empty() )
+        return;
+    // algorithm is the same for both messages
+    record::CertificateCompressionAlgorithm stapled_compression;
+    prepare_certificate_message_pair( domain_keys, true, domain_keys.stapled_certificate_message
+            , domain_keys.stapled_compressed_certificate_message, stapled_compression );
+}
+
 bool KeyStore::is_supported_signature_scheme( record::SignatureScheme signature_scheme )
 {
     switch( signature_scheme.num() )
@@ -10,7 +10,13 @@
 #include <cstdint>
 
 #include <array>
+#include <deque>
+#include <mutex>
+#include <atomic>
 #include <string>
+#include <vector>
+#include <utility>
+#include <string_view>
 
 #include <openssl/x509.h>
 
@@ -38,6 +44,58 @@ struct DomainKeys
     uint8_t*  der_domain_cert = nullptr;
     uint8_t*  der_cert_chain  = nullptr;
     CertificateSignatureSchemes signature_schemes;
+    // 0-RTT policy for domain, early data is replayable, so it is off by default
+    uint32_t  max_early_data_size = 0;
+    // serialized once by KeyStore::prepare_certificate_messages(), handshake copies them
+    std::vector<uint8_t> certificate_message; ///< Certificate handshake message
+    std::vector<uint8_t> compressed_certificate_message; ///< RFC 8879 CompressedCertificate message
+    record::CertificateCompressionAlgorithm certificate_compression = record::CertificateCompressionAlgorithm::NONE;
+    // DER OCSPResponse of domain_cert (empty if not loaded), stapled if client sent status_request
+    std::vector<uint8_t> ocsp_response;
+    std::vector<uint8_t> stapled_certificate_message;
+    std::vector<uint8_t> stapled_compressed_certificate_message;
+};
+
+/**
+ * @brief reference of KeyStore snapshot, it keeps DomainKeys of snapshot alive
+ *
+ * Counter belongs to snapshot of one thread, so it is not shared between
+ * threads (handshake releases reference on thread, where keys were found).
+ */
+class KeyStoreSnapshotRef
+{
+public:
+    KeyStoreSnapshotRef() = default;
+    explicit KeyStoreSnapshotRef( std::atomic<uint32_t>* refs_counter ) noexcept
+        :m_refs_counter{ refs_counter }
+    { m_refs_counter->fetch_add( 1, std::memory_order_relaxed ); }
+    ~KeyStoreSnapshotRef() { reset(); }
+
+    KeyStoreSnapshotRef( KeyStoreSnapshotRef&& other ) noexcept
+        :m_refs_counter{ std::exchange( other.m_refs_counter, nullptr ) }
+    {}
+    KeyStoreSnapshotRef& operator=( KeyStoreSnapshotRef&& other ) noexcept
+    {
+        if( this != &other )
+        {
+            reset();
+            m_refs_counter = std::exchange( other.m_refs_counter, nullptr );
+        }
+        return *this;
+    }
+
+    void reset() noexcept
+    {
+        if( m_refs_counter )
+            m_refs_counter->fetch_sub( 1, std::memory_order_release );
+        m_refs_counter = nullptr;
+    }
+
+    KeyStoreSnapshotRef( const KeyStoreSnapshotRef& ) = delete;
+    KeyStoreSnapshotRef& operator=( const KeyStoreSnapshotRef& ) = delete;
+
+private:
+    std::atomic<uint32_t>* m_refs_counter = nullptr;
 };
 
 class KeyStore
@@ -47,6 +105,12 @@ public:
     virtual ~KeyStore() = default;
 
     virtual DomainKeys* find( const char* domain_name ) noexcept = 0;
+    /**
+     * find keys for one handshake, keys stay valid while snapshot_ref is kept.
+     * Stores without reload do not use snapshot_ref
+     */
+    virtual DomainKeys* acquire( const char* domain_name, KeyStoreSnapshotRef& ) noexcept
+    { return find( domain_name ); }
 
     KeyStore( KeyStore&& )            = delete;
     KeyStore& operator=( KeyStore&& ) = delete;
@@ -54,6 +118,21 @@ public:
     KeyStore& operator=( const KeyStore& ) = delete;
 
     static CertificateSignatureSchemes signature_scheme_for_cert( X509* cert );
+    /**
+     * load key, certificate, optional chain and OCSP response, prepare certificate
+     * messages. On error throws with domain_keys left empty. Missing or bad (not
+     * good, expired) OCSP response is not an error, certificate is not stapled
+     */
+    static void load_domain_keys( DomainKeys& domain_keys, const char* key_file
+            , const char* cert_file, const char* cert_chain = nullptr
+            , const char* ocsp_response_file = nullptr );
+    static void free_domain_keys( DomainKeys& domain_keys ) noexcept;
+    /**
+     * serialize Certificate message (and CompressedCertificate with most preferred
+     * compiled in algorithm) of loaded domain certificate and chain, and their
+     * stapled variants if domain has OCSP response
+     */
+    static void prepare_certificate_messages( DomainKeys& domain_keys );
     static bool is_supported_signature_scheme( record::SignatureScheme signature_scheme );
     static record::SignatureScheme find_best_signature_scheme(
             record::SignatureScheme*, uint32_t schemes_count, CertificateSignatureSchemes& );
@@ -63,7 +142,8 @@ class SingleDomainKeyStore : public KeyStore
 {
 public:
     SingleDomainKeyStore( const char* domain_name, const char* key_file
-            , const char* cert_file, const char* cert_chain = nullptr );
+            , const char* cert_file, const char* cert_chain = nullptr
+            , const char* ocsp_response_file = nullptr );
     ~SingleDomainKeyStore() override;
 
     DomainKeys* find( const char* domain_name ) noexcept final;
@@ -79,4 +159,113 @@ private:
     DomainKeys  m_keys;
 };
 
+/**
+ * @brief KeyStore of many domains with exact and wildcard (*.example.com) names
+ *
+ * Exact names are in open addressing hash table, wildcard names are in trie
+ * of reversed labels (com -> example -> *) with trie edges in the same kind of
+ * hash table, so find() costs one hash probe (plus one per label of wildcard
+ * lookup). Names are stored in one chars arena (trie labels point into names),
+ * key and certificates of domain are loaded on first find() of domain (or by
+ * load_all()), not loaded domain costs its name plus ~40 bytes. Names are case insensitive, wildcard matches one left most label
+ * only (RFC 6125 6.4.3).
+ *
+ * Directory layout for scan_directory(): "<name>.cert.pem", "<name>.key.pem",
+ * optional "<name>.chain.pem" and "<name>.ocsp.der" (DER OCSP response of
+ * certificate, see OcspRefresher), wildcard names use "_" instead of "*"
+ * ("_.example.com.cert.pem" is certificate of "*.example.com").
+ *
+ * Domains are added from one thread before use, find() can be called from
+ * many poller threads.
+ */
+class MultiDomainKeyStore : public KeyStore
+{
+public:
+    MultiDomainKeyStore() = default;
+    explicit MultiDomainKeyStore( const char* directory );
+    ~MultiDomainKeyStore() override;
+
+    void add_domain( const char* domain_name, const char* key_file
+            , const char* cert_file, const char* cert_chain = nullptr
+            , const char* ocsp_response_file = nullptr );
+    /**
+     * add domains of all certificates in directory, files are not read here
+     * @return count of added domains
+     */
+    uint32_t scan_directory( const char* directory );
+    /**
+     * load keys of all domains now (lazy load errors are visible as
+     * not found domain only), throws on first failed domain
+     */
+    void load_all();
+
+    DomainKeys* find( const char* domain_name ) noexcept final;
+    [[nodiscard]]
+    uint32_t domains_count() const noexcept { return static_cast<uint32_t>( m_domains.size() ); }
+
+    MultiDomainKeyStore( MultiDomainKeyStore&& )            = delete;
+    MultiDomainKeyStore& operator=( MultiDomainKeyStore&& ) = delete;
+    MultiDomainKeyStore( const MultiDomainKeyStore& )       = delete;
+    MultiDomainKeyStore& operator=( const MultiDomainKeyStore& ) = delete;
+
+private:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Domain
+    {
+        std::atomic<DomainKeys*> keys = nullptr;
+        uint32_t name_offset;   ///< name in m_names
+        uint16_t name_size;
+        uint16_t directory;     ///< index in m_directories if files is NONE
+        uint32_t files;         ///< index in m_domain_files
+        bool     load_failed = false;
+    };
+    struct DomainFiles
+    {
+        std::string key_file;
+        std::string cert_file;
+        std::string cert_chain;
+        std::string ocsp_response;
+    };
+    struct TrieNode
+    {
+        uint32_t label_offset; ///< label in m_names
+        uint16_t label_size;
+        uint32_t parent;
+        uint32_t wildcard_domain = NONE;
+    };
+    /**
+     * open addressing table (linear probing) of indexes, keys are compared
+     * by index owner, so slot keeps index and full hash only
+     */
+    struct IndexTable
+    {
+        struct Slot
+        {
+            uint32_t hash  = 0;
+            uint32_t index = NONE;
+        };
+        std::vector<Slot> slots;
+        uint32_t size = 0;
+    };
+
+    uint32_t add_name( std::string_view domain_name, uint16_t directory, uint32_t files );
+    void add_name_index( uint32_t name_offset, uint32_t name_size, bool wildcard, uint32_t domain_index );
+    uint32_t find_domain( const char* domain_name ) const noexcept;
+    uint32_t find_edge( uint32_t parent, const char* label, uint32_t label_size, uint32_t hash ) const noexcept;
+    /// @return nullptr if domain failed to load before, throws on load error
+    DomainKeys* load_domain( Domain& domain );
+    [[nodiscard]]
+    bool name_equal( uint32_t offset, uint32_t size, const char* name, uint32_t name_size ) const noexcept;
+
+    std::string m_names;                ///< arena of lower case names and labels
+    std::deque<Domain> m_domains;       ///< deque, because std::atomic is not movable
+    std::vector<DomainFiles> m_domain_files;
+    std::vector<std::string> m_directories;
+    std::vector<TrieNode> m_trie_nodes = { TrieNode{ 0, 0, NONE } }; ///< m_trie_nodes[0] is root
+    IndexTable m_exact_names;           ///< index in m_domains
+    IndexTable m_trie_edges;            ///< index in m_trie_nodes
+    std::mutex m_load_mutex;
+};
+
 }
@@ -0,0 +1,156 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/tls/ktls.hpp>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/tls.h>
+#include <endian.h>
+#include <cerrno>
+
+#include <algorithm>
+
+#include <libcornet/tls/types.hpp>
+
+#ifndef SOL_TLS
+#define SOL_TLS 282
+#endif
+#ifndef TLS_SET_RECORD_TYPE
+#define TLS_SET_RECORD_TYPE 1
+#endif
+#ifndef TLS_GET_RECORD_TYPE
+#define TLS_GET_RECORD_TYPE 2
+#endif
+
+namespace pioneer19::cornet::tls13
+{
+
+/*
+ * TLS 1.3 per record nonce is static iv xor record sequence number,
+ * kernel crypto_info wants iv split to salt (first bytes) and iv (other bytes)
+ */
+template< typename CryptoInfo >
+static void fill_crypto_info( CryptoInfo& crypto_info, uint16_t cipher_type
+        , const uint8_t* key, const uint8_t* static_iv, uint64_t sequence_number )
+{
+    std::fill_n( reinterpret_cast<uint8_t*>(&crypto_info), sizeof(crypto_info), 0 );
+    crypto_info.info.version     = TLS_1_3_VERSION;
+    crypto_info.info.cipher_type = cipher_type;
+    std::copy_n( key, sizeof(crypto_info.key), crypto_info.key );
+    std::copy_n( static_iv, sizeof(crypto_info.salt), crypto_info.salt );
+    std::copy_n( static_iv + sizeof(crypto_info.salt), sizeof(crypto_info.iv), crypto_info.iv );
+    uint64_t sequence_in_net_order = htobe64( sequence_number );
+    std::copy_n( reinterpret_cast<const uint8_t*>(&sequence_in_net_order)
+                 , sizeof(crypto_info.rec_seq), crypto_info.rec_seq );
+}
+
+static bool set_crypto_info( int socket_fd, int direction, const uint8_t* key
+        , const uint8_t* static_iv, uint64_t sequence_number, record::CipherSuite cipher_suite ) noexcept
+{
+    int res = -1;
+    switch( cipher_suite.num() )
+    {
+        case record::TLS_AES_128_GCM_SHA256.num():
+        {
+            tls12_crypto_info_aes_gcm_128 crypto_info;
+            fill_crypto_info( crypto_info, TLS_CIPHER_AES_GCM_128, key, static_iv, sequence_number );
+            res = ::setsockopt( socket_fd, SOL_TLS, direction, &crypto_info, sizeof(crypto_info) );
+            break;
+        }
+        case record::TLS_AES_256_GCM_SHA384.num():
+        {
+            tls12_crypto_info_aes_gcm_256 crypto_info;
+            fill_crypto_info( crypto_info, TLS_CIPHER_AES_GCM_256, key, static_iv, sequence_number );
+            res = ::setsockopt( socket_fd, SOL_TLS, direction, &crypto_info, sizeof(crypto_info) );
+            break;
+        }
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+        case record::TLS_CHACHA20_POLY1305_SHA256.num():
+        {
+            tls12_crypto_info_chacha20_poly1305 crypto_info;
+            fill_crypto_info( crypto_info, TLS_CIPHER_CHACHA20_POLY1305, key, static_iv, sequence_number );
+            res = ::setsockopt( socket_fd, SOL_TLS, direction, &crypto_info, sizeof(crypto_info) );
+            break;
+        }
+#endif
+        default:
+            return false;
+    }
+    return res == 0;
+}
+
+bool ktls_attach_ulp( int socket_fd ) noexcept
+{
+    static constexpr char ulp_name[] = "tls";
+    if( ::setsockopt( socket_fd, SOL_TCP, TCP_ULP, ulp_name, sizeof(ulp_name) ) == 0 )
+        return true;
+    // ulp already attached (tx enabled before rx)
+    return errno == EEXIST;
+}
+
+bool ktls_enable_tx( int socket_fd, const crypto::TlsCipherSuite& cipher_suite ) noexcept
+{
+    if( !ktls_attach_ulp( socket_fd ) )
+        return false;
+
+    return set_crypto_info( socket_fd, TLS_TX, cipher_suite.sender_key_data()
+            , cipher_suite.sender_iv_data(), cipher_suite.sender_counter(), cipher_suite.cipher_suite() );
+}
+
+bool ktls_enable_rx( int socket_fd, const crypto::TlsCipherSuite& cipher_suite ) noexcept
+{
+    if( !ktls_attach_ulp( socket_fd ) )
+        return false;
+
+    return set_crypto_info( socket_fd, TLS_RX, cipher_suite.receiver_key_data()
+            , cipher_suite.receiver_iv_data(), cipher_suite.receiver_counter(), cipher_suite.cipher_suite() );
+}
+
+KtlsReadMessage::KtlsReadMessage( void* buffer, uint32_t buffer_size ) noexcept
+    :iov{ buffer, buffer_size }
+{
+    message.msg_iov        = &iov;
+    message.msg_iovlen     = 1;
+    message.msg_control    = control;
+    message.msg_controllen = sizeof(control);
+}
+
+record::ContentType KtlsReadMessage::record_type() noexcept
+{
+    for( cmsghdr* control_message = CMSG_FIRSTHDR( &message ); control_message != nullptr
+         ; control_message = CMSG_NXTHDR( &message, control_message ))
+    {
+        if( control_message->cmsg_level == SOL_TLS && control_message->cmsg_type == TLS_GET_RECORD_TYPE )
+            return static_cast<record::ContentType>( *CMSG_DATA( control_message ));
+    }
+
+    return record::ContentType::APPLICATION_DATA;
+}
+
+bool ktls_send_alert( int socket_fd, record::Alert alert ) noexcept
+{
+    // data written to kTLS socket is application_data, other record type is set by control message
+    char control[CMSG_SPACE( sizeof(record::ContentType) )] = {};
+    iovec iov{ &alert, sizeof(alert) };
+    msghdr message{};
+    message.msg_iov        = &iov;
+    message.msg_iovlen     = 1;
+    message.msg_control    = control;
+    message.msg_controllen = sizeof(control);
+
+    cmsghdr* control_message = CMSG_FIRSTHDR( &message );
+    control_message->cmsg_level = SOL_TLS;
+    control_message->cmsg_type  = TLS_SET_RECORD_TYPE;
+    control_message->cmsg_len   = CMSG_LEN( sizeof(record::ContentType) );
+    *CMSG_DATA( control_message ) = static_cast<uint8_t>( record::ContentType::ALERT );
+
+    return ::sendmsg( socket_fd, &message, MSG_NOSIGNAL ) == sizeof(alert);
+}
+
+}
@@ -0,0 +1,73 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <sys/socket.h>
+
+#include <libcornet/tls/crypto/record_ciphers.hpp>
+#include <libcornet/tls/types.hpp>
+
+namespace pioneer19::cornet::tls13
+{
+
+/*
+ * Linux kernel TLS (kTLS) offload of established TLS 1.3 connection.
+ * After successful ktls_enable_tx() plain data written to socket will be sent
+ * as encrypted application_data records (so sendfile() works too), after
+ * ktls_enable_rx() reading socket returns decrypted application data.
+ * Socket with kTLS rx returns EIO on plain read if non application_data record
+ * (alert, post handshake message) received, such records are read by recvmsg()
+ * with KtlsReadMessage, which gets record type from kernel.
+ *
+ * Functions return false and leave socket for user space encryption
+ * if kernel has no tls module or cipher suite not supported by kTLS.
+ */
+
+/**
+ * attach "tls" upper layer protocol to tcp socket (once per socket)
+ * @return false if kernel has no tls module
+ */
+bool ktls_attach_ulp( int socket_fd ) noexcept;
+/**
+ * install cipher_suite sender key, iv and record sequence number to socket
+ */
+bool ktls_enable_tx( int socket_fd, const crypto::TlsCipherSuite& cipher_suite ) noexcept;
+/**
+ * install cipher_suite receiver key, iv and record sequence number to socket,
+ * must be called when no unprocessed record data read from socket
+ */
+bool ktls_enable_rx( int socket_fd, const crypto::TlsCipherSuite& cipher_suite ) noexcept;
+/**
+ * @brief recvmsg() message of socket with kTLS rx
+ *
+ * Kernel returns one not application_data record per call with its type
+ * in control message, application data of several records can be read at once.
+ */
+struct KtlsReadMessage
+{
+    KtlsReadMessage( void* buffer, uint32_t buffer_size ) noexcept;
+
+    /// type of record read by last recvmsg(), application_data if kernel sent no type
+    [[nodiscard]]
+    record::ContentType record_type() noexcept;
+
+    msghdr message{};
+    iovec  iov{};
+    alignas(cmsghdr) uint8_t control[CMSG_SPACE( sizeof(record::ContentType) )] = {};
+
+    KtlsReadMessage( const KtlsReadMessage& ) = delete;
+    KtlsReadMessage& operator=( const KtlsReadMessage& ) = delete;
+};
+
+/**
+ * send alert record through socket with kTLS tx (kernel encrypts it as alert content type)
+ * @return false if alert was not sent (socket send buffer full or connection broken)
+ */
+bool ktls_send_alert( int socket_fd, record::Alert alert ) noexcept;
+
+}
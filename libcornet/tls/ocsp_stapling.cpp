@@ -0,0 +1,332 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/tls/ocsp_stapling.hpp>
+
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <system_error>
+
+#include <openssl/ocsp.h>
+#include <openssl/pem.h>
+#include <openssl/x509v3.h>
+#include <openssl/err.h>
+
+#include <libcornet/poller.hpp>
+#include <libcornet/async_file.hpp>
+#include <pioneer19_utils/guards.hpp>
+
+namespace pioneer19::cornet::tls13
+{
+
+// clock skew of responder and server
+static constexpr long OCSP_VALIDITY_LEEWAY_SEC = 300;
+
+std::vector<uint8_t> OcspStapling::load_response( const char* file_name )
+{
+    int fd = open( file_name, O_RDONLY|O_CLOEXEC );
+    if( fd == -1 )
+    {
+        if( errno == ENOENT )
+            return {};
+        throw std::system_error( errno, std::system_category(),
+                                 std::string("open() ocsp response file \"")+file_name+"\"" );
+    }
+    auto file_close_guard = make_scope_guard( [fd](){ ::close( fd ); } );
+
+    std::vector<uint8_t> response;
+    uint8_t buffer[4096];
+    while( true )
+    {
+        ssize_t bytes_read = ::read( fd, buffer, sizeof(buffer) );
+        if( bytes_read == 0 )
+            break;
+        if( bytes_read == -1 )
+        {
+            if( errno == EINTR )
+                continue;
+            throw std::system_error( errno, std::system_category(),
+                                     std::string("read() ocsp response file \"")+file_name+"\"" );
+        }
+        response.insert( response.end(), buffer, buffer + bytes_read );
+        if( response.size() > MAX_RESPONSE_SIZE )
+            throw std::runtime_error( std::string("ocsp response file \"")+file_name+"\" is too big" );
+    }
+
+    return response;
+}
+
+void OcspStapling::write_response( const std::string& file_name, const std::vector<uint8_t>& response )
+{
+    std::string tmp_file_name = file_name + ".tmp";
+    int fd = open( tmp_file_name.c_str(), O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644 );
+    if( fd == -1 )
+        throw std::system_error( errno, std::system_category(),
+                                 "open() ocsp response file \""+tmp_file_name+"\"" );
+    size_t written = 0;
+    while( written < response.size() )
+    {
+        ssize_t res = ::write( fd, response.data() + written, response.size() - written );
+        if( res == -1 && errno == EINTR )
+            continue;
+        if( res == -1 )
+        {
+            int err = errno;
+            ::close( fd );
+            unlink( tmp_file_name.c_str() );
+            throw std::system_error( err, std::system_category(),
+                                     "write() ocsp response file \""+tmp_file_name+"\"" );
+        }
+        written += res;
+    }
+    ::close( fd );
+    if( rename( tmp_file_name.c_str(), file_name.c_str() ) == -1 )
+    {
+        int err = errno;
+        unlink( tmp_file_name.c_str() );
+        throw std::system_error( err, std::system_category(),
+                                 "rename() ocsp response file \""+file_name+"\"" );
+    }
+}
+
+std::string OcspStapling::check_response( const uint8_t* response, uint32_t response_size
+        , X509* cert, X509* issuer )
+{
+    const uint8_t* data = response;
+    OCSP_RESPONSE* ocsp_response = d2i_OCSP_RESPONSE( nullptr, &data, response_size );
+    if( ocsp_response == nullptr )
+    {
+        ERR_clear_error();
+        return "wrong OCSPResponse DER";
+    }
+    auto response_guard = make_scope_guard( [ocsp_response](){ OCSP_RESPONSE_free( ocsp_response ); } );
+
+    int response_status = OCSP_response_status( ocsp_response );
+    if( response_status != OCSP_RESPONSE_STATUS_SUCCESSFUL )
+        return std::string("response status ") + OCSP_response_status_str( response_status );
+    OCSP_BASICRESP* basic_response = OCSP_response_get1_basic( ocsp_response );
+    if( basic_response == nullptr )
+    {
+        ERR_clear_error();
+        return "no basic response";
+    }
+    auto basic_guard = make_scope_guard( [basic_response](){ OCSP_BASICRESP_free( basic_response ); } );
+
+    int status = -1;
+    int reason = 0;
+    ASN1_GENERALIZEDTIME* this_update = nullptr;
+    ASN1_GENERALIZEDTIME* next_update = nullptr;
+    if( issuer != nullptr )
+    {
+        // response is signed by issuer or by delegated responder (certificate in response
+        // issued by issuer with OCSPSigning usage), issuer is trust anchor of signer chain
+        STACK_OF(X509)* signers = sk_X509_new_null();
+        sk_X509_push( signers, issuer );
+        X509_STORE* store = X509_STORE_new();
+        X509_STORE_add_cert( store, issuer );
+        X509_STORE_set_flags( store, X509_V_FLAG_PARTIAL_CHAIN );
+        int verified = OCSP_basic_verify( basic_response, signers, store, 0 );
+        X509_STORE_free( store );
+        sk_X509_free( signers );
+        if( verified <= 0 )
+        {
+            ERR_clear_error();
+            return "response signature verify failed";
+        }
+
+        OCSP_CERTID* cert_id = OCSP_cert_to_id( nullptr, cert, issuer );
+        int found = OCSP_resp_find_status( basic_response, cert_id, &status, &reason
+                                           , nullptr, &this_update, &next_update );
+        OCSP_CERTID_free( cert_id );
+        if( found != 1 )
+            return "no response for certificate";
+    }
+    else
+    {
+        // issuer is unknown (self signed certificate), response is taken as is
+        OCSP_SINGLERESP* single = OCSP_resp_get0( basic_response, 0 );
+        if( single == nullptr )
+            return "no single response";
+        status = OCSP_single_get0_status( single, &reason, nullptr, &this_update, &next_update );
+    }
+    if( status != V_OCSP_CERTSTATUS_GOOD )
+        return std::string("certificate status ") + OCSP_cert_status_str( status );
+    if( OCSP_check_validity( this_update, next_update, OCSP_VALIDITY_LEEWAY_SEC, -1 ) != 1 )
+    {
+        ERR_clear_error();
+        return "response is expired or not yet valid";
+    }
+
+    return {};
+}
+
+std::vector<uint8_t> OcspStapling::create_request( X509* cert, X509* issuer )
+{
+    OCSP_REQUEST* request = OCSP_REQUEST_new();
+    auto request_guard = make_scope_guard( [request](){ OCSP_REQUEST_free( request ); } );
+    OCSP_CERTID* cert_id = OCSP_cert_to_id( nullptr, cert, issuer );
+    if( cert_id == nullptr || OCSP_request_add0_id( request, cert_id ) == nullptr )
+    {
+        OCSP_CERTID_free( cert_id );
+        throw std::runtime_error( "OcspStapling::create_request() failed create certificate id" );
+    }
+
+    int request_size = i2d_OCSP_REQUEST( request, nullptr );
+    if( request_size <= 0 )
+        throw std::runtime_error( "OcspStapling::create_request() failed encode request" );
+    std::vector<uint8_t> request_der( request_size );
+    uint8_t* data = request_der.data();
+    i2d_OCSP_REQUEST( request, &data );
+
+    return request_der;
+}
+
+std::string OcspStapling::responder_url( X509* cert )
+{
+    STACK_OF(OPENSSL_STRING)* urls = X509_get1_ocsp( cert );
+    std::string url;
+    if( urls != nullptr && sk_OPENSSL_STRING_num( urls ) > 0 )
+        url = sk_OPENSSL_STRING_value( urls, 0 );
+    X509_email_free( urls );
+
+    return url;
+}
+
+static X509* load_pem_cert( const char* cert_file_name )
+{
+    FILE* cert_file = fopen( cert_file_name, "r" );
+    if( cert_file == nullptr )
+        throw std::system_error( errno, std::system_category(),
+                                 std::string("fopen() cert file \"")+cert_file_name+"\"" );
+    X509* cert = PEM_read_X509( cert_file, nullptr, nullptr, nullptr );
+    fclose( cert_file );
+    if( cert == nullptr )
+    {
+        ERR_clear_error();
+        throw std::runtime_error( std::string("PEM_read_X509 failed for \"")+cert_file_name+"\"" );
+    }
+
+    return cert;
+}
+
+OcspRefresher::OcspRefresher( OcspFetcher& fetcher, std::function<void()> on_updated )
+    :m_fetcher{ fetcher }
+    ,m_on_updated{ std::move(on_updated) }
+{}
+
+OcspRefresher::~OcspRefresher()
+{
+    if( m_refresh_loop )
+        m_refresh_loop->stop();
+    for( auto& certificate : m_certificates )
+    {
+        X509_free( certificate.cert );
+        X509_free( certificate.issuer );
+    }
+}
+
+void OcspRefresher::add_certificate( const char* cert_file, const char* issuer_file
+        , std::string response_file, std::string responder_url )
+{
+    Certificate certificate;
+    certificate.cert = load_pem_cert( cert_file );
+    try
+    {
+        certificate.issuer = load_pem_cert( issuer_file );
+        if( responder_url.empty() )
+            responder_url = OcspStapling::responder_url( certificate.cert );
+        if( responder_url.empty() )
+            throw std::runtime_error( std::string("OcspRefresher no OCSP responder in \"")+cert_file+"\"" );
+        certificate.request = OcspStapling::create_request( certificate.cert, certificate.issuer );
+    }
+    catch( ... )
+    {
+        X509_free( certificate.cert );
+        X509_free( certificate.issuer );
+        throw;
+    }
+    certificate.response_file = std::move(response_file);
+    certificate.responder_url = std::move(responder_url);
+
+    m_certificates.push_back( std::move(certificate) );
+}
+
+CoroutineAwaiter<uint32_t> OcspRefresher::refresh()
+{
+    uint32_t updated = 0;
+    for( auto& certificate : m_certificates )
+    {
+        std::vector<uint8_t> response;
+        try
+        {
+            response = co_await m_fetcher.fetch( certificate.responder_url, certificate.request );
+        }
+        catch( const std::exception& ex )
+        {
+            fprintf( stderr, "OcspRefresher fetch from %s failed: %s\n"
+                     , certificate.responder_url.c_str(), ex.what() );
+            continue;
+        }
+        if( response.empty() || response.size() > OcspStapling::MAX_RESPONSE_SIZE )
+            continue;
+        // bad response never replaces previous one
+        auto error = OcspStapling::check_response( response.data(), response.size()
+                                                   , certificate.cert, certificate.issuer );
+        if( !error.empty() )
+        {
+            fprintf( stderr, "OcspRefresher got bad response from %s: %s\n"
+                     , certificate.responder_url.c_str(), error.c_str() );
+            continue;
+        }
+        try
+        {
+            OcspStapling::write_response( certificate.response_file, response );
+            ++updated;
+        }
+        catch( const std::exception& ex )
+        {
+            fprintf( stderr, "OcspRefresher %s\n", ex.what() );
+        }
+    }
+    if( updated > 0 && m_on_updated )
+        m_on_updated();
+
+    co_return updated;
+}
+
+void OcspRefresher::run( Poller& poller, std::chrono::seconds interval )
+{
+    if( m_refresh_loop )
+        m_refresh_loop->stop();
+    m_refresh_loop.emplace( refresh_loop( poller, interval ) );
+}
+
+CommonCoroutine OcspRefresher::refresh_loop( Poller& poller, std::chrono::seconds interval )
+{
+    int timer_fd = timerfd_create( CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC );
+    if( timer_fd == -1 )
+        throw std::system_error( errno, std::system_category()
+                                 , "OcspRefresher::run() timerfd_create failed" );
+    AsyncFile timer{ timer_fd, &poller };
+    itimerspec timer_spec{};
+    timer_spec.it_interval.tv_sec = std::max( interval.count(), 1l );
+    timer_spec.it_value = timer_spec.it_interval;
+    timerfd_settime( timer_fd, 0, &timer_spec, nullptr );
+
+    while( true )
+    {
+        co_await refresh();
+        uint64_t expirations = 0;
+        co_await timer.async_read( reinterpret_cast<char*>(&expirations), sizeof(expirations) );
+    }
+}
+
+}
@@ -0,0 +1,136 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <optional>
+#include <functional>
+
+#include <openssl/x509.h>
+
+#include <pioneer19_utils/coroutines_utils.hpp>
+
+namespace pioneer19::cornet
+{
+class Poller;
+}
+
+namespace pioneer19::cornet::tls13
+{
+
+/**
+ * @brief OCSP responses for status_request stapling (RFC 6066 8, RFC 8446 4.4.2.1)
+ *
+ * Server staples DER OCSPResponse of domain certificate in CertificateEntry
+ * extensions, if client sent status_request. Response is part of DomainKeys:
+ * it is loaded with key and certificate (KeyStore::load_domain_keys()) from
+ * response file, so new response is published by KeyStore reload
+ * (ReloadableKeyStore) and handshake never waits for OCSP responder.
+ */
+struct OcspStapling
+{
+    /// status_request extension data is limited by 2^16-1
+    static constexpr uint32_t MAX_RESPONSE_SIZE = UINT16_MAX - 4;
+
+    /**
+     * @return DER OCSPResponse, empty if file does not exist
+     */
+    static std::vector<uint8_t> load_response( const char* file_name );
+    /**
+     * write response to temporary file and rename it to file_name,
+     * so KeyStore never reads partially written response
+     */
+    static void write_response( const std::string& file_name, const std::vector<uint8_t>& response );
+    /**
+     * response is stapled if it is successful, status of cert is good and
+     * response is valid now. Signature is verified if issuer is known
+     * @return empty string if response is good or error description
+     */
+    static std::string check_response( const uint8_t* response, uint32_t response_size
+                                       , X509* cert, X509* issuer );
+    /// DER OCSPRequest for cert
+    static std::vector<uint8_t> create_request( X509* cert, X509* issuer );
+    /// first OCSP responder url from cert authority information access, empty if no one
+    static std::string responder_url( X509* cert );
+};
+
+/**
+ * @brief transport of OCSP requests, HTTP client or stub (in tests, offline)
+ */
+class OcspFetcher
+{
+public:
+    OcspFetcher() = default;
+    virtual ~OcspFetcher() = default;
+
+    /**
+     * @return DER OCSPResponse or empty vector on fetch error
+     */
+    virtual CoroutineAwaiter<std::vector<uint8_t>> fetch(
+            const std::string& responder_url, const std::vector<uint8_t>& request ) = 0;
+
+    OcspFetcher( OcspFetcher&& )            = delete;
+    OcspFetcher& operator=( OcspFetcher&& ) = delete;
+    OcspFetcher( const OcspFetcher& )       = delete;
+    OcspFetcher& operator=( const OcspFetcher& ) = delete;
+};
+
+/**
+ * @brief refreshes OCSP response files in background
+ *
+ * Every refresh() fetches responses of added certificates by OcspFetcher,
+ * checks them and replaces response files, then calls on_updated (usually
+ * ReloadableKeyStore::reload(), or it is reloaded by file change). Failed
+ * fetch keeps previous response file. Works in one poller thread.
+ */
+class OcspRefresher
+{
+public:
+    explicit OcspRefresher( OcspFetcher& fetcher, std::function<void()> on_updated = {} );
+    ~OcspRefresher();
+
+    /**
+     * @param responder_url OCSP responder, by default it is taken from certificate
+     */
+    void add_certificate( const char* cert_file, const char* issuer_file
+            , std::string response_file, std::string responder_url = {} );
+    /**
+     * @return count of updated response files
+     */
+    CoroutineAwaiter<uint32_t> refresh();
+    /// refresh() now and every interval
+    void run( Poller& poller, std::chrono::seconds interval );
+
+    OcspRefresher( OcspRefresher&& )            = delete;
+    OcspRefresher& operator=( OcspRefresher&& ) = delete;
+    OcspRefresher( const OcspRefresher& )       = delete;
+    OcspRefresher& operator=( const OcspRefresher& ) = delete;
+
+private:
+    struct Certificate
+    {
+        X509* cert   = nullptr;
+        X509* issuer = nullptr;
+        std::string response_file;
+        std::string responder_url;
+        std::vector<uint8_t> request;
+    };
+
+    CommonCoroutine refresh_loop( Poller& poller, std::chrono::seconds interval );
+
+    OcspFetcher& m_fetcher;
+    std::function<void()> m_on_updated;
+    std::vector<Certificate> m_certificates;
+    std::optional<CommonCoroutine> m_refresh_loop;
+};
+
+}
@@ -42,13 +42,27 @@ struct PrintHook
     static void named_group( NamedGroup );
     static void signature_scheme( SignatureScheme );
     static void psk_key_exchange_mode( PskKeyExchangeMode );
+    static void psk_identity( const uint8_t*, uint16_t, uint32_t );
+    static void psk_binders( const uint8_t* ) {}
+    static void psk_binder( const uint8_t*, uint8_t );
+    static void psk_selected_identity( uint16_t );
+    static void extension_early_data( uint32_t max_early_data_size );
+    static void certificate_compression_algorithm( CertificateCompressionAlgorithm );
+    static void status_request( CertificateStatusType );
     static void key_share_entry( NamedGroup, const uint8_t*, uint16_t );
+    static void key_share_selected_group( NamedGroup );
+    static void cookie( const uint8_t*, uint16_t );
     static void certificate_request_context( const uint8_t* certificate_request_context_data
             , uint32_t certificate_request_context_size );
     static void certificate_list( uint32_t certificate_list_size );
     static void cert_data(  CertificateType cert_type, const uint8_t* cert_data, uint32_t cert_size );
+    static void compressed_certificate( CertificateCompressionAlgorithm, uint32_t, const uint8_t*, uint32_t );
+    static void certificate_status( CertificateStatusType, const uint8_t*, uint32_t );
     static void cert_verify_data( const SignatureScheme*, const uint8_t*, uint32_t );
     static void finished_data( const uint8_t*, uint32_t );
+    static void new_session_ticket( const NewSessionTicket*, const uint8_t*, uint8_t
+                                    ,const uint8_t*, uint16_t );
+    static void end_of_early_data();
     static void tls_alert( const Alert );
 };
 
@@ -154,6 +168,8 @@ static std::string handshake_type_string( HandshakeType msg_type )
             return "finished(20)";
         case HandshakeType::KEY_UPDATE:
             return "key_update(24)";
+        case HandshakeType::COMPRESSED_CERTIFICATE:
+            return "compressed_certificate(25)";
         case HandshakeType::MESSAGE_HASH:
             return "message_hash(254)";
         default:
@@ -208,6 +224,8 @@ static std::string extension_type_string( ExtensionType type )
             return "server_certificate_type(20)";
         case ExtensionType::PADDING:
             return "padding(21)";
+        case ExtensionType::COMPRESS_CERTIFICATE:
+            return "compress_certificate(27)";
         case ExtensionType::PRE_SHARED_KEY:
             return "pre_shared_key(41)";
         case ExtensionType::EARLY_DATA:
@@ -457,6 +475,51 @@ void PrintHook::psk_key_exchange_mode( PskKeyExchangeMode psk_kex_mode )
     std::cout << "        " << psk_key_exchange_mode_string( psk_kex_mode ) << "\n";
 }
 
+void PrintHook::psk_identity( const uint8_t* identity, uint16_t identity_size, uint32_t obfuscated_ticket_age )
+{
+    std::cout << "        psk_identity[" << identity_size << "] obfuscated_ticket_age "
+              << obfuscated_ticket_age << " " << hex_string( identity, identity_size ) << "\n";
+}
+
+void PrintHook::psk_binder( const uint8_t* binder, uint8_t binder_size )
+{
+    std::cout << "        psk_binder " << hex_string( binder, binder_size ) << "\n";
+}
+
+void PrintHook::psk_selected_identity( uint16_t selected_identity )
+{
+    std::cout << "        psk selected_identity " << selected_identity << "\n";
+}
+
+void PrintHook::extension_early_data( uint32_t max_early_data_size )
+{
+    std::cout << "        early_data max_early_data_size " << max_early_data_size << "\n";
+}
+
+static std::string compression_algorithm_string( CertificateCompressionAlgorithm algorithm )
+{
+    switch( algorithm )
+    {
+        case CertificateCompressionAlgorithm::ZLIB:
+            return "zlib(1)";
+        case CertificateCompressionAlgorithm::BROTLI:
+            return "brotli(2)";
+        case CertificateCompressionAlgorithm::ZSTD:
+            return "zstd(3)";
+        default:
+            return std::string("unknown")+std::to_string(static_cast<uint16_t>(algorithm));
+    }
+}
+void PrintHook::certificate_compression_algorithm( CertificateCompressionAlgorithm algorithm )
+{
+    std::cout << "        compress_certificate " << compression_algorithm_string( algorithm ) << "\n";
+}
+
+void PrintHook::status_request( CertificateStatusType status_type )
+{
+    std::cout << "        status_request status_type " << static_cast<uint32_t>(status_type) << "\n";
+}
+
 void PrintHook::key_share_entry( NamedGroup named_group, const uint8_t* key_data, uint16_t key_size )
 {
     std::cout << "        key_share_entry " << named_group_string( named_group )
@@ -464,6 +527,16 @@ void PrintHook::key_share_entry( NamedGroup named_group, const uint8_t* key_data
 
 }
 
+void PrintHook::key_share_selected_group( NamedGroup named_group )
+{
+    std::cout << "        key_share_selected_group " << named_group_string( named_group ) << "\n";
+}
+
+void PrintHook::cookie( const uint8_t* cookie, uint16_t cookie_size )
+{
+    std::cout << "        cookie " << hex_string( cookie, cookie_size ) << "\n";
+}
+
 void PrintHook::certificate_request_context( const uint8_t* certificate_request_context_data,
                                              uint32_t certificate_request_context_size )
 {
@@ -514,6 +587,20 @@ void PrintHook::cert_data( CertificateType cert_type, const uint8_t* cert_data,
     X509_free( x );
 }
 
+void PrintHook::certificate_status( CertificateStatusType status_type, const uint8_t*, uint32_t response_size )
+{
+    std::cout << "            certificate_status status_type " << static_cast<uint32_t>(status_type)
+              << " ocsp_response[" << response_size << "]\n";
+}
+
+void PrintHook::compressed_certificate( CertificateCompressionAlgorithm algorithm
+        ,uint32_t uncompressed_length, const uint8_t*, uint32_t compressed_size )
+{
+    std::cout << "    compressed_certificate " << compression_algorithm_string( algorithm )
+              << " uncompressed_length " << uncompressed_length
+              << " size " << compressed_size << "\n";
+}
+
 void PrintHook::cert_verify_data( const SignatureScheme* signature_scheme
         ,const uint8_t*, uint32_t buffer_size )
 {
@@ -526,6 +613,20 @@ void PrintHook::finished_data( const uint8_t*, uint32_t buffer_size )
     std::cout << "     finished verify_data["<< buffer_size << "]\n";
 }
 
+void PrintHook::new_session_ticket( const NewSessionTicket* new_session_ticket
+        ,const uint8_t* nonce, uint8_t nonce_size, const uint8_t*, uint16_t ticket_size )
+{
+    std::cout << "     new_session_ticket lifetime " << new_session_ticket->ticket_lifetime()
+              << " age_add " << new_session_ticket->ticket_age_add()
+              << " nonce " << hex_string( nonce, nonce_size )
+              << " ticket[" << ticket_size << "]\n";
+}
+
+void PrintHook::end_of_early_data()
+{
+    std::cout << "     end_of_early_data\n";
+}
+
 static std::string alert_level_string( AlertLevel level )
 {
     switch( level )
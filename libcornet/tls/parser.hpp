@@ -13,6 +13,7 @@
 #include <string>
 #include <libcornet/tls/types.hpp>
 #include <libcornet/tls/parser_error.hpp>
+#include <libcornet/tls/handshake_chain.hpp>
 
 namespace pioneer19::cornet::tls13::record
 {
@@ -38,12 +39,26 @@ struct EmptyHook
     static void named_group( NamedGroup ) {}
     static void signature_scheme( SignatureScheme ) {}
     static void psk_key_exchange_mode( PskKeyExchangeMode ) {}
+    static void psk_identity( const uint8_t*, uint16_t, uint32_t ) {}
+    static void psk_binders( const uint8_t* ) {}
+    static void psk_binder( const uint8_t*, uint8_t ) {}
+    static void psk_selected_identity( uint16_t ) {}
+    static void extension_early_data( uint32_t ) {}
+    static void certificate_compression_algorithm( CertificateCompressionAlgorithm ) {}
+    static void status_request( CertificateStatusType ) {}
     static void key_share_entry( NamedGroup, const uint8_t*, uint16_t ) {}
+    static void key_share_selected_group( NamedGroup ) {}
+    static void cookie( const uint8_t*, uint16_t ) {}
     static void certificate_request_context( const uint8_t*, uint32_t ) {}
     static void certificate_list( uint32_t ) {}
     static void cert_data(  CertificateType, const uint8_t*, uint32_t ) {}
+    static void certificate_status( CertificateStatusType, const uint8_t*, uint32_t ) {}
+    static void compressed_certificate( CertificateCompressionAlgorithm, uint32_t, const uint8_t*, uint32_t ) {}
     static void cert_verify_data( const SignatureScheme*, const uint8_t*, uint32_t ) {}
     static void finished_data( const uint8_t*, uint32_t ){}
+    static void new_session_ticket( const NewSessionTicket*, const uint8_t*, uint8_t
+                                    ,const uint8_t*, uint16_t ) {}
+    static void end_of_early_data() {}
     static void tls_alert( const Alert ){}
 };
 
@@ -63,6 +78,12 @@ public:
     template< typename Hook>
     std::pair<uint32_t,ParserError> parse_net_record( Hook* hook
             , const uint8_t* buffer, uint32_t buffer_size );
+    /**
+     * parse Handshake message received in several records. Certificate entries
+     * are parsed in place, entry split between fragments is copied by chain
+     */
+    template< typename Hook>
+    ParserError parse_handshake_chain( Hook* hook, HandshakeChain& chain );
 
     [[nodiscard]]
     const std::string& message_addon() const noexcept { return m_message_addon; }
@@ -88,15 +109,26 @@ private:
     ParserError parse_certificate( Hook* hook
             ,const uint8_t* buffer, uint16_t buffer_size );
     template<typename Hook>
+    ParserError parse_compressed_certificate( Hook* hook
+            ,const uint8_t* buffer, uint16_t buffer_size );
+    template<typename Hook>
     ParserError parse_certificate_verify( Hook* hook
             ,const uint8_t* buffer, uint16_t buffer_size );
     template<typename Hook>
     ParserError parse_finished( Hook* hook
             ,const uint8_t* buffer, uint16_t buffer_size );
+    template<typename Hook>
+    ParserError parse_new_session_ticket( Hook* hook
+            ,const uint8_t* buffer, uint16_t buffer_size );
+    template<typename Hook>
+    ParserError parse_end_of_early_data( Hook* hook
+            ,const uint8_t* buffer, uint16_t buffer_size );
 
     template<typename Hook>
     ParserError parse_certificate_entry( Hook* hook
             ,const uint8_t* buffer, uint16_t buffer_size, CertificateType cert_type = CertificateType::X509 );
+    template<typename Hook>
+    ParserError parse_certificate_chain( Hook* hook, HandshakeChain& chain );
 
     template< typename Hook >
     ParserError parse_extensions( Hook* hook
@@ -122,6 +154,24 @@ private:
     template< typename Hook >
     ParserError parse_extension_psk_key_exchange_modes( Hook* hook
             ,const uint8_t* extensions_internal_data, uint16_t extensions_data_size );
+    template< typename Hook >
+    ParserError parse_extension_pre_shared_key( Hook* hook
+            ,const uint8_t* extensions_internal_data, uint16_t extensions_data_size
+            ,HandshakeType handshake_type );
+    template< typename Hook >
+    ParserError parse_extension_early_data( Hook* hook
+            ,const uint8_t* extensions_internal_data, uint16_t extensions_data_size
+            ,HandshakeType handshake_type );
+    template< typename Hook >
+    ParserError parse_extension_compress_certificate( Hook* hook
+            ,const uint8_t* extensions_internal_data, uint16_t extensions_data_size );
+    template< typename Hook >
+    ParserError parse_extension_status_request( Hook* hook
+            ,const uint8_t* extensions_internal_data, uint16_t extensions_data_size
+            ,HandshakeType handshake_type );
+    template< typename Hook >
+    ParserError parse_extension_cookie( Hook* hook
+            ,const uint8_t* extensions_internal_data, uint16_t extensions_data_size );
 
     std::string m_message_addon;
 };
@@ -204,8 +254,7 @@ std::pair<uint32_t,ParserError> Parser::parse_net_record( Hook* hook
         {
             auto hs_err = parse_handshake<Hook>( hook, record_data, record_data_size );
             if( hs_err ) return { 0, hs_err };
-            // TODO: it is possible that handshake size > net_record_data_size
-            // that means, more net records must be read and concatenated
+            // handshake message bigger than record is parsed by parse_handshake_chain()
             break;
         }
         case ContentType::APPLICATION_DATA:
@@ -214,6 +263,26 @@ std::pair<uint32_t,ParserError> Parser::parse_net_record( Hook* hook
     return { sizeof(TlsPlaintext) + record_data_size, {} };
 }
 
+template< typename Hook >
+ParserError Parser::parse_handshake_chain( Hook* hook, HandshakeChain& chain )
+{
+    uint32_t message_size = chain.message_size();
+    if( message_size == 0 || message_size != chain.size() )
+        return ParserError( ParserErrno::W_LOW_DATA_IN_HANDSHAKE );
+
+    const auto* handshake = reinterpret_cast<const Handshake*>(
+            chain.contiguous( 0, sizeof(Handshake) ) );
+    if( handshake->msg_type == HandshakeType::CERTIFICATE )
+    {
+        hook->tls_handshake( handshake );
+        return parse_certificate_chain<Hook>( hook, chain );
+    }
+    // other messages are small, they are parsed from copy
+    if( message_size > UINT16_MAX )
+        return ParserError( ParserErrno::E_HANDSHAKE_TOO_BIG );
+    return parse_handshake<Hook>( hook, chain.contiguous( 0, message_size ), message_size );
+}
+
 template<typename Hook>
 ParserError Parser::parse_alert( Hook* hook, const uint8_t* buffer, uint32_t buffer_size )
 {
@@ -248,7 +317,9 @@ ParserError Parser::parse_handshake( Hook* hook
         case HandshakeType::SERVER_HELLO:
             return parse_server_hello_message<Hook>( hook, handshake_data, handshake_data_size );
         case HandshakeType::NEW_SESSION_TICKET:
+            return parse_new_session_ticket<Hook>( hook, handshake_data, handshake_data_size );
         case HandshakeType::END_OF_EARLY_DATA:
+            return parse_end_of_early_data<Hook>( hook, handshake_data, handshake_data_size );
         case HandshakeType::ENCRYPTED_EXTENSIONS:
             return parse_encrypted_extensions<Hook>( hook
                     ,handshake_data, handshake_data_size, HandshakeType::ENCRYPTED_EXTENSIONS );
@@ -259,6 +330,8 @@ ParserError Parser::parse_handshake( Hook* hook
             return parse_certificate_verify<Hook>( hook, handshake_data, handshake_data_size );
         case HandshakeType::FINISHED:
             return parse_finished<Hook>( hook, handshake_data, handshake_data_size );
+        case HandshakeType::COMPRESSED_CERTIFICATE:
+            return parse_compressed_certificate<Hook>( hook, handshake_data, handshake_data_size );
         case HandshakeType::KEY_UPDATE:
         case HandshakeType::MESSAGE_HASH:
             break;
@@ -465,6 +538,31 @@ ParserError Parser::parse_certificate( Hook* hook
     return parse_certificate_entry<Hook>( hook, certificate_list_data, certificate_list_size );
 }
 
+template<typename Hook>
+ParserError Parser::parse_compressed_certificate( Hook* hook, const uint8_t* buffer, uint16_t buffer_size )
+{
+    /*
+     * struct {
+     *     CertificateCompressionAlgorithm algorithm;
+     *     uint24 uncompressed_length;
+     *     opaque compressed_certificate_message<1..2^24-1>;
+     * } CompressedCertificate;
+     */
+    uint32_t compressed_size = 0;
+    const uint8_t* compressed_data;
+    if( !parse_vec24( buffer, buffer_size, compressed_data, compressed_size, sizeof(CompressedCertificate) )
+        || compressed_size == 0 )
+    {
+        return ParserError(ParserErrno::E_COMPRESSED_CERTIFICATE_NO_SPACE);
+    }
+    auto* compressed_certificate = reinterpret_cast<const CompressedCertificate*>(buffer);
+
+    hook->compressed_certificate( compressed_certificate->algorithm()
+                                  ,compressed_certificate->uncompressed_length.length()
+                                  ,compressed_data, compressed_size );
+
+    return ParserError();
+}
 template<typename Hook>
 ParserError Parser::parse_certificate_verify( Hook* hook, const uint8_t* buffer, uint16_t buffer_size )
 {
@@ -499,6 +597,58 @@ ParserError Parser::parse_finished( Hook* hook, const uint8_t* buffer, uint16_t
 
     return ParserError();
 }
+template<typename Hook>
+ParserError Parser::parse_new_session_ticket( Hook* hook, const uint8_t* buffer, uint16_t buffer_size )
+{
+    /*
+     * struct {
+     *     uint32 ticket_lifetime;
+     *     uint32 ticket_age_add;
+     *     opaque ticket_nonce<0..255>;
+     *     opaque ticket<1..2^16-1>;
+     *     Extension extensions<0..2^16-2>;
+     * } NewSessionTicket;
+     */
+    if( sizeof(NewSessionTicket) > buffer_size )
+        return ParserError( ParserErrno::E_NEW_SESSION_TICKET_NO_SPACE );
+    const auto* new_session_ticket = reinterpret_cast<const NewSessionTicket*>( buffer );
+    uint32_t offset = sizeof(NewSessionTicket);
+
+    uint8_t nonce_size;
+    const uint8_t* nonce;
+    if( !parse_vec8( buffer+offset, buffer_size-offset, nonce, nonce_size ) )
+        return ParserError( ParserErrno::E_NEW_SESSION_TICKET_NO_SPACE );
+    offset += (sizeof(uint8_t)+nonce_size);
+
+    uint16_t ticket_size;
+    const uint8_t* ticket;
+    if( !parse_vec16( buffer+offset, buffer_size-offset, ticket, ticket_size ) || ticket_size == 0 )
+        return ParserError( ParserErrno::E_NEW_SESSION_TICKET_NO_SPACE );
+    offset += (sizeof(uint16_t)+ticket_size);
+
+    uint16_t extensions_data_size;
+    const uint8_t* extensions_data;
+    if( !parse_vec16( buffer+offset, buffer_size-offset, extensions_data, extensions_data_size ) )
+        return ParserError( ParserErrno::E_NEW_SESSION_TICKET_NO_SPACE );
+
+    hook->new_session_ticket( new_session_ticket, nonce, nonce_size, ticket, ticket_size );
+    hook->extensions_list( extensions_data_size );
+
+    return parse_extensions<Hook>( hook, extensions_data, extensions_data_size
+                                   ,HandshakeType::NEW_SESSION_TICKET );
+}
+
+template<typename Hook>
+ParserError Parser::parse_end_of_early_data( Hook* hook, const uint8_t*, uint16_t buffer_size )
+{
+    // struct {} EndOfEarlyData;
+    if( buffer_size != 0 )
+        return ParserError( ParserErrno::E_END_OF_EARLY_DATA_NOT_EMPTY );
+
+    hook->end_of_early_data();
+
+    return {};
+}
 
 
 template<typename Hook>
@@ -546,7 +696,7 @@ ParserError Parser::parse_certificate_entry( Hook* hook
         hook->cert_data( cert_type, cert_data, cert_data_size );
         hook->extensions_list( extensions_data_size );
         auto err = parse_extensions<Hook>( hook, extensions_data, extensions_data_size
-                                           ,HandshakeType::SERVER_HELLO );
+                                           ,HandshakeType::CERTIFICATE );
         if( err )
             return err;
     }
@@ -555,6 +705,52 @@ ParserError Parser::parse_certificate_entry( Hook* hook
 }
 
 
+template<typename Hook>
+ParserError Parser::parse_certificate_chain( Hook* hook, HandshakeChain& chain )
+{
+    // the same as parse_certificate(), but CertificateEntry is parsed separately
+    uint32_t offset = sizeof(Handshake);
+    const uint8_t* context_size = chain.contiguous( offset, sizeof(uint8_t) );
+    if( context_size == nullptr )
+        return ParserError(ParserErrno::E_CERTIFICATE_NO_SPACE_FOR_CERTIFICATE_REQUEST_CONTEXT);
+    const uint8_t* context_data = chain.contiguous( offset + sizeof(uint8_t), *context_size );
+    if( context_data == nullptr )
+        return ParserError(ParserErrno::E_CERTIFICATE_NO_SPACE_FOR_CERTIFICATE_REQUEST_CONTEXT);
+    offset += sizeof(uint8_t) + *context_size;
+
+    const auto* list_size = reinterpret_cast<const NetUint24*>( chain.contiguous( offset, sizeof(NetUint24) ) );
+    if( list_size == nullptr || offset + sizeof(NetUint24) + list_size->length() != chain.size() )
+        return ParserError(ParserErrno::E_CERTIFICATE_NO_SPACE_FOR_CERTIFICATE_LIST);
+    offset += sizeof(NetUint24);
+
+    hook->certificate_request_context( context_data, *context_size );
+    hook->certificate_list( list_size->length() );
+
+    while( offset < chain.size() )
+    {
+        const auto* cert_data_size = reinterpret_cast<const NetUint24*>(
+                chain.contiguous( offset, sizeof(NetUint24) ) );
+        if( cert_data_size == nullptr )
+            return ParserError(ParserErrno::E_CERTIFICATE_NO_SPACE_FOR_CERTIFICATE_ENTRY );
+        uint32_t extensions_offset = offset + sizeof(NetUint24) + cert_data_size->length();
+        const uint8_t* extensions_size = chain.contiguous( extensions_offset, sizeof(uint16_t) );
+        if( extensions_size == nullptr )
+            return ParserError(ParserErrno::E_CERTIFICATE_NO_SPACE_FOR_CERTIFICATE_EXTENSIONS );
+
+        uint32_t entry_size = extensions_offset + sizeof(uint16_t)
+                              + ((extensions_size[0] << 8u) | extensions_size[1]) - offset;
+        const uint8_t* entry = chain.contiguous( offset, entry_size );
+        if( entry == nullptr || entry_size > UINT16_MAX )
+            return ParserError(ParserErrno::E_CERTIFICATE_NO_SPACE_FOR_CERTIFICATE_ENTRY );
+        auto err = parse_certificate_entry<Hook>( hook, entry, entry_size );
+        if( err )
+            return err;
+        offset += entry_size;
+    }
+
+    return ParserError();
+}
+
 template<typename Hook>
 ParserError Parser::parse_extensions( Hook* hook
         ,const uint8_t* buffer, uint16_t buffer_size
@@ -591,8 +787,14 @@ ParserError Parser::parse_extensions( Hook* hook
                 break;
             }
             case ExtensionType::MAX_FRAGMENT_LENGTH:
+                break;
             case ExtensionType::STATUS_REQUEST:
+            {
+                auto err = parse_extension_status_request<Hook>( hook
+                        ,extension_internal_data, extension_data_size, handshake_type );
+                if( err ) return err;
                 break;
+            }
             case ExtensionType::SUPPORTED_GROUPS:
             {
                 auto err = parse_extension_supported_groups<Hook>(
@@ -614,9 +816,28 @@ ParserError Parser::parse_extensions( Hook* hook
             case ExtensionType::CLIENT_CERTIFICATE_TYPE:
             case ExtensionType::SERVER_CERTIFICATE_TYPE:
             case ExtensionType::PADDING:
+                break;
+            case ExtensionType::COMPRESS_CERTIFICATE:
+            {
+                auto err = parse_extension_compress_certificate<Hook>( hook
+                        ,extension_internal_data, extension_data_size );
+                if( err ) return err;
+                break;
+            }
             case ExtensionType::PRE_SHARED_KEY:
+            {
+                auto err = parse_extension_pre_shared_key<Hook>( hook
+                        ,extension_internal_data, extension_data_size, handshake_type );
+                if( err ) return err;
+                break;
+            }
             case ExtensionType::EARLY_DATA:
+            {
+                auto err = parse_extension_early_data<Hook>( hook
+                        ,extension_internal_data, extension_data_size, handshake_type );
+                if( err ) return err;
                 break;
+            }
             case ExtensionType::SUPPORTED_VERSIONS:
             {
                 auto err = parse_extension_supported_versions<Hook>( hook
@@ -625,7 +846,12 @@ ParserError Parser::parse_extensions( Hook* hook
                 break;
             }
             case ExtensionType::COOKIE:
+            {
+                auto err = parse_extension_cookie<Hook>( hook
+                        ,extension_internal_data, extension_data_size );
+                if( err ) return err;
                 break;
+            }
             case ExtensionType::PSK_KEY_EXCHANGE_MODES:
             {
                 auto err = parse_extension_psk_key_exchange_modes<Hook>( hook
@@ -759,6 +985,9 @@ ParserError Parser::parse_extension_key_share( Hook* hook, const uint8_t* buffer
      * struct {
      *     KeyShareEntry server_share;
      * } KeyShareServerHello;
+     * struct {
+     *     NamedGroup selected_group;
+     * } KeyShareHelloRetryRequest;
      */
     const KeyShareEntry* key_share_entry = nullptr;
     uint16_t key_share_entry_size = 0;
@@ -776,6 +1005,13 @@ ParserError Parser::parse_extension_key_share( Hook* hook, const uint8_t* buffer
         }
         case HandshakeType::SERVER_HELLO:
         {
+            // KeyShareEntry is longer than NamedGroup, so selected_group is HelloRetryRequest
+            if( buffer_size == sizeof(NamedGroup) )
+            {
+                hook->key_share_selected_group(
+                        ntoh_named_group( *reinterpret_cast<const NamedGroup*>( buffer ) ) );
+                return ParserError();
+            }
             key_share_entry = reinterpret_cast<const KeyShareEntry*>( buffer );
             key_share_entry_size = buffer_size;
             break;
@@ -885,6 +1121,197 @@ ParserError Parser::parse_extension_psk_key_exchange_modes( Hook* hook
     return ParserError();
 }
 
+template<typename Hook>
+ParserError Parser::parse_extension_pre_shared_key( Hook* hook
+        ,const uint8_t* buffer, uint16_t buffer_size, HandshakeType handshake_type )
+{
+    /*
+     * struct {
+     *     PskIdentity identities<7..2^16-1>;
+     *     PskBinderEntry binders<33..2^16-1>;
+     * } OfferedPsks;
+     * struct {
+     *     select (Handshake.msg_type) {
+     *         case client_hello: OfferedPsks;
+     *         case server_hello: uint16 selected_identity;
+     *     };
+     * } PreSharedKeyExtension;
+     */
+    if( handshake_type != HandshakeType::CLIENT_HELLO )
+    {
+        if( sizeof(uint16_t) > buffer_size )
+            return ParserError( ParserErrno::E_EXTENSION_PRE_SHARED_KEY_NO_SPACE );
+        hook->psk_selected_identity( be16toh( *reinterpret_cast<const uint16_t*>(buffer) ) );
+        return ParserError();
+    }
+
+    uint16_t identities_size;
+    const uint8_t* identities;
+    if( !parse_vec16( buffer, buffer_size, identities, identities_size ) )
+        return ParserError( ParserErrno::E_EXTENSION_PRE_SHARED_KEY_NO_SPACE );
+    const uint8_t* binders_vector = identities + identities_size;
+
+    uint16_t binders_size;
+    const uint8_t* binders;
+    if( !parse_vec16( binders_vector, buffer_size - (binders_vector-buffer), binders, binders_size ) )
+        return ParserError( ParserErrno::E_EXTENSION_PRE_SHARED_KEY_NO_SPACE );
+
+    while( identities_size > 0 )
+    {
+        uint16_t identity_size;
+        const uint8_t* identity;
+        if( !parse_vec16( identities, identities_size, identity, identity_size )
+            || (sizeof(uint16_t) + identity_size + sizeof(uint32_t)) > identities_size )
+        {
+            return ParserError( ParserErrno::E_EXTENSION_PRE_SHARED_KEY_NO_SPACE );
+        }
+        uint32_t obfuscated_ticket_age = be32toh(
+                *reinterpret_cast<const uint32_t*>( identity + identity_size ) );
+        hook->psk_identity( identity, identity_size, obfuscated_ticket_age );
+
+        identities      += (sizeof(uint16_t) + identity_size + sizeof(uint32_t));
+        identities_size -= (sizeof(uint16_t) + identity_size + sizeof(uint32_t));
+    }
+    // ClientHello truncated for binders calculation ends on binders list
+    hook->psk_binders( binders_vector );
+    while( binders_size > 0 )
+    {
+        uint8_t binder_size;
+        const uint8_t* binder;
+        if( !parse_vec8( binders, binders_size, binder, binder_size ) )
+            return ParserError( ParserErrno::E_EXTENSION_PRE_SHARED_KEY_NO_SPACE );
+        hook->psk_binder( binder, binder_size );
+
+        binders      += (sizeof(uint8_t) + binder_size);
+        binders_size -= (sizeof(uint8_t) + binder_size);
+    }
+
+    return ParserError();
+}
+template< typename Hook >
+ParserError Parser::parse_extension_early_data( Hook* hook
+        ,const uint8_t* buffer, uint16_t buffer_size, HandshakeType handshake_type )
+{
+    /*
+     * struct {
+     *     select (Handshake.msg_type) {
+     *         case new_session_ticket:   uint32 max_early_data_size;
+     *         case client_hello:         Empty;
+     *         case encrypted_extensions: Empty;
+     *     };
+     * } EarlyDataIndication;
+     */
+    if( handshake_type == HandshakeType::NEW_SESSION_TICKET )
+    {
+        if( buffer_size != sizeof(EarlyDataIndication) )
+            return ParserError( ParserErrno::E_EXTENSION_EARLY_DATA_WRONG_SIZE );
+        hook->extension_early_data(
+                reinterpret_cast<const EarlyDataIndication*>( buffer )->max_early_data_size() );
+    }
+    else
+    {
+        if( buffer_size != 0 )
+            return ParserError( ParserErrno::E_EXTENSION_EARLY_DATA_WRONG_SIZE );
+        hook->extension_early_data( 0 );
+    }
+
+    return ParserError();
+}
+template< typename Hook >
+ParserError Parser::parse_extension_compress_certificate( Hook* hook
+        ,const uint8_t* buffer, uint16_t buffer_size )
+{
+    /*
+     * CertificateCompressionAlgorithm is 2 bytes enum
+     * struct {
+     *     CertificateCompressionAlgorithm algorithms<2..2^8-2>;
+     * } CertificateCompressionAlgorithms;
+     */
+    const uint8_t* algorithms;
+    uint8_t algorithms_size;
+    if( !parse_vec8( buffer, buffer_size, algorithms, algorithms_size )
+        || algorithms_size < sizeof(uint16_t) || algorithms_size % sizeof(uint16_t) != 0 )
+    {
+        return ParserError( ParserErrno::E_EXTENSION_COMPRESS_CERTIFICATE_NO_SPACE );
+    }
+
+    for( unsigned i = 0; i < algorithms_size/sizeof(uint16_t); ++i )
+    {
+        hook->certificate_compression_algorithm( static_cast<CertificateCompressionAlgorithm>(
+                be16toh( reinterpret_cast<const uint16_t*>( algorithms )[i] ) ) );
+    }
+
+    return ParserError();
+}
+template< typename Hook >
+ParserError Parser::parse_extension_status_request( Hook* hook
+        ,const uint8_t* buffer, uint16_t buffer_size, HandshakeType handshake_type )
+{
+    switch( handshake_type )
+    {
+        case HandshakeType::CLIENT_HELLO:
+        {
+            /*
+             * struct {
+             *     CertificateStatusType status_type;
+             *     select (status_type) {
+             *         case ocsp: OCSPStatusRequest;
+             *     } request;
+             * } CertificateStatusRequest;
+             * responder_id_list and request_extensions are not used
+             */
+            if( buffer_size < sizeof(CertificateStatusType) )
+                return ParserError( ParserErrno::E_EXTENSION_STATUS_REQUEST_NO_SPACE );
+            hook->status_request( static_cast<CertificateStatusType>( buffer[0] ) );
+            break;
+        }
+        case HandshakeType::CERTIFICATE:
+        {
+            /*
+             * struct {
+             *     CertificateStatusType status_type;
+             *     select (status_type) {
+             *         case ocsp: OCSPResponse;
+             *     } response;
+             * } CertificateStatus;
+             * opaque OCSPResponse<1..2^24-1>;
+             */
+            uint32_t response_size;
+            const uint8_t* response;
+            if( !parse_vec24( buffer, buffer_size, response, response_size, sizeof(CertificateStatusType) )
+                || response_size == 0 )
+            {
+                return ParserError( ParserErrno::E_EXTENSION_STATUS_REQUEST_NO_SPACE );
+            }
+            hook->certificate_status( static_cast<CertificateStatusType>( buffer[0] ), response, response_size );
+            break;
+        }
+        default:
+            // empty status_request of TLS 1.2 ServerHello
+            break;
+    }
+
+    return ParserError();
+}
+
+template< typename Hook >
+ParserError Parser::parse_extension_cookie( Hook* hook, const uint8_t* buffer, uint16_t buffer_size )
+{
+    /*
+     * struct {
+     *     opaque cookie<1..2^16-1>;
+     * } Cookie;
+     */
+    const uint8_t* cookie;
+    uint16_t cookie_size;
+    if( !parse_vec16( buffer, buffer_size, cookie, cookie_size ) || cookie_size == 0 )
+        return ParserError( ParserErrno::E_EXTENSION_COOKIE_NO_SPACE );
+
+    hook->cookie( cookie, cookie_size );
+
+    return ParserError();
+}
+
 inline uint32_t full_record_size( const uint8_t* buffer )
 {
     const auto* tls_record = reinterpret_cast<const TLSCiphertext*>( buffer );
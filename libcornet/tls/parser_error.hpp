@@ -17,6 +17,7 @@ enum class ParserErrno : uint32_t
     SUCCESS = 0,
     W_LOW_DATA_IN_NET_RECORD,   // buffer do not have enough data, need to read next record
     W_LOW_DATA_IN_HANDSHAKE,    // Handshake need more records concatenated
+    E_HANDSHAKE_TOO_BIG,        // chained Handshake message (not Certificate) longer than 2^16-1
 
     E_CLIENT_HELLO_NO_SPACE_FOR_VERSION_OR_RANDOM,
     E_CLIENT_HELLO_NO_SPACE_FOR_LEGACY_SESSION_ID,
@@ -31,6 +32,11 @@ enum class ParserErrno : uint32_t
     E_EXTENSION_SIGNATURE_ALGORITHMS_NO_SPACE,
     E_EXTENSION_KEY_SHARE_NO_SPACE,
     E_EXTENSION_KEY_EXCHANGE_MODES_NO_SPACE,
+    E_EXTENSION_PRE_SHARED_KEY_NO_SPACE,
+    E_EXTENSION_EARLY_DATA_WRONG_SIZE,
+    E_EXTENSION_COMPRESS_CERTIFICATE_NO_SPACE,
+    E_EXTENSION_STATUS_REQUEST_NO_SPACE,
+    E_EXTENSION_COOKIE_NO_SPACE,
 
     E_SERVER_HELLO_NO_SPACE_FOR_VERSION_OR_RANDOM,
     E_SERVER_HELLO_NO_SPACE_FOR_LEGACY_SESSION_ID_ECHO,
@@ -43,6 +49,9 @@ enum class ParserErrno : uint32_t
     E_CERTIFICATE_NO_SPACE_FOR_CERTIFICATE_ENTRY,
     E_CERTIFICATE_NO_SPACE_FOR_CERTIFICATE_EXTENSIONS,
     E_CERTIFICATE_NO_SPACE_FOR_CERTIFICATE_VERIFY,
+    E_COMPRESSED_CERTIFICATE_NO_SPACE,
+    E_NEW_SESSION_TICKET_NO_SPACE,
+    E_END_OF_EARLY_DATA_NOT_EMPTY,
 
     E_ALERT_NO_SPACE,
 };
@@ -8,6 +8,7 @@
 #include <libcornet/tls/record_helpers.hpp>
 
 #include <endian.h>
+#include <cstring>
 #include <algorithm>
 #include <string>
 
@@ -15,6 +16,11 @@
 #include <libcornet/tls/record_layer.hpp>
 #include <libcornet/crypto.hpp>
 #include <libcornet/tls/crypto/tls_handshake.hpp>
+#include <libcornet/tls/crypto/cipher_preference.hpp>
+#include <libcornet/tls/crypto/named_group_preference.hpp>
+#include <libcornet/tls/session_ticket.hpp>
+#include <libcornet/tls/key_store.hpp>
+#include <libcornet/tls/certificate_compression.hpp>
 namespace crypto = pioneer19::cornet::crypto;
 
 namespace pioneer19::cornet::tls13
@@ -77,12 +83,12 @@ uint32_t cipher_suites( uint8_t* buffer )
 
     if constexpr( !just_size )
     {
+        // fastest on this cpu cipher suite first
         auto* cipher_suite = reinterpret_cast<record::CipherSuite*>( buffer + record_size );
-        cipher_suite[0] = record::TLS_CHACHA20_POLY1305_SHA256;
-        cipher_suite[1] = record::TLS_AES_128_GCM_SHA256;
-        cipher_suite[2] = record::TLS_AES_256_GCM_SHA384;
+        std::copy_n( crypto::CipherSuitePreference::instance().order()
+                     , crypto::CipherSuitePreference::SUITES_COUNT, cipher_suite );
     }
-    uint32_t data_size = 3*sizeof(record::CipherSuite);
+    uint32_t data_size = crypto::CipherSuitePreference::SUITES_COUNT*sizeof(record::CipherSuite);
     record_size += data_size;
 
     if constexpr( !just_size )
@@ -144,16 +150,14 @@ static uint32_t named_group_list( uint8_t* buffer )
     auto* named_group_list = reinterpret_cast<record::NamedGroupList*>( buffer );
     uint32_t record_size = sizeof( record::NamedGroupList );
 
+    auto groups = crypto::NamedGroupPreference::instance().groups();
     if constexpr( !just_size )
     {
         auto* named_group = reinterpret_cast<record::NamedGroup*>( buffer + record_size );
-        named_group[0] = hton_named_group(record::NamedGroup::X25519);
-        named_group[1] = hton_named_group(record::NamedGroup::SECP256R1);
-        named_group[2] = hton_named_group(record::NamedGroup::X448);
-        named_group[3] = hton_named_group(record::NamedGroup::SECP384R1);
-        named_group[4] = hton_named_group(record::NamedGroup::SECP521R1);
+        for( uint32_t i = 0; i < groups.size(); ++i )
+            named_group[i] = hton_named_group( groups[i] );
     }
-    uint32_t data_size = 5 * sizeof( record::NamedGroup );
+    uint32_t data_size = groups.size() * sizeof( record::NamedGroup );
     record_size += data_size;
 
     if constexpr( !just_size )
@@ -255,8 +259,9 @@ uint32_t psk_key_exchange_modes_extension_data( uint8_t* buffer )
     {
         auto* psk_ke_mode = reinterpret_cast<record::PskKeyExchangeMode*>( buffer + record_size );
         psk_ke_mode[0] = record::PskKeyExchangeMode::PSK_DHE_KE;
+        psk_ke_mode[1] = record::PskKeyExchangeMode::PSK_KE;
     }
-    uint32_t data_size = 1*sizeof( record::PskKeyExchangeMode );
+    uint32_t data_size = 2*sizeof( record::PskKeyExchangeMode );
     record_size += data_size;
 
     if constexpr( !just_size )
@@ -265,6 +270,77 @@ uint32_t psk_key_exchange_modes_extension_data( uint8_t* buffer )
     return record_size;
 }
 
+static uint8_t psk_binder_size( const ClientTicket& ticket )
+{
+    return EVP_MD_size( crypto::TlsHandshake::cipher_suite_digest( ticket.cipher_suite ) );
+}
+
+template< bool just_size >
+static uint32_t offered_psks( const ClientTicket& ticket, uint8_t* buffer )
+{   /*
+     * struct {
+     *     PskIdentity identities<7..2^16-1>;
+     *     PskBinderEntry binders<33..2^16-1>;
+     * } OfferedPsks;
+     */
+    auto* identities = reinterpret_cast<RecordVector16*>( buffer );
+    uint32_t record_size = sizeof( RecordVector16 );
+
+    auto* identity = reinterpret_cast<record::PskIdentity*>( buffer + record_size );
+    uint32_t identity_size = sizeof( record::PskIdentity ) + ticket.ticket.size() + sizeof(uint32_t);
+    if constexpr( !just_size )
+    {
+        identity->finalize( ticket.ticket.size() );
+        std::copy( ticket.ticket.begin(), ticket.ticket.end(), buffer + record_size + sizeof(record::PskIdentity) );
+        uint32_t obfuscated_ticket_age = htobe32(
+                ticket.obfuscated_ticket_age( SessionTicketKeys::now_ms() ) );
+        std::copy_n( reinterpret_cast<const uint8_t*>(&obfuscated_ticket_age), sizeof(uint32_t)
+                     ,buffer + record_size + identity_size - sizeof(uint32_t) );
+        identities->finalize( identity_size );
+    }
+    record_size += identity_size;
+
+    // binder calculated over truncated ClientHello, here only space reserved
+    auto* binders = reinterpret_cast<RecordVector16*>( buffer + record_size );
+    uint8_t binder_size = psk_binder_size( ticket );
+    if constexpr( !just_size )
+    {
+        binders->finalize( sizeof(RecordVector8) + binder_size );
+        auto* binder = reinterpret_cast<RecordVector8*>( buffer + record_size + sizeof(RecordVector16) );
+        binder->finalize( binder_size );
+    }
+    record_size += sizeof(RecordVector16) + sizeof(RecordVector8) + binder_size;
+
+    return record_size;
+}
+
+template< bool just_size >
+uint32_t pre_shared_key_extension_data( crypto::TlsHandshake& tls_handshake, uint8_t* buffer )
+{   /*
+     * struct {
+     *     select (Handshake.msg_type) {
+     *         case client_hello: OfferedPsks;
+     *         case server_hello: uint16 selected_identity;
+     *     };
+     * } PreSharedKeyExtension;
+     */
+    switch( tls_handshake.m_hello_type )
+    {
+        case crypto::TlsHandshake::HelloType::ClientHello:
+            return offered_psks<just_size>( *tls_handshake.psk_ticket, buffer );
+        case crypto::TlsHandshake::HelloType::ServerHello:
+        {
+            // only one psk offered by libcornet client, server selects first identity
+            if constexpr( !just_size )
+                *reinterpret_cast<uint16_t*>( buffer ) = htobe16( 0 );
+            return sizeof(uint16_t);
+        }
+        default:
+            throw std::runtime_error( "pre_shared_key_extension_data() unknown hello type "
+                                      +std::to_string(static_cast<uint8_t>(tls_handshake.m_hello_type)) );
+    }
+}
+
 template< bool just_size >
 static uint32_t signature_scheme_list( uint8_t* buffer )
 {
@@ -300,20 +376,61 @@ static uint32_t signature_scheme_list( uint8_t* buffer )
 }
 
 template< bool just_size >
-uint32_t key_share_entry( crypto::TlsHandshake& record_cryptor
-        , uint8_t* buffer )
+static uint32_t compression_algorithm_list( uint8_t* buffer )
+{   // CertificateCompressionAlgorithm algorithms<2..2^8-2>;
+    auto algorithms = CertificateCompression::algorithms();
+    uint32_t data_size = algorithms.size() * sizeof(uint16_t);
+
+    if constexpr( !just_size )
+    {
+        buffer[0] = static_cast<uint8_t>( data_size );
+        auto* algorithm = reinterpret_cast<uint16_t*>( buffer + sizeof(uint8_t) );
+        for( uint32_t i = 0; i < algorithms.size(); ++i )
+            algorithm[i] = htobe16( static_cast<uint16_t>(algorithms[i]) );
+    }
+
+    return sizeof(uint8_t) + data_size;
+}
+
+template< bool just_size >
+static uint32_t certificate_status_request( uint8_t* buffer )
+{   /*
+     * struct {
+     *     CertificateStatusType status_type;
+     *     select (status_type) {
+     *         case ocsp: OCSPStatusRequest;
+     *     } request;
+     * } CertificateStatusRequest;
+     * struct {
+     *     ResponderID responder_id_list<0..2^16-1>;
+     *     Extensions  request_extensions;
+     * } OCSPStatusRequest;
+     */
+    // any responder, no request extensions
+    constexpr uint32_t data_size = sizeof(record::CertificateStatusType) + 2*sizeof(RecordVector16);
+    if constexpr( !just_size )
+    {
+        buffer[0] = static_cast<uint8_t>( record::CertificateStatusType::OCSP );
+        std::memset( buffer + sizeof(record::CertificateStatusType), 0, 2*sizeof(RecordVector16) );
+    }
+
+    return data_size;
+}
+
+template< bool just_size >
+uint32_t key_share_entry( crypto::DheGroup& dhe_group, uint8_t* buffer )
 {
     auto* entry = reinterpret_cast<record::KeyShareEntry*>( buffer );
     uint32_t record_size = sizeof( record::KeyShareEntry );
 
     if constexpr( !just_size )
-        entry->init( record_cryptor.dhe_group().named_group() );
+        entry->init( dhe_group.named_group() );
 
     size_t data_size = 0;
     if constexpr( just_size )
-        data_size = record_cryptor.dhe_group().public_key_size();
+        data_size = dhe_group.public_key_size();
     else // !just_size
-        data_size = record_cryptor.dhe_group().copy_public_key( buffer+record_size );
+        data_size = dhe_group.copy_public_key( buffer+record_size );
 
     record_size += data_size;
 
@@ -327,8 +444,10 @@ template< bool just_size >
 static uint32_t key_share_entries( crypto::TlsHandshake& record_cryptor
         , uint8_t* buffer )
 {
-    // Here can be many entries for different private keys
-    uint32_t data_size = key_share_entry<just_size>( record_cryptor, buffer );
+    // entry for every key share of client strategy (single after HelloRetryRequest)
+    uint32_t data_size = 0;
+    for( uint32_t i = 0; i < record_cryptor.key_shares_count(); ++i )
+        data_size += key_share_entry<just_size>( record_cryptor.key_share( i ), buffer + data_size );
     return data_size;
 }
 
@@ -360,13 +479,39 @@ uint32_t key_share_extension_data( crypto::TlsHandshake& record_cryptor
         case crypto::TlsHandshake::HelloType::ClientHello:
             return key_share_client_hello<just_size>( record_cryptor, buffer );
         case crypto::TlsHandshake::HelloType::ServerHello:
-            return key_share_entry<just_size>( record_cryptor, buffer );
+            return key_share_entry<just_size>( record_cryptor.dhe_group(), buffer );
+        case crypto::TlsHandshake::HelloType::HelloRetry:
+        {   // KeyShareHelloRetryRequest: NamedGroup selected_group
+            if constexpr( !just_size )
+                *reinterpret_cast<record::NamedGroup*>( buffer ) = hton_named_group( record_cryptor.hello_retry_group );
+            return sizeof(record::NamedGroup);
+        }
         default:
             throw std::runtime_error( "key_share_extension_data() unknown hello type "
                                       +std::to_string(static_cast<uint8_t>(record_cryptor.m_hello_type)) );
     }
 }
 
+template< bool just_size >
+uint32_t cookie_extension_data( const std::vector<uint8_t>& cookie, uint8_t* buffer )
+{   /*
+     * struct {
+     *     opaque cookie<1..2^16-1>;
+     * } Cookie;
+     */
+    auto* cookie_vector = reinterpret_cast<RecordVector16*>( buffer );
+    uint32_t record_size = sizeof( RecordVector16 );
+
+    if constexpr( !just_size )
+    {
+        std::copy_n( cookie.data(), cookie.size(), buffer + record_size );
+        cookie_vector->finalize( cookie.size() );
+    }
+    record_size += cookie.size();
+
+    return record_size;
+}
+
 template< bool just_size >
 uint32_t extension_helper( crypto::TlsHandshake& record_cryptor
         , uint8_t* buffer, record::ExtensionType extension_type )
@@ -384,7 +529,9 @@ uint32_t extension_helper( crypto::TlsHandshake& record_cryptor
                     record_cryptor, buffer + record_size );
             break;
         case record::ExtensionType::MAX_FRAGMENT_LENGTH:
+            break;
         case record::ExtensionType::STATUS_REQUEST:
+            data_size = certificate_status_request<just_size>( buffer + record_size );
             break;
         case record::ExtensionType::SUPPORTED_GROUPS:
             data_size = named_group_list<just_size>( buffer + record_size );
@@ -402,7 +549,13 @@ uint32_t extension_helper( crypto::TlsHandshake& record_cryptor
         case record::ExtensionType::CLIENT_CERTIFICATE_TYPE:
         case record::ExtensionType::SERVER_CERTIFICATE_TYPE:
         case record::ExtensionType::PADDING:
+            break;
+        case record::ExtensionType::COMPRESS_CERTIFICATE:
+            data_size = compression_algorithm_list<just_size>( buffer + record_size );
+            break;
         case record::ExtensionType::PRE_SHARED_KEY:
+            data_size = pre_shared_key_extension_data<just_size>( record_cryptor, buffer + record_size );
+            break;
         case record::ExtensionType::EARLY_DATA:
             break;
         case record::ExtensionType::SUPPORTED_VERSIONS:
@@ -410,6 +563,7 @@ uint32_t extension_helper( crypto::TlsHandshake& record_cryptor
                     record_cryptor, buffer + record_size );
             break;
         case record::ExtensionType::COOKIE:
+            data_size = cookie_extension_data<just_size>( record_cryptor.hello_retry_cookie, buffer + record_size );
             break;
         case record::ExtensionType::PSK_KEY_EXCHANGE_MODES:
             data_size = psk_key_exchange_modes_extension_data<just_size>( buffer + record_size );
@@ -479,6 +633,46 @@ uint32_t extension_psk_kex_modes( crypto::TlsHandshake& record_cryptor
             , buffer, record::ExtensionType::PSK_KEY_EXCHANGE_MODES );
 }
 
+template< bool just_size >
+uint32_t extension_pre_shared_key( crypto::TlsHandshake& record_cryptor
+        , uint8_t* buffer )
+{
+    return extension_helper<just_size>( record_cryptor
+            , buffer, record::ExtensionType::PRE_SHARED_KEY );
+}
+
+template< bool just_size >
+uint32_t extension_early_data( crypto::TlsHandshake& record_cryptor
+        , uint8_t* buffer )
+{
+    return extension_helper<just_size>( record_cryptor
+            , buffer, record::ExtensionType::EARLY_DATA );
+}
+
+template< bool just_size >
+uint32_t extension_compress_certificate( crypto::TlsHandshake& record_cryptor
+        , uint8_t* buffer )
+{
+    return extension_helper<just_size>( record_cryptor
+            , buffer, record::ExtensionType::COMPRESS_CERTIFICATE );
+}
+
+template< bool just_size >
+uint32_t extension_status_request( crypto::TlsHandshake& record_cryptor
+        , uint8_t* buffer )
+{
+    return extension_helper<just_size>( record_cryptor
+            , buffer, record::ExtensionType::STATUS_REQUEST );
+}
+
+template< bool just_size >
+uint32_t extension_cookie( crypto::TlsHandshake& record_cryptor
+        , uint8_t* buffer )
+{
+    return extension_helper<just_size>( record_cryptor
+            , buffer, record::ExtensionType::COOKIE );
+}
+
 template< bool just_size>
 uint32_t extension_key_share( crypto::TlsHandshake& record_cryptor
         , uint8_t* buffer )
@@ -508,6 +702,22 @@ uint32_t client_hello_extensions( crypto::TlsHandshake& record_cryptor
             , buffer + record_size + data_size );
     data_size += extension_key_share<just_size>(record_cryptor
             , buffer + record_size + data_size );
+    // second ClientHello echoes HelloRetryRequest cookie
+    if( !record_cryptor.hello_retry_cookie.empty() )
+        data_size += extension_cookie<just_size>( record_cryptor
+                , buffer + record_size + data_size );
+    data_size += extension_status_request<just_size>( record_cryptor
+            , buffer + record_size + data_size );
+    if( !CertificateCompression::algorithms().empty() )
+        data_size += extension_compress_certificate<just_size>( record_cryptor
+                , buffer + record_size + data_size );
+    if( record_cryptor.early_data_offered )
+        data_size += extension_early_data<just_size>( record_cryptor
+                , buffer + record_size + data_size );
+    // pre_shared_key MUST be the last extension in the ClientHello
+    if( record_cryptor.psk_ticket != nullptr )
+        data_size += extension_pre_shared_key<just_size>( record_cryptor
+                , buffer + record_size + data_size );
 
     record_size += data_size;
 
@@ -551,8 +761,17 @@ uint32_t server_hello_extensions( crypto::TlsHandshake& record_cryptor
     uint32_t data_size = 0;
     data_size += extension_supported_versions_list<just_size>( record_cryptor
                                                               , buffer+record_size+data_size);
-    data_size += extension_key_share<just_size>( record_cryptor
-                                                 , buffer + record_size + data_size );
+    // HelloRetryRequest has selected group in key_share and no psk
+    bool hello_retry = record_cryptor.m_hello_type == crypto::TlsHandshake::HelloType::HelloRetry;
+    if( hello_retry || !record_cryptor.psk_resumed
+        || record_cryptor.psk_mode == record::PskKeyExchangeMode::PSK_DHE_KE )
+    {
+        data_size += extension_key_share<just_size>( record_cryptor
+                                                     , buffer + record_size + data_size );
+    }
+    if( record_cryptor.psk_resumed && !hello_retry )
+        data_size += extension_pre_shared_key<just_size>( record_cryptor
+                                                          , buffer + record_size + data_size );
     record_size += data_size;
 
     if constexpr( !just_size )
@@ -578,7 +797,10 @@ uint32_t server_hello_message( crypto::TlsHandshake& record_cryptor
     if constexpr( !just_size )
     {
         server_hello->init();
-        ::crypto::random_bytes( server_hello->random.data(), server_hello->random.size() );
+        if( record_cryptor.m_hello_type == crypto::TlsHandshake::HelloType::HelloRetry )
+            server_hello->random = record::HELLO_RETRY_REQUEST_RANDOM;
+        else
+            ::crypto::random_bytes( server_hello->random.data(), server_hello->random.size() );
         std::copy_n( record_cryptor.legacy_session
                      ,sizeof(record::LegacySessionId) +
                       reinterpret_cast<record::LegacySessionId*>(record_cryptor.legacy_session)->size
@@ -641,6 +863,26 @@ uint32_t empty_record_vector16( uint8_t* buffer )
     return record_size;
 }
 template< bool just_size >
+uint32_t encrypted_extensions_message( crypto::TlsHandshake& record_cryptor, uint8_t* buffer )
+{   /* struct {
+     *     Extension extensions<0..2^16-1>;
+     * } EncryptedExtensions;
+     */
+    auto* extension_list = reinterpret_cast<RecordVector16*>(buffer);
+    uint32_t record_size = sizeof( RecordVector16 );
+
+    uint32_t data_size = 0;
+    if( record_cryptor.early_data_accepted )
+        data_size += extension_early_data<just_size>( record_cryptor
+                , buffer + record_size + data_size );
+    record_size += data_size;
+
+    if constexpr( !just_size )
+        extension_list->finalize( data_size );
+
+    return record_size;
+}
+template< bool just_size >
 uint32_t empty_record_vector8( uint8_t* buffer )
 {
     auto* record_vector8 = reinterpret_cast<RecordVector8*>(buffer);
@@ -675,7 +917,36 @@ uint32_t cert_data( uint8_t* der_cert, uint32_t cert_size, uint8_t* buffer )
     return record_size;
 }
 template< bool just_size >
-uint32_t certificate_entry( uint8_t* der_cert, uint32_t cert_size, uint8_t* buffer )
+uint32_t certificate_status_extension( const std::vector<uint8_t>& ocsp_response, uint8_t* buffer )
+{   /*
+     * struct {
+     *     CertificateStatusType status_type;
+     *     select (status_type) {
+     *         case ocsp: OCSPResponse;
+     *     } response;
+     * } CertificateStatus;
+     * opaque OCSPResponse<1..2^24-1>;
+     */
+    auto* extension = reinterpret_cast<record::Extension*>( buffer );
+    uint32_t record_size = sizeof( record::Extension );
+    if constexpr( !just_size )
+        extension->init( record::ExtensionType::STATUS_REQUEST );
+
+    uint32_t data_size = sizeof(record::CertificateStatusType);
+    if constexpr( !just_size )
+        buffer[record_size] = static_cast<uint8_t>( record::CertificateStatusType::OCSP );
+    data_size += cert_data<just_size>( const_cast<uint8_t*>( ocsp_response.data() ), ocsp_response.size()
+                                       , buffer + record_size + data_size );
+    record_size += data_size;
+
+    if constexpr( !just_size )
+        extension->finalize( data_size );
+
+    return record_size;
+}
+template< bool just_size >
+uint32_t certificate_entry( uint8_t* der_cert, uint32_t cert_size, uint8_t* buffer
+        , const std::vector<uint8_t>* ocsp_response = nullptr )
 {   /*
      * enum {
      *     X509(0),
@@ -699,21 +970,35 @@ uint32_t certificate_entry( uint8_t* der_cert, uint32_t cert_size, uint8_t* buff
 
     uint32_t data_size = 0;
     data_size += cert_data<just_size>( der_cert, cert_size, buffer+record_size+data_size );
-    data_size += empty_record_vector16<just_size>( buffer + record_size + data_size );
+    if( ocsp_response == nullptr || ocsp_response->empty() )
+    {
+        data_size += empty_record_vector16<just_size>( buffer + record_size + data_size );
+    }
+    else
+    {
+        auto* extensions = reinterpret_cast<RecordVector16*>( buffer + record_size + data_size );
+        uint32_t extensions_size = certificate_status_extension<just_size>(
+                *ocsp_response, buffer + record_size + data_size + sizeof(RecordVector16) );
+        if constexpr( !just_size )
+            extensions->finalize( extensions_size );
+        data_size += sizeof(RecordVector16) + extensions_size;
+    }
     record_size += data_size;
 
     return record_size;
 }
 template< bool just_size >
-uint32_t certificate_chain( crypto::TlsHandshake& record_cryptor, uint8_t* buffer )
+uint32_t certificate_chain( const DomainKeys& domain_keys, uint8_t* buffer )
 {
     // FIXME: currently only single certificate in chain supported
-    auto record_size = certificate_entry<just_size>( record_cryptor.domain_keys->der_cert_chain
-                                         ,record_cryptor.domain_keys->der_chain_size, buffer );
+    if( domain_keys.der_chain_size == 0 )
+        return 0;
+    auto record_size = certificate_entry<just_size>( domain_keys.der_cert_chain
+                                         ,domain_keys.der_chain_size, buffer );
     return record_size;
 }
 template< bool just_size >
-uint32_t certificate_list( crypto::TlsHandshake& record_cryptor, uint8_t* buffer )
+uint32_t certificate_list( const DomainKeys& domain_keys, bool ocsp_staple, uint8_t* buffer )
 {   /*
      * enum {
      *     X509(0),
@@ -740,10 +1025,10 @@ uint32_t certificate_list( crypto::TlsHandshake& record_cryptor, uint8_t* buffer
     uint32_t record_size = sizeof( RecordVector24 );
 
     uint32_t data_size = 0;
-    data_size += certificate_entry<just_size>(
-            record_cryptor.domain_keys->der_domain_cert
-            , record_cryptor.domain_keys->der_cert_size, buffer + record_size + data_size );
-    data_size += certificate_chain<just_size>( record_cryptor, buffer + record_size + data_size );
+    // OCSP response of end-entity certificate only (RFC 8446 4.4.2.1)
+    data_size += certificate_entry<just_size>( domain_keys.der_domain_cert, domain_keys.der_cert_size
+            , buffer + record_size + data_size, ocsp_staple ? &domain_keys.ocsp_response : nullptr );
+    data_size += certificate_chain<just_size>( domain_keys, buffer + record_size + data_size );
     record_size += data_size;
 
     if constexpr( !just_size )
@@ -752,7 +1037,7 @@ uint32_t certificate_list( crypto::TlsHandshake& record_cryptor, uint8_t* buffer
     return record_size;
 }
 template< bool just_size >
-uint32_t certificate_message( crypto::TlsHandshake& record_cryptor, uint8_t* buffer )
+uint32_t certificate_message( const DomainKeys& domain_keys, uint8_t* buffer, bool ocsp_staple = false )
 {   /*
      * enum {
      *     X509(0),
@@ -779,7 +1064,7 @@ uint32_t certificate_message( crypto::TlsHandshake& record_cryptor, uint8_t* buf
     uint32_t data_size = 0;
     // empty certificate_request_context
     data_size += empty_record_vector8<just_size>( buffer+record_size+data_size );
-    data_size += certificate_list<just_size>( record_cryptor, buffer + record_size + data_size );
+    data_size += certificate_list<just_size>( domain_keys, ocsp_staple, buffer + record_size + data_size );
     record_size += data_size;
 
     return record_size;
@@ -849,10 +1134,11 @@ uint32_t handshake_message( crypto::TlsHandshake& tls_handshake
         case record::HandshakeType::END_OF_EARLY_DATA:
             break;
         case record::HandshakeType::ENCRYPTED_EXTENSIONS:
-            data_size = empty_record_vector16<just_size>( buffer + record_size );
+            data_size = encrypted_extensions_message<just_size>( tls_handshake, buffer + record_size );
             break;
         case record::HandshakeType::CERTIFICATE:
-            data_size = certificate_message<just_size>( tls_handshake, buffer + record_size );
+            data_size = certificate_message<just_size>( *tls_handshake.domain_keys, buffer + record_size
+                                                        , tls_handshake.ocsp_status_requested );
             break;
         case record::HandshakeType::CERTIFICATE_REQUEST:
             break;
@@ -863,6 +1149,7 @@ uint32_t handshake_message( crypto::TlsHandshake& tls_handshake
             data_size = finished_message<just_size>( tls_handshake, buffer + record_size, from_server );
             break;
         case record::HandshakeType::KEY_UPDATE:
+        case record::HandshakeType::COMPRESSED_CERTIFICATE:
         case record::HandshakeType::MESSAGE_HASH:
             break;
     }
@@ -900,7 +1187,17 @@ uint32_t RecordHelpers::client_hello_record_buffer_size( crypto::TlsHandshake& r
 
 uint32_t RecordHelpers::create_client_hello_record( crypto::TlsHandshake& record_cryptor, uint8_t* buffer )
 {
-    return client_hello_record<false>( record_cryptor, buffer );
+    uint32_t record_size = client_hello_record<false>( record_cryptor, buffer );
+    if( record_cryptor.psk_ticket != nullptr )
+    {   // binders list is ClientHello tail, truncated ClientHello is handshake message before it
+        uint8_t binder_size = psk_binder_size( *record_cryptor.psk_ticket );
+        uint8_t* binders = buffer + record_size
+                - (sizeof(RecordVector16) + sizeof(RecordVector8) + binder_size);
+        const uint8_t* client_hello = buffer + sizeof(record::TlsPlaintext);
+        record_cryptor.psk_binder( client_hello, binders - client_hello
+                                   ,binders + sizeof(RecordVector16) + sizeof(RecordVector8) );
+    }
+    return record_size;
 }
 template< bool just_size >
 uint32_t handshake_record( record::HandshakeType handshake_type
@@ -949,10 +1246,86 @@ uint32_t RecordHelpers::create_encrypted_extensions_record(
     return handshake_record<false>( record::HandshakeType::ENCRYPTED_EXTENSIONS
                                     , record_cryptor, buffer, true );
 }
+static const std::vector<uint8_t>& prepared_certificate_message( const crypto::TlsHandshake& record_cryptor )
+{
+    const DomainKeys& domain_keys = *record_cryptor.domain_keys;
+    bool stapled = record_cryptor.ocsp_status_requested && !domain_keys.stapled_certificate_message.empty();
+    const auto& certificate_message = stapled
+            ? domain_keys.stapled_certificate_message : domain_keys.certificate_message;
+    const auto& compressed_message = stapled
+            ? domain_keys.stapled_compressed_certificate_message : domain_keys.compressed_certificate_message;
+    // message is not compressed if compression does not make it smaller
+    return record_cryptor.certificate_compression != record::CertificateCompressionAlgorithm::NONE
+           && !compressed_message.empty() ? compressed_message : certificate_message;
+}
+uint32_t RecordHelpers::certificate_record_buffer_size( crypto::TlsHandshake& record_cryptor )
+{
+    const auto& message = prepared_certificate_message( record_cryptor );
+    if( message.empty() )
+        return handshake_record<true>( record::HandshakeType::CERTIFICATE, record_cryptor, nullptr, true );
+
+    return sizeof(record::TlsPlaintext) + message.size();
+}
 uint32_t RecordHelpers::create_certificate_record( crypto::TlsHandshake& record_cryptor, uint8_t* buffer )
 {
-    return handshake_record<false>( record::HandshakeType::CERTIFICATE
-                                    , record_cryptor, buffer, true );
+    const auto& message = prepared_certificate_message( record_cryptor );
+    // KeyStore without prepared messages
+    if( message.empty() )
+        return handshake_record<false>( record::HandshakeType::CERTIFICATE, record_cryptor, buffer, true );
+
+    auto* plaintext_record = reinterpret_cast<record::TlsPlaintext*>( buffer );
+    plaintext_record->init( record::ContentType::HANDSHAKE );
+    std::memcpy( buffer + sizeof(record::TlsPlaintext), message.data(), message.size() );
+    plaintext_record->finalize( message.size() );
+
+    return sizeof(record::TlsPlaintext) + message.size();
+}
+uint32_t RecordHelpers::certificate_message_size( const DomainKeys& domain_keys, bool ocsp_staple )
+{
+    return sizeof(record::Handshake) + certificate_message<true>( domain_keys, nullptr, ocsp_staple );
+}
+uint32_t RecordHelpers::create_certificate_message( const DomainKeys& domain_keys, uint8_t* buffer
+        , bool ocsp_staple )
+{
+    auto* handshake_message = reinterpret_cast<record::Handshake*>( buffer );
+    handshake_message->init( record::HandshakeType::CERTIFICATE );
+    uint32_t data_size = certificate_message<false>( domain_keys, buffer + sizeof(record::Handshake)
+                                                     , ocsp_staple );
+    handshake_message->finalize( data_size );
+
+    return sizeof(record::Handshake) + data_size;
+}
+uint32_t RecordHelpers::compressed_certificate_message_size( uint32_t compressed_size )
+{
+    return sizeof(record::Handshake) + sizeof(record::CompressedCertificate)
+           + sizeof(RecordVector24) + compressed_size;
+}
+uint32_t RecordHelpers::create_compressed_certificate_message( record::CertificateCompressionAlgorithm algorithm
+        , uint32_t uncompressed_size, const uint8_t* compressed_data, uint32_t compressed_size, uint8_t* buffer )
+{   /*
+     * struct {
+     *     CertificateCompressionAlgorithm algorithm;
+     *     uint24 uncompressed_length;
+     *     opaque compressed_certificate_message<1..2^24-1>;
+     * } CompressedCertificate;
+     */
+    auto* handshake_message = reinterpret_cast<record::Handshake*>( buffer );
+    handshake_message->init( record::HandshakeType::COMPRESSED_CERTIFICATE );
+    uint32_t offset = sizeof(record::Handshake);
+
+    auto* compressed_certificate = reinterpret_cast<record::CompressedCertificate*>( buffer + offset );
+    compressed_certificate->set_algorithm( algorithm );
+    compressed_certificate->uncompressed_length = uncompressed_size;
+    offset += sizeof(record::CompressedCertificate);
+
+    reinterpret_cast<RecordVector24*>( buffer + offset )->finalize( compressed_size );
+    offset += sizeof(RecordVector24);
+    std::memcpy( buffer + offset, compressed_data, compressed_size );
+    offset += compressed_size;
+
+    handshake_message->finalize( offset - sizeof(record::Handshake) );
+
+    return offset;
 }
 uint32_t RecordHelpers::create_certificate_verify_record(
         crypto::TlsHandshake& record_cryptor, uint8_t* buffer )
@@ -960,6 +1333,64 @@ uint32_t RecordHelpers::create_certificate_verify_record(
     return handshake_record<false>( record::HandshakeType::CERTIFICATE_VERIFY
                                     , record_cryptor, buffer, true );
 }
+uint32_t RecordHelpers::create_new_session_ticket_record( uint32_t ticket_lifetime, uint32_t ticket_age_add
+        , const uint8_t* nonce, uint8_t nonce_size, const uint8_t* ticket, uint16_t ticket_size
+        , uint32_t max_early_data_size, uint8_t* buffer )
+{   /*
+     * struct {
+     *     uint32 ticket_lifetime;
+     *     uint32 ticket_age_add;
+     *     opaque ticket_nonce<0..255>;
+     *     opaque ticket<1..2^16-1>;
+     *     Extension extensions<0..2^16-2>;
+     * } NewSessionTicket;
+     */
+    auto* plaintext_record = reinterpret_cast<record::TlsPlaintext*>( buffer );
+    plaintext_record->init( record::ContentType::HANDSHAKE );
+    uint32_t record_size = sizeof( record::TlsPlaintext );
+
+    auto* handshake_message = reinterpret_cast<record::Handshake*>( buffer + record_size );
+    handshake_message->init( record::HandshakeType::NEW_SESSION_TICKET );
+    uint32_t message_offset = record_size + sizeof( record::Handshake );
+
+    auto* new_session_ticket = reinterpret_cast<record::NewSessionTicket*>( buffer + message_offset );
+    new_session_ticket->init( ticket_lifetime, ticket_age_add );
+    uint32_t data_size = sizeof( record::NewSessionTicket );
+
+    reinterpret_cast<RecordVector8*>( buffer + message_offset + data_size )->finalize( nonce_size );
+    std::copy_n( nonce, nonce_size, buffer + message_offset + data_size + sizeof(RecordVector8) );
+    data_size += sizeof(RecordVector8) + nonce_size;
+
+    reinterpret_cast<RecordVector16*>( buffer + message_offset + data_size )->finalize( ticket_size );
+    std::copy_n( ticket, ticket_size, buffer + message_offset + data_size + sizeof(RecordVector16) );
+    data_size += sizeof(RecordVector16) + ticket_size;
+
+    auto* extension_list = reinterpret_cast<RecordVector16*>( buffer + message_offset + data_size );
+    data_size += sizeof(RecordVector16);
+    uint16_t extensions_size = 0;
+    if( max_early_data_size > 0 )
+    {
+        auto* extension = reinterpret_cast<record::Extension*>( buffer + message_offset + data_size );
+        extensions_size += extension->init( record::ExtensionType::EARLY_DATA );
+        auto* early_data_indication = reinterpret_cast<record::EarlyDataIndication*>(
+                buffer + message_offset + data_size + extensions_size );
+        early_data_indication->init( max_early_data_size );
+        extension->finalize( sizeof(record::EarlyDataIndication) );
+        extensions_size += sizeof(record::EarlyDataIndication);
+    }
+    extension_list->finalize( extensions_size );
+    data_size += extensions_size;
+
+    handshake_message->finalize( data_size );
+    plaintext_record->finalize( sizeof( record::Handshake ) + data_size );
+
+    return message_offset + data_size;
+}
+uint32_t RecordHelpers::create_end_of_early_data_record( crypto::TlsHandshake& record_cryptor, uint8_t* buffer )
+{
+    return handshake_record<false>( record::HandshakeType::END_OF_EARLY_DATA, record_cryptor, buffer
+                                    , false );
+}
 uint32_t RecordHelpers::create_server_finished_record( crypto::TlsHandshake& record_cryptor, uint8_t* buffer )
 {
     return handshake_record<false>( record::HandshakeType::FINISHED, record_cryptor, buffer
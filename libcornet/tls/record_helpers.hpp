@@ -13,6 +13,7 @@
 
 namespace pioneer19::cornet::tls13
 {
+struct DomainKeys;
 
 /**
  * @brief helpers to create tls network records
@@ -24,11 +25,29 @@ struct RecordHelpers
     static uint32_t client_finished_record_buffer_size( crypto::TlsHandshake& record_cryptor );
     static uint32_t create_client_finished_record( crypto::TlsHandshake& record_cryptor, uint8_t* buffer );
     static uint32_t server_hello_record_buffer_size( crypto::TlsHandshake& );
+    /// HelloRetryRequest if TlsHandshake::m_hello_type is HelloRetry
     static uint32_t create_server_hello_record( crypto::TlsHandshake& record_cryptor, uint8_t* buffer );
     static uint32_t create_encrypted_extensions_record( crypto::TlsHandshake&, uint8_t* buffer );
+    static uint32_t certificate_record_buffer_size( crypto::TlsHandshake& record_cryptor );
+    /// prepared (or compressed if negotiated) Certificate message of DomainKeys
     static uint32_t create_certificate_record( crypto::TlsHandshake&, uint8_t* buffer );
+    static uint32_t certificate_message_size( const DomainKeys& domain_keys, bool ocsp_staple = false );
+    /**
+     * Certificate handshake message (without record header) of domain cert and chain,
+     * ocsp_staple adds status_request extension with OCSP response of domain cert
+     */
+    static uint32_t create_certificate_message( const DomainKeys& domain_keys, uint8_t* buffer
+            , bool ocsp_staple = false );
+    static uint32_t compressed_certificate_message_size( uint32_t compressed_size );
+    static uint32_t create_compressed_certificate_message( record::CertificateCompressionAlgorithm
+            , uint32_t uncompressed_size, const uint8_t* compressed_data, uint32_t compressed_size
+            , uint8_t* buffer );
     static uint32_t create_certificate_verify_record( crypto::TlsHandshake&, uint8_t* buffer );
     static uint32_t create_server_finished_record( crypto::TlsHandshake&, uint8_t* buffer );
+    static uint32_t create_new_session_ticket_record( uint32_t ticket_lifetime, uint32_t ticket_age_add
+            , const uint8_t* nonce, uint8_t nonce_size, const uint8_t* ticket, uint16_t ticket_size
+            , uint32_t max_early_data_size, uint8_t* buffer );
+    static uint32_t create_end_of_early_data_record( crypto::TlsHandshake&, uint8_t* buffer );
 };
 
 }
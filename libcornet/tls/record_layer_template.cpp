@@ -7,45 +7,55 @@
 
 #include <libcornet/tls/record_layer_template.hpp>
 
+#include <chrono>
 #include <utility>
+#include <optional>
+#include <span>
 #include <iterator>
 #include <algorithm>
 #include <stdexcept>
+#include <system_error>
 
 #include <libcornet/tls/tls_acceptor_template.hpp>
 #include <libcornet/tls/tls_connector_template.hpp>
 #include <libcornet/tls/crypto/record_cryptor.hpp>
 #include <libcornet/tls/crypto/tls_handshake.hpp>
+#include <libcornet/tls/crypto/named_group_preference.hpp>
+#include <libcornet/tls/crypto/crypto_workers.hpp>
 #include <libcornet/tls/tls_socket.hpp>
 #include <libcornet/tls/parser.hpp>
 #include <libcornet/tls/tls_read_buffer.hpp>
+#include <libcornet/tls/record_scan.hpp>
 #include <libcornet/tls/crypto/hkdf.hpp>
 #include <libcornet/tls/types.hpp>
+#include <libcornet/tls/ktls.hpp>
+#include <libcornet/tls/session_ticket.hpp>
 
 #include <libcornet/cache_allocator.hpp>
+#include <libcornet/metrics.hpp>
+#include <libcornet/trace.hpp>
+#include <pioneer19_utils/guards.hpp>
 
 namespace pioneer19::cornet::tls13
 {
 
-static bool is_full_record_in_buffer( const uint8_t* buffer, uint32_t buffer_size )
-{
-    if( sizeof(record::TLSCiphertext) > buffer_size )
-        return false;
-    const auto* tls_record = reinterpret_cast<const record::TLSCiphertext*>( buffer );
-    return buffer_size >= ( tls_record->length() + sizeof(record::TLSCiphertext) );
-}
-
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
 uint16_t RecordLayerImpl<OS_SEAM,LOG_LEVEL>::decrypt_record( uint8_t* buffer, crypto::RecordCryptor& cryptor )
 {
     auto bytes_decrypted = cryptor.decrypt_record(
             buffer, buffer + sizeof( record::TLSCiphertext ) );
 
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        printf( "RecordLayer::tls_connect decrypted %u bytes\n", bytes_decrypted );
-
     if( bytes_decrypted == 0 )
-        std::runtime_error( "RecordLayer::tls_connect failed decrypt record" );
+        throw std::runtime_error( "RecordLayer::tls_connect failed decrypt record" );
+    unpad_inner_plaintext( buffer, bytes_decrypted );
+    TraceRing::instance().add_net_record( TraceEvent::RECORD_DECRYPTED, m_socket.connection_id(), buffer );
+
+    return bytes_decrypted;
+}
+
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+void RecordLayerImpl<OS_SEAM,LOG_LEVEL>::unpad_inner_plaintext( uint8_t* buffer, uint32_t bytes_decrypted )
+{
     /*
          * struct {
          *     opaque content[TLSPlaintext.length];
@@ -56,40 +66,43 @@ uint16_t RecordLayerImpl<OS_SEAM,LOG_LEVEL>::decrypt_record( uint8_t* buffer, cr
     // decrypted data will contain TLSInnerPlaintext, so I need skip zeroes on tail
     // and found record ContentType, then calculate length
     auto* tls_record = reinterpret_cast<record::TlsPlaintext*>( buffer );
-    auto it = std::find_if(
-            std::reverse_iterator( buffer + sizeof( record::TlsPlaintext ) + bytes_decrypted )
-            , std::reverse_iterator( buffer + sizeof( record::TlsPlaintext ))
-            , []( uint8_t value ){ return value != 0; } );
-    tls_record->init( static_cast<record::ContentType>(*it));
-    tls_record->finalize( std::reverse_iterator( buffer + sizeof( record::TlsPlaintext ))
-                          - it - sizeof( record::ContentType ));
-
-    return bytes_decrypted;
+    uint8_t* inner_plaintext = buffer + sizeof( record::TlsPlaintext );
+    uint32_t inner_size = record::trim_zero_tail( inner_plaintext, bytes_decrypted );
+    if( inner_size == 0 )
+        throw std::runtime_error( "RecordLayer::unpad_inner_plaintext() record without content type" );
+    tls_record->init( static_cast<record::ContentType>( inner_plaintext[inner_size - 1] ));
+    tls_record->finalize( inner_size - sizeof( record::ContentType ));
 }
 
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
 CoroutineAwaiter<void> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::read_full_record()
 {
-    if( !is_full_record_in_buffer( m_read_buffer.head(), m_read_buffer.size() ) )
+    // record at head is new (previous one consumed), received bytes are parsed once
+    m_record_parser.reset();
+    m_record_parser.feed( m_read_buffer.head(), m_read_buffer.size() );
+    if( m_record_parser.record_ready() )
+        co_return;
+
+    m_read_buffer.compact();
+    while( true )
     {
-        m_read_buffer.compact();
-        while( true )
+        if( m_record_parser.overflow() )
+            throw std::runtime_error( "RecordLayer::read_full_record() record is too long" );
+        if( m_record_parser.bytes_needed() > m_read_buffer.tail_size() )
+            throw std::runtime_error( "RecordLayer::read_full_record() record do not fit in buffer" );
+
+        auto read_bytes = co_await m_socket.async_read(
+                m_read_buffer.tail(), m_read_buffer.tail_size() );
+        if( read_bytes <= 0 )
+            throw std::runtime_error( "RecordLayer::read_full_record() failed async_read" );
+        m_record_parser.feed( m_read_buffer.tail(), read_bytes );
+        m_read_buffer.produce( read_bytes );
+
+        if( m_record_parser.record_ready() )
         {
-            auto read_bytes = co_await m_socket.async_read(
-                    m_read_buffer.tail(), m_read_buffer.tail_size() );
-            if( read_bytes == 0 )
-                throw std::runtime_error( "RecordLayer::read_full_record() failed async_read" );
-            m_read_buffer.produce( read_bytes );
-
-            if( is_full_record_in_buffer( m_read_buffer.head(), m_read_buffer.size() ) )
-                break;
-            else
-            {
-                if( m_read_buffer.tail_size() > 0 )
-                    continue;
-                else
-                    throw std::runtime_error( "RecordLayer::read_full_record() record do not fit in buffer" );
-            }
+            TraceRing::instance().add_net_record(
+                    TraceEvent::RECORD_RECEIVED, m_socket.connection_id(), m_read_buffer.head(), read_bytes );
+            break;
         }
     }
 }
@@ -116,6 +129,18 @@ CoroutineAwaiter<uint32_t> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::async_read(
         void* user_buffer, uint32_t buffer_size, uint32_t min_threshold )
 {
     uint32_t bytes_copied = 0;
+    // 0-RTT data is returned before data received after handshake,
+    // nothing is conserved until early data is fully read
+    if( !m_early_data.empty() )
+    {
+        bytes_copied = std::min<uint32_t>( buffer_size, m_early_data.size() - m_early_data_offset );
+        std::copy_n( m_early_data.data() + m_early_data_offset, bytes_copied, (uint8_t*)user_buffer );
+        m_early_data_offset += bytes_copied;
+        if( m_early_data_offset < m_early_data.size() )
+            co_return bytes_copied;
+        m_early_data_offset = 0;
+        std::vector<uint8_t>{}.swap( m_early_data );
+    }
     // conserved data will contain previously decrypted but not fully read data
     if( m_read_buffer.conserved_size() > 0 )
     {
@@ -132,50 +157,180 @@ CoroutineAwaiter<uint32_t> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::async_read(
         }
     }
 
-    while( bytes_copied < min_threshold )
+    if( m_ktls_rx ) // kernel decrypts records, read buffer was empty when rx offloaded
+        co_return co_await ktls_read( (uint8_t*)user_buffer, buffer_size, min_threshold, bytes_copied );
+
+    while( bytes_copied < min_threshold && !m_close_notify_received )
     {
+        // all complete records received by last read are decrypted in one pass
+        if( decrypt_buffered_records( (uint8_t*)user_buffer, buffer_size, bytes_copied ) )
+            continue;
+
         auto full_record_size = co_await read_and_decrypt_record();
-        if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-            printf( "RecordLayer::async_read() read_and_decrypt_record() returns %u bytes\n", full_record_size );
+        bytes_copied = process_plaintext_record( (uint8_t*)user_buffer, buffer_size, bytes_copied, full_record_size );
+    }
+
+    co_return bytes_copied;
+}
 
-        switch( record::record_content_type( m_read_buffer.head() ) )
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+CoroutineAwaiter<uint32_t> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::ktls_read(
+        uint8_t* user_buffer, uint32_t buffer_size, uint32_t min_threshold, uint32_t bytes_copied )
+{
+    while( bytes_copied < min_threshold && !m_close_notify_received )
+    {
+        // not application_data record is returned by one read, it surely fits in user
+        // buffer with place for max plaintext, otherwise data is read to read buffer
+        uint32_t user_space = buffer_size - bytes_copied;
+        bool to_user_buffer = user_space >= MAX_PLAINTEXT_SIZE;
+        m_read_buffer.compact();
+        uint8_t* record_content = m_read_buffer.tail() + sizeof(record::TlsPlaintext);
+        uint32_t record_space = m_read_buffer.tail_size() - sizeof(record::TlsPlaintext);
+        KtlsReadMessage read_message{ to_user_buffer ? user_buffer + bytes_copied : record_content
+                                      , to_user_buffer ? user_space : record_space };
+
+        auto bytes_read = co_await m_socket.async_recvmsg( &read_message.message );
+        if( bytes_read < 0 )
+            throw std::system_error( -bytes_read, std::system_category()
+                                     , "RecordLayer::ktls_read() kTLS read failed" );
+        if( bytes_read == 0 )
+            break;
+
+        record::ContentType record_type = read_message.record_type();
+        if( to_user_buffer && record_type == record::ContentType::APPLICATION_DATA )
         {
-            case record::ContentType::CHANGE_CIPHER_SPEC:
-                // this must send some Alert
-            case record::ContentType::HANDSHAKE:
-                // this must process psk tickets
-                m_read_buffer.consume( full_record_size );
-                break;
-            case record::ContentType::APPLICATION_DATA:
+            bytes_copied += bytes_read;
+            continue;
+        }
+        // decrypted content as plaintext record at read buffer head, processed as in user space
+        if( to_user_buffer )
+            std::copy_n( user_buffer + bytes_copied, bytes_read, record_content );
+        auto* plaintext_record = reinterpret_cast<record::TlsPlaintext*>( m_read_buffer.tail() );
+        plaintext_record->init( record_type );
+        plaintext_record->finalize( bytes_read );
+        uint32_t record_size = sizeof(record::TlsPlaintext) + bytes_read;
+        m_read_buffer.produce( record_size );
+        bytes_copied = process_plaintext_record( user_buffer, buffer_size, bytes_copied, record_size );
+    }
+
+    co_return bytes_copied;
+}
+
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+uint32_t RecordLayerImpl<OS_SEAM,LOG_LEVEL>::process_plaintext_record(
+        uint8_t* user_buffer, uint32_t buffer_size, uint32_t bytes_copied, uint32_t full_record_size )
+{
+    switch( record::record_content_type( m_read_buffer.head() ) )
+    {
+        case record::ContentType::CHANGE_CIPHER_SPEC:
+            // this must send some Alert
+        case record::ContentType::HANDSHAKE:
+        {   // post handshake messages, only NewSessionTicket is processed now
+            if( !m_server_name.empty() )
             {
-                uint32_t content_size = record::record_content_size( m_read_buffer.head() );
-                if( content_size > (buffer_size-bytes_copied) )
-                {
-                    std::copy_n( m_read_buffer.head() + sizeof(record::TlsPlaintext)
-                                 , (buffer_size-bytes_copied)
-                                 , (uint8_t*)user_buffer+bytes_copied );
-                    m_read_buffer.conserve_head( sizeof(record::TlsPlaintext) + (buffer_size-bytes_copied)
-                                            ,content_size - (buffer_size-bytes_copied)
-                                            ,full_record_size
-                                            -(sizeof(record::TlsPlaintext)+content_size) );
-                    bytes_copied = buffer_size;
-                } else {
-                    std::copy_n( m_read_buffer.head() + sizeof(record::TlsPlaintext)
-                                 , content_size
-                                 , (uint8_t*)user_buffer+bytes_copied );
-                    bytes_copied += content_size;
-                    m_read_buffer.consume( full_record_size );
-                }
-                break;
+                record::Parser parser;
+                TlsConnectorImpl<OS_SEAM>::process_new_session_ticket_record( *this, parser );
             }
-            default:
-                throw std::runtime_error( "RecordLayer::async_read unexpected record content type "
-                                          + std::to_string( static_cast<uint8_t>(
-                                                  record::record_content_type( m_read_buffer.head()))));
+            m_read_buffer.consume( full_record_size );
+            break;
+        }
+        case record::ContentType::APPLICATION_DATA:
+        {
+            uint32_t content_size = record::record_content_size( m_read_buffer.head() );
+            if( content_size > (buffer_size-bytes_copied) )
+            {
+                std::copy_n( m_read_buffer.head() + sizeof(record::TlsPlaintext)
+                             , (buffer_size-bytes_copied)
+                             , user_buffer+bytes_copied );
+                m_read_buffer.conserve_head( sizeof(record::TlsPlaintext) + (buffer_size-bytes_copied)
+                                        ,content_size - (buffer_size-bytes_copied)
+                                        ,full_record_size
+                                        -(sizeof(record::TlsPlaintext)+content_size) );
+                bytes_copied = buffer_size;
+            } else {
+                std::copy_n( m_read_buffer.head() + sizeof(record::TlsPlaintext)
+                             , content_size
+                             , user_buffer+bytes_copied );
+                bytes_copied += content_size;
+                m_read_buffer.consume( full_record_size );
+            }
+            break;
+        }
+        case record::ContentType::ALERT:
+        {
+            if( record::record_content_size( m_read_buffer.head() ) != sizeof(record::Alert) )
+                throw std::runtime_error( "RecordLayer::async_read got malformed alert record" );
+            const auto* alert = reinterpret_cast<const record::Alert*>(
+                    m_read_buffer.head() + sizeof(record::TlsPlaintext) );
+            // user_canceled is followed by close_notify, all other alerts are fatal in TLS 1.3
+            if( alert->description == record::AlertDescription::CLOSE_NOTIFY )
+                m_close_notify_received = true;
+            else if( alert->description != record::AlertDescription::USER_CANCELED )
+                throw std::runtime_error( "RecordLayer::async_read got alert "
+                                          + std::to_string( static_cast<uint8_t>(alert->description) ) );
+            m_read_buffer.consume( full_record_size );
+            break;
         }
+        default:
+            throw std::runtime_error( "RecordLayer::async_read unexpected record content type "
+                                      + std::to_string( static_cast<uint8_t>(
+                                              record::record_content_type( m_read_buffer.head()))));
     }
 
-    co_return bytes_copied;
+    return bytes_copied;
+}
+
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+bool RecordLayerImpl<OS_SEAM,LOG_LEVEL>::decrypt_buffered_records(
+        uint8_t* user_buffer, uint32_t buffer_size, uint32_t& bytes_copied )
+{
+    uint32_t record_sizes[crypto::RecordCryptor::MAX_BATCH_RECORDS];
+    uint32_t records_count = record::scan_complete_records(
+            m_read_buffer.head(), m_read_buffer.size(), record_sizes );
+
+    // batch takes encrypted records which surely fit in user buffer (content
+    // is shorter than ciphertext without tag), so nothing is conserved
+    uint32_t batch_size = 0;
+    uint32_t batch_content_size = 0;
+    const uint8_t* record = m_read_buffer.head();
+    for( ; batch_size < records_count; ++batch_size )
+    {
+        if( record::record_content_type( record ) != record::ContentType::APPLICATION_DATA )
+            break;
+        uint32_t encrypted_data_size = record_sizes[batch_size] - sizeof(record::TLSCiphertext);
+        if( encrypted_data_size <= crypto::TlsCipherSuite::tag_size() )
+            break;
+        batch_content_size += encrypted_data_size - crypto::TlsCipherSuite::tag_size() - sizeof(record::ContentType);
+        if( batch_content_size > buffer_size - bytes_copied )
+            break;
+        record += record_sizes[batch_size];
+    }
+    if( batch_size == 0 )
+        return false;
+
+    uint32_t decrypted_sizes[crypto::RecordCryptor::MAX_BATCH_RECORDS];
+    uint32_t decrypted_count = m_cryptor.decrypt_records( m_read_buffer.head()
+            , std::span( record_sizes, batch_size ), decrypted_sizes );
+    if( decrypted_count != batch_size )
+        throw std::runtime_error( "RecordLayer::decrypt_buffered_records() failed decrypt record" );
+
+    // each processed record is consumed, next one is at read buffer head. Inner content
+    // type is known after decryption only, so records after close_notify are decrypted
+    // too, they are dropped (data after closure alert MUST be ignored, RFC 8446 6.1)
+    for( uint32_t i = 0; i < batch_size; ++i )
+    {
+        if( m_close_notify_received )
+        {
+            m_read_buffer.consume( record_sizes[i] );
+            continue;
+        }
+        unpad_inner_plaintext( m_read_buffer.head(), decrypted_sizes[i] );
+        TraceRing::instance().add_net_record(
+                TraceEvent::RECORD_DECRYPTED, m_socket.connection_id(), m_read_buffer.head() );
+        bytes_copied = process_plaintext_record( user_buffer, buffer_size, bytes_copied, record_sizes[i] );
+    }
+
+    return true;
 }
 
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
@@ -183,23 +338,10 @@ CoroutineAwaiter <uint32_t> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::read_and_decrypt
 {
     co_await read_full_record();
 
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        record::print_net_record( m_read_buffer.head(), m_read_buffer.size() );
-
     auto encrypted_record_size = record::full_record_size( m_read_buffer.head() );
-
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        printf( "read_and_decrypt_record full record size %u\n", encrypted_record_size );
     // FIXME: record MUST be encrypted
     if( record::record_content_type( m_read_buffer.head() ) == record::ContentType::APPLICATION_DATA )
-    {
         decrypt_record( m_read_buffer.head(), m_cryptor );
-        if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        {
-            printf( "decrypted record\n" );
-            record::print_net_record( m_read_buffer.head(), m_read_buffer.size());
-        }
-    }
 
     co_return encrypted_record_size;
 }
@@ -212,15 +354,7 @@ CoroutineAwaiter<uint32_t> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::read_record_decry
     {
         co_await read_full_record_skip_change_cipher_spec();
 
-        if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-            record::print_net_record( m_read_buffer.head(), m_read_buffer.size());
         encrypted_record_size = record::full_record_size( m_read_buffer.head());
-
-        if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        {
-            printf( "read_record_decrypt_and_skip_change_cipher() enc. record size %u\n"
-                    , encrypted_record_size );
-        }
         if( record::record_content_type( m_read_buffer.head() ) != record::ContentType::APPLICATION_DATA )
         {
             throw std::runtime_error(
@@ -230,11 +364,6 @@ CoroutineAwaiter<uint32_t> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::read_record_decry
         }
 
         decrypt_record( m_read_buffer.head(), m_cryptor );
-        if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        {
-            printf( "decrypted record\n" );
-            record::print_net_record( m_read_buffer.head(), m_read_buffer.size() );
-        }
 
         if( record::record_content_type( m_read_buffer.head()) == record::ContentType::CHANGE_CIPHER_SPEC )
             m_read_buffer.consume( encrypted_record_size );
@@ -245,6 +374,93 @@ CoroutineAwaiter<uint32_t> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::read_record_decry
     co_return encrypted_record_size;
 }
 
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+CoroutineAwaiter<uint32_t> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::read_handshake_message()
+{
+    m_handshake_chain.clear();
+    uint32_t content_size = m_handshake_rest_size;
+    if( m_handshake_rest_size > 0 )
+    {   // previous message consumed, its last bytes become header of rest messages
+        auto* tls_record = reinterpret_cast<record::TlsPlaintext*>( m_read_buffer.head() );
+        tls_record->init( record::ContentType::HANDSHAKE );
+        tls_record->finalize( m_handshake_rest_size );
+    }
+    else
+    {
+        uint32_t encrypted_record_size = co_await read_record_decrypt_and_skip_change_cipher();
+        if( !record::is_handshake_record( m_read_buffer.head() ) )
+            co_return encrypted_record_size;
+        content_size = record::record_content_size( m_read_buffer.head() );
+        m_handshake_record_tail = encrypted_record_size - sizeof(record::TlsPlaintext) - content_size;
+    }
+
+    const auto* handshake = reinterpret_cast<const record::Handshake*>(
+            record::handshake_message( m_read_buffer.head() ) );
+    if( content_size < sizeof(record::Handshake)
+        || sizeof(record::Handshake) + handshake->host_length() > content_size )
+    {
+        co_return co_await read_handshake_message_chain( content_size );
+    }
+    uint32_t message_size = sizeof(record::Handshake) + handshake->host_length();
+
+    m_handshake_rest_size = content_size - message_size;
+    if( m_handshake_rest_size == 0 )
+        co_return sizeof(record::TlsPlaintext) + content_size + m_handshake_record_tail;
+
+    reinterpret_cast<record::TlsPlaintext*>( m_read_buffer.head() )->finalize( message_size );
+    co_return message_size;
+}
+
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+CoroutineAwaiter<uint32_t> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::read_handshake_message_chain( uint32_t fragment_size )
+{
+    while( true )
+    {
+        // fragment stays in its buffer, next records data is moved to new read buffer
+        uint32_t record_size = sizeof(record::TlsPlaintext) + fragment_size + m_handshake_record_tail;
+        TlsReadBuffer fragment_buffer;
+        std::copy_n( m_read_buffer.head() + record_size, m_read_buffer.size() - record_size
+                     , fragment_buffer.tail() );
+        fragment_buffer.produce( m_read_buffer.size() - record_size );
+        std::swap( m_read_buffer, fragment_buffer );
+        const uint8_t* fragment = record::record_content_data( fragment_buffer.head() );
+        m_handshake_chain.append( std::move(fragment_buffer), fragment, fragment_size );
+
+        uint32_t encrypted_record_size = co_await read_record_decrypt_and_skip_change_cipher();
+        // handshake message MUST NOT be interleaved with other record types
+        if( !record::is_handshake_record( m_read_buffer.head() ) )
+            throw std::runtime_error( "RecordLayer::read_handshake_message() handshake message"
+                                      " interleaved with other record type" );
+        fragment_size = record::record_content_size( m_read_buffer.head() );
+        m_handshake_record_tail = encrypted_record_size - sizeof(record::TlsPlaintext) - fragment_size;
+        fragment = record::record_content_data( m_read_buffer.head() );
+
+        uint32_t chained_size = m_handshake_chain.size();
+        uint32_t message_size = m_handshake_chain.message_size();
+        if( message_size == 0 )
+        {   // Handshake header is split between records too
+            if( chained_size + fragment_size < sizeof(record::Handshake) )
+                continue;
+            record::Handshake header;
+            auto* header_data = reinterpret_cast<uint8_t*>( &header );
+            m_handshake_chain.copy( 0, header_data, chained_size );
+            std::copy_n( fragment, sizeof(header) - chained_size, header_data + chained_size );
+            message_size = sizeof(header) + header.host_length();
+        }
+        if( chained_size + fragment_size < message_size )
+            continue;
+
+        // last fragment is not moved, chain is parsed before read buffer is consumed
+        uint32_t last_fragment_size = message_size - chained_size;
+        m_handshake_chain.append( fragment, last_fragment_size );
+        m_handshake_rest_size = fragment_size - last_fragment_size;
+        if( m_handshake_rest_size == 0 )
+            co_return encrypted_record_size;
+
+        co_return last_fragment_size;
+    }
+}
+
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
 CoroutineAwaiter <uint32_t> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::async_write_buffer()
 {
@@ -258,6 +474,7 @@ CoroutineAwaiter <uint32_t> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::async_write_buff
         else
             break;
     }
+    TraceRing::instance().add( TraceEvent::BYTES_SENT, m_socket.connection_id(), bytes_sent, m_write_buffer.size() );
     m_write_buffer.consume( bytes_sent );
 
     co_return bytes_sent;
@@ -267,13 +484,14 @@ CoroutineAwaiter<uint32_t> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::encrypt_and_send_
         const void* buffer, uint32_t chunk_size )
 {
     uint8_t* record = m_write_buffer.tail();
+    // inner content type and handshake type are not visible after encryption
+    auto content_type = static_cast<uint8_t>( record::record_content_type( record ) );
+    uint8_t handshake_type = ( content_type == static_cast<uint8_t>(record::ContentType::HANDSHAKE)
+                               && chunk_size > 0 ) ? *(const uint8_t*)buffer : 0;
 
     auto rec_size = m_cryptor.encrypt_record( record, (const uint8_t*)buffer, chunk_size );
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-    {
-        printf( "encrypted record size %u\n", rec_size );
-        record::print_net_record( record, rec_size );
-    }
+    TraceRing::instance().add( TraceEvent::RECORD_ENCRYPTED, m_socket.connection_id(), chunk_size, rec_size
+                               , content_type, handshake_type );
     m_write_buffer.produce( rec_size );
 
     auto bytes_sent = co_await async_write_buffer();
@@ -293,16 +511,32 @@ CoroutineAwaiter<void> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::encrypt_and_send_appl
     tls_plaintext_record->init( record::ContentType::APPLICATION_DATA );
     tls_plaintext_record->finalize( chunk_size );
 
-    auto rec_size = co_await encrypt_and_send_record( buffer, chunk_size );
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        printf( "RecordLayer::async_write wrote %u bytes\n", rec_size );
+    co_await encrypt_and_send_record( buffer, chunk_size );
 }
 
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
 CoroutineAwaiter<void> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::async_write(
         const void* buffer, uint32_t buffer_size )
 {
+    if( m_close_notify_sent )
+        throw std::runtime_error( "RecordLayer::async_write() after close_notify" );
+    m_write_in_progress = true;
+    auto write_guard = make_scope_guard( [this](){ m_write_in_progress = false; } );
+
     uint32_t total_sent = 0;
+    if( m_ktls_tx )
+    {   // kernel splits data to records and encrypts them
+        while( total_sent < buffer_size )
+        {
+            auto bytes_sent = co_await m_socket.async_write(
+                    (const uint8_t*)buffer + total_sent, buffer_size - total_sent );
+            if( bytes_sent <= 0 )
+                throw std::runtime_error( "RecordLayer::async_write() kTLS write failed" );
+            total_sent += bytes_sent;
+        }
+        co_return;
+    }
+
     while( total_sent < buffer_size )
     {
         // tls plaintext payload limit is 2^14 = 16K
@@ -313,19 +547,167 @@ CoroutineAwaiter<void> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::async_write(
     }
 }
 
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+uint32_t RecordLayerImpl<OS_SEAM,LOG_LEVEL>::produce_close_notify_record()
+{
+    const record::Alert close_notify{ record::AlertLevel::WARNING, record::AlertDescription::CLOSE_NOTIFY };
+
+    m_write_buffer.compact();
+    uint8_t* record = m_write_buffer.tail();
+    auto* tls_plaintext_record = reinterpret_cast<record::TlsPlaintext*>( record );
+    tls_plaintext_record->init( record::ContentType::ALERT );
+    tls_plaintext_record->finalize( sizeof(close_notify) );
+
+    auto rec_size = m_cryptor.encrypt_record(
+            record, reinterpret_cast<const uint8_t*>(&close_notify), sizeof(close_notify) );
+    TraceRing::instance().add( TraceEvent::RECORD_ENCRYPTED, m_socket.connection_id(), sizeof(close_notify)
+                               , rec_size, static_cast<uint8_t>(record::ContentType::ALERT) );
+    m_write_buffer.produce( rec_size );
+
+    return rec_size;
+}
+
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+CoroutineAwaiter<void> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::async_close_notify()
+{
+    if( m_close_notify_sent )
+        co_return;
+    assert( !m_write_in_progress );
+    m_close_notify_sent = true;
+    m_write_in_progress = true;
+    auto write_guard = make_scope_guard( [this](){ m_write_in_progress = false; } );
+
+    if( m_ktls_tx )
+    {   // if alert not sent, peer will get just tcp FIN
+        ktls_send_alert( m_socket.native_handle()
+                , record::Alert{ record::AlertLevel::WARNING, record::AlertDescription::CLOSE_NOTIFY } );
+    }
+    else
+    {
+        produce_close_notify_record();
+        co_await async_write_buffer();
+    }
+    m_socket.shutdown( SHUT_WR );
+}
+
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+bool RecordLayerImpl<OS_SEAM,LOG_LEVEL>::try_close_notify() noexcept
+{
+    if( m_close_notify_sent || m_write_in_progress )
+        return false;
+    m_close_notify_sent = true;
+
+    bool alert_sent = false;
+    try
+    {
+        if( m_ktls_tx )
+        {
+            alert_sent = ktls_send_alert( m_socket.native_handle()
+                    , record::Alert{ record::AlertLevel::WARNING, record::AlertDescription::CLOSE_NOTIFY } );
+        }
+        else
+        {
+            auto rec_size = produce_close_notify_record();
+            auto bytes_sent = m_socket.write( reinterpret_cast<const char*>(m_write_buffer.head())
+                                              , m_write_buffer.size() );
+            alert_sent = ( bytes_sent == rec_size );
+            // not sent record tail can't be sent later, write side is closed now
+            m_write_buffer.consume( m_write_buffer.size() );
+        }
+        m_socket.shutdown( SHUT_WR );
+    }
+    catch( const std::system_error& )
+    {
+        m_write_buffer.consume( m_write_buffer.size() );
+        alert_sent = false;
+    }
+
+    return alert_sent;
+}
+
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+bool RecordLayerImpl<OS_SEAM,LOG_LEVEL>::enable_ktls()
+{
+    if( !m_ktls_tx )
+    {
+        assert( m_write_buffer.size() == 0 );
+        m_ktls_tx = ktls_enable_tx( m_socket.native_handle(), m_cryptor.cipher_suite() );
+    }
+    if( m_ktls_tx && !m_ktls_rx && m_early_data.empty()
+        && m_read_buffer.size() == 0 && m_read_buffer.conserved_size() == 0 )
+    {
+        m_ktls_rx = ktls_enable_rx( m_socket.native_handle(), m_cryptor.cipher_suite() );
+    }
+    TraceRing::instance().add( TraceEvent::KTLS_ENABLED, m_socket.connection_id(), 0
+                               , (m_ktls_tx ? 1u : 0u) | (m_ktls_rx ? 2u : 0u) );
+
+    return m_ktls_tx;
+}
+
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
 CoroutineAwaiter<TlsSocket> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::tls_accept(
         Poller& poller, sockaddr_in6* peer_addr, KeyStore* keys_store )
 {
     TcpSocket client_sock = co_await m_socket.async_accept( poller, peer_addr );
 
-    RecordLayer record_layer{ std::move(client_sock) };
+    co_return co_await tls_server_handshake( std::move(client_sock), keys_store );
+}
+
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+void RecordLayerImpl<OS_SEAM,LOG_LEVEL>::handshake_completed(
+        bool server, uint64_t connection_id, std::chrono::steady_clock::time_point start_time ) noexcept
+{
+    auto duration = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start_time );
+    ThreadMetrics::instance().handshake_completed( server, duration );
+    TraceRing::instance().add( TraceEvent::HANDSHAKE_COMPLETED, connection_id, 0, duration.count() );
+}
+
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+void RecordLayerImpl<OS_SEAM,LOG_LEVEL>::handshake_failed(
+        bool server, uint64_t connection_id, HandshakeFailure reason ) noexcept
+{
+    ThreadMetrics::instance().handshake_failed( server, reason );
+    TraceRing::instance().add( TraceEvent::HANDSHAKE_FAILED, connection_id, 0, static_cast<uint32_t>(reason) );
+}
+
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+CoroutineAwaiter<TlsSocket> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::tls_server_handshake(
+        TcpSocket tcp_socket, KeyStore* keys_store )
+{
+    auto start_time = std::chrono::steady_clock::now();
+    uint64_t connection_id = tcp_socket.connection_id();
+    TraceRing::instance().add( TraceEvent::HANDSHAKE_STARTED, connection_id, 0, 1 );
+    try
+    {
+        TlsSocket tls_socket = co_await server_handshake( std::move(tcp_socket), keys_store );
+        handshake_completed( true, connection_id, start_time );
+        co_return tls_socket;
+    }
+    catch( const std::system_error& )
+    {
+        handshake_failed( true, connection_id, HandshakeFailure::IO );
+        throw;
+    }
+    catch( ... )
+    {
+        handshake_failed( true, connection_id, HandshakeFailure::PROTOCOL );
+        throw;
+    }
+}
+
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+CoroutineAwaiter<TlsSocket> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::server_handshake(
+        TcpSocket tcp_socket, KeyStore* keys_store )
+{
+    RecordLayer record_layer{ std::move(tcp_socket) };
     TlsReadBuffer&  read_buffer  = record_layer.m_read_buffer;
     TlsWriteBuffer& write_buffer = record_layer.m_write_buffer;
     crypto::RecordCryptor& record_cryptor = record_layer.m_cryptor;
 
     std::string server_name;
     crypto::TlsHandshake tls_handshake{record_cryptor, server_name};
+    tls_handshake.connection_id = record_layer.m_socket.connection_id();
     record::Parser parser;
     // this MUST be ClientHello unencrypted record
     if( !co_await TlsAcceptorImpl<OS_SEAM>::read_client_hello_record(
@@ -335,22 +717,42 @@ CoroutineAwaiter<TlsSocket> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::tls_accept(
                 "TlsServer::async_accept got record type "
                 + std::to_string( static_cast<uint8_t>(record::record_content_type( read_buffer.head()))) );
     }
+    if( tls_handshake.m_hello_type == crypto::TlsHandshake::HelloType::HelloRetry )
+    {   // client has no key share of supported group, second ClientHello must have it
+        TlsAcceptorImpl<OS_SEAM>::produce_hello_retry_request_record( write_buffer, tls_handshake );
+        tls_handshake.m_hello_type = crypto::TlsHandshake::HelloType::ServerHello;
+        co_await record_layer.async_write_buffer();
+        if( !co_await TlsAcceptorImpl<OS_SEAM>::read_client_hello_record(
+                record_layer, tls_handshake, parser, keys_store ) )
+        {
+            throw std::runtime_error(
+                    "TlsServer::async_accept got record type instead of second ClientHello "
+                    + std::to_string( static_cast<uint8_t>(record::record_content_type( read_buffer.head()))) );
+        }
+    }
 
     tls_handshake.m_hello_type = crypto::TlsHandshake::HelloType::ServerHello;
-    uint32_t record_size = TlsAcceptorImpl<OS_SEAM>::produce_server_hello_record( write_buffer, tls_handshake );
-    record_size = TlsAcceptorImpl<OS_SEAM>::produce_encrypted_extensions_record( write_buffer, tls_handshake );
-    record_size = TlsAcceptorImpl<OS_SEAM>::produce_certificate_record( write_buffer, tls_handshake );
-    record_size = TlsAcceptorImpl<OS_SEAM>::produce_certificate_verify_record( write_buffer, tls_handshake );
-    record_size = TlsAcceptorImpl<OS_SEAM>::produce_server_finished_record( write_buffer, tls_handshake );
-
-    uint32_t bytes_sent = co_await record_layer.async_write_buffer();
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        printf( "TlsServer::async_accept() sent %d bytes\n", bytes_sent );
+    TlsAcceptorImpl<OS_SEAM>::produce_server_hello_record( write_buffer, tls_handshake );
+    // EncryptedExtensions..Finished are sent in one record (or minimal records count)
+    uint32_t flight_size = TlsAcceptorImpl<OS_SEAM>::append_encrypted_extensions( write_buffer, tls_handshake, 0 );
+    if( !tls_handshake.psk_resumed )
+    {
+        flight_size = TlsAcceptorImpl<OS_SEAM>::append_certificate( write_buffer, tls_handshake, flight_size );
+        // signing runs in crypto worker thread if CryptoWorkers started
+        co_await crypto::CryptoWorkers::offload( [&tls_handshake](){ tls_handshake.prepare_certificate_verify_signature(); } );
+        flight_size = TlsAcceptorImpl<OS_SEAM>::append_certificate_verify( write_buffer, tls_handshake, flight_size );
+    }
+    flight_size = TlsAcceptorImpl<OS_SEAM>::append_server_finished( write_buffer, tls_handshake, flight_size );
+    TlsAcceptorImpl<OS_SEAM>::produce_encrypted_flight( write_buffer, tls_handshake, flight_size );
 
+    co_await record_layer.async_write_buffer();
 
     uint8_t server_finished_transcript_hash[ EVP_MAX_MD_SIZE ]; // ClientHello...server Finished
     tls_handshake.current_transcript_hash( server_finished_transcript_hash );
 
+    if( tls_handshake.early_data_accepted )
+        co_await TlsAcceptorImpl<OS_SEAM>::read_early_data_records( record_layer, tls_handshake, parser );
+
     if( !co_await TlsAcceptorImpl<OS_SEAM>::read_client_finished_record(record_layer, tls_handshake, parser ) )
     {
         throw std::runtime_error(
@@ -364,26 +766,85 @@ CoroutineAwaiter<TlsSocket> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::tls_accept(
     record_layer.create_application_traffic_cryptor(
             tls_handshake, server_finished_transcript_hash, client_finished_transcript_hash, true );
 
+    if( SessionTicketKeys::instance().issue_tickets() )
+    {
+        if( TlsAcceptorImpl<OS_SEAM>::produce_new_session_ticket_record( write_buffer, tls_handshake ) > 0 )
+            co_await record_layer.async_write_buffer();
+    }
+
     co_return TlsSocket{ std::move(record_layer) };
 }
 
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
 CoroutineAwaiter<bool> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::tls_connect(
-        Poller& poller, const char* hostname, uint16_t port, const std::string& sni )
+        Poller& poller, const char* hostname, uint16_t port, const std::string& sni
+        , const void* early_data, uint32_t early_data_size )
 {
     if( !co_await m_socket.async_connect( poller, hostname, port ) )
-    co_return false;
+    {
+        handshake_failed( false, 0, HandshakeFailure::CONNECT );
+        co_return false;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    uint64_t connection_id = m_socket.connection_id();
+    TraceRing::instance().add( TraceEvent::HANDSHAKE_STARTED, connection_id, 0, 0 );
+    try
+    {
+        co_await client_handshake( sni, early_data, early_data_size );
+        handshake_completed( false, connection_id, start_time );
+    }
+    catch( const std::system_error& )
+    {
+        handshake_failed( false, connection_id, HandshakeFailure::IO );
+        throw;
+    }
+    catch( ... )
+    {
+        handshake_failed( false, connection_id, HandshakeFailure::PROTOCOL );
+        throw;
+    }
+    co_return true;
+}
 
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+CoroutineAwaiter<void> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::client_handshake(
+        const std::string& sni, const void* early_data, uint32_t early_data_size )
+{
     crypto::RecordCryptor& record_cryptor = m_cryptor;
-    crypto::TlsHandshake  tls_handshake{ record_cryptor, sni, record::NamedGroup::X25519 };
+    // key shares of client strategy, several shares avoid HelloRetryRequest
+    auto key_share_groups = crypto::NamedGroupPreference::instance().key_shares();
+    crypto::TlsHandshake  tls_handshake{ record_cryptor, sni, key_share_groups[0] };
+    for( uint32_t i = 1; i < key_share_groups.size(); ++i )
+        tls_handshake.add_key_share( key_share_groups[i] );
     tls_handshake.m_hello_type = crypto::TlsHandshake::HelloType::ClientHello;
+    tls_handshake.connection_id = m_socket.connection_id();
+
+    m_server_name = sni;
+    std::optional<ClientTicket> psk_ticket = TicketCache::instance().take( sni, SessionTicketKeys::now_ms() );
+    if( psk_ticket )
+    {
+        tls_handshake.psk_ticket = &*psk_ticket;
+        tls_handshake.set_resumption_psk( psk_ticket->cipher_suite, psk_ticket->psk, psk_ticket->psk_size );
+        // early data is sent in single record with ClientHello
+        tls_handshake.early_data_offered = early_data_size > 0
+                && early_data_size <= psk_ticket->max_early_data_size
+                && early_data_size <= 16*1024U;
+    }
 
     uint32_t record_size = TlsConnectorImpl<OS_SEAM>::produce_client_hello_record( m_write_buffer, tls_handshake );
+    uint32_t early_data_record_size = 0;
+    if( tls_handshake.early_data_offered )
+    {
+        early_data_record_size = TlsConnectorImpl<OS_SEAM>::produce_early_data_record(
+                m_write_buffer, tls_handshake, early_data, early_data_size );
+    }
 
-    auto bytes_sent = co_await m_socket.async_write( m_write_buffer.head(), record_size );
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        printf( "RecordLayer::tls_connect sent %ld bytes\n", bytes_sent );
+    auto bytes_sent = co_await m_socket.async_write( m_write_buffer.head(), record_size + early_data_record_size );
+    TraceRing::instance().add( TraceEvent::BYTES_SENT, m_socket.connection_id()
+                               , bytes_sent, record_size + early_data_record_size );
     // ClientHello Must wait in write buffer until ServerHello will be read and hash method get known
+    m_write_buffer.shrink( early_data_record_size );
 
     record::Parser parser;
     if( !co_await TlsConnectorImpl<OS_SEAM>::read_server_hello_record( *this, tls_handshake, parser ) )
@@ -393,6 +854,20 @@ CoroutineAwaiter<bool> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::tls_connect(
                 + std::to_string( static_cast<uint8_t>(
                                           record::record_content_type( m_read_buffer.head()))));
     }
+    if( tls_handshake.hello_retried() )
+    {   // second ClientHello with key share of server selected group
+        record_size = TlsConnectorImpl<OS_SEAM>::produce_client_hello_record( m_write_buffer, tls_handshake );
+        bytes_sent = co_await m_socket.async_write( m_write_buffer.head(), record_size );
+        TraceRing::instance().add( TraceEvent::BYTES_SENT, m_socket.connection_id(), bytes_sent, record_size );
+
+        if( !co_await TlsConnectorImpl<OS_SEAM>::read_server_hello_record( *this, tls_handshake, parser ) )
+        {
+            throw std::runtime_error(
+                    "RecordLayer::tls_connect got record type "
+                    + std::to_string( static_cast<uint8_t>(
+                                              record::record_content_type( m_read_buffer.head()))));
+        }
+    }
     if( !co_await TlsConnectorImpl<OS_SEAM>::read_encrypted_extensions_record( *this, tls_handshake, parser ))
     {
         throw std::runtime_error(
@@ -400,13 +875,16 @@ CoroutineAwaiter<bool> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::tls_connect(
                 + std::to_string( static_cast<uint8_t>(
                                           record::record_content_type( m_read_buffer.head()))));
     }
-    if( !co_await TlsConnectorImpl<OS_SEAM>::read_certificate_record( *this, tls_handshake, parser ))
+    // resumed session is authenticated by psk, server sends no certificate
+    if( !tls_handshake.psk_resumed
+        && !co_await TlsConnectorImpl<OS_SEAM>::read_certificate_record( *this, tls_handshake, parser ))
     {
         throw std::runtime_error(
                 "RecordLayer::tls_connect got record type "
                 + std::to_string( static_cast<uint8_t>(record::record_content_type( m_read_buffer.head()))));
     }
-    if( !co_await TlsConnectorImpl<OS_SEAM>::read_certificate_verify_record( *this, tls_handshake, parser ))
+    if( !tls_handshake.psk_resumed
+        && !co_await TlsConnectorImpl<OS_SEAM>::read_certificate_verify_record( *this, tls_handshake, parser ))
     {
         throw std::runtime_error(
                 "RecordLayer::tls_connect got record type "
@@ -423,6 +901,8 @@ CoroutineAwaiter<bool> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::tls_connect(
     uint8_t server_finished_transcript_hash[ EVP_MAX_MD_SIZE ]; // ClientHello...server Finished
     tls_handshake.current_transcript_hash( server_finished_transcript_hash );
 
+    if( tls_handshake.early_data_accepted )
+        TlsConnectorImpl<OS_SEAM>::produce_end_of_early_data_record( m_write_buffer, tls_handshake );
     co_await TlsConnectorImpl<OS_SEAM>::send_client_finished_record( *this, tls_handshake );
 
     uint8_t client_finished_transcript_hash[ EVP_MAX_MD_SIZE ]; // ClientHello...client Finished
@@ -430,7 +910,8 @@ CoroutineAwaiter<bool> RecordLayerImpl<OS_SEAM,LOG_LEVEL>::tls_connect(
 
     create_application_traffic_cryptor(
             tls_handshake, server_finished_transcript_hash, client_finished_transcript_hash, false );
-    co_return true;
+    if( tls_handshake.early_data_accepted )
+        m_early_data_size = early_data_size;
 }
 
 }
@@ -10,14 +10,18 @@
 #include <cstdint>
 
 #include <string>
+#include <vector>
 
 #include <libcornet/tcp_socket.hpp>
 #include <libcornet/tls/tls_read_buffer.hpp>
+#include <libcornet/tls/handshake_chain.hpp>
+#include <libcornet/tls/record_stream_parser.hpp>
 #include <libcornet/tls/crypto/record_cryptor.hpp>
 #include <libcornet/tls/parser.hpp>
 #include <libcornet/tls/key_store.hpp>
 #include <pioneer19_utils/coroutines_utils.hpp>
 #include <libcornet/log_level.hpp>
+#include <libcornet/metrics.hpp>
 
 namespace pioneer19::cornet::tls13
 {
@@ -41,9 +45,24 @@ public:
     void listen( Poller& poller ) {m_socket.listen(poller);}
     CoroutineAwaiter<TlsSocket> tls_accept(
             Poller& poller, sockaddr_in6* peer_addr, KeyStore* keys_store );
+    /**
+     * accept tcp connection only, tls handshake is made by tls_server_handshake(),
+     * so listener is not blocked by slow clients
+     */
+    CoroutineAwaiter<TcpSocket> async_accept_tcp( Poller& poller, sockaddr_in6* peer_addr )
+    { return m_socket.async_accept( poller, peer_addr ); }
+    /**
+     * make server side tls handshake on accepted tcp socket, keys_store must
+     * live until handshake finished
+     */
+    static CoroutineAwaiter<TlsSocket> tls_server_handshake( TcpSocket tcp_socket, KeyStore* keys_store );
+    /**
+     * connect and make tls handshake, early_data is sent in 0-RTT if session
+     * ticket for sni allows it, otherwise it is not sent at all
+     */
     [[nodiscard]]
     CoroutineAwaiter<bool>     tls_connect( Poller& poller, const char* hostname, uint16_t port
-            , const std::string& sni );
+            , const std::string& sni, const void* early_data = nullptr, uint32_t early_data_size = 0 );
     /**
      * receive data from Tls socket to buffer until got minimum min_threshold bytes, buffer_size is max threshold
      * @param buffer buffer for data
@@ -54,17 +73,72 @@ public:
     CoroutineAwaiter<uint32_t> async_read(
             void* user_buffer, uint32_t buffer_size, uint32_t min_threshold = 1 );
     CoroutineAwaiter<void>     async_write( const void* buffer, uint32_t buffer_size );
+    /**
+     * send close_notify alert and shutdown write side of tcp connection (half-close),
+     * data from peer can be read until peer close_notify. Sent once, next calls do nothing
+     */
+    CoroutineAwaiter<void>     async_close_notify();
+    /**
+     * close_notify without waiting: alert is written to socket only if socket send buffer
+     * has space for it, then write side of connection is closed anyway.
+     * Can't be called when write is in progress.
+     * @return true if close_notify alert was sent
+     */
+    bool try_close_notify() noexcept;
+    /**
+     * peer sent close_notify, async_read() returns data received before it and 0 after
+     */
+    [[nodiscard]]
+    bool close_notify_received() const noexcept { return m_close_notify_received; }
+    [[nodiscard]]
+    bool close_notify_sent() const noexcept { return m_close_notify_sent; }
+    /**
+     * async_write() or async_close_notify() is running, other write can't be started now
+     */
+    [[nodiscard]]
+    bool write_in_progress() const noexcept { return m_write_in_progress; }
+    /**
+     * opt-in kernel TLS offload of established connection. After it application data
+     * is written (and read, if rx offloaded) directly through tcp socket.
+     * Rx is offloaded only if no record data left in read buffer.
+     * @return true if at least tx offloaded, false - user space encryption continue to work
+     */
+    bool enable_ktls();
+    [[nodiscard]]
+    bool ktls_tx() const noexcept { return m_ktls_tx; }
+    [[nodiscard]]
+    bool ktls_rx() const noexcept { return m_ktls_rx; }
+    /**
+     * 0-RTT data was accepted by server. On server early data is returned by
+     * async_read() first, it is replayable and must be processed as idempotent
+     */
+    [[nodiscard]]
+    bool early_data_accepted() const noexcept { return m_early_data_size > 0; }
+    [[nodiscard]]
+    uint32_t early_data_size() const noexcept { return m_early_data_size; }
 
     RecordLayerImpl( const RecordLayerImpl& )       = delete;
     RecordLayerImpl& operator=( const RecordLayerImpl& ) = delete;
 
 private:
+    /// TLSPlaintext.length MUST NOT exceed 2^14 (RFC 8446 5.1)
+    static constexpr uint32_t MAX_PLAINTEXT_SIZE = 16*1024;
+
     template<typename T, LogLevel >
     friend class TlsConnectorImpl;
     template<typename T, LogLevel >
     friend class TlsAcceptorImpl;
 
+    static CoroutineAwaiter<TlsSocket> server_handshake( TcpSocket tcp_socket, KeyStore* keys_store );
+    /// metrics and trace event of finished handshake
+    static void handshake_completed( bool server, uint64_t connection_id
+                                     , std::chrono::steady_clock::time_point start_time ) noexcept;
+    static void handshake_failed( bool server, uint64_t connection_id, HandshakeFailure reason ) noexcept;
+    CoroutineAwaiter<void> client_handshake(
+            const std::string& sni, const void* early_data, uint32_t early_data_size );
+
     uint16_t decrypt_record( uint8_t* buffer, crypto::RecordCryptor& cryptor );
+    static void unpad_inner_plaintext( uint8_t* buffer, uint32_t bytes_decrypted );
 
     void create_application_traffic_cryptor( crypto::TlsHandshake& tls_handshake,
                                              const uint8_t* server_finished_transcript_hash,
@@ -74,15 +148,52 @@ private:
     CoroutineAwaiter<void> read_full_record_skip_change_cipher_spec();
     CoroutineAwaiter <uint32_t> read_and_decrypt_record();
     CoroutineAwaiter <uint32_t> read_record_decrypt_and_skip_change_cipher();
+    /**
+     * decrypt all complete application data records in read buffer by one batch
+     * and gather their content to user buffer (only records surely fitting in it)
+     * @return false if no record was processed
+     */
+    bool decrypt_buffered_records( uint8_t* user_buffer, uint32_t buffer_size, uint32_t& bytes_copied );
+    /// async_read() of socket with kTLS rx, not application_data records go to process_plaintext_record()
+    CoroutineAwaiter<uint32_t> ktls_read( uint8_t* user_buffer, uint32_t buffer_size
+                                          , uint32_t min_threshold, uint32_t bytes_copied );
+    /// process decrypted record at read buffer head (data to user buffer), consume it
+    uint32_t process_plaintext_record( uint8_t* user_buffer, uint32_t buffer_size
+                                       , uint32_t bytes_copied, uint32_t full_record_size );
+    /**
+     * read next handshake message of encrypted peer flight. Message is at read buffer
+     * head as decrypted record with this message only (record with several messages
+     * is split in place, next message is returned by next call). Message spanning
+     * records is in m_handshake_chain (not empty only in this case)
+     * @return bytes to consume from read buffer after message processed
+     */
+    CoroutineAwaiter <uint32_t> read_handshake_message();
+    /// read records with rest of message, first fragment_size bytes are in current record
+    CoroutineAwaiter <uint32_t> read_handshake_message_chain( uint32_t fragment_size );
 
     CoroutineAwaiter <uint32_t> async_write_buffer();
     CoroutineAwaiter<void> encrypt_and_send_application_data( const void* buffer, uint32_t chunk_size );
     CoroutineAwaiter<uint32_t> encrypt_and_send_record( const void* buffer, uint32_t chunk_size );
+    /// encrypted close_notify alert record to write buffer
+    uint32_t produce_close_notify_record();
 
     TcpSocket      m_socket;
     TlsReadBuffer  m_read_buffer;
+    record::RecordStreamParser m_record_parser; ///< framing of record at read buffer head
+    HandshakeChain m_handshake_chain; ///< handshake message received in several records
     TlsWriteBuffer m_write_buffer;
     crypto::RecordCryptor m_cryptor;
+    std::string    m_server_name; ///< client side sni, session tickets are cached by it
+    std::vector<uint8_t> m_early_data; ///< server side 0-RTT data not read by user yet
+    uint32_t m_early_data_offset = 0;
+    uint32_t m_early_data_size   = 0; ///< accepted 0-RTT data size
+    uint32_t m_handshake_rest_size   = 0; ///< plaintext size of not read messages in current record
+    uint32_t m_handshake_record_tail = 0; ///< content type, padding and tag after record plaintext
+    bool m_ktls_tx = false;
+    bool m_ktls_rx = false;
+    bool m_write_in_progress     = false;
+    bool m_close_notify_sent     = false;
+    bool m_close_notify_received = false;
 };
 
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
@@ -0,0 +1,101 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/tls/record_scan.hpp>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include <libcornet/cpu_features.hpp>
+#include <libcornet/tls/types.hpp>
+#include <libcornet/tls/record_stream_parser.hpp>
+
+namespace pioneer19::cornet::tls13::record
+{
+
+static uint32_t trim_zero_tail_scalar( const uint8_t* data, uint32_t size ) noexcept
+{
+    while( size > 0 && data[size - 1] == 0 )
+        --size;
+    return size;
+}
+
+#if defined(__x86_64__)
+// SSE2 is part of x86_64, blocks are checked from the tail
+static uint32_t trim_zero_tail_sse2( const uint8_t* data, uint32_t size ) noexcept
+{
+    const __m128i zero = _mm_setzero_si128();
+    while( size >= 16 )
+    {
+        __m128i block = _mm_loadu_si128( reinterpret_cast<const __m128i*>( data + size - 16 ));
+        auto nonzero_mask = ~static_cast<uint32_t>( _mm_movemask_epi8( _mm_cmpeq_epi8( block, zero ))) & 0xffffu;
+        if( nonzero_mask != 0 )
+            return size - 16 + ( 32 - __builtin_clz( nonzero_mask ));
+        size -= 16;
+    }
+    return trim_zero_tail_scalar( data, size );
+}
+
+__attribute__((target("avx2")))
+static uint32_t trim_zero_tail_avx2( const uint8_t* data, uint32_t size ) noexcept
+{
+    const __m256i zero = _mm256_setzero_si256();
+    while( size >= 32 )
+    {
+        __m256i block = _mm256_loadu_si256( reinterpret_cast<const __m256i*>( data + size - 32 ));
+        auto nonzero_mask = ~static_cast<uint32_t>( _mm256_movemask_epi8( _mm256_cmpeq_epi8( block, zero )));
+        if( nonzero_mask != 0 )
+            return size - 32 + ( 32 - __builtin_clz( nonzero_mask ));
+        size -= 32;
+    }
+    return trim_zero_tail_sse2( data, size );
+}
+#endif
+
+using TrimZeroTail = uint32_t (*)( const uint8_t*, uint32_t ) noexcept;
+
+static TrimZeroTail select_trim_zero_tail() noexcept
+{
+#if defined(__x86_64__)
+    if( CpuFeatures::instance().avx2 )
+        return &trim_zero_tail_avx2;
+    return &trim_zero_tail_sse2;
+#else
+    return &trim_zero_tail_scalar;
+#endif
+}
+
+uint32_t trim_zero_tail( const uint8_t* data, uint32_t size ) noexcept
+{
+    static const TrimZeroTail impl = select_trim_zero_tail();
+    return impl( data, size );
+}
+
+uint32_t scan_complete_records( const uint8_t* data, uint32_t size, std::span<uint32_t> record_sizes ) noexcept
+{
+    // record boundaries are a chain (each header gives next record offset),
+    // so headers are walked, record data is not touched
+    uint32_t records_count = 0;
+    uint32_t offset = 0;
+    while( records_count < record_sizes.size() && size - offset >= sizeof(TLSCiphertext) )
+    {
+        uint32_t record_length = reinterpret_cast<const TLSCiphertext*>( data + offset )->length();
+        if( record_length > RecordStreamParser::MAX_RECORD_LENGTH )
+            break;
+        uint32_t record_size = sizeof(TLSCiphertext) + record_length;
+        if( record_size > size - offset )
+            break;
+
+        record_sizes[records_count++] = record_size;
+        offset += record_size;
+    }
+
+    return records_count;
+}
+
+}
@@ -0,0 +1,34 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <span>
+
+namespace pioneer19::cornet::tls13::record
+{
+
+/**
+ * size of data without zero tail (TLSInnerPlaintext padding), vectorized
+ * with AVX2 or SSE2 when cpu has them
+ * @return position after last non zero byte, 0 if all bytes are zero
+ */
+[[nodiscard]]
+uint32_t trim_zero_tail( const uint8_t* data, uint32_t size ) noexcept;
+
+/**
+ * find all complete records at data start in one pass
+ * @param record_sizes filled with full record sizes (with header)
+ * @return number of complete records (stops at incomplete or too long record
+ * or when record_sizes is full)
+ */
+[[nodiscard]]
+uint32_t scan_complete_records( const uint8_t* data, uint32_t size, std::span<uint32_t> record_sizes ) noexcept;
+
+}
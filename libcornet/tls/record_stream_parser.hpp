@@ -0,0 +1,116 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <algorithm>
+
+#include <libcornet/tls/types.hpp>
+
+namespace pioneer19::cornet::tls13::record
+{
+
+/**
+ * @brief resumable TLS record framing of network stream
+ *
+ * Bytes are fed as they arrive, parser keeps its position between calls
+ * (record header can be split between reads too), so each received byte
+ * is looked at once. Record is not copied, parser tracks boundaries only.
+ * Record longer than TLS allows is detected as soon as its header is parsed.
+ */
+class RecordStreamParser
+{
+public:
+    /// TLSCiphertext.length MUST NOT exceed 2^14 + 256 (RFC 8446 5.2)
+    static constexpr uint32_t MAX_RECORD_LENGTH = 16*1024 + 256;
+
+    /**
+     * parse next bytes of current record
+     * @return bytes belonging to current record, parsing stops at record end
+     */
+    uint32_t feed( const uint8_t* data, uint32_t size ) noexcept;
+    void reset() noexcept;
+
+    [[nodiscard]]
+    bool record_ready() const noexcept { return m_state == State::READY; }
+    [[nodiscard]]
+    bool overflow() const noexcept { return m_state == State::OVERFLOW; }
+    /// record size with header, 0 until header is parsed
+    [[nodiscard]]
+    uint32_t record_size() const noexcept { return m_record_size; }
+    /// bytes of current record fed already
+    [[nodiscard]]
+    uint32_t parsed_size() const noexcept { return m_parsed_size; }
+    /// bytes to complete current record (or its header, if header is not parsed yet)
+    [[nodiscard]]
+    uint32_t bytes_needed() const noexcept;
+
+private:
+    enum class State : uint8_t { HEADER, BODY, READY, OVERFLOW };
+
+    uint8_t  m_header[sizeof(TLSCiphertext)] = {};
+    uint32_t m_parsed_size = 0;
+    uint32_t m_record_size = 0;
+    State    m_state = State::HEADER;
+};
+
+inline uint32_t RecordStreamParser::feed( const uint8_t* data, uint32_t size ) noexcept
+{
+    uint32_t consumed = 0;
+    if( m_state == State::HEADER )
+    {
+        uint32_t header_part = std::min<uint32_t>( size, sizeof(TLSCiphertext) - m_parsed_size );
+        std::copy_n( data, header_part, m_header + m_parsed_size );
+        m_parsed_size += header_part;
+        consumed = header_part;
+        if( m_parsed_size < sizeof(TLSCiphertext) )
+            return consumed;
+
+        uint32_t record_length = reinterpret_cast<const TLSCiphertext*>( m_header )->length();
+        if( record_length > MAX_RECORD_LENGTH )
+        {
+            m_state = State::OVERFLOW;
+            return consumed;
+        }
+        m_record_size = sizeof(TLSCiphertext) + record_length;
+        m_state = State::BODY;
+    }
+    if( m_state == State::BODY )
+    {
+        uint32_t body_part = std::min( size - consumed, m_record_size - m_parsed_size );
+        m_parsed_size += body_part;
+        consumed += body_part;
+        if( m_parsed_size == m_record_size )
+            m_state = State::READY;
+    }
+
+    return consumed;
+}
+
+inline void RecordStreamParser::reset() noexcept
+{
+    m_parsed_size = 0;
+    m_record_size = 0;
+    m_state = State::HEADER;
+}
+
+inline uint32_t RecordStreamParser::bytes_needed() const noexcept
+{
+    switch( m_state )
+    {
+        case State::HEADER:
+            return sizeof(TLSCiphertext) - m_parsed_size;
+        case State::BODY:
+            return m_record_size - m_parsed_size;
+        default:
+            return 0;
+    }
+}
+
+}
@@ -0,0 +1,199 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/tls/reloadable_key_store.hpp>
+
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <algorithm>
+#include <system_error>
+#include <unordered_map>
+
+#include <libcornet/poller.hpp>
+#include <libcornet/async_file.hpp>
+
+namespace pioneer19::cornet::tls13
+{
+
+static std::atomic<uint64_t> reloadable_key_stores_count = 0;
+
+ReloadableKeyStore::ReloadableKeyStore( Factory factory )
+    :m_id{ reloadable_key_stores_count.fetch_add( 1, std::memory_order_relaxed ) + 1 }
+    ,m_factory{ std::move(factory) }
+    ,m_key_store{ m_factory() }
+{
+    if( !m_key_store )
+        throw std::runtime_error( "ReloadableKeyStore() factory returned empty KeyStore" );
+}
+
+ReloadableKeyStore::~ReloadableKeyStore()
+{
+    if( m_watcher )
+        m_watcher->stop();
+}
+
+ReloadableKeyStore::ThreadCache& ReloadableKeyStore::thread_cache()
+{
+    // last used store is checked first, map is used by threads with many stores
+    thread_local uint64_t last_store_id = 0;
+    thread_local ThreadCache* last_cache = nullptr;
+    thread_local std::unordered_map<uint64_t,ThreadCache*> thread_caches;
+
+    if( last_store_id == m_id )
+        return *last_cache;
+
+    ThreadCache*& cache = thread_caches[m_id];
+    if( cache == nullptr )
+    {
+        std::lock_guard lock( m_mutex );
+        cache = &m_thread_caches.emplace_back();
+    }
+    last_store_id = m_id;
+    last_cache = cache;
+
+    return *cache;
+}
+
+ReloadableKeyStore::ThreadCache& ReloadableKeyStore::update_thread_cache( ThreadCache& cache, uint64_t version )
+{
+    auto snapshot = std::make_unique<ThreadSnapshot>();
+    {
+        std::lock_guard lock( m_mutex );
+        snapshot->key_store = m_key_store;
+        // version could be incremented after it was loaded, it is consistent with m_key_store here
+        version = m_version.load( std::memory_order_relaxed );
+    }
+    cache.snapshots.push_back( std::move(snapshot) );
+    cache.current = cache.snapshots.back().get();
+    cache.version = version;
+    release_snapshots( cache );
+
+    return cache;
+}
+
+void ReloadableKeyStore::release_snapshots( ThreadCache& cache ) noexcept
+{
+    auto& snapshots = cache.snapshots;
+    snapshots.erase( std::remove_if( snapshots.begin(), snapshots.end()
+            , [current = cache.current]( const std::unique_ptr<ThreadSnapshot>& snapshot ) {
+                return snapshot.get() != current && snapshot->refs.load( std::memory_order_acquire ) == 0;
+            } ), snapshots.end() );
+}
+
+ReloadableKeyStore::ThreadSnapshot* ReloadableKeyStore::current_snapshot() noexcept
+{
+    try
+    {
+        ThreadCache& cache = thread_cache();
+        uint64_t version = m_version.load( std::memory_order_acquire );
+        if( cache.version != version )
+            update_thread_cache( cache, version );
+        else if( cache.snapshots.size() > 1 )
+            release_snapshots( cache );
+
+        return cache.current;
+    }
+    catch( const std::exception& ex )
+    {
+        fprintf( stderr, "ReloadableKeyStore failed update thread snapshot: %s\n", ex.what() );
+        return nullptr;
+    }
+}
+
+DomainKeys* ReloadableKeyStore::find( const char* domain_name ) noexcept
+{
+    ThreadSnapshot* snapshot = current_snapshot();
+    if( snapshot == nullptr )
+        return nullptr;
+
+    return snapshot->key_store->find( domain_name );
+}
+
+DomainKeys* ReloadableKeyStore::acquire( const char* domain_name, KeyStoreSnapshotRef& snapshot_ref ) noexcept
+{
+    ThreadSnapshot* snapshot = current_snapshot();
+    if( snapshot == nullptr )
+        return nullptr;
+
+    DomainKeys* domain_keys = snapshot->key_store->find( domain_name );
+    if( domain_keys != nullptr )
+        snapshot_ref = KeyStoreSnapshotRef{ &snapshot->refs };
+
+    return domain_keys;
+}
+
+bool ReloadableKeyStore::reload() noexcept
+{
+    std::shared_ptr<KeyStore> key_store;
+    try
+    {
+        key_store = m_factory();
+    }
+    catch( const std::exception& ex )
+    {
+        fprintf( stderr, "ReloadableKeyStore::reload() failed: %s\n", ex.what() );
+        return false;
+    }
+    if( !key_store )
+        return false;
+
+    {
+        std::lock_guard lock( m_mutex );
+        m_key_store.swap( key_store );
+        m_version.fetch_add( 1, std::memory_order_release );
+    }
+    // previous snapshot is freed here if no thread uses it
+
+    return true;
+}
+
+void ReloadableKeyStore::reload_on_signal( Poller& poller, int signum )
+{
+    poller.run_on_signal( signum, [this](){ reload(); } );
+}
+
+void ReloadableKeyStore::reload_on_change( Poller& poller, const std::vector<std::string>& paths )
+{
+    int inotify_fd = inotify_init1( IN_NONBLOCK|IN_CLOEXEC );
+    if( inotify_fd == -1 )
+        throw std::system_error( errno, std::system_category()
+                                 , "ReloadableKeyStore::reload_on_change() inotify_init1 failed" );
+    for( auto& path : paths )
+    {
+        // directory watch survives certificate replacement by rename
+        if( inotify_add_watch( inotify_fd, path.c_str()
+                , IN_CLOSE_WRITE|IN_MOVED_TO|IN_CREATE|IN_DELETE|IN_MOVE_SELF|IN_DELETE_SELF ) == -1 )
+        {
+            int err = errno;
+            ::close( inotify_fd );
+            throw std::system_error( err, std::system_category()
+                                     , "ReloadableKeyStore::reload_on_change() inotify_add_watch \""+path+"\"" );
+        }
+    }
+    if( m_watcher )
+        m_watcher->stop();
+    m_watcher.emplace( watch_changes( poller, inotify_fd ) );
+}
+
+CommonCoroutine ReloadableKeyStore::watch_changes( Poller& poller, int inotify_fd )
+{
+    AsyncFile inotify_file{ inotify_fd, &poller };
+    alignas(inotify_event) char events[4096];
+    while( true )
+    {
+        // all events read at once give one reload
+        ssize_t bytes_read = co_await inotify_file.async_read( events, sizeof(events) );
+        if( bytes_read <= 0 )
+            break;
+        reload();
+    }
+}
+
+}
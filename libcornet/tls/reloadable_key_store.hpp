@@ -0,0 +1,114 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <csignal>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <deque>
+#include <string>
+#include <vector>
+#include <optional>
+#include <functional>
+
+#include <pioneer19_utils/coroutines_utils.hpp>
+#include <libcornet/tls/key_store.hpp>
+
+namespace pioneer19::cornet
+{
+class Poller;
+}
+
+namespace pioneer19::cornet::tls13
+{
+
+/**
+ * @brief KeyStore reloaded from disk without restart
+ *
+ * Every reload() creates new KeyStore snapshot by factory (SingleDomainKeyStore,
+ * MultiDomainKeyStore...) and publishes it by version increment, failed reload
+ * keeps current snapshot. Every thread keeps its own reference of snapshot, so
+ * lookup is one atomic version load (no lock) while version not changed.
+ * Handshake keeps KeyStoreSnapshotRef of its thread snapshot (counter is not
+ * shared between threads), snapshot replaced on thread is released when its
+ * handshakes finished and snapshot is freed when all threads released it
+ * (thread without handshakes keeps old snapshot until its next lookup).
+ *
+ * reload() is called by reload_on_signal() (SIGHUP) or reload_on_change()
+ * (inotify), can be called directly from any thread. Store must outlive
+ * handshakes and poller threads using it.
+ */
+class ReloadableKeyStore : public KeyStore
+{
+public:
+    using Factory = std::function<std::unique_ptr<KeyStore>()>;
+
+    /**
+     * first snapshot is created here, factory exception is thrown
+     */
+    explicit ReloadableKeyStore( Factory factory );
+    ~ReloadableKeyStore() override;
+
+    /**
+     * keys are valid until next lookup on this thread after reload,
+     * handshake uses acquire()
+     */
+    DomainKeys* find( const char* domain_name ) noexcept final;
+    DomainKeys* acquire( const char* domain_name, KeyStoreSnapshotRef& snapshot_ref ) noexcept final;
+
+    /**
+     * @return false if new snapshot failed to load (current snapshot is kept)
+     */
+    bool reload() noexcept;
+    [[nodiscard]]
+    uint64_t version() const noexcept { return m_version.load( std::memory_order_acquire ); }
+    void reload_on_signal( Poller& poller, int signum = SIGHUP );
+    /**
+     * reload after files in paths (files or directories) were written, moved or deleted.
+     * Events read at once give one reload, partial update (new certificate with old key)
+     * fails on key check and is reloaded on next event
+     */
+    void reload_on_change( Poller& poller, const std::vector<std::string>& paths );
+
+    ReloadableKeyStore( ReloadableKeyStore&& )            = delete;
+    ReloadableKeyStore& operator=( ReloadableKeyStore&& ) = delete;
+    ReloadableKeyStore( const ReloadableKeyStore& )       = delete;
+    ReloadableKeyStore& operator=( const ReloadableKeyStore& ) = delete;
+
+private:
+    struct ThreadSnapshot
+    {
+        std::shared_ptr<KeyStore> key_store;
+        std::atomic<uint32_t> refs = 0; ///< KeyStoreSnapshotRef of handshakes
+    };
+    struct ThreadCache
+    {
+        uint64_t version = 0;
+        ThreadSnapshot* current = nullptr;
+        std::vector<std::unique_ptr<ThreadSnapshot>> snapshots; ///< current and replaced in use
+    };
+
+    ThreadCache& thread_cache();
+    ThreadCache& update_thread_cache( ThreadCache& cache, uint64_t version );
+    static void release_snapshots( ThreadCache& cache ) noexcept;
+    ThreadSnapshot* current_snapshot() noexcept;
+    CommonCoroutine watch_changes( Poller& poller, int inotify_fd );
+
+    const uint64_t m_id; ///< thread caches are found by id (address can be reused)
+    Factory m_factory;
+    std::mutex m_mutex; ///< reload and thread cache update (after reload) only
+    std::shared_ptr<KeyStore> m_key_store;
+    std::atomic<uint64_t> m_version = 1;
+    std::deque<ThreadCache> m_thread_caches;
+    std::optional<CommonCoroutine> m_watcher;
+};
+
+}
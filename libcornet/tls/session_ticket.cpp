@@ -0,0 +1,205 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/tls/session_ticket.hpp>
+
+#include <chrono>
+#include <algorithm>
+
+#include <openssl/crypto.h>
+
+#include <libcornet/crypto.hpp>
+
+namespace pioneer19::cornet::tls13
+{
+
+static void hash_server_name( const std::string& server_name, uint8_t* hash ) noexcept
+{
+    unsigned int hash_size = 0;
+    EVP_Digest( server_name.data(), server_name.size(), hash, &hash_size, EVP_sha256(), nullptr );
+}
+
+void SessionTicketState::set_server_name( const std::string& server_name ) noexcept
+{
+    hash_server_name( server_name, server_name_hash );
+}
+
+bool SessionTicketState::server_name_equal( const std::string& server_name ) const noexcept
+{
+    uint8_t hash[SERVER_NAME_HASH_SIZE];
+    hash_server_name( server_name, hash );
+    return CRYPTO_memcmp( hash, server_name_hash, SERVER_NAME_HASH_SIZE ) == 0;
+}
+
+SessionTicketKeys::SessionTicketKeys( uint32_t rotation_interval )
+        : m_rotation_interval{rotation_interval}
+{
+    std::lock_guard lock{ m_mutex };
+    rotate_locked( now_ms() );
+}
+
+SessionTicketKeys& SessionTicketKeys::instance()
+{
+    static SessionTicketKeys ticket_keys;
+    return ticket_keys;
+}
+
+uint64_t SessionTicketKeys::now_ms() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch() ).count();
+}
+
+void SessionTicketKeys::rotate( uint64_t now_ms )
+{
+    std::lock_guard lock{ m_mutex };
+    rotate_locked( now_ms );
+}
+
+void SessionTicketKeys::rotate_locked( uint64_t now_ms )
+{
+    m_previous = m_current;
+    cornet::crypto::random_bytes( m_current.name, sizeof(m_current.name) );
+    cornet::crypto::random_bytes( m_current.key, sizeof(m_current.key) );
+    m_current.create_time_ms = now_ms;
+}
+
+bool SessionTicketKeys::find_key( const uint8_t* key_name, TicketKey& ticket_key )
+{
+    std::lock_guard lock{ m_mutex };
+    // previous key with zero create time was never generated
+    for( const TicketKey* key : { &m_current, &m_previous } )
+    {
+        if( key->create_time_ms != 0
+            && std::equal( key_name, key_name + KEY_NAME_SIZE, key->name ) )
+        {
+            ticket_key = *key;
+            return true;
+        }
+    }
+    return false;
+}
+
+uint32_t SessionTicketKeys::seal( const SessionTicketState& state, uint8_t* ticket, uint64_t now_ms )
+{
+    TicketKey ticket_key;
+    {
+        std::lock_guard lock{ m_mutex };
+        if( now_ms >= m_current.create_time_ms + uint64_t{m_rotation_interval}*1000 )
+            rotate_locked( now_ms );
+        ticket_key = m_current;
+    }
+    uint8_t* iv         = ticket + KEY_NAME_SIZE;
+    uint8_t* ciphertext = iv + IV_SIZE;
+    uint8_t* tag        = ciphertext + sizeof(SessionTicketState);
+
+    std::copy_n( ticket_key.name, KEY_NAME_SIZE, ticket );
+    cornet::crypto::random_bytes( iv, IV_SIZE );
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int out_size = 0;
+    bool sealed = EVP_EncryptInit_ex( ctx, EVP_aes_256_gcm(), nullptr, ticket_key.key, iv ) == 1
+            && EVP_EncryptUpdate( ctx, nullptr, &out_size, ticket, KEY_NAME_SIZE ) == 1
+            && EVP_EncryptUpdate( ctx, ciphertext, &out_size
+                                  ,reinterpret_cast<const uint8_t*>(&state), sizeof(state) ) == 1
+            && EVP_EncryptFinal_ex( ctx, ciphertext + out_size, &out_size ) == 1
+            && EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_GCM_GET_TAG, TAG_SIZE, tag ) == 1;
+    EVP_CIPHER_CTX_free( ctx );
+    OPENSSL_cleanse( ticket_key.key, sizeof(ticket_key.key) );
+
+    return sealed ? TICKET_SIZE : 0;
+}
+
+bool SessionTicketKeys::open( const uint8_t* ticket, uint32_t ticket_size
+        , SessionTicketState& state, uint64_t now_ms )
+{
+    if( ticket_size != TICKET_SIZE )
+        return false;
+    TicketKey ticket_key;
+    if( !find_key( ticket, ticket_key ) )
+        return false;
+
+    const uint8_t* iv         = ticket + KEY_NAME_SIZE;
+    const uint8_t* ciphertext = iv + IV_SIZE;
+    const uint8_t* tag        = ciphertext + sizeof(SessionTicketState);
+
+    EVP_CIPHER_CTX* ctx = EVP_CIPHER_CTX_new();
+    int out_size = 0;
+    bool opened = EVP_DecryptInit_ex( ctx, EVP_aes_256_gcm(), nullptr, ticket_key.key, iv ) == 1
+            && EVP_DecryptUpdate( ctx, nullptr, &out_size, ticket, KEY_NAME_SIZE ) == 1
+            && EVP_DecryptUpdate( ctx, reinterpret_cast<uint8_t*>(&state), &out_size
+                                  ,ciphertext, sizeof(SessionTicketState) ) == 1
+            && EVP_CIPHER_CTX_ctrl( ctx, EVP_CTRL_GCM_SET_TAG, TAG_SIZE, const_cast<uint8_t*>(tag) ) == 1
+            && EVP_DecryptFinal_ex( ctx, reinterpret_cast<uint8_t*>(&state) + out_size, &out_size ) == 1;
+    EVP_CIPHER_CTX_free( ctx );
+    OPENSSL_cleanse( ticket_key.key, sizeof(ticket_key.key) );
+
+    return opened
+           && state.issue_time_ms <= now_ms
+           && now_ms - state.issue_time_ms <= uint64_t{m_rotation_interval}*1000
+           && state.psk_size <= sizeof(state.psk);
+}
+
+TicketCache& TicketCache::instance()
+{
+    static thread_local TicketCache ticket_cache;
+    return ticket_cache;
+}
+
+void TicketCache::store( const std::string& server_name, ClientTicket&& ticket )
+{
+    auto it = m_servers.find( server_name );
+    if( it == m_servers.end() )
+    {
+        m_lru.emplace_front( server_name, std::deque<ClientTicket>{} );
+        it = m_servers.emplace( server_name, m_lru.begin() ).first;
+        if( m_servers.size() > m_capacity )
+        {
+            m_servers.erase( m_lru.back().first );
+            m_lru.pop_back();
+        }
+    }
+    else
+        m_lru.splice( m_lru.begin(), m_lru, it->second );
+
+    auto& tickets = it->second->second;
+    tickets.push_back( std::move(ticket) );
+    if( tickets.size() > TICKETS_PER_SERVER )
+        tickets.pop_front();
+}
+
+std::optional<ClientTicket> TicketCache::take( const std::string& server_name, uint64_t now_ms )
+{
+    auto it = m_servers.find( server_name );
+    if( it == m_servers.end() )
+        return std::nullopt;
+
+    auto& tickets = it->second->second;
+    std::optional<ClientTicket> ticket;
+    // newest ticket last
+    while( !tickets.empty() && !ticket )
+    {
+        if( !tickets.back().expired( now_ms ) )
+            ticket.emplace( std::move(tickets.back()) );
+        tickets.pop_back();
+    }
+    if( tickets.empty() )
+    {
+        m_lru.erase( it->second );
+        m_servers.erase( it );
+    }
+
+    return ticket;
+}
+
+void TicketCache::clear()
+{
+    m_servers.clear();
+    m_lru.clear();
+}
+
+}
@@ -0,0 +1,174 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <list>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+
+#include <openssl/evp.h>
+
+#include <libcornet/tls/types.hpp>
+
+namespace pioneer19::cornet::tls13
+{
+
+/**
+ * @brief server resumption state, sealed into NewSessionTicket.ticket
+ */
+struct SessionTicketState
+{
+    static constexpr uint32_t SERVER_NAME_HASH_SIZE = 32;
+
+    /// ticket resumes session only for the same SNI (SHA-256 of server name is sealed)
+    void set_server_name( const std::string& server_name ) noexcept;
+    [[nodiscard]]
+    bool server_name_equal( const std::string& server_name ) const noexcept;
+
+    record::CipherSuite cipher_suite;
+    uint32_t ticket_age_add;
+    uint64_t issue_time_ms;  ///< system clock milliseconds
+    uint8_t  server_name_hash[SERVER_NAME_HASH_SIZE];
+    uint8_t  psk_size;
+    uint8_t  psk[EVP_MAX_MD_SIZE];
+};
+
+/**
+ * @brief keys for stateless session tickets, shared by all server threads
+ *
+ * ticket = key_name | iv | AES-256-GCM( SessionTicketState ) | tag
+ * Current key seals new tickets, previous key still opens tickets issued
+ * before last rotation. Keys are random and never leave the process.
+ */
+class SessionTicketKeys
+{
+public:
+    static constexpr uint32_t KEY_NAME_SIZE = 16;
+    static constexpr uint32_t KEY_SIZE = 32;
+    static constexpr uint32_t IV_SIZE  = 12;
+    static constexpr uint32_t TAG_SIZE = 16;
+    static constexpr uint32_t TICKET_SIZE =
+            KEY_NAME_SIZE + IV_SIZE + sizeof(SessionTicketState) + TAG_SIZE;
+    static constexpr uint32_t DEFAULT_ROTATION_INTERVAL = 3600; ///< seconds
+
+    explicit SessionTicketKeys( uint32_t rotation_interval = DEFAULT_ROTATION_INTERVAL );
+    ~SessionTicketKeys() = default;
+
+    static SessionTicketKeys& instance();
+    static uint64_t now_ms() noexcept;
+
+    /**
+     * encrypt state to ticket buffer (must have TICKET_SIZE bytes)
+     * @return ticket size or 0 on error
+     */
+    uint32_t seal( const SessionTicketState& state, uint8_t* ticket, uint64_t now_ms );
+    /**
+     * decrypt ticket sealed by current or previous key and check ticket lifetime
+     * @return true if state restored
+     */
+    bool open( const uint8_t* ticket, uint32_t ticket_size, SessionTicketState& state, uint64_t now_ms );
+    /**
+     * make current key previous and generate new current key
+     */
+    void rotate( uint64_t now_ms );
+
+    [[nodiscard]]
+    uint32_t ticket_lifetime() const noexcept { return m_rotation_interval; }
+    [[nodiscard]]
+    bool issue_tickets() const noexcept { return m_issue_tickets.load( std::memory_order_relaxed ); }
+    void set_issue_tickets( bool issue ) noexcept { m_issue_tickets.store( issue, std::memory_order_relaxed ); }
+
+    SessionTicketKeys( const SessionTicketKeys& ) = delete;
+    SessionTicketKeys( SessionTicketKeys&& )      = delete;
+    SessionTicketKeys& operator=( const SessionTicketKeys& ) = delete;
+    SessionTicketKeys& operator=( SessionTicketKeys&& )      = delete;
+
+private:
+    struct TicketKey
+    {
+        uint8_t  name[KEY_NAME_SIZE] = {};
+        uint8_t  key[KEY_SIZE] = {};
+        uint64_t create_time_ms = 0;
+    };
+    void rotate_locked( uint64_t now_ms );
+    [[nodiscard]]
+    bool find_key( const uint8_t* key_name, TicketKey& ticket_key );
+
+    std::mutex m_mutex;
+    TicketKey  m_current;
+    TicketKey  m_previous;
+    uint32_t   m_rotation_interval;
+    std::atomic<bool> m_issue_tickets = true;
+};
+
+/**
+ * @brief session ticket received by client in NewSessionTicket
+ */
+struct ClientTicket
+{
+    std::vector<uint8_t> ticket;
+    record::CipherSuite  cipher_suite = record::TLS_PRIVATE_CIPHER_SUITE;
+    uint32_t ticket_age_add  = 0;
+    uint32_t ticket_lifetime = 0; ///< seconds
+    uint64_t receive_time_ms = 0;
+    uint32_t max_early_data_size = 0;
+    uint8_t  psk_size = 0;
+    uint8_t  psk[EVP_MAX_MD_SIZE];
+
+    [[nodiscard]]
+    uint32_t obfuscated_ticket_age( uint64_t now_ms ) const noexcept
+    { return static_cast<uint32_t>( now_ms - receive_time_ms ) + ticket_age_add; }
+    [[nodiscard]]
+    bool expired( uint64_t now_ms ) const noexcept
+    { return now_ms >= receive_time_ms + uint64_t{ticket_lifetime}*1000; }
+};
+
+/**
+ * @brief per thread client cache of session tickets by server name (LRU)
+ *
+ * Tickets are single use (RFC 8446 C.4), take() removes ticket from cache.
+ */
+class TicketCache
+{
+public:
+    static constexpr uint32_t DEFAULT_CAPACITY   = 256; ///< servers count
+    static constexpr uint32_t TICKETS_PER_SERVER = 4;
+
+    explicit TicketCache( uint32_t capacity = DEFAULT_CAPACITY ) : m_capacity{capacity} {}
+    ~TicketCache() = default;
+
+    static TicketCache& instance();
+
+    void store( const std::string& server_name, ClientTicket&& ticket );
+    std::optional<ClientTicket> take( const std::string& server_name, uint64_t now_ms );
+    [[nodiscard]]
+    size_t size() const noexcept { return m_servers.size(); }
+    void clear();
+
+    TicketCache( const TicketCache& ) = delete;
+    TicketCache( TicketCache&& )      = delete;
+    TicketCache& operator=( const TicketCache& ) = delete;
+    TicketCache& operator=( TicketCache&& )      = delete;
+
+private:
+    using ServerTickets = std::pair<std::string,std::deque<ClientTicket>>;
+    using LruList = std::list<ServerTickets>;
+
+    LruList  m_lru; ///< most recently used server first
+    std::unordered_map<std::string,LruList::iterator> m_servers;
+    uint32_t m_capacity;
+};
+
+}
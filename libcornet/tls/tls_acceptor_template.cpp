@@ -7,14 +7,28 @@
 
 #include <libcornet/tls/tls_acceptor_template.hpp>
 
+#include <cstring>
+#include <cassert>
+#include <string>
 #include <algorithm>
 
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
+
+#include <libcornet/crypto.hpp>
 #include <libcornet/tls/parser.hpp>
 #include <libcornet/tls/crypto/dhe_groups.hpp>
+#include <libcornet/tls/crypto/crypto_workers.hpp>
 #include <libcornet/tls/crypto/record_ciphers.hpp>
+#include <libcornet/tls/crypto/cipher_preference.hpp>
+#include <libcornet/tls/crypto/named_group_preference.hpp>
 #include <libcornet/tls/crypto/tls_handshake.hpp>
 #include <libcornet/tls/tls_socket.hpp>
 #include <libcornet/tls/record_helpers.hpp>
+#include <libcornet/tls/session_ticket.hpp>
+#include <libcornet/trace.hpp>
+#include <libcornet/metrics.hpp>
+#include <libcornet/tls/anti_replay.hpp>
 
 namespace pioneer19::cornet::tls13
 {
@@ -29,6 +43,8 @@ struct ClientHelloHook : record::EmptyHook
     {}
     ~ClientHelloHook() = default;
     // hooks
+    void tls_handshake( const record::Handshake* handshake )
+    { m_client_hello = reinterpret_cast<const uint8_t*>( handshake ); }
     void client_hello_legacy_session_id( const record::LegacySessionId* legacy_session_id ) const;
     void client_hello_cipher_suites( const record::CipherSuite*, uint32_t );
     void extension_server_name( record::NameType, const uint8_t* name, uint16_t name_size )
@@ -38,9 +54,26 @@ struct ClientHelloHook : record::EmptyHook
     void named_group( record::NamedGroup named_group );
     void signature_scheme( record::SignatureScheme );
     void key_share_entry( record::NamedGroup, const uint8_t*, uint16_t );
+    void psk_key_exchange_mode( record::PskKeyExchangeMode );
+    void psk_identity( const uint8_t* identity, uint16_t identity_size, uint32_t obfuscated_ticket_age );
+    void psk_binders( const uint8_t* binders ) { m_psk.binders = binders; }
+    void psk_binder( const uint8_t* binder, uint8_t binder_size );
+    void extension_early_data( uint32_t ) { m_early_data_offered = true; }
+    void certificate_compression_algorithm( record::CertificateCompressionAlgorithm algorithm );
+    void status_request( record::CertificateStatusType status_type )
+    { if( status_type == record::CertificateStatusType::OCSP ) m_tls_handshake.ocsp_status_requested = true; }
 
     [[nodiscard]]
     bool commit( TlsReadBuffer& buffer, KeyStore* domain_keys_store );
+    [[nodiscard]]
+    bool resume_session();
+    [[nodiscard]]
+    bool accept_early_data();
+    /**
+     * DHE (or psk_ke zero) shared secret from ClientHello key_share,
+     * key_share data is in read buffer, so call it before buffer consumed
+     */
+    void derive_shared_secret();
 
     crypto::TlsHandshake& m_tls_handshake;
 
@@ -49,6 +82,9 @@ struct ClientHelloHook : record::EmptyHook
     record::SignatureScheme signature_schemes[SIGNATURE_SCHEMES_ARRAY_SIZE];
 
     record::LegacySessionId* legacy_session_container;
+    const uint8_t*             m_client_hello = nullptr;
+    const record::CipherSuite* m_client_cipher_suites = nullptr;
+    uint32_t                   m_client_cipher_suites_count = 0;
     record::CipherSuite m_cipher_suite = record::TLS_PRIVATE_CIPHER_SUITE;
     record::NamedGroup  m_supported_group = record::NamedGroup::TLS_PRIVATE_NAMED_GROUP;
     struct {
@@ -56,7 +92,24 @@ struct ClientHelloHook : record::EmptyHook
         uint16_t       data_size = {};
         const uint8_t* key_data  = {};
     } m_key_share;
-    bool m_tls13_supported = false;
+    // first offered psk
+    struct {
+        const uint8_t* identity = nullptr;
+        uint16_t       identity_size = 0;
+        uint32_t       obfuscated_ticket_age = 0;
+        const uint8_t* binders = nullptr;
+        const uint8_t* binder  = nullptr;
+        uint8_t        binder_size = 0;
+        bool           psk_ke     = false;
+        bool           psk_dhe_ke = false;
+        // accepted ticket data
+        uint32_t       ticket_age_add = 0;
+        uint64_t       issue_time_ms  = 0;
+    } m_psk;
+    uint32_t m_compression_algorithms = 0; ///< offered RFC 8879 algorithms bit mask
+    bool m_tls13_supported    = false;
+    bool m_early_data_offered = false;
+    bool m_dhe_key_exchange   = false;
 
     ClientHelloHook() = delete;
     ClientHelloHook( const ClientHelloHook& ) = delete;
@@ -68,19 +121,15 @@ struct ClientHelloHook : record::EmptyHook
 inline void ClientHelloHook::client_hello_cipher_suites(
         const record::CipherSuite* cipher_suite, uint32_t size_in_bytes )
 {
-    for( uint32_t idx = 0; idx < size_in_bytes/sizeof(record::CipherSuite); ++idx )
-    {
-        if( crypto::TlsCipherSuite::is_supported_cipher_suite(cipher_suite[idx]) )
-        {
-            m_cipher_suite = cipher_suite[idx];
-            break;
-        }
-    }
+    m_client_cipher_suites = cipher_suite;
+    m_client_cipher_suites_count = size_in_bytes/sizeof(record::CipherSuite);
+    m_cipher_suite = crypto::CipherSuitePreference::instance().select(
+            cipher_suite, m_client_cipher_suites_count );
 }
 void ClientHelloHook::named_group( record::NamedGroup group )
 {
     if( m_supported_group == record::NamedGroup::TLS_PRIVATE_NAMED_GROUP
-        && crypto::DheGroup::is_supported(group) )
+        && crypto::NamedGroupPreference::instance().is_enabled( group ) )
     {
         m_supported_group = group;
     }
@@ -88,7 +137,7 @@ void ClientHelloHook::named_group( record::NamedGroup group )
 void ClientHelloHook::key_share_entry( record::NamedGroup named_group, const uint8_t* key_data, uint16_t data_size )
 {
     if( m_key_share.named_group == record::NamedGroup::TLS_PRIVATE_NAMED_GROUP
-        && crypto::DheGroup::is_supported(named_group) )
+        && crypto::NamedGroupPreference::instance().is_enabled( named_group ) )
     {
         m_key_share.named_group = named_group;
         m_key_share.key_data = key_data;
@@ -96,32 +145,211 @@ void ClientHelloHook::key_share_entry( record::NamedGroup named_group, const uin
     }
 }
 
-bool ClientHelloHook::commit( TlsReadBuffer& buffer, KeyStore* domain_keys_store )
+void ClientHelloHook::psk_key_exchange_mode( record::PskKeyExchangeMode mode )
 {
-    if( !m_tls13_supported
-        || m_cipher_suite == record::TLS_PRIVATE_CIPHER_SUITE
-        || m_key_share.named_group == record::NamedGroup::TLS_PRIVATE_NAMED_GROUP )
+    if( mode == record::PskKeyExchangeMode::PSK_KE )
+        m_psk.psk_ke = true;
+    else if( mode == record::PskKeyExchangeMode::PSK_DHE_KE )
+        m_psk.psk_dhe_ke = true;
+}
+void ClientHelloHook::psk_identity( const uint8_t* identity, uint16_t identity_size, uint32_t obfuscated_ticket_age )
+{
+    if( m_psk.identity == nullptr )
+    {
+        m_psk.identity = identity;
+        m_psk.identity_size = identity_size;
+        m_psk.obfuscated_ticket_age = obfuscated_ticket_age;
+    }
+}
+void ClientHelloHook::psk_binder( const uint8_t* binder, uint8_t binder_size )
+{
+    if( m_psk.binder == nullptr )
     {
-        // FIXME: send HelloRetryRequest if m_key_share.named_group is empty
-        // but m_supported_group not
+        m_psk.binder = binder;
+        m_psk.binder_size = binder_size;
+    }
+}
+
+/**
+ * try to resume session with first offered psk (ticket issued by this server)
+ * @return true if psk accepted, cipher suite and early secret are set
+ */
+bool ClientHelloHook::resume_session()
+{
+    if( m_psk.identity == nullptr || m_psk.binder == nullptr || m_psk.binders == nullptr
+        || m_client_hello == nullptr )
+    {
+        return false;
+    }
+    bool key_share_present = m_key_share.named_group != record::NamedGroup::TLS_PRIVATE_NAMED_GROUP;
+    record::PskKeyExchangeMode psk_mode;
+    if( m_psk.psk_dhe_ke && key_share_present )
+        psk_mode = record::PskKeyExchangeMode::PSK_DHE_KE;
+    else if( m_psk.psk_ke )
+        psk_mode = record::PskKeyExchangeMode::PSK_KE;
+    else
+        return false;
+
+    SessionTicketState state{};
+    if( !SessionTicketKeys::instance().open(
+            m_psk.identity, m_psk.identity_size, state, SessionTicketKeys::now_ms() ) )
+    {
+        return false;
+    }
+    // ticket issued for other domain of this server makes full handshake
+    if( !state.server_name_equal( *m_tls_handshake.accept_sni ) )
+    {
+        OPENSSL_cleanse( state.psk, sizeof(state.psk) );
         return false;
     }
-    m_tls_handshake.set_named_group( m_key_share.named_group );
-    m_tls_handshake.set_tls_cipher_suite( m_cipher_suite );
+    // ticket cipher suite must be offered again
+    auto suites_end = m_client_cipher_suites + m_client_cipher_suites_count;
+    if( std::find( m_client_cipher_suites, suites_end, state.cipher_suite ) == suites_end )
+        return false;
+    // after HelloRetryRequest suite is selected and transcript is started
+    if( m_tls_handshake.hello_retried() )
+    {
+        if( state.cipher_suite != m_tls_handshake.cipher_suite() )
+            return false;
+    }
+    else
+        m_tls_handshake.set_tls_cipher_suite( state.cipher_suite );
+    m_tls_handshake.set_resumption_psk( state.cipher_suite, state.psk, state.psk_size );
+    OPENSSL_cleanse( state.psk, sizeof(state.psk) );
+    m_psk.ticket_age_add = state.ticket_age_add;
+    m_psk.issue_time_ms  = state.issue_time_ms;
+
+    uint8_t binder[EVP_MAX_MD_SIZE];
+    uint32_t binder_size = m_tls_handshake.psk_binder(
+            m_client_hello, m_psk.binders - m_client_hello, binder );
+    if( binder_size != m_psk.binder_size
+        || CRYPTO_memcmp( binder, m_psk.binder, binder_size ) != 0 )
+    {
+        throw std::runtime_error( "ClientHelloHook::resume_session() psk binder verification failed" );
+    }
+
+    m_tls_handshake.psk_mode    = psk_mode;
+    m_tls_handshake.psk_resumed = true;
+
+    return true;
+}
+
+/**
+ * accept 0-RTT if domain policy allows it, ticket age is fresh and
+ * ClientHello is not replayed. Transcript must contain ClientHello only.
+ * @return true if early data accepted and early traffic secret derived
+ */
+bool ClientHelloHook::accept_early_data()
+{
+    uint32_t max_early_data_size = m_tls_handshake.domain_keys->max_early_data_size;
+    if( max_early_data_size == 0 )
+        return false;
+
+    EarlyDataAntiReplay& anti_replay = EarlyDataAntiReplay::instance();
+    uint64_t now_ms = SessionTicketKeys::now_ms();
+    uint32_t client_ticket_age = m_psk.obfuscated_ticket_age - m_psk.ticket_age_add;
+    if( !anti_replay.fresh_ticket_age( client_ticket_age, m_psk.issue_time_ms, now_ms ) )
+        return false;
+
+    uint8_t client_hello_hash[EVP_MAX_MD_SIZE];
+    uint32_t hash_size = m_tls_handshake.current_transcript_hash( client_hello_hash );
+    if( !anti_replay.check_and_insert( client_hello_hash, hash_size, now_ms ) )
+        return false;
+
+    m_tls_handshake.derive_client_early_traffic_secret( client_hello_hash );
+    m_tls_handshake.max_early_data_size = max_early_data_size;
+    m_tls_handshake.early_data_accepted = true;
+
+    return true;
+}
+
+void ClientHelloHook::derive_shared_secret()
+{
+    if( m_dhe_key_exchange )
+    {
+        m_tls_handshake.set_handshake_hello_key_share(
+                m_key_share.named_group, m_key_share.key_data, m_key_share.data_size
+        );
+    }
+    else
+        m_tls_handshake.set_psk_ke_shared_secret();
+}
+
+/**
+ * @return false if ClientHello is not acceptable, m_hello_type is HelloRetry
+ * if HelloRetryRequest must be sent
+ */
+bool ClientHelloHook::commit( TlsReadBuffer& buffer, KeyStore* domain_keys_store )
+{
+    if( !m_tls13_supported || m_cipher_suite == record::TLS_PRIVATE_CIPHER_SUITE )
+        return false;
+
+    bool hello_retried = m_tls_handshake.hello_retried();
+    if( hello_retried )
+    {   // second ClientHello must offer HelloRetryRequest suite and must not send early data
+        auto suites_end = m_client_cipher_suites + m_client_cipher_suites_count;
+        if( std::find( m_client_cipher_suites, suites_end, m_tls_handshake.cipher_suite() ) == suites_end
+            || m_early_data_offered )
+        {
+            return false;
+        }
+        m_tls_handshake.psk_resumed = false;
+    }
+
+    bool psk_resumed = resume_session();
+    bool dhe_key_exchange = !psk_resumed
+            || m_tls_handshake.psk_mode == record::PskKeyExchangeMode::PSK_DHE_KE;
+    if( dhe_key_exchange && m_key_share.named_group == record::NamedGroup::TLS_PRIVATE_NAMED_GROUP )
+    {
+        // single HelloRetryRequest for mutually supported group without client key share
+        if( hello_retried || m_supported_group == record::NamedGroup::TLS_PRIVATE_NAMED_GROUP )
+            return false;
+        if( !psk_resumed )
+            m_tls_handshake.set_tls_cipher_suite( m_cipher_suite );
+        m_tls_handshake.add_message_hash( record::handshake_message( buffer.head() )
+                                          ,record::record_content_size( buffer.head() ) );
+        m_tls_handshake.hello_retry_group = m_supported_group;
+        m_tls_handshake.m_hello_type = crypto::TlsHandshake::HelloType::HelloRetry;
+        m_tls_handshake.psk_resumed = false;
+        // early data of first flight is skipped before second ClientHello
+        m_tls_handshake.early_data_offered = m_early_data_offered;
+        return true;
+    }
+    if( hello_retried && dhe_key_exchange && m_key_share.named_group != m_tls_handshake.hello_retry_group )
+        return false;
+    if( !psk_resumed && !hello_retried )
+        m_tls_handshake.set_tls_cipher_suite( m_cipher_suite );
     m_tls_handshake.add_message( record::handshake_message( buffer.head() )
                                  ,record::record_content_size( buffer.head() ) );
 
-    m_tls_handshake.set_handshake_hello_key_share(
-            m_key_share.named_group, m_key_share.key_data, m_key_share.data_size
-    );
+    m_dhe_key_exchange = dhe_key_exchange;
+    // ephemeral key is taken from per thread pool of poller thread
+    if( dhe_key_exchange )
+        m_tls_handshake.set_named_group( m_key_share.named_group );
 
-    m_tls_handshake.domain_keys = domain_keys_store->find( m_tls_handshake.accept_sni->c_str() );
+    m_tls_handshake.domain_keys = domain_keys_store->acquire( m_tls_handshake.accept_sni->c_str()
+                                                              , m_tls_handshake.domain_keys_ref );
     if( m_tls_handshake.domain_keys == nullptr )
         throw std::runtime_error( "ClientHelloHook::commit() failed find domain \""
                                   + *m_tls_handshake.accept_sni +"\"" );
-    // find signature scheme for certificate
-    m_tls_handshake.cert_signature_scheme = KeyStore::find_best_signature_scheme( signature_schemes, signature_schemes_count
-                                                                                  , m_tls_handshake.domain_keys->signature_schemes );
+    // resumed session is authenticated by psk, certificate is not sent
+    if( !psk_resumed )
+    {
+        // find signature scheme for certificate
+        m_tls_handshake.cert_signature_scheme = KeyStore::find_best_signature_scheme(
+                signature_schemes, signature_schemes_count, m_tls_handshake.domain_keys->signature_schemes );
+        // only algorithm of prepared compressed message is used
+        auto compression = m_tls_handshake.domain_keys->certificate_compression;
+        if( compression != record::CertificateCompressionAlgorithm::NONE
+            && (m_compression_algorithms & (1u << static_cast<uint16_t>(compression))) )
+        {
+            m_tls_handshake.certificate_compression = compression;
+        }
+    }
+    // early data is possible only with first psk, rejected data is skipped until client Finished
+    m_tls_handshake.early_data_offered = m_early_data_offered;
+    if( m_early_data_offered && psk_resumed )
+        static_cast<void>( accept_early_data() );
 
     return true;
 }
@@ -133,6 +361,12 @@ void ClientHelloHook::client_hello_legacy_session_id( const record::LegacySessio
                , reinterpret_cast<uint8_t*>(legacy_session_container) );
 }
 
+void ClientHelloHook::certificate_compression_algorithm( record::CertificateCompressionAlgorithm algorithm )
+{
+    if( static_cast<uint16_t>(algorithm) < 32 )
+        m_compression_algorithms |= 1u << static_cast<uint16_t>(algorithm);
+}
+
 void ClientHelloHook::signature_scheme( record::SignatureScheme scheme )
 {
     if( KeyStore::is_supported_signature_scheme( scheme )
@@ -150,8 +384,17 @@ CoroutineAwaiter<bool> TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::read_client_hello_rec
     TlsReadBuffer& read_buffer = record_layer.m_read_buffer;
 
     co_await record_layer.read_full_record_skip_change_cipher_spec(); // FIXME: check result
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        record::print_net_record( read_buffer.head(), read_buffer.size() );
+    // early data of first flight is skipped after HelloRetryRequest (RFC 8446 4.2.10)
+    uint32_t skipped_size = 0;
+    while( tls_handshake.hello_retried() && tls_handshake.early_data_offered
+           && record::record_content_type( read_buffer.head() ) == record::ContentType::APPLICATION_DATA )
+    {
+        skipped_size += record::full_record_size( read_buffer.head() );
+        if( skipped_size > MAX_REJECTED_EARLY_DATA_SIZE )
+            throw std::runtime_error( "TlsAcceptor::read_client_hello_record() too much early data" );
+        read_buffer.consume( record::full_record_size( read_buffer.head() ) );
+        co_await record_layer.read_full_record_skip_change_cipher_spec();
+    }
 
     auto encrypted_record_size = record::full_record_size( read_buffer.head() );
 
@@ -169,7 +412,11 @@ CoroutineAwaiter<bool> TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::read_client_hello_rec
     if( err )
         throw std::runtime_error( "TlsAcceptor::read_client_hello_record() failed parse ClientHello message" );
 
-    client_hello_hook.commit( read_buffer, domain_keys_store ); // FIXME: check result
+    if( !client_hello_hook.commit( read_buffer, domain_keys_store ) )
+        throw std::runtime_error( "TlsAcceptor::read_client_hello_record() ClientHello parameters not acceptable" );
+    // DHE derive runs in crypto worker thread if CryptoWorkers started
+    if( tls_handshake.m_hello_type != crypto::TlsHandshake::HelloType::HelloRetry )
+        co_await crypto::CryptoWorkers::offload( [&client_hello_hook](){ client_hello_hook.derive_shared_secret(); } );
 
     read_buffer.consume( encrypted_record_size );
 
@@ -220,7 +467,11 @@ CoroutineAwaiter<bool> TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::read_client_finished_
         RecordLayer& record_layer, crypto::TlsHandshake& tls_handshake, record::Parser& parser )
 {
     TlsReadBuffer& read_buffer = record_layer.m_read_buffer;
-    uint32_t encrypted_record_size = co_await record_layer.read_record_decrypt_and_skip_change_cipher();
+    uint32_t encrypted_record_size = 0;
+    if( tls_handshake.early_data_offered && !tls_handshake.early_data_accepted )
+        encrypted_record_size = co_await skip_rejected_early_data( record_layer );
+    else
+        encrypted_record_size = co_await record_layer.read_record_decrypt_and_skip_change_cipher();
 
     if( ! record::is_handshake_record( read_buffer.head() ) )
         co_return false; // FIXME: probably need to send some Alert
@@ -245,6 +496,84 @@ CoroutineAwaiter<bool> TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::read_client_finished_
 
     co_return true;
 }
+/**
+ * read 0-RTT application data (protected by client early traffic keys) until
+ * EndOfEarlyData, data is kept in record layer for async_read()
+ */
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+CoroutineAwaiter<void> TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::read_early_data_records(
+        RecordLayer& record_layer, crypto::TlsHandshake& tls_handshake, record::Parser& parser )
+{
+    TlsReadBuffer& read_buffer = record_layer.m_read_buffer;
+    tls_handshake.set_early_data_traffic_keys( false );
+
+    while( true )
+    {
+        uint32_t encrypted_record_size = co_await record_layer.read_record_decrypt_and_skip_change_cipher();
+        if( record::record_content_type( read_buffer.head() ) == record::ContentType::APPLICATION_DATA )
+        {
+            uint32_t content_size = record::record_content_size( read_buffer.head() );
+            if( record_layer.m_early_data.size() + content_size > tls_handshake.max_early_data_size )
+                throw std::runtime_error( "TlsAcceptor::read_early_data_records() early data exceeds max_early_data_size" );
+            const uint8_t* content = read_buffer.head() + sizeof(record::TlsPlaintext);
+            record_layer.m_early_data.insert( record_layer.m_early_data.end(), content, content + content_size );
+            read_buffer.consume( encrypted_record_size );
+            continue;
+        }
+        if( !record::is_handshake_record( read_buffer.head() )
+            || record::record_handshake_type( read_buffer.head() ) != record::HandshakeType::END_OF_EARLY_DATA )
+        {
+            throw std::runtime_error( "TlsAcceptor::read_early_data_records() got unexpected record instead of EndOfEarlyData" );
+        }
+        auto[bytes_parsed, err] = parser.parse_net_record<record::EmptyHook>(
+                nullptr, read_buffer.head(), read_buffer.size() );
+        if( err )
+            throw std::runtime_error( "TlsAcceptor::read_early_data_records() failed parse EndOfEarlyData" );
+
+        tls_handshake.add_message( record::handshake_message( read_buffer.head() )
+                                   ,record::record_content_size( read_buffer.head() ) );
+        read_buffer.consume( encrypted_record_size );
+        break;
+    }
+
+    tls_handshake.set_client_handshake_traffic_keys( false );
+    record_layer.m_early_data_size = record_layer.m_early_data.size();
+}
+
+/**
+ * rejected 0-RTT records can not be decrypted by handshake keys and are
+ * skipped (RFC 8446 4.2.10) up to MAX_REJECTED_EARLY_DATA_SIZE bytes
+ * @return size of first record decrypted by current keys
+ */
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+CoroutineAwaiter<uint32_t> TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::skip_rejected_early_data( RecordLayer& record_layer )
+{
+    TlsReadBuffer& read_buffer = record_layer.m_read_buffer;
+    uint32_t skipped_size = 0;
+    while( true )
+    {
+        co_await record_layer.read_full_record_skip_change_cipher_spec();
+        uint32_t encrypted_record_size = record::full_record_size( read_buffer.head() );
+        if( record::record_content_type( read_buffer.head() ) != record::ContentType::APPLICATION_DATA )
+        {
+            throw std::runtime_error(
+                    "TlsAcceptor::skip_rejected_early_data() got unencrypted record content type "
+                    + std::to_string( static_cast<uint8_t>(record::record_content_type( read_buffer.head()))));
+        }
+        uint32_t bytes_decrypted = record_layer.m_cryptor.try_decrypt_record( read_buffer.head() );
+        if( bytes_decrypted > 0 )
+        {
+            RecordLayer::unpad_inner_plaintext( read_buffer.head(), bytes_decrypted );
+            co_return encrypted_record_size;
+        }
+
+        skipped_size += encrypted_record_size;
+        if( skipped_size > MAX_REJECTED_EARLY_DATA_SIZE )
+            throw std::runtime_error( "TlsAcceptor::skip_rejected_early_data() too much early data" );
+        read_buffer.consume( encrypted_record_size );
+    }
+}
+
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
 uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::produce_server_hello_record(
         TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake )
@@ -253,8 +582,7 @@ uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::produce_server_hello_record(
 //                record_layer, tls_handshake );
 
     auto server_hello_record_size = RecordHelpers::create_server_hello_record( tls_handshake, buffer.tail());
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        record::print_net_record( buffer.tail(), server_hello_record_size );
+    TraceRing::instance().add_net_record( TraceEvent::HANDSHAKE_MESSAGE, tls_handshake.connection_id, buffer.tail() );
 
     tls_handshake.add_message( record::handshake_message( buffer.tail() )
                                ,record::record_content_size( buffer.tail() ) );
@@ -265,77 +593,168 @@ uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::produce_server_hello_record(
     return server_hello_record_size;
 }
 
+/**
+ * HelloRetryRequest follows message_hash of ClientHello1 in transcript
+ */
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
-uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::produce_encrypted_extensions_record(
+uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::produce_hello_retry_request_record(
         TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake )
 {
-    auto encrypted_extensions_record_size = RecordHelpers::create_encrypted_extensions_record(
-            tls_handshake, buffer.tail() );
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        record::print_net_record( buffer.tail(), encrypted_extensions_record_size );
+    auto record_size = RecordHelpers::create_server_hello_record( tls_handshake, buffer.tail() );
+    TraceRing::instance().add_net_record( TraceEvent::HANDSHAKE_MESSAGE, tls_handshake.connection_id, buffer.tail() );
 
     tls_handshake.add_message( record::handshake_message( buffer.tail() )
                                ,record::record_content_size( buffer.tail() ) );
+    ThreadMetrics::instance().add( Counter::SERVER_HELLO_RETRY_REQUESTS );
 
-    auto encrypted_size = tls_handshake.m_record_cryptor.encrypt_record( buffer.tail()
-                                                        , record::record_content_data( buffer.tail()), record::record_content_size( buffer.tail() ) );
-
-    buffer.produce( encrypted_size );
+    buffer.produce( record_size );
 
-    return encrypted_size;
+    return record_size;
 }
 
+/**
+ * create_record() makes full record with handshake message, record is placed so that
+ * message continues flight content and record header overlaps flight tail (saved and
+ * restored after message added to transcript), so message is not copied
+ */
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
-uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::produce_certificate_record(
-        TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake )
+template< typename CreateRecord >
+uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::append_flight_message(
+        TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake
+        , uint32_t flight_size, CreateRecord create_record )
 {
-    auto certificate_record_size = RecordHelpers::create_certificate_record( tls_handshake, buffer.tail() );
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        record::print_net_record( buffer.tail(), certificate_record_size );
+    uint8_t* record = buffer.tail() + flight_size;
+    uint8_t flight_tail[sizeof(record::TlsPlaintext)];
+    if( flight_size > 0 )
+        std::memcpy( flight_tail, record, sizeof(flight_tail) );
 
-    tls_handshake.add_message( record::handshake_message( buffer.tail() )
-                               ,record::record_content_size( buffer.tail() ) );
+    uint32_t record_size = create_record( record );
+    TraceRing::instance().add_net_record( TraceEvent::HANDSHAKE_MESSAGE, tls_handshake.connection_id, record );
+    tls_handshake.add_message( record::handshake_message( record ), record::record_content_size( record ) );
 
-    auto encrypted_size = tls_handshake.m_record_cryptor.encrypt_record( buffer.tail()
-                                                        , record::record_content_data( buffer.tail() )
-                                                        , record::record_content_size( buffer.tail() ) );
+    if( flight_size > 0 )
+        std::memcpy( record, flight_tail, sizeof(flight_tail) );
 
-    buffer.produce( encrypted_size );
+    return flight_size + record_size - sizeof(record::TlsPlaintext);
+}
 
-    return encrypted_size;
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::append_encrypted_extensions(
+        TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake, uint32_t flight_size )
+{
+    return append_flight_message( buffer, tls_handshake, flight_size, [&tls_handshake]( uint8_t* record ){
+        return RecordHelpers::create_encrypted_extensions_record( tls_handshake, record ); } );
 }
 
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
-uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::produce_certificate_verify_record(
-        TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake )
+uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::append_certificate(
+        TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake, uint32_t flight_size )
 {
-    auto certificate_verify_record_size = RecordHelpers::create_certificate_verify_record(
-            tls_handshake, buffer.tail() );
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        record::print_net_record( buffer.tail(), certificate_verify_record_size );
+    // KeyStore does not limit certificate chain size, so whole flight (with CertificateVerify
+    // and Finished of max size) is checked to fit write buffer before it is written
+    uint32_t certificate_size = RecordHelpers::certificate_record_buffer_size( tls_handshake )
+                                - sizeof(record::TlsPlaintext);
+    uint32_t certificate_verify_size = sizeof(record::Handshake) + sizeof(record::SignatureScheme)
+                                       + sizeof(uint16_t) + EVP_PKEY_size( tls_handshake.domain_keys->key );
+    uint32_t finished_size = sizeof(record::Handshake) + EVP_MAX_MD_SIZE;
+    uint32_t max_flight_size = flight_size + certificate_size + certificate_verify_size + finished_size;
+    if( encrypted_flight_buffer_size( max_flight_size ) > buffer.tail_size() )
+    {
+        throw std::runtime_error( "TlsAcceptor::append_certificate() server flight with certificate "
+                                  + std::to_string( certificate_size ) + " bytes does not fit write buffer" );
+    }
 
-    tls_handshake.add_message( record::handshake_message( buffer.tail() )
-                               ,record::record_content_size( buffer.tail() ) );
+    return append_flight_message( buffer, tls_handshake, flight_size, [&tls_handshake]( uint8_t* record ){
+        return RecordHelpers::create_certificate_record( tls_handshake, record ); } );
+}
+
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::append_certificate_verify(
+        TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake, uint32_t flight_size )
+{
+    return append_flight_message( buffer, tls_handshake, flight_size, [&tls_handshake]( uint8_t* record ){
+        return RecordHelpers::create_certificate_verify_record( tls_handshake, record ); } );
+}
+
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::append_server_finished(
+        TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake, uint32_t flight_size )
+{
+    return append_flight_message( buffer, tls_handshake, flight_size, [&tls_handshake]( uint8_t* record ){
+        return RecordHelpers::create_server_finished_record( tls_handshake, record ); } );
+}
+
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::encrypted_flight_buffer_size( uint32_t flight_size ) noexcept
+{
+    const uint32_t record_overhead = sizeof(record::TLSCiphertext) + sizeof(record::ContentType)
+                                     + crypto::TlsCipherSuite::tag_size();
+    uint32_t records_count = (flight_size + MAX_FLIGHT_RECORD_CONTENT - 1) / MAX_FLIGHT_RECORD_CONTENT;
+    return flight_size + records_count*record_overhead;
+}
 
-    auto encrypted_size = tls_handshake.m_record_cryptor.encrypt_record( buffer.tail()
-                                                        , record::record_content_data( buffer.tail()), record::record_content_size( buffer.tail() ) );
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::produce_encrypted_flight(
+        TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake, uint32_t flight_size )
+{
+    const uint32_t record_overhead = sizeof(record::TLSCiphertext) + sizeof(record::ContentType)
+                                     + crypto::TlsCipherSuite::tag_size();
+    uint32_t records_count = (flight_size + MAX_FLIGHT_RECORD_CONTENT - 1) / MAX_FLIGHT_RECORD_CONTENT;
+    assert( encrypted_flight_buffer_size( flight_size ) <= buffer.tail_size() );
+
+    uint8_t* flight = buffer.tail() + sizeof(record::TlsPlaintext);
+    // every record is encrypted in place, so records after first are moved
+    // to their places (from last, places do not overlap not moved data)
+    for( uint32_t i = records_count - 1; i > 0; --i )
+    {
+        uint32_t content_size = std::min( MAX_FLIGHT_RECORD_CONTENT, flight_size - i*MAX_FLIGHT_RECORD_CONTENT );
+        uint8_t* record = buffer.tail() + i*(MAX_FLIGHT_RECORD_CONTENT + record_overhead);
+        std::memmove( record + sizeof(record::TlsPlaintext), flight + i*MAX_FLIGHT_RECORD_CONTENT, content_size );
+    }
 
+    uint32_t encrypted_size = 0;
+    for( uint32_t i = 0; i < records_count; ++i )
+    {
+        uint32_t content_size = std::min( MAX_FLIGHT_RECORD_CONTENT, flight_size - i*MAX_FLIGHT_RECORD_CONTENT );
+        uint8_t* record = buffer.tail() + i*(MAX_FLIGHT_RECORD_CONTENT + record_overhead);
+        reinterpret_cast<record::TlsPlaintext*>( record )->init( record::ContentType::HANDSHAKE );
+        encrypted_size += tls_handshake.m_record_cryptor.encrypt_record(
+                record, record + sizeof(record::TlsPlaintext), content_size );
+    }
     buffer.produce( encrypted_size );
 
     return encrypted_size;
 }
 
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
-uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::produce_server_finished_record(
+uint32_t TlsAcceptorImpl<OS_SEAM,LOG_LEVEL>::produce_new_session_ticket_record(
         TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake )
 {
-    auto finished_record_size = RecordHelpers::create_server_finished_record(
-            tls_handshake, buffer.tail() );
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        record::print_net_record( buffer.tail(), finished_record_size );
-
-    tls_handshake.add_message( record::handshake_message( buffer.tail() )
-                               ,record::record_content_size( buffer.tail() ) );
+    SessionTicketKeys& ticket_keys = SessionTicketKeys::instance();
+    uint64_t now_ms = SessionTicketKeys::now_ms();
+
+    // value initialized, padding bytes are sealed too
+    SessionTicketState state{};
+    state.cipher_suite  = tls_handshake.cipher_suite();
+    state.issue_time_ms = now_ms;
+    state.set_server_name( *tls_handshake.accept_sni );
+    cornet::crypto::random_bytes( reinterpret_cast<uint8_t*>(&state.ticket_age_add), sizeof(state.ticket_age_add) );
+    // single ticket per connection, so nonce need not vary
+    const uint8_t ticket_nonce[] = { 0 };
+    state.psk_size = tls_handshake.m_record_cryptor.resumption_psk(
+            ticket_nonce, sizeof(ticket_nonce), state.psk );
+
+    uint8_t ticket[SessionTicketKeys::TICKET_SIZE];
+    uint32_t ticket_size = ticket_keys.seal( state, ticket, now_ms );
+    OPENSSL_cleanse( state.psk, sizeof(state.psk) );
+    if( ticket_size == 0 )
+        return 0;
+
+    RecordHelpers::create_new_session_ticket_record(
+            ticket_keys.ticket_lifetime(), state.ticket_age_add
+            ,ticket_nonce, sizeof(ticket_nonce), ticket, ticket_size
+            ,tls_handshake.domain_keys->max_early_data_size, buffer.tail() );
+    TraceRing::instance().add_net_record( TraceEvent::HANDSHAKE_MESSAGE, tls_handshake.connection_id, buffer.tail() );
 
     auto encrypted_size = tls_handshake.m_record_cryptor.encrypt_record(
             buffer.tail(), record::record_content_data( buffer.tail() )
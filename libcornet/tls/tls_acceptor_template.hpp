@@ -26,6 +26,9 @@ template< typename OS_SEAM, LogLevel LOG_LEVEL=LogLevel::NONE >
 class TlsAcceptorImpl
 {
 public:
+    // rejected early data skipped before client Finished
+    static constexpr uint32_t MAX_REJECTED_EARLY_DATA_SIZE = 64*1024;
+
     TlsAcceptorImpl() = delete;
     TlsAcceptorImpl( const TlsAcceptorImpl& ) = delete;
     TlsAcceptorImpl( TlsAcceptorImpl&& ) = delete;
@@ -38,17 +41,40 @@ public:
             record::Parser& parser, KeyStore* domain_keys_store );
     static CoroutineAwaiter<bool> read_client_finished_record(
             RecordLayer& record_layer, crypto::TlsHandshake& tls_handshake, record::Parser& parser );
+    static CoroutineAwaiter<void> read_early_data_records(
+            RecordLayer& record_layer, crypto::TlsHandshake& tls_handshake, record::Parser& parser );
+    static CoroutineAwaiter<uint32_t> skip_rejected_early_data( RecordLayer& record_layer );
 
     static uint32_t produce_server_hello_record(
             TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake );
-    static uint32_t produce_encrypted_extensions_record(
-            TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake );
-    static uint32_t produce_certificate_record(
+    static uint32_t produce_hello_retry_request_record(
             TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake );
-    static uint32_t produce_certificate_verify_record(
-            TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake );
-    static uint32_t produce_server_finished_record(
+    /*
+     * encrypted server flight (EncryptedExtensions..Finished) is collected as plaintext
+     * handshake messages after single record header at buffer tail (append_* functions
+     * take and return flight content size), then produce_encrypted_flight() encrypts it
+     * to minimal number of records (one record if flight fits 16K)
+     */
+    static uint32_t append_encrypted_extensions(
+            TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake, uint32_t flight_size );
+    static uint32_t append_certificate(
+            TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake, uint32_t flight_size );
+    static uint32_t append_certificate_verify(
+            TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake, uint32_t flight_size );
+    static uint32_t append_server_finished(
+            TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake, uint32_t flight_size );
+    static uint32_t produce_encrypted_flight(
+            TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake, uint32_t flight_size );
+    static uint32_t produce_new_session_ticket_record(
             TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake );
+
+private:
+    static constexpr uint32_t MAX_FLIGHT_RECORD_CONTENT = 16*1024; // TlsPlaintext payload limit
+    /// write buffer space used by produce_encrypted_flight() for flight_size content
+    static uint32_t encrypted_flight_buffer_size( uint32_t flight_size ) noexcept;
+    template< typename CreateRecord >
+    static uint32_t append_flight_message( TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake
+                                           , uint32_t flight_size, CreateRecord create_record );
 };
 
 }
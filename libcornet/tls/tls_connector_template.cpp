@@ -7,13 +7,21 @@
 
 #include <libcornet/tls/tls_connector_template.hpp>
 
-#include <deque>
+#include <ctime>
+#include <vector>
 #include <cassert>
 
 #include <libcornet/tls/parser.hpp>
 #include <libcornet/tls/tls_trusted_certs.hpp>
 #include <libcornet/tls/record_helpers.hpp>
 #include <libcornet/tls/crypto/tls_handshake.hpp>
+#include <libcornet/tls/crypto/named_group_preference.hpp>
+#include <libcornet/tls/session_ticket.hpp>
+#include <libcornet/tls/certificate_compression.hpp>
+#include <libcornet/tls/ocsp_stapling.hpp>
+#include <libcornet/tls/certificate_verify_cache.hpp>
+#include <libcornet/metrics.hpp>
+#include <libcornet/trace.hpp>
 
 namespace pioneer19::cornet::tls13
 {
@@ -25,29 +33,86 @@ uint32_t TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::produce_client_hello_record(
     auto client_hello_record_size = RecordHelpers::client_hello_record_buffer_size( tls_handshake );
     auto size2 = RecordHelpers::create_client_hello_record( tls_handshake, buffer.tail() );
     assert( client_hello_record_size == size2 );
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        record::print_net_record( buffer.tail(), client_hello_record_size );
+    TraceRing::instance().add_net_record( TraceEvent::HANDSHAKE_MESSAGE, tls_handshake.connection_id, buffer.tail() );
 
     buffer.produce( client_hello_record_size );
 
     return client_hello_record_size;
 }
 
+/**
+ * encrypt early data with client_early_traffic_secret keys, ClientHello must be in buffer head
+ */
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+uint32_t TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::produce_early_data_record( TlsReadBuffer& buffer
+        , crypto::TlsHandshake& tls_handshake, const void* early_data, uint32_t early_data_size )
+{
+    // early data is protected by cipher suite of resumption psk
+    record::CipherSuite cipher_suite = tls_handshake.psk_ticket->cipher_suite;
+    tls_handshake.set_tls_cipher_suite( cipher_suite );
+
+    uint8_t client_hello_hash[EVP_MAX_MD_SIZE];
+    EVP_Digest( record::handshake_message( buffer.head() ), record::record_content_size( buffer.head() )
+                ,client_hello_hash, nullptr, crypto::TlsHandshake::cipher_suite_digest( cipher_suite ), nullptr );
+    tls_handshake.derive_client_early_traffic_secret( client_hello_hash );
+    tls_handshake.set_early_data_traffic_keys( true );
+
+    uint8_t* record = buffer.tail();
+    auto* tls_plaintext_record = reinterpret_cast<record::TlsPlaintext*>( record );
+    tls_plaintext_record->init( record::ContentType::APPLICATION_DATA );
+    tls_plaintext_record->finalize( early_data_size );
+
+    auto encrypted_size = tls_handshake.m_record_cryptor.encrypt_record(
+            record, reinterpret_cast<const uint8_t*>(early_data), early_data_size );
+    TraceRing::instance().add( TraceEvent::RECORD_ENCRYPTED, tls_handshake.connection_id
+                               , early_data_size, encrypted_size
+                               , static_cast<uint8_t>(record::ContentType::APPLICATION_DATA) );
+
+    buffer.produce( encrypted_size );
+
+    return encrypted_size;
+}
+
 struct ServerHelloHook : record::EmptyHook
 {
     explicit ServerHelloHook( crypto::TlsHandshake* record_cryptor )
             : m_record_cryptor{record_cryptor}{}
     // hooks
-    void server_hello_cipher_suites( const record::CipherSuite*, uint32_t cs_size );
+    void server_hello_random( const record::Random* random )
+    { m_hello_retry = *random == record::HELLO_RETRY_REQUEST_RANDOM; }
+    void server_hello_cipher_suites( const record::CipherSuite* cipher_suites, uint32_t )
+    { m_cipher_suite = cipher_suites[0]; }
     void key_share_entry( record::NamedGroup, const uint8_t*, uint16_t );
-
+    void key_share_selected_group( record::NamedGroup named_group ) { m_selected_group = named_group; }
+    void cookie( const uint8_t* cookie, uint16_t cookie_size )
+    { m_cookie = cookie; m_cookie_size = cookie_size; }
+    void psk_selected_identity( uint16_t selected_identity )
+    { m_psk_selected = true; m_psk_selected_identity = selected_identity; }
+
+    /**
+     * set cipher suite before ClientHello added to transcript,
+     * after HelloRetryRequest transcript is kept and suite must not change
+     */
+    void set_cipher_suite();
+    /**
+     * prepare second ClientHello with key share of selected group
+     */
+    void commit_hello_retry();
     void commit();
 
     crypto::TlsHandshake* m_record_cryptor;
+    bool     m_hello_retry  = false;
+    bool     m_psk_selected = false;
+    uint16_t m_psk_selected_identity = 0;
+    record::CipherSuite m_cipher_suite = record::TLS_PRIVATE_CIPHER_SUITE;
     // key_share cache
     record::NamedGroup  m_key_share_named_group = record::NamedGroup::TLS_PRIVATE_NAMED_GROUP;
     uint16_t            m_key_share_pub_key_size = 0;
     const uint8_t*      m_key_share_pub_key = nullptr;
+    // HelloRetryRequest data
+    record::NamedGroup  m_selected_group = record::NamedGroup::TLS_PRIVATE_NAMED_GROUP;
+    const uint8_t*      m_cookie = nullptr;
+    uint16_t            m_cookie_size = 0;
 
     ServerHelloHook() = delete;
     ServerHelloHook(const ServerHelloHook& ) = delete;
@@ -64,16 +129,76 @@ void ServerHelloHook::key_share_entry( record::NamedGroup named_group
     m_key_share_pub_key_size = key_size;
 }
 
-void ServerHelloHook::server_hello_cipher_suites(
-        const record::CipherSuite* cipher_suites, uint32_t )
+void ServerHelloHook::set_cipher_suite()
+{
+    if( m_record_cryptor->hello_retried() )
+    {
+        if( m_hello_retry )
+            throw std::runtime_error( "ServerHelloHook::set_cipher_suite() second HelloRetryRequest" );
+        if( m_cipher_suite != m_record_cryptor->cipher_suite() )
+            throw std::runtime_error( "ServerHelloHook::set_cipher_suite() cipher suite differs from HelloRetryRequest" );
+        return;
+    }
+    m_record_cryptor->set_tls_cipher_suite( m_cipher_suite );
+}
+
+void ServerHelloHook::commit_hello_retry()
 {
-    m_record_cryptor->set_tls_cipher_suite( cipher_suites[0] );
+    // selected group must be offered in supported_groups and have no key share
+    bool key_share_offered = false;
+    for( uint32_t i = 0; i < m_record_cryptor->key_shares_count(); ++i )
+        key_share_offered |= m_record_cryptor->key_share( i ).named_group() == m_selected_group;
+    if( !crypto::NamedGroupPreference::instance().is_enabled( m_selected_group ) || key_share_offered )
+    {
+        throw std::runtime_error( "ServerHelloHook::commit_hello_retry() HelloRetryRequest selected group "
+                                  + std::to_string( static_cast<uint16_t>(m_selected_group) ) );
+    }
+    ThreadMetrics::instance().add( Counter::CLIENT_HELLO_RETRY_REQUESTS );
+
+    m_record_cryptor->hello_retry_group = m_selected_group;
+    m_record_cryptor->set_named_group( m_selected_group );
+    if( m_cookie != nullptr )
+        m_record_cryptor->hello_retry_cookie.assign( m_cookie, m_cookie + m_cookie_size );
+    // early data is not permitted after HelloRetryRequest, psk is kept if its hash is suite hash
+    m_record_cryptor->early_data_offered = false;
+    const ClientTicket* psk_ticket = m_record_cryptor->psk_ticket;
+    if( psk_ticket != nullptr
+        && crypto::TlsHandshake::cipher_suite_digest( psk_ticket->cipher_suite )
+           != crypto::TlsHandshake::cipher_suite_digest( m_cipher_suite ) )
+    {
+        m_record_cryptor->psk_ticket = nullptr;
+    }
 }
 
 void ServerHelloHook::commit()
 {
-    m_record_cryptor->set_handshake_hello_key_share(
-            m_key_share_named_group, m_key_share_pub_key, m_key_share_pub_key_size );
+    if( m_psk_selected )
+    {
+        const ClientTicket* psk_ticket = m_record_cryptor->psk_ticket;
+        if( psk_ticket == nullptr || m_psk_selected_identity != 0
+            || crypto::TlsHandshake::cipher_suite_digest( psk_ticket->cipher_suite )
+               != crypto::TlsHandshake::cipher_suite_digest( m_record_cryptor->cipher_suite() ) )
+        {
+            throw std::runtime_error( "ServerHelloHook::commit() server selected not offered psk" );
+        }
+        m_record_cryptor->psk_resumed = true;
+    }
+
+    if( m_key_share_pub_key != nullptr )
+    {
+        if( !m_record_cryptor->select_key_share( m_key_share_named_group ) )
+            throw std::runtime_error( "ServerHelloHook::commit() server selected not offered key_share" );
+        m_record_cryptor->set_handshake_hello_key_share(
+                m_key_share_named_group, m_key_share_pub_key, m_key_share_pub_key_size );
+    }
+    else if( m_record_cryptor->psk_resumed )
+    {
+        m_record_cryptor->psk_mode = record::PskKeyExchangeMode::PSK_KE;
+        m_record_cryptor->set_psk_ke_shared_secret();
+    }
+    else
+        throw std::runtime_error( "ServerHelloHook::commit() ServerHello without key_share" );
+
     m_record_cryptor->derive_client_server_traffic_secrets( true );
 }
 
@@ -84,8 +209,6 @@ CoroutineAwaiter<bool> TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::read_server_hello_re
     TlsReadBuffer& read_buffer = record_layer.m_read_buffer;
 
     co_await record_layer.read_full_record_skip_change_cipher_spec(); // FIXME: check result
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        record::print_net_record( read_buffer.head(), read_buffer.size() );
     auto record_size = record::full_record_size( read_buffer.head() );
 
     if( ! record::is_handshake_record( read_buffer.head() ) )
@@ -100,32 +223,81 @@ CoroutineAwaiter<bool> TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::read_server_hello_re
     auto[bytes_parsed, err] = parser.parse_net_record( &server_hello_hook, read_buffer.head(), read_buffer.size() );
     if( err )
         throw std::runtime_error( "TlsConnector::read_server_hello_record() failed parse server response" );
+    server_hello_hook.set_cipher_suite();
 
     // add to transcript hash ClientHello from write_buffer
     TlsWriteBuffer& write_buffer = record_layer.m_write_buffer;
-    tls_handshake.add_message( record::handshake_message( write_buffer.head() )
-                               ,record::record_content_size( write_buffer.head()) );
+    if( server_hello_hook.m_hello_retry )
+    {   // ClientHello1 is replaced by its hash, second ClientHello is sent by caller
+        tls_handshake.add_message_hash( record::handshake_message( write_buffer.head() )
+                                        ,record::record_content_size( write_buffer.head()) );
+    }
+    else
+    {
+        tls_handshake.add_message( record::handshake_message( write_buffer.head() )
+                                   ,record::record_content_size( write_buffer.head()) );
+    }
     write_buffer.consume( record::full_record_size(write_buffer.head()) );
 
     tls_handshake.add_message( record::handshake_message( read_buffer.head() )
                                ,record::record_content_size( read_buffer.head()) );
-    server_hello_hook.commit();
+    if( server_hello_hook.m_hello_retry )
+        server_hello_hook.commit_hello_retry();
+    else
+        server_hello_hook.commit();
     read_buffer.consume( record_size );
 
     co_return true;
 }
 
+struct EncryptedExtensionsHook : record::EmptyHook
+{
+    EncryptedExtensionsHook() = default;
+    void extension_early_data( uint32_t ) { m_early_data = true; }
+
+    bool m_early_data = false;
+
+    EncryptedExtensionsHook( const EncryptedExtensionsHook& ) = delete;
+    EncryptedExtensionsHook( EncryptedExtensionsHook&& ) = delete;
+    EncryptedExtensionsHook& operator=( const EncryptedExtensionsHook& ) = delete;
+    EncryptedExtensionsHook& operator=( EncryptedExtensionsHook&& ) = delete;
+};
+
+/**
+ * plaintext record with handshake message of read_handshake_message(): read buffer
+ * head or copy of message spanning records (all messages except Certificate are small)
+ */
+static const uint8_t* handshake_message_record( TlsReadBuffer& read_buffer, const HandshakeChain& chain
+                                                , std::vector<uint8_t>& chained_record )
+{
+    if( chain.empty() )
+        return read_buffer.head();
+    if( chain.size() > UINT16_MAX )
+        throw std::runtime_error( "TlsConnector got too big handshake message " + std::to_string( chain.size() ) );
+
+    chained_record.resize( sizeof(record::TlsPlaintext) + chain.size() );
+    auto* plaintext_record = reinterpret_cast<record::TlsPlaintext*>( chained_record.data() );
+    plaintext_record->init( record::ContentType::HANDSHAKE );
+    plaintext_record->finalize( chain.size() );
+    chain.copy( 0, record::record_content_data( chained_record.data() ), chain.size() );
+
+    return chained_record.data();
+}
+
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
 CoroutineAwaiter<bool> TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::read_encrypted_extensions_record(
         RecordLayer& record_layer, crypto::TlsHandshake& tls_handshake, record::Parser& parser )
 {
-    uint32_t encrypted_record_size = co_await record_layer.read_record_decrypt_and_skip_change_cipher();
+    uint32_t consume_size = co_await record_layer.read_handshake_message();
 
     TlsReadBuffer& read_buffer = record_layer.m_read_buffer;
-    if( !record::is_handshake_record( read_buffer.head() ) )
+    std::vector<uint8_t> chained_record;
+    const uint8_t* message_record = handshake_message_record(
+            read_buffer, record_layer.m_handshake_chain, chained_record );
+    if( !record::is_handshake_record( message_record ) )
         co_return false; // FIXME: probably need to send some Alert
 
-    record::HandshakeType handshake_type = record::record_handshake_type( read_buffer.head() );
+    record::HandshakeType handshake_type = record::record_handshake_type( message_record );
     if( handshake_type != record::HandshakeType::ENCRYPTED_EXTENSIONS )
     {
         throw std::runtime_error(
@@ -135,9 +307,22 @@ CoroutineAwaiter<bool> TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::read_encrypted_exten
                         static_cast<uint8_t>(record::HandshakeType::ENCRYPTED_EXTENSIONS) ) );
     }
 
-    tls_handshake.add_message( record::handshake_message( read_buffer.head() )
-                               ,record::record_content_size( read_buffer.head()) );
-    read_buffer.consume( encrypted_record_size );
+    EncryptedExtensionsHook encrypted_extensions_hook;
+    auto[bytes_parsed, err] = parser.parse_net_record(
+            &encrypted_extensions_hook, message_record, record::full_record_size( message_record ) );
+    if( err )
+        throw std::runtime_error( "TlsConnector::read_encrypted_extensions_record() failed parse EncryptedExtensions" );
+    // server accepts early data only with offered psk
+    if( encrypted_extensions_hook.m_early_data
+        && !(tls_handshake.early_data_offered && tls_handshake.psk_resumed) )
+    {
+        throw std::runtime_error( "TlsConnector::read_encrypted_extensions_record() not offered early_data accepted" );
+    }
+    tls_handshake.early_data_accepted = encrypted_extensions_hook.m_early_data;
+
+    tls_handshake.add_message( record::handshake_message( message_record )
+                               ,record::record_content_size( message_record ) );
+    read_buffer.consume( consume_size );
 
     co_return true;
 }
@@ -154,14 +339,22 @@ struct CertificateHook : record::EmptyHook
     CertificateHook& operator=( CertificateHook&& ) = delete;
 
     void cert_data(  record::CertificateType, const uint8_t*, uint32_t );
+    void certificate_status( record::CertificateStatusType, const uint8_t*, uint32_t );
     bool commit();
 
 private:
     static bool verify_certificate( X509_STORE* trusted_store, X509* cert
-            ,STACK_OF(X509)* cert_chain_stack, const std::string& hostname );
+            ,STACK_OF(X509)* cert_chain_stack, const std::string& hostname
+            ,const CertificateVerifyCache::Key& cache_key, time_t now
+            ,CertificateVerifyCache::IssuerPtr& issuer );
+    /// chain certificates after host certificate, nullptr if one of them is broken
+    STACK_OF(X509)* parse_cert_chain() const;
 
     crypto::TlsHandshake* m_record_cryptor;
-    std::deque<std::pair<const uint8_t*,uint32_t>> m_certs_buffers;
+    std::vector<CertificateVerifyCache::DerCert> m_certs_buffers;
+    // stapled OCSP response of host certificate
+    const uint8_t* m_ocsp_response = nullptr;
+    uint32_t m_ocsp_response_size  = 0;
 };
 
 void CertificateHook::cert_data( record::CertificateType
@@ -170,44 +363,87 @@ void CertificateHook::cert_data( record::CertificateType
     m_certs_buffers.emplace_back( cert_data, data_size );
 }
 
+void CertificateHook::certificate_status( record::CertificateStatusType status_type
+        ,const uint8_t* response, uint32_t response_size )
+{
+    // extensions follow cert_data of their entry, only host certificate status is used
+    if( status_type == record::CertificateStatusType::OCSP && m_certs_buffers.size() == 1 )
+    {
+        m_ocsp_response = response;
+        m_ocsp_response_size = response_size;
+    }
+}
+
+STACK_OF(X509)* CertificateHook::parse_cert_chain() const
+{
+    STACK_OF( X509 )* cert_chain_stack = sk_X509_new_null();
+    for( size_t i = 1; i < m_certs_buffers.size(); ++i )
+    {
+        const uint8_t* cert_data = m_certs_buffers[i].first;
+        X509* x = d2i_X509( nullptr, &cert_data, m_certs_buffers[i].second );
+        if( x == nullptr )
+        {
+            sk_X509_pop_free( cert_chain_stack, X509_free );
+            return nullptr;
+        }
+        sk_X509_push( cert_chain_stack, x );
+    }
+
+    return cert_chain_stack;
+}
+
 bool CertificateHook::commit()
 {
     if( m_certs_buffers.empty() )
         return false;
 
+    // host certificate key is needed for CertificateVerify even if chain is cached
     const uint8_t* cert_data = m_certs_buffers.front().first;
-    uint32_t data_size       = m_certs_buffers.front().second;
-    X509* host_certificate = d2i_X509( nullptr, &cert_data, data_size );
+    X509* host_certificate = d2i_X509( nullptr, &cert_data, m_certs_buffers.front().second );
     if( host_certificate == nullptr )
         return false;
     m_record_cryptor->handshake_set_certificate( host_certificate );
-    m_certs_buffers.pop_front();
 
-    STACK_OF( X509 )* cert_chain_stack = sk_X509_new_null();
-    for( auto& cert_pair : m_certs_buffers )
+    const std::string& hostname = *m_record_cryptor->connect_sni;
+    auto& verify_cache = CertificateVerifyCache::instance();
+    auto cache_key = CertificateVerifyCache::chain_key( hostname, m_certs_buffers );
+    time_t now = time( nullptr );
+    // OCSP staple issuer is taken from verified chain (server can send leaf only)
+    CertificateVerifyCache::IssuerPtr issuer;
+    bool cached = verify_cache.find( cache_key, now, &issuer );
+    ThreadMetrics::instance().add( cached ? Counter::CERT_VERIFY_CACHE_HITS : Counter::CERT_VERIFY_CACHE_MISSES );
+
+    STACK_OF( X509 )* cert_chain_stack = nullptr;
+    if( !cached )
     {
-        cert_data = cert_pair.first;
-        data_size = cert_pair.second;
-
-        X509* x = d2i_X509( nullptr, &cert_data, data_size );
-        if( x == nullptr )
-        {
-            sk_X509_pop_free( cert_chain_stack, X509_free );
+        cert_chain_stack = parse_cert_chain();
+        if( cert_chain_stack == nullptr )
             return false;
+    }
+    bool verify_res = cached || verify_certificate( TlsTrustedCerts::store_instance()
+            ,host_certificate, cert_chain_stack, hostname, cache_key, now, issuer );
+    if( verify_res && m_ocsp_response != nullptr )
+    {
+        // revoked or stale staple fails verification, certificate without staple is accepted
+        auto error = OcspStapling::check_response( m_ocsp_response, m_ocsp_response_size
+                                                   , host_certificate, issuer.get() );
+        if( !error.empty() )
+        {
+            ThreadMetrics::instance().add( Counter::OCSP_STAPLE_REJECTIONS );
+            verify_res = false;
         }
-        sk_X509_push( cert_chain_stack, x );
     }
     m_certs_buffers.clear();
-    bool verify_res = verify_certificate( TlsTrustedCerts::store_instance()
-                                          ,host_certificate, cert_chain_stack, *m_record_cryptor->connect_sni );
-
-    sk_X509_pop_free(cert_chain_stack, X509_free);
+    if( cert_chain_stack != nullptr )
+        sk_X509_pop_free( cert_chain_stack, X509_free );
 
     return verify_res;
 }
 
 bool CertificateHook::verify_certificate( X509_STORE* trusted_store, X509* cert
-        ,STACK_OF(X509)* cert_chain_stack, const std::string& hostname )
+        ,STACK_OF(X509)* cert_chain_stack, const std::string& hostname
+        ,const CertificateVerifyCache::Key& cache_key, time_t now
+        ,CertificateVerifyCache::IssuerPtr& issuer )
 {
     X509_STORE_CTX* verify_ctx = X509_STORE_CTX_new();
     X509_STORE_CTX_init( verify_ctx, trusted_store, cert, cert_chain_stack);
@@ -219,8 +455,15 @@ bool CertificateHook::verify_certificate( X509_STORE* trusted_store, X509* cert
     int verify_res = X509_verify_cert( verify_ctx );
     if( verify_res <= 0 )
     {
-        printf( "verify error: %s\n"
-                ,X509_verify_cert_error_string(X509_STORE_CTX_get_error(verify_ctx) ) );
+        // handshake is failed by connector on commit()
+        ThreadMetrics::instance().add( Counter::CERT_VERIFY_FAILURES );
+    }
+    else
+    {
+        // built chain ends with trust anchor, entry expires with first expired certificate
+        STACK_OF(X509)* verified_chain = X509_STORE_CTX_get0_chain( verify_ctx );
+        issuer = CertificateVerifyCache::chain_issuer( verified_chain );
+        CertificateVerifyCache::instance().store( cache_key, verified_chain, now );
     }
 
     X509_STORE_CTX_free( verify_ctx );
@@ -228,20 +471,79 @@ bool CertificateHook::verify_certificate( X509_STORE* trusted_store, X509* cert
     return verify_res > 0;
 }
 
+struct CompressedCertificateHook : record::EmptyHook
+{
+    void compressed_certificate( record::CertificateCompressionAlgorithm algorithm
+            , uint32_t uncompressed_length, const uint8_t* data, uint32_t data_size )
+    {
+        m_algorithm = algorithm;
+        m_uncompressed_length = uncompressed_length;
+        m_data = data;
+        m_data_size = data_size;
+    }
+
+    record::CertificateCompressionAlgorithm m_algorithm = record::CertificateCompressionAlgorithm::NONE;
+    uint32_t m_uncompressed_length = 0;
+    const uint8_t* m_data = nullptr;
+    uint32_t m_data_size  = 0;
+};
+
+/**
+ * RFC 8879 CompressedCertificate record to plaintext record with Certificate message
+ */
+static std::vector<uint8_t> decompress_certificate_record(
+        record::Parser& parser, const uint8_t* buffer, uint32_t buffer_size )
+{
+    CompressedCertificateHook hook;
+    auto[bytes_parsed, err] = parser.parse_net_record( &hook, buffer, buffer_size );
+    if( err )
+        throw std::runtime_error( "TlsConnector::read_certificate_record() failed parse CompressedCertificate" );
+    // server can use only algorithm offered in ClientHello
+    if( !CertificateCompression::is_supported( hook.m_algorithm )
+        || hook.m_uncompressed_length > CertificateCompression::MAX_UNCOMPRESSED_SIZE )
+    {
+        throw std::runtime_error( "TlsConnector::read_certificate_record() got not offered compression algorithm "
+                                  + std::to_string( static_cast<uint16_t>(hook.m_algorithm) )
+                                  + " or too big certificate " + std::to_string( hook.m_uncompressed_length ) );
+    }
+
+    std::vector<uint8_t> certificate_record(
+            sizeof(record::TlsPlaintext) + sizeof(record::Handshake) + hook.m_uncompressed_length );
+    auto* plaintext_record = reinterpret_cast<record::TlsPlaintext*>( certificate_record.data() );
+    plaintext_record->init( record::ContentType::HANDSHAKE );
+    plaintext_record->finalize( sizeof(record::Handshake) + hook.m_uncompressed_length );
+    auto* handshake_message = reinterpret_cast<record::Handshake*>(
+            certificate_record.data() + sizeof(record::TlsPlaintext) );
+    handshake_message->init( record::HandshakeType::CERTIFICATE );
+    handshake_message->finalize( hook.m_uncompressed_length );
+
+    if( !CertificateCompression::decompress( hook.m_algorithm, hook.m_data, hook.m_data_size
+            , certificate_record.data() + sizeof(record::TlsPlaintext) + sizeof(record::Handshake)
+            , hook.m_uncompressed_length ) )
+    {
+        throw std::runtime_error( "TlsConnector::read_certificate_record() failed decompress certificate" );
+    }
+
+    return certificate_record;
+}
+
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
 CoroutineAwaiter<bool> TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::read_certificate_record(
         RecordLayer& record_layer, crypto::TlsHandshake& tls_handshake,
         record::Parser& parser )
 {
-    uint32_t encrypted_record_size = co_await record_layer.read_record_decrypt_and_skip_change_cipher();
+    uint32_t consume_size = co_await record_layer.read_handshake_message();
 
     TlsReadBuffer& read_buffer = record_layer.m_read_buffer;
-    if( ! record::is_handshake_record( read_buffer.head() ) )
+    HandshakeChain& chain = record_layer.m_handshake_chain;
+    if( chain.empty() && !record::is_handshake_record( read_buffer.head() ) )
         co_return false; // FIXME: probably need to send some Alert
 
     record::HandshakeType expected_handshake_type = record::HandshakeType::CERTIFICATE;
-    record::HandshakeType handshake_type = record::record_handshake_type( read_buffer.head() );
-    if( handshake_type != expected_handshake_type )
+    record::HandshakeType handshake_type = chain.empty() ? record::record_handshake_type( read_buffer.head() )
+            : reinterpret_cast<const record::Handshake*>( chain.contiguous( 0, sizeof(record::Handshake) ) )->msg_type;
+    if( handshake_type != expected_handshake_type
+        && handshake_type != record::HandshakeType::COMPRESSED_CERTIFICATE )
     {
         throw std::runtime_error(
                 "TlsConnector::read_encrypted_extensions_record() got unexpected handshake record "
@@ -249,16 +551,36 @@ CoroutineAwaiter<bool> TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::read_certificate_rec
                 + "expected " + std::to_string( static_cast<uint8_t>(expected_handshake_type) ) );
     }
 
+    // transcript gets CompressedCertificate as received, Certificate is parsed from decompressed copy
+    std::vector<uint8_t> certificate_record;
+    if( handshake_type == record::HandshakeType::COMPRESSED_CERTIFICATE )
+    {
+        std::vector<uint8_t> chained_record;
+        const uint8_t* message_record = handshake_message_record( read_buffer, chain, chained_record );
+        certificate_record = decompress_certificate_record(
+                parser, message_record, record::full_record_size( message_record ) );
+    }
+
     CertificateHook certificate_hook{&tls_handshake}; // FIXME: cryptor! not handshake
-    auto[bytes_parsed, err] = parser.parse_net_record( &certificate_hook, read_buffer.head(), read_buffer.size() );
+    record::ParserError err;
+    if( !certificate_record.empty() )
+        err = parser.parse_net_record( &certificate_hook, certificate_record.data(), certificate_record.size() ).second;
+    else if( !chain.empty() ) // long certificate chain
+        err = parser.parse_handshake_chain( &certificate_hook, chain );
+    else
+        err = parser.parse_net_record( &certificate_hook, read_buffer.head(), read_buffer.size() ).second;
     if( err )
         throw std::runtime_error( "TlsConnector::read_server_hello_record() failed parse server response" );
-    certificate_hook.commit();
+    if( !certificate_hook.commit() )
+        throw std::runtime_error( "TlsConnector::read_certificate_record() server certificate verification failed" );
 
-    tls_handshake.add_message( record::handshake_message( read_buffer.head() )
-                               ,record::record_content_size( read_buffer.head()) );
+    if( chain.empty() )
+        tls_handshake.add_message( record::handshake_message( read_buffer.head() )
+                                   ,record::record_content_size( read_buffer.head()) );
+    for( const auto& fragment : chain.fragments() )
+        tls_handshake.add_message( fragment.data, fragment.size );
 
-    read_buffer.consume( encrypted_record_size );
+    read_buffer.consume( consume_size );
 
     co_return true;
 }
@@ -303,14 +625,17 @@ CoroutineAwaiter<bool> TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::read_certificate_ver
         RecordLayer& record_layer, crypto::TlsHandshake& tls_handshake,
         record::Parser& parser )
 {
-    uint32_t encrypted_record_size = co_await record_layer.read_record_decrypt_and_skip_change_cipher();
+    uint32_t consume_size = co_await record_layer.read_handshake_message();
 
     TlsReadBuffer& read_buffer = record_layer.m_read_buffer;
-    if( ! record::is_handshake_record( read_buffer.head() ) )
+    std::vector<uint8_t> chained_record;
+    const uint8_t* message_record = handshake_message_record(
+            read_buffer, record_layer.m_handshake_chain, chained_record );
+    if( ! record::is_handshake_record( message_record ) )
         co_return false; // FIXME: probably need to send some Alert
 
     record::HandshakeType expected_handshake_type = record::HandshakeType::CERTIFICATE_VERIFY;
-    record::HandshakeType handshake_type = record::record_handshake_type( read_buffer.head() );
+    record::HandshakeType handshake_type = record::record_handshake_type( message_record );
     if( handshake_type != expected_handshake_type )
     {
         throw std::runtime_error(
@@ -320,14 +645,16 @@ CoroutineAwaiter<bool> TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::read_certificate_ver
     }
 
     CertificateVerifyHook certificate_verify_hook{&tls_handshake}; // FIXME: cryptor! not handshake
-    auto[bytes_parsed, err] = parser.parse_net_record( &certificate_verify_hook, read_buffer.head(), read_buffer.size() );
+    auto[bytes_parsed, err] = parser.parse_net_record(
+            &certificate_verify_hook, message_record, record::full_record_size( message_record ) );
     if( err )
         throw std::runtime_error( "TlsConnector::read_server_hello_record() failed parse server response" );
-    certificate_verify_hook.commit();
+    if( !certificate_verify_hook.commit() )
+        throw std::runtime_error( "TlsConnector::read_certificate_verify_record() signature verification failed" );
 
-    tls_handshake.add_message( record::handshake_message( read_buffer.head() )
-                               ,record::record_content_size( read_buffer.head()) );
-    read_buffer.consume( encrypted_record_size );
+    tls_handshake.add_message( record::handshake_message( message_record )
+                               ,record::record_content_size( message_record ) );
+    read_buffer.consume( consume_size );
 
     co_return true;
 }
@@ -375,14 +702,17 @@ CoroutineAwaiter<bool> TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::read_server_finished
         RecordLayer& record_layer, crypto::TlsHandshake& tls_handshake,
         record::Parser& parser )
 {
-    uint32_t encrypted_record_size = co_await record_layer.read_record_decrypt_and_skip_change_cipher();
+    uint32_t consume_size = co_await record_layer.read_handshake_message();
 
     TlsReadBuffer& read_buffer = record_layer.m_read_buffer;
-    if( ! record::is_handshake_record( read_buffer.head() ) )
+    std::vector<uint8_t> chained_record;
+    const uint8_t* message_record = handshake_message_record(
+            read_buffer, record_layer.m_handshake_chain, chained_record );
+    if( ! record::is_handshake_record( message_record ) )
         co_return false; // FIXME: probably need to send some Alert
 
     record::HandshakeType expected_handshake_type = record::HandshakeType::FINISHED;
-    record::HandshakeType handshake_type = record::record_handshake_type( read_buffer.head() );
+    record::HandshakeType handshake_type = record::record_handshake_type( message_record );
     if( handshake_type != expected_handshake_type )
     {
         throw std::runtime_error(
@@ -392,19 +722,105 @@ CoroutineAwaiter<bool> TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::read_server_finished
     }
 
     ServerFinishedHook finished_hook{&tls_handshake};
-    auto[bytes_parsed, err] = parser.parse_net_record( &finished_hook, read_buffer.head(), read_buffer.size() );
+    auto[bytes_parsed, err] = parser.parse_net_record(
+            &finished_hook, message_record, record::full_record_size( message_record ) );
     if( err )
         throw std::runtime_error( "TlsConnector::read_server_hello_record() failed parse server response" );
-    finished_hook.commit();
+    if( !finished_hook.commit() )
+        throw std::runtime_error( "TlsConnector::read_server_finished_record() verify_data mismatch" );
 
-    tls_handshake.add_message( record::handshake_message( read_buffer.head() )
-                               ,record::record_content_size( read_buffer.head()) );
+    tls_handshake.add_message( record::handshake_message( message_record )
+                               ,record::record_content_size( message_record ) );
 
-    read_buffer.consume( encrypted_record_size );
+    read_buffer.consume( consume_size );
 
     co_return true;
 }
 
+struct NewSessionTicketHook : record::EmptyHook
+{
+    explicit NewSessionTicketHook( const crypto::RecordCryptor& record_cryptor )
+            : m_record_cryptor{record_cryptor}
+    {}
+
+    void new_session_ticket( const record::NewSessionTicket* new_session_ticket
+            ,const uint8_t* nonce, uint8_t nonce_size, const uint8_t* ticket, uint16_t ticket_size );
+    void extension_early_data( uint32_t max_early_data_size )
+    { m_ticket.max_early_data_size = max_early_data_size; }
+    void commit( const std::string& server_name );
+
+    NewSessionTicketHook() = delete;
+    NewSessionTicketHook( const NewSessionTicketHook& ) = delete;
+    NewSessionTicketHook( NewSessionTicketHook&& ) = delete;
+    NewSessionTicketHook& operator=( const NewSessionTicketHook& ) = delete;
+    NewSessionTicketHook& operator=( NewSessionTicketHook&& ) = delete;
+
+private:
+    const crypto::RecordCryptor& m_record_cryptor;
+    ClientTicket m_ticket;
+};
+
+void NewSessionTicketHook::new_session_ticket( const record::NewSessionTicket* new_session_ticket
+        ,const uint8_t* nonce, uint8_t nonce_size, const uint8_t* ticket, uint16_t ticket_size )
+{
+    m_ticket.ticket.assign( ticket, ticket + ticket_size );
+    m_ticket.cipher_suite    = m_record_cryptor.cipher_suite().cipher_suite();
+    m_ticket.ticket_age_add  = new_session_ticket->ticket_age_add();
+    m_ticket.ticket_lifetime = new_session_ticket->ticket_lifetime();
+    m_ticket.receive_time_ms = SessionTicketKeys::now_ms();
+    m_ticket.psk_size = m_record_cryptor.resumption_psk( nonce, nonce_size, m_ticket.psk );
+}
+
+void NewSessionTicketHook::commit( const std::string& server_name )
+{
+    // zero lifetime means ticket must be discarded immediately
+    if( !m_ticket.ticket.empty() && m_ticket.ticket_lifetime > 0 )
+        TicketCache::instance().store( server_name, std::move(m_ticket) );
+}
+
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+bool TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::process_new_session_ticket_record(
+        RecordLayer& record_layer, record::Parser& parser )
+{
+    TlsReadBuffer& read_buffer = record_layer.m_read_buffer;
+    if( record::record_handshake_type( read_buffer.head() ) != record::HandshakeType::NEW_SESSION_TICKET )
+        return false;
+
+    NewSessionTicketHook new_session_ticket_hook{ record_layer.m_cryptor };
+    auto[bytes_parsed, err] = parser.parse_net_record(
+            &new_session_ticket_hook, read_buffer.head(), read_buffer.size() );
+    if( err )
+        return false;
+    new_session_ticket_hook.commit( record_layer.m_server_name );
+
+    return true;
+}
+
+/**
+ * EndOfEarlyData is protected by early traffic keys, after it client
+ * returns to handshake traffic keys for Finished
+ */
+template< typename OS_SEAM, LogLevel LOG_LEVEL >
+uint32_t TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::produce_end_of_early_data_record(
+        TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake )
+{
+    // single early data record was sent before
+    tls_handshake.set_early_data_traffic_keys( true, 1 );
+
+    uint8_t* record = buffer.tail();
+    RecordHelpers::create_end_of_early_data_record( tls_handshake, record );
+    TraceRing::instance().add_net_record( TraceEvent::HANDSHAKE_MESSAGE, tls_handshake.connection_id, record );
+    tls_handshake.add_message( record::handshake_message( record ), record::record_content_size( record ) );
+
+    auto encrypted_size = tls_handshake.m_record_cryptor.encrypt_record(
+            record, record::record_content_data( record ), record::record_content_size( record ) );
+    buffer.produce( encrypted_size );
+
+    tls_handshake.set_client_handshake_traffic_keys( true );
+
+    return encrypted_size;
+}
+
 template< typename OS_SEAM, LogLevel LOG_LEVEL >
 CoroutineAwaiter<uint32_t> TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::send_client_finished_record(
         RecordLayer& record_layer, crypto::TlsHandshake& tls_handshake )
@@ -414,8 +830,7 @@ CoroutineAwaiter<uint32_t> TlsConnectorImpl<OS_SEAM,LOG_LEVEL>::send_client_fini
     uint32_t rec_size = RecordHelpers::create_client_finished_record( tls_handshake, buffer );
 
     assert( rec_size == rec_size_calculated );
-    if constexpr ( LOG_LEVEL >= LogLevel::NOTICE )
-        record::print_net_record( buffer, rec_size );
+    TraceRing::instance().add_net_record( TraceEvent::HANDSHAKE_MESSAGE, tls_handshake.connection_id, buffer );
     tls_handshake.add_message( record::handshake_message(buffer), record::record_content_size(buffer) );
 
     rec_size = co_await record_layer.encrypt_and_send_record(
@@ -27,6 +27,10 @@ class TlsConnectorImpl
 public:
     ~TlsConnectorImpl() = default;
 
+    /**
+     * read ServerHello or HelloRetryRequest (TlsHandshake::hello_retried() becomes true,
+     * caller sends second ClientHello and reads ServerHello again)
+     */
     static CoroutineAwaiter<bool> read_server_hello_record(
             RecordLayer& record_layer, crypto::TlsHandshake& tls_handshake, record::Parser& parser );
     static CoroutineAwaiter<bool> read_encrypted_extensions_record(
@@ -39,6 +43,14 @@ public:
             RecordLayer& record_layer, crypto::TlsHandshake& tls_handshake, record::Parser& parser );
 
     static uint32_t produce_client_hello_record( TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake );
+    static uint32_t produce_early_data_record( TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake
+            , const void* early_data, uint32_t early_data_size );
+    static uint32_t produce_end_of_early_data_record( TlsReadBuffer& buffer, crypto::TlsHandshake& tls_handshake );
+    /**
+     * store session ticket from post handshake NewSessionTicket in TicketCache
+     * @return false if record is not NewSessionTicket
+     */
+    static bool process_new_session_ticket_record( RecordLayer& record_layer, record::Parser& parser );
     static CoroutineAwaiter<uint32_t> send_client_finished_record(
             RecordLayer& record_layer, crypto::TlsHandshake& tls_handshake );
 
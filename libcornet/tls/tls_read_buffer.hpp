@@ -48,6 +48,7 @@ public:
     void consume_conserved( uint16_t size );
     void consume( uint16_t size );
     void produce( uint16_t size );
+    void shrink( uint16_t size );
     void compact();
 
 private:
@@ -184,6 +185,15 @@ inline void TlsReadBufferTemplate<INITIAL_ALLOCATE>::consume( uint16_t size )
     m_data_offset += size;
     m_data_size   -= size;
 }
+/**
+ * remove size bytes from user buffer tail (data sent, but not needed anymore)
+ * @param size
+ */
+template< bool INITIAL_ALLOCATE >
+inline void TlsReadBufferTemplate<INITIAL_ALLOCATE>::shrink( uint16_t size )
+{
+    m_data_size -= size;
+}
 /**
  * move user data to buffer head so tail_size() become bigger
  */
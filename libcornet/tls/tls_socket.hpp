@@ -32,12 +32,50 @@ public:
     void listen( Poller& poller );
     CoroutineAwaiter<TlsSocket> async_accept(
             Poller& poller, sockaddr_in6* peer_addr, KeyStore* keys_store );
+    /**
+     * split accept: async_accept_tcp() returns just accepted tcp connection and
+     * server_handshake() makes tls handshake on it in separate coroutine,
+     * so handshakes of many clients run concurrently
+     */
+    CoroutineAwaiter<TcpSocket> async_accept_tcp( Poller& poller, sockaddr_in6* peer_addr = nullptr )
+    { return m_record_layer.async_accept_tcp( poller, peer_addr ); }
+    static CoroutineAwaiter<TlsSocket> server_handshake( TcpSocket tcp_socket, KeyStore* keys_store )
+    { return RecordLayer::tls_server_handshake( std::move(tcp_socket), keys_store ); }
+    /**
+     * early_data is sent with ClientHello (0-RTT) if resumption ticket for sni
+     * allows it. Application must check early_data_accepted() and resend data
+     * which was not accepted by server.
+     */
     CoroutineAwaiter<bool> async_connect( Poller& poller, const char* hostname, uint16_t port
-            , const char* sni=nullptr );
+            , const char* sni=nullptr, const void* early_data=nullptr, uint32_t early_data_size=0 );
     auto async_read( void* buffer, size_t buffer_size )
     { return m_record_layer.async_read( buffer, buffer_size ); }
     auto async_write( const void* buffer, size_t buffer_size )
     { return m_record_layer.async_write( buffer, buffer_size ); }
+    /**
+     * graceful close: send close_notify and shutdown write side, async_read() works
+     * until peer close_notify (async_read() returns 0 after it)
+     */
+    auto async_close_notify() { return m_record_layer.async_close_notify(); }
+    bool try_close_notify() noexcept { return m_record_layer.try_close_notify(); }
+    [[nodiscard]]
+    bool close_notify_received() const noexcept { return m_record_layer.close_notify_received(); }
+    [[nodiscard]]
+    bool close_notify_sent() const noexcept { return m_record_layer.close_notify_sent(); }
+    [[nodiscard]]
+    bool write_in_progress() const noexcept { return m_record_layer.write_in_progress(); }
+    /**
+     * opt-in kernel TLS offload after handshake, reads and writes go through
+     * tcp socket if offloaded. Returns false if kTLS not available.
+     */
+    bool enable_ktls() { return m_record_layer.enable_ktls(); }
+    /// reads are decrypted by kernel (enable_ktls() offloaded rx too)
+    [[nodiscard]]
+    bool ktls_rx() const noexcept { return m_record_layer.ktls_rx(); }
+    [[nodiscard]]
+    bool early_data_accepted() const noexcept { return m_record_layer.early_data_accepted(); }
+    [[nodiscard]]
+    uint32_t early_data_size() const noexcept { return m_record_layer.early_data_size(); }
 
     TlsSocket( const TlsSocket& )       = delete;
     TlsSocket& operator=( const TlsSocket& ) = delete;
@@ -67,7 +105,8 @@ inline CoroutineAwaiter<TlsSocket> TlsSocket::async_accept(
 }
 
 inline CoroutineAwaiter<bool> TlsSocket::async_connect(
-        Poller& poller, const char* hostname, uint16_t port, const char* sni )
+        Poller& poller, const char* hostname, uint16_t port, const char* sni
+        , const void* early_data, uint32_t early_data_size )
 {
     std::string tls_sni;
     if( sni )
@@ -75,7 +114,8 @@ inline CoroutineAwaiter<bool> TlsSocket::async_connect(
     else
         tls_sni = hostname;
 
-    bool connected = co_await m_record_layer.tls_connect( poller, hostname, port, tls_sni );
+    bool connected = co_await m_record_layer.tls_connect( poller, hostname, port, tls_sni
+                                                           , early_data, early_data_size );
 
     co_return connected;
 }
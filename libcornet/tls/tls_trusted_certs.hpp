@@ -12,6 +12,13 @@
 namespace pioneer19::cornet::tls13
 {
 
+/**
+ * @brief trusted CA certificates of client (system default paths), shared by all threads
+ *
+ * X509_STORE is locked internally, certificates can be added (X509_STORE_add_cert)
+ * while other threads verify. Certificates are never removed, so verification
+ * cached by CertificateVerifyCache stays valid.
+ */
 class TlsTrustedCerts
 {
 public:
@@ -55,7 +62,7 @@ inline TlsTrustedCerts::~TlsTrustedCerts() noexcept
 
 inline X509_STORE* TlsTrustedCerts::store_instance()
 {
-    static thread_local TlsTrustedCerts trusted_tls_certs;
+    static TlsTrustedCerts trusted_tls_certs;
 
     return trusted_tls_certs.store();
 }
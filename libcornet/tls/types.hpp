@@ -121,6 +121,7 @@ struct TLSCiphertext
  *     certificate_verify(15),
  *     finished(20),
  *     key_update(24),
+ *     compressed_certificate(25), // RFC 8879
  *     message_hash(254),
  *     (255)
  * } HandshakeType;
@@ -153,6 +154,7 @@ enum class HandshakeType : uint8_t
     CERTIFICATE_VERIFY   = 15,
     FINISHED     = 20,
     KEY_UPDATE   = 24,
+    COMPRESSED_CERTIFICATE = 25,
     MESSAGE_HASH = 254,
 };
 
@@ -259,6 +261,7 @@ struct ClientHello
  *     client_certificate_type(19),                // RFC 7250
  *     server_certificate_type(20),                // RFC 7250
  *     padding(21),                                // RFC 7685
+ *     compress_certificate(27),                   // RFC 8879
  *     pre_shared_key(41),                         // RFC 8446
  *     early_data(42),                             // RFC 8446
  *     supported_versions(43),                     // RFC 8446
@@ -286,6 +289,7 @@ enum class ExtensionType : uint16_t
     CLIENT_CERTIFICATE_TYPE = 19,
     SERVER_CERTIFICATE_TYPE = 20,
     PADDING                 = 21,
+    COMPRESS_CERTIFICATE    = 27,
     PRE_SHARED_KEY          = 41,
     EARLY_DATA              = 42,
     SUPPORTED_VERSIONS      = 43,
@@ -579,6 +583,80 @@ struct PskKeyExchangeModes
     void convert_from_network(){}
 };
 
+// pre_shared_key extension
+/*
+ * struct {
+ *     opaque identity<1..2^16-1>;
+ *     uint32 obfuscated_ticket_age;
+ * } PskIdentity;
+ * opaque PskBinderEntry<32..255>;
+ * struct {
+ *     PskIdentity identities<7..2^16-1>;
+ *     PskBinderEntry binders<33..2^16-1>;
+ * } OfferedPsks;
+ * struct {
+ *     select (Handshake.msg_type) {
+ *         case client_hello: OfferedPsks;
+ *         case server_hello: uint16 selected_identity;
+ *     };
+ * } PreSharedKeyExtension;
+ */
+struct PskIdentity
+{
+    uint16_t m_size;
+    // opaque identity<1..2^16-1>;
+    // uint32 obfuscated_ticket_age;
+
+    void finalize( uint16_t identity_size ) { m_size = htobe16( identity_size ); }
+    [[nodiscard]]
+    uint16_t size() const noexcept { return be16toh( m_size ); }
+};
+
+/*
+ * struct {
+ *     uint32 ticket_lifetime;
+ *     uint32 ticket_age_add;
+ *     opaque ticket_nonce<0..255>;
+ *     opaque ticket<1..2^16-1>;
+ *     Extension extensions<0..2^16-2>;
+ * } NewSessionTicket;
+ */
+struct NewSessionTicket
+{
+    uint32_t m_ticket_lifetime;
+    uint32_t m_ticket_age_add;
+    // opaque ticket_nonce<0..255>;
+    // opaque ticket<1..2^16-1>;
+    // Extension extensions<0..2^16-2>;
+
+    void init( uint32_t lifetime, uint32_t age_add )
+    { m_ticket_lifetime = htobe32( lifetime ); m_ticket_age_add = htobe32( age_add ); }
+    [[nodiscard]]
+    uint32_t ticket_lifetime() const noexcept { return be32toh( m_ticket_lifetime ); }
+    [[nodiscard]]
+    uint32_t ticket_age_add() const noexcept { return be32toh( m_ticket_age_add ); }
+};
+
+/*
+ * struct {} Empty;
+ * struct {
+ *     select (Handshake.msg_type) {
+ *         case new_session_ticket:   uint32 max_early_data_size;
+ *         case client_hello:         Empty;
+ *         case encrypted_extensions: Empty;
+ *     };
+ * } EarlyDataIndication;
+ */
+struct EarlyDataIndication
+{
+    uint32_t m_max_early_data_size;
+
+    void init( uint32_t max_early_data_size )
+    { m_max_early_data_size = htobe32( max_early_data_size ); }
+    [[nodiscard]]
+    uint32_t max_early_data_size() const noexcept { return be32toh( m_max_early_data_size ); }
+};
+
 /*
  * struct {
  *     NamedGroup group;
@@ -637,6 +715,13 @@ inline uint16_t ServerHello::init( ProtocolVersion proto_legacy_version )
     return sizeof(ClientHello);
 }
 
+/*
+ * HelloRetryRequest is ServerHello with random SHA-256("HelloRetryRequest")
+ */
+inline constexpr Random HELLO_RETRY_REQUEST_RANDOM = {
+        0xCF, 0x21, 0xAD, 0x74, 0xE5, 0x9A, 0x61, 0x11, 0xBE, 0x1D, 0x8C, 0x02, 0x1E, 0x65, 0xB8, 0x91,
+        0xC2, 0xA2, 0x11, 0x16, 0x7A, 0xBB, 0x8C, 0x5E, 0x07, 0x9E, 0x09, 0xE2, 0xC8, 0xA8, 0x33, 0x9C };
+
 /*
  * struct {
  *     Extension extensions<0..2^16-1>;
@@ -687,6 +772,68 @@ struct NetUint24
     void assign( uint32_t data_size ) { m_length = htobe32( data_size ) >> 8u; }
     void finalize( uint32_t content_size ) { assign( content_size ); }
 };
+/*
+ * RFC 8879
+ * enum {
+ *     zlib(1),
+ *     brotli(2),
+ *     zstd(3),
+ *     (65535)
+ * } CertificateCompressionAlgorithm;
+ * struct {
+ *     CertificateCompressionAlgorithm algorithms<2..2^8-2>;
+ * } CertificateCompressionAlgorithms;
+ */
+enum class CertificateCompressionAlgorithm : uint16_t
+{
+    NONE   = 0, ///< not in RFC, certificate is not compressed
+    ZLIB   = 1,
+    BROTLI = 2,
+    ZSTD   = 3,
+};
+/*
+ * struct {
+ *     CertificateCompressionAlgorithm algorithm;
+ *     uint24 uncompressed_length;
+ *     opaque compressed_certificate_message<1..2^24-1>;
+ * } CompressedCertificate;
+ */
+struct CompressedCertificate
+{
+    uint16_t  m_algorithm;
+    NetUint24 uncompressed_length;
+    // opaque compressed_certificate_message<1..2^24-1>;
+
+    void set_algorithm( CertificateCompressionAlgorithm algorithm )
+    { m_algorithm = htobe16( static_cast<uint16_t>(algorithm) ); }
+    [[nodiscard]]
+    CertificateCompressionAlgorithm algorithm() const noexcept
+    { return static_cast<CertificateCompressionAlgorithm>( be16toh( m_algorithm ) ); }
+};
+/*
+ * RFC 6066 8, RFC 8446 4.4.2.1
+ * enum { ocsp(1), (255) } CertificateStatusType;
+ * struct {
+ *     CertificateStatusType status_type;
+ *     select (status_type) {
+ *         case ocsp: OCSPStatusRequest;
+ *     } request;
+ * } CertificateStatusRequest;
+ * struct {
+ *     ResponderID responder_id_list<0..2^16-1>;
+ *     Extensions  request_extensions;
+ * } OCSPStatusRequest;
+ * struct {
+ *     CertificateStatusType status_type;
+ *     select (status_type) {
+ *         case ocsp: OCSPResponse; // opaque OCSPResponse<1..2^24-1>;
+ *     } response;
+ * } CertificateStatus;
+ */
+enum class CertificateStatusType : uint8_t
+{
+    OCSP = 1,
+};
 /*
  * struct {
  *     SignatureScheme algorithm;
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <libcornet/trace.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <algorithm>
+
+#include <libcornet/poller.hpp>
+
+namespace pioneer19::cornet
+{
+
+static std::atomic<uint32_t> trace_threads_count = 0;
+
+TraceRing& TraceRing::instance()
+{
+    static thread_local TraceRing trace_ring;
+
+    return trace_ring;
+}
+
+TraceRing::TraceRing( uint32_t capacity )
+    :m_records{ new TraceRecord[capacity] }
+    ,m_mask{ capacity - 1 }
+    ,m_thread_index{ trace_threads_count.fetch_add( 1, std::memory_order_relaxed ) + 1 }
+{}
+
+uint64_t TraceRing::next_connection_id() noexcept
+{
+    auto& trace_ring = instance();
+    ++trace_ring.m_connections_count;
+
+    return (uint64_t{trace_ring.m_thread_index} << 48u)
+           | (trace_ring.m_connections_count & ((uint64_t{1} << 48u) - 1));
+}
+
+void TraceRing::add_net_record(
+        TraceEvent event, uint64_t connection_id, const uint8_t* record, uint32_t extra ) noexcept
+{
+    // TLSPlaintext header: ContentType type, ProtocolVersion legacy_record_version, uint16 length
+    constexpr uint8_t HANDSHAKE_CONTENT_TYPE = 22;
+    constexpr uint32_t HEADER_SIZE = 5;
+
+    uint8_t  content_type = record[0];
+    uint32_t content_size = (uint32_t{record[3]} << 8u) | record[4];
+    uint8_t  handshake_type = 0;
+    if( content_type == HANDSHAKE_CONTENT_TYPE && content_size > 0 )
+        handshake_type = record[HEADER_SIZE];
+
+    add( event, connection_id, content_size, extra, content_type, handshake_type );
+}
+
+std::vector<TraceRecord> TraceRing::records() const
+{
+    uint64_t capacity = m_mask + 1;
+    uint64_t records_kept = std::min( m_count, capacity );
+
+    std::vector<TraceRecord> records;
+    records.reserve( records_kept );
+    for( uint64_t i = m_count - records_kept; i < m_count; ++i )
+        records.push_back( m_records[i & m_mask] );
+
+    return records;
+}
+
+static bool write_all( int fd, const void* data, size_t size )
+{
+    auto* bytes = static_cast<const uint8_t*>( data );
+    while( size > 0 )
+    {
+        ssize_t res = ::write( fd, bytes, size );
+        if( res == -1 )
+        {
+            if( errno == EINTR )
+                continue;
+            return false;
+        }
+        bytes += res;
+        size  -= res;
+    }
+    return true;
+}
+
+bool TraceRing::dump( int fd ) const
+{
+    auto records = this->records();
+
+    TraceFileHeader header{};
+    std::memcpy( header.magic, TraceFileHeader::MAGIC, sizeof(header.magic) );
+    header.version       = TraceFileHeader::VERSION;
+    header.record_size   = sizeof(TraceRecord);
+    header.records_count = records.size();
+    header.lost_count    = m_count - records.size();
+    header.ns_per_cycle  = LoopProfiler::ns_per_cycle();
+    header.thread_index  = m_thread_index;
+    header.dump_tsc      = rdtsc();
+    header.dump_realtime_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch() ).count();
+
+    return write_all( fd, &header, sizeof(header) )
+           && write_all( fd, records.data(), records.size() * sizeof(TraceRecord) );
+}
+
+bool TraceRing::dump( const char* file_name ) const
+{
+    int fd = ::open( file_name, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644 );
+    if( fd == -1 )
+        return false;
+    bool res = dump( fd );
+    ::close( fd );
+
+    return res;
+}
+
+void TraceRing::dump_on_signal( Poller& poller, int signum, std::string path_prefix )
+{
+    poller.run_on_signal( signum, [path_prefix=std::move(path_prefix)](){
+        auto& trace_ring = TraceRing::instance();
+        std::string file_name = path_prefix + "." + std::to_string( getpid() )
+                                + "." + std::to_string( trace_ring.thread_index() ) + ".trace";
+        trace_ring.dump( file_name.c_str() );
+    } );
+}
+
+}
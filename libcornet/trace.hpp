@@ -0,0 +1,166 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <iterator>
+
+#include <libcornet/loop_profiler.hpp>
+
+namespace pioneer19::cornet
+{
+class Poller;
+
+enum class TraceEvent : uint16_t
+{
+    NONE = 0,
+    CONNECTION_ACCEPTED,
+    CONNECTION_CONNECTED,
+    CONNECTION_CLOSED,
+    HANDSHAKE_STARTED,   ///< extra: 1 server, 0 client
+    HANDSHAKE_COMPLETED, ///< extra: duration in microseconds
+    HANDSHAKE_FAILED,    ///< extra: HandshakeFailure
+    HANDSHAKE_MESSAGE,   ///< plaintext handshake record created, size: record content size
+    RECORD_RECEIVED,     ///< full record in read buffer, size: record content size
+    RECORD_DECRYPTED,    ///< size: plaintext size, content_type: inner content type
+    RECORD_ENCRYPTED,    ///< size: plaintext size, extra: record size, content_type: inner content type
+    BYTES_SENT,          ///< write buffer sent, size: bytes sent, extra: bytes to send
+    KTLS_ENABLED,        ///< extra: bit 0 tx offloaded, bit 1 rx offloaded
+    COUNT
+};
+
+constexpr const char* trace_event_name( TraceEvent event ) noexcept
+{
+    constexpr const char* names[] = {
+            "none", "connection_accepted", "connection_connected", "connection_closed"
+            , "handshake_started", "handshake_completed", "handshake_failed", "handshake_message"
+            , "record_received", "record_decrypted", "record_encrypted", "bytes_sent"
+            , "ktls_enabled" };
+    static_assert( std::size(names) == static_cast<uint16_t>(TraceEvent::COUNT) );
+
+    auto index = static_cast<uint16_t>(event);
+    return index < std::size(names) ? names[index] : "unknown";
+}
+
+/**
+ * @brief fixed size binary trace event
+ */
+struct TraceRecord
+{
+    uint64_t   tsc;            ///< rdtsc()
+    uint64_t   connection_id;  ///< TcpSocket::connection_id() or 0
+    uint32_t   size;
+    uint32_t   extra;          ///< event specific value
+    TraceEvent event;
+    uint8_t    content_type;   ///< tls record ContentType or 0
+    uint8_t    handshake_type; ///< tls HandshakeType if content_type is handshake
+    uint32_t   reserved;
+};
+static_assert( sizeof(TraceRecord) == 32 );
+
+/**
+ * @brief header of trace dump file, followed by records_count TraceRecords (oldest first)
+ */
+struct TraceFileHeader
+{
+    static constexpr char MAGIC[8] = { 'C','O','R','N','T','R','C','\0' };
+    static constexpr uint32_t VERSION = 1;
+
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;      ///< sizeof(TraceRecord)
+    uint64_t records_count;
+    uint64_t lost_count;       ///< records overwritten before dump
+    uint64_t dump_tsc;
+    int64_t  dump_realtime_ns; ///< system clock at dump_tsc, maps tsc to wall time
+    double   ns_per_cycle;
+    uint32_t thread_index;
+    uint32_t reserved;
+};
+static_assert( sizeof(TraceFileHeader) == 64 );
+
+/**
+ * @brief per thread ring of last trace events (flight recorder)
+ *
+ * Event is one rdtsc and 32 bytes store to thread own memory, tracing is
+ * on by default and can be switched off process wide by set_enabled().
+ * Ring is written to file by dump() on demand or by signal (dump_on_signal()),
+ * helpers/trace_decoder prints dump files.
+ */
+class TraceRing
+{
+public:
+    static constexpr uint32_t DEFAULT_CAPACITY = 4096; ///< power of 2
+
+    static TraceRing& instance();
+
+    static void set_enabled( bool enabled ) noexcept { s_enabled.store( enabled, std::memory_order_relaxed ); }
+    [[nodiscard]]
+    static bool enabled() noexcept { return s_enabled.load( std::memory_order_relaxed ); }
+    /**
+     * unique in process: thread index in high 16 bits, thread connection counter in low 48 bits
+     */
+    static uint64_t next_connection_id() noexcept;
+
+    void add( TraceEvent event, uint64_t connection_id, uint32_t size = 0, uint32_t extra = 0
+              , uint8_t content_type = 0, uint8_t handshake_type = 0 ) noexcept
+    {
+        if( !enabled() )
+            return;
+        m_records[m_count & m_mask] = TraceRecord{ rdtsc(), connection_id, size, extra
+                                                   , event, content_type, handshake_type, 0 };
+        ++m_count;
+    }
+    /**
+     * add event with content type, handshake type and content size from tls record header
+     */
+    void add_net_record( TraceEvent event, uint64_t connection_id, const uint8_t* record
+                         , uint32_t extra = 0 ) noexcept;
+
+    /**
+     * records in ring, oldest first
+     */
+    [[nodiscard]]
+    std::vector<TraceRecord> records() const;
+    [[nodiscard]]
+    uint64_t count() const noexcept { return m_count; }
+    [[nodiscard]]
+    uint32_t thread_index() const noexcept { return m_thread_index; }
+    void clear() noexcept { m_count = 0; }
+
+    bool dump( int fd ) const;
+    bool dump( const char* file_name ) const;
+    /**
+     * dump ring of poller thread to "<path_prefix>.<pid>.<thread index>.trace" on signal
+     */
+    static void dump_on_signal( Poller& poller, int signum, std::string path_prefix );
+
+    TraceRing( const TraceRing& ) = delete;
+    TraceRing( TraceRing&& )      = delete;
+    TraceRing& operator=( const TraceRing& ) = delete;
+    TraceRing& operator=( TraceRing&& )      = delete;
+
+private:
+    explicit TraceRing( uint32_t capacity = DEFAULT_CAPACITY );
+    ~TraceRing() = default;
+
+    inline static std::atomic<bool> s_enabled = true;
+
+    std::unique_ptr<TraceRecord[]> m_records;
+    uint64_t m_mask;
+    uint64_t m_count = 0;
+    uint64_t m_connections_count = 0;
+    uint32_t m_thread_index;
+};
+
+}
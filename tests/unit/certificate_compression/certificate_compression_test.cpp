@@ -0,0 +1,269 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <experimental/coroutine>
+
+#include <openssl/evp.h>
+#include <openssl/ec.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <doctest/doctest.h>
+
+#include <libcornet/tls/types.hpp>
+#include <libcornet/tls/tls_socket.hpp>
+#include <libcornet/tls/key_store.hpp>
+#include <libcornet/tls/tls_trusted_certs.hpp>
+#include <libcornet/tls/certificate_compression.hpp>
+#include <libcornet/poller.hpp>
+#include <libcornet/trace.hpp>
+
+namespace net    = pioneer19::cornet;
+namespace tls13  = pioneer19::cornet::tls13;
+namespace record = pioneer19::cornet::tls13::record;
+
+TEST_CASE("algorithms compiled in by build config")
+{
+    auto algorithms = tls13::CertificateCompression::algorithms();
+#if defined(USE_BROTLI)
+    CHECK( tls13::CertificateCompression::is_supported( record::CertificateCompressionAlgorithm::BROTLI ) );
+    // brotli compresses better and is preferred
+    REQUIRE( !algorithms.empty() );
+    CHECK( algorithms.front() == record::CertificateCompressionAlgorithm::BROTLI );
+#else
+    CHECK_FALSE( tls13::CertificateCompression::is_supported( record::CertificateCompressionAlgorithm::BROTLI ) );
+#endif
+#if defined(USE_ZLIB)
+    CHECK( tls13::CertificateCompression::is_supported( record::CertificateCompressionAlgorithm::ZLIB ) );
+#else
+    CHECK_FALSE( tls13::CertificateCompression::is_supported( record::CertificateCompressionAlgorithm::ZLIB ) );
+#endif
+#if !defined(USE_BROTLI) && !defined(USE_ZLIB)
+    CHECK( algorithms.empty() );
+#endif
+}
+
+TEST_CASE("compressed data decompressed to original")
+{
+    std::string data;
+    for( uint32_t i = 0; i < 200; ++i )
+        data += "DNS:host" + std::to_string( i ) + ".localhost,";
+    const auto* bytes = reinterpret_cast<const uint8_t*>( data.data() );
+
+    for( auto algorithm : tls13::CertificateCompression::algorithms() )
+    {
+        auto compressed = tls13::CertificateCompression::compress( algorithm, bytes, data.size() );
+        REQUIRE( !compressed.empty() );
+        CHECK( compressed.size() < data.size() );
+
+        std::string decompressed( data.size(), '\0' );
+        auto* out = reinterpret_cast<uint8_t*>( decompressed.data() );
+        CHECK( tls13::CertificateCompression::decompress( algorithm, compressed.data(), compressed.size()
+                                                          , out, decompressed.size() ) );
+        CHECK( decompressed == data );
+        // uncompressed_length from message must match exactly
+        CHECK_FALSE( tls13::CertificateCompression::decompress( algorithm, compressed.data(), compressed.size()
+                                                                , out, decompressed.size() - 1 ) );
+        // corrupted data
+        compressed.resize( compressed.size() / 2 );
+        CHECK_FALSE( tls13::CertificateCompression::decompress( algorithm, compressed.data(), compressed.size()
+                                                                , out, decompressed.size() ) );
+    }
+}
+
+/**
+ * P-256 key and self signed "localhost" certificate with many alt names (compressible
+ * Certificate message) in temporary directory, certificate is trusted by clients of this thread
+ */
+class LocalhostKeyStore
+{
+public:
+    LocalhostKeyStore()
+    {
+        char dir_template[] = "/tmp/libcornet_compression_test.XXXXXX";
+        REQUIRE( mkdtemp( dir_template ) != nullptr );
+        m_dir = dir_template;
+
+        EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id( EVP_PKEY_EC, nullptr );
+        EVP_PKEY* key = nullptr;
+        REQUIRE( EVP_PKEY_keygen_init( pctx ) == 1 );
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid( pctx, NID_X9_62_prime256v1 );
+        REQUIRE( EVP_PKEY_keygen( pctx, &key ) == 1 );
+        EVP_PKEY_CTX_free( pctx );
+
+        X509* cert = X509_new();
+        X509_set_version( cert, 2 );
+        ASN1_INTEGER_set( X509_get_serialNumber( cert ), 1 );
+        X509_gmtime_adj( X509_getm_notBefore( cert ), -3600 );
+        X509_gmtime_adj( X509_getm_notAfter( cert ), 3600 );
+        X509_set_pubkey( cert, key );
+        X509_NAME* name = X509_get_subject_name( cert );
+        X509_NAME_add_entry_by_txt( name, "CN", MBSTRING_ASC
+                                    , reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0 );
+        X509_set_issuer_name( cert, name );
+        std::string alt_names = "DNS:localhost";
+        for( uint32_t i = 0; i < 50; ++i )
+            alt_names += ",DNS:host" + std::to_string( i ) + ".localhost";
+        X509_EXTENSION* san = X509V3_EXT_conf_nid( nullptr, nullptr, NID_subject_alt_name, alt_names.data() );
+        X509_add_ext( cert, san, -1 );
+        X509_EXTENSION_free( san );
+        REQUIRE( X509_sign( cert, key, EVP_sha256() ) != 0 );
+
+        m_key_file  = m_dir + "/localhost.key.pem";
+        m_cert_file = m_dir + "/localhost.cert.pem";
+        FILE* file = fopen( m_key_file.c_str(), "w" );
+        PEM_write_PrivateKey( file, key, nullptr, nullptr, 0, nullptr, nullptr );
+        fclose( file );
+        file = fopen( m_cert_file.c_str(), "w" );
+        PEM_write_X509( file, cert );
+        fclose( file );
+
+        X509_STORE_add_cert( tls13::TlsTrustedCerts::store_instance(), cert );
+        X509_free( cert );
+        EVP_PKEY_free( key );
+
+        key_store = std::make_unique<tls13::SingleDomainKeyStore>(
+                "localhost", m_key_file.c_str(), m_cert_file.c_str() );
+    }
+    ~LocalhostKeyStore()
+    {
+        unlink( m_key_file.c_str() );
+        unlink( m_cert_file.c_str() );
+        rmdir( m_dir.c_str() );
+    }
+
+    std::unique_ptr<tls13::SingleDomainKeyStore> key_store;
+
+private:
+    std::string m_dir;
+    std::string m_key_file;
+    std::string m_cert_file;
+};
+
+/**
+ * coroutine started by resume() only
+ */
+struct TestTask
+{
+    struct promise_type;
+    using coro_handler = std::experimental::coroutine_handle<promise_type>;
+
+    struct promise_type
+    {
+        std::experimental::suspend_always initial_suspend() noexcept { return {}; }
+        std::experimental::suspend_always final_suspend() noexcept   { return {}; }
+        TestTask get_return_object() { return TestTask{coro_handler::from_promise(*this)}; }
+        void unhandled_exception() { std::terminate(); }
+        void return_void() {}
+    };
+
+    explicit TestTask( coro_handler coro ) noexcept : coro( coro ) {}
+    TestTask( const TestTask& ) = delete;
+    TestTask& operator=( const TestTask& ) = delete;
+    ~TestTask() { if( coro ) coro.destroy(); }
+
+    coro_handler coro;
+};
+
+struct SessionResult
+{
+    std::string data;
+    std::string error;
+};
+
+static const char SERVER_MESSAGE[] = "data after compressed certificate";
+
+static TestTask server_session( net::Poller& poller, tls13::TlsSocket& listener
+                                , tls13::KeyStore* key_store, SessionResult& result )
+{
+    try
+    {
+        net::TcpSocket tcp_socket = co_await listener.async_accept_tcp( poller );
+        tls13::TlsSocket socket = co_await tls13::TlsSocket::server_handshake( std::move(tcp_socket), key_store );
+        co_await socket.async_write( SERVER_MESSAGE, sizeof(SERVER_MESSAGE)-1 );
+        co_await socket.async_close_notify();
+    }
+    catch( const std::exception& ex )
+    {
+        result.error = ex.what();
+    }
+}
+
+static TestTask client_session( net::Poller& poller, uint16_t port, SessionResult& result )
+{
+    try
+    {
+        tls13::TlsSocket socket;
+        if( co_await socket.async_connect( poller, "::1", port, "localhost" ))
+        {
+            char buffer[1024];
+            while( auto bytes_read = co_await socket.async_read( buffer, sizeof(buffer) ))
+                result.data.append( buffer, bytes_read );
+        }
+    }
+    catch( const std::exception& ex )
+    {
+        result.error = ex.what();
+    }
+    poller.stop();
+}
+
+TEST_CASE("server certificate sent compressed is verified by client")
+{
+    constexpr uint16_t PORT = 10430;
+    LocalhostKeyStore localhost;
+    const tls13::DomainKeys* domain_keys = localhost.key_store->find( "localhost" );
+    REQUIRE( domain_keys != nullptr );
+    bool compressed = !tls13::CertificateCompression::algorithms().empty();
+    if( compressed )
+    {
+        REQUIRE( !domain_keys->compressed_certificate_message.empty() );
+        CHECK( domain_keys->compressed_certificate_message.size() < domain_keys->certificate_message.size() );
+    }
+    else
+    {
+        CHECK( domain_keys->compressed_certificate_message.empty() );
+    }
+
+    net::TraceRing::set_enabled( true );
+    net::TraceRing::instance().clear();
+
+    net::Poller poller;
+    tls13::TlsSocket listener;
+    listener.bind( "::1", PORT );
+    listener.listen( poller );
+
+    SessionResult server_result;
+    SessionResult client_result;
+    TestTask server = server_session( poller, listener, localhost.key_store.get(), server_result );
+    server.coro.resume();
+    TestTask client = client_session( poller, PORT, client_result );
+    client.coro.resume();
+    poller.run();
+
+    CHECK( server_result.error.empty() );
+    CHECK( client_result.error.empty() );
+    CHECK( client_result.data == SERVER_MESSAGE );
+
+    // server flight has CompressedCertificate instead of Certificate if algorithm is compiled in
+    auto records = net::TraceRing::instance().records();
+    auto sent_message = [&records]( record::HandshakeType type ) {
+        return std::any_of( records.begin(), records.end(), [type]( const net::TraceRecord& trace ) {
+            return trace.event == net::TraceEvent::HANDSHAKE_MESSAGE
+                   && trace.handshake_type == static_cast<uint8_t>(type); } );
+    };
+    CHECK( sent_message( record::HandshakeType::COMPRESSED_CERTIFICATE ) == compressed );
+    CHECK( sent_message( record::HandshakeType::CERTIFICATE ) != compressed );
+}
@@ -0,0 +1,138 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <ctime>
+#include <vector>
+
+#include <openssl/evp.h>
+#include <openssl/ec.h>
+#include <openssl/x509.h>
+
+#include <libcornet/tls/certificate_verify_cache.hpp>
+
+namespace tls13 = pioneer19::cornet::tls13;
+using tls13::CertificateVerifyCache;
+
+TEST_CASE("CertificateVerifyCache chain key")
+{
+    const uint8_t cert1[] = { 1, 2, 3, 4 };
+    const uint8_t cert2[] = { 5, 6 };
+    std::vector<CertificateVerifyCache::DerCert> chain = { { cert1, 4 }, { cert2, 2 } };
+    auto key = CertificateVerifyCache::chain_key( "example.com", chain );
+
+    CHECK( CertificateVerifyCache::chain_key( "example.com", chain ) == key );
+    CHECK( CertificateVerifyCache::chain_key( "example.org", chain ) != key );
+    // the same bytes split in other certificates
+    std::vector<CertificateVerifyCache::DerCert> other_split = { { cert1, 3 }, { cert1 + 3, 1 }, { cert2, 2 } };
+    CHECK( CertificateVerifyCache::chain_key( "example.com", other_split ) != key );
+    chain.pop_back();
+    CHECK( CertificateVerifyCache::chain_key( "example.com", chain ) != key );
+}
+
+static CertificateVerifyCache::Key test_key( uint8_t n )
+{
+    CertificateVerifyCache::Key key = {};
+    key[0] = n;
+    key[31] = n;
+    return key;
+}
+
+TEST_CASE("CertificateVerifyCache expires and evicts least recently used")
+{
+    CertificateVerifyCache cache{ 2, 3600 };
+    time_t now = 1000000;
+
+    CHECK_FALSE( cache.find( test_key(1), now ) );
+    cache.store( test_key(1), now + 10 );
+    cache.store( test_key(2), now + 100 );
+    CHECK( cache.find( test_key(1), now ) );
+    CHECK( cache.size() == 2 );
+
+    // 2 is least recently used
+    cache.store( test_key(3), now + 100 );
+    CHECK( cache.size() == 2 );
+    CHECK_FALSE( cache.find( test_key(2), now ) );
+    CHECK( cache.find( test_key(1), now ) );
+    CHECK( cache.find( test_key(3), now ) );
+
+    // expired entry is removed
+    CHECK_FALSE( cache.find( test_key(1), now + 10 ) );
+    CHECK( cache.size() == 1 );
+
+    cache.clear();
+    CHECK( cache.size() == 0 );
+}
+
+static X509* create_cert( long not_after_sec )
+{
+    EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id( EVP_PKEY_EC, nullptr );
+    EVP_PKEY* key = nullptr;
+    EVP_PKEY_keygen_init( pctx );
+    EVP_PKEY_CTX_set_ec_paramgen_curve_nid( pctx, NID_X9_62_prime256v1 );
+    EVP_PKEY_keygen( pctx, &key );
+    EVP_PKEY_CTX_free( pctx );
+
+    X509* cert = X509_new();
+    X509_set_version( cert, 2 );
+    X509_gmtime_adj( X509_getm_notBefore( cert ), 0 );
+    X509_gmtime_adj( X509_getm_notAfter( cert ), not_after_sec );
+    X509_set_pubkey( cert, key );
+    X509_sign( cert, key, EVP_sha256() );
+    EVP_PKEY_free( key );
+
+    return cert;
+}
+
+TEST_CASE("CertificateVerifyCache entry expires with chain")
+{
+    CertificateVerifyCache cache{ 16, 3600 };
+    time_t now = time( nullptr );
+
+    STACK_OF(X509)* chain = sk_X509_new_null();
+    sk_X509_push( chain, create_cert( 24*3600 ) );
+    sk_X509_push( chain, create_cert( 600 ) );
+
+    cache.store( test_key(1), chain, now );
+    CHECK( cache.find( test_key(1), now + 599 ) );
+    CHECK_FALSE( cache.find( test_key(1), now + 601 ) );
+
+    // max ttl is shorter than certificates validity
+    X509_free( sk_X509_pop( chain ) );
+    cache.store( test_key(2), chain, now );
+    CHECK( cache.find( test_key(2), now + 3599 ) );
+    CHECK_FALSE( cache.find( test_key(2), now + 3600 ) );
+
+    sk_X509_pop_free( chain, X509_free );
+}
+
+TEST_CASE("CertificateVerifyCache keeps issuer of host certificate")
+{
+    CertificateVerifyCache cache{ 16, 3600 };
+    time_t now = time( nullptr );
+
+    STACK_OF(X509)* chain = sk_X509_new_null();
+    sk_X509_push( chain, create_cert( 24*3600 ) );
+    sk_X509_push( chain, create_cert( 24*3600 ) );
+
+    cache.store( test_key(1), chain, now );
+    CertificateVerifyCache::IssuerPtr issuer;
+    REQUIRE( cache.find( test_key(1), now, &issuer ) );
+    CHECK( issuer.get() == sk_X509_value( chain, 1 ) );
+
+    // self signed host certificate is verified chain itself
+    X509_free( sk_X509_pop( chain ) );
+    cache.store( test_key(2), chain, now );
+    REQUIRE( cache.find( test_key(2), now, &issuer ) );
+    CHECK( issuer.get() == sk_X509_value( chain, 0 ) );
+
+    // issuer outlives chain and evicted entry
+    sk_X509_pop_free( chain, X509_free );
+    cache.clear();
+    CHECK( X509_get0_notAfter( issuer.get() ) != nullptr );
+}
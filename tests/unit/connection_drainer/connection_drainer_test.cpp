@@ -0,0 +1,137 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <chrono>
+#include <optional>
+#include <experimental/coroutine>
+
+#include <libcornet/poller.hpp>
+#include <libcornet/async_file.hpp>
+#include <libcornet/tls/connection_drainer.hpp>
+
+namespace net = pioneer19::cornet;
+namespace tls13 = pioneer19::cornet::tls13;
+
+/**
+ * coroutine started by resume() only
+ */
+struct TestTask
+{
+    struct promise_type;
+    using coro_handler = std::experimental::coroutine_handle<promise_type>;
+
+    struct promise_type
+    {
+        std::experimental::suspend_always initial_suspend() noexcept { return {}; }
+        std::experimental::suspend_always final_suspend() noexcept   { return {}; }
+        TestTask get_return_object() { return TestTask{coro_handler::from_promise(*this)}; }
+        void unhandled_exception() { std::terminate(); }
+        void return_void() {}
+    };
+
+    explicit TestTask( coro_handler coro ) noexcept : coro( coro ) {}
+    TestTask( const TestTask& ) = delete;
+    TestTask& operator=( const TestTask& ) = delete;
+    ~TestTask() { if( coro ) coro.destroy(); }
+
+    coro_handler coro;
+};
+
+static TestTask wait_sessions( net::Poller& poller, tls13::ConnectionDrainer& drainer
+                               , bool drain, std::chrono::milliseconds timeout, std::optional<bool>& result )
+{
+    if( drain )
+        result = co_await drainer.drain( poller, timeout );
+    else
+        result = co_await drainer.wait_finished( poller, timeout );
+    poller.stop();
+}
+
+/**
+ * session finished when pipe gets data
+ */
+static TestTask finish_session( net::AsyncFile& file, std::optional<tls13::ConnectionDrainer::Session>& session )
+{
+    char buffer[16];
+    co_await file.async_read( buffer, sizeof(buffer) );
+    session.reset();
+}
+
+TEST_CASE("wait without sessions returns at once")
+{
+    net::Poller poller;
+    tls13::ConnectionDrainer drainer;
+    std::optional<bool> result;
+
+    TestTask task = wait_sessions( poller, drainer, false, std::chrono::milliseconds{10}, result );
+    task.coro.resume();
+
+    CHECK( task.coro.done() );
+    REQUIRE( result.has_value() );
+    CHECK( *result );
+    CHECK_FALSE( drainer.draining() );
+}
+
+TEST_CASE("wait returns when last session finished")
+{
+    int pipe_fds[2];
+    REQUIRE( pipe2( pipe_fds, O_NONBLOCK|O_CLOEXEC ) == 0 );
+
+    net::Poller poller;
+    net::AsyncFile file{ pipe_fds[0], &poller };
+    tls13::ConnectionDrainer drainer;
+    std::optional<tls13::ConnectionDrainer::Session> session1;
+    std::optional<tls13::ConnectionDrainer::Session> session2;
+    session1.emplace( drainer );
+    session2.emplace( drainer );
+    CHECK( drainer.sessions_count() == 2 );
+    session1.reset();
+    CHECK( drainer.sessions_count() == 1 );
+
+    TestTask finisher = finish_session( file, session2 );
+    finisher.coro.resume();
+    std::optional<bool> result;
+    TestTask task = wait_sessions( poller, drainer, false, std::chrono::milliseconds::max(), result );
+    task.coro.resume();
+    CHECK_FALSE( task.coro.done() );
+
+    REQUIRE( write( pipe_fds[1], "x", 1 ) == 1 );
+    poller.run();
+
+    CHECK( finisher.coro.done() );
+    CHECK( task.coro.done() );
+    REQUIRE( result.has_value() );
+    CHECK( *result );
+    CHECK( drainer.sessions_count() == 0 );
+    close( pipe_fds[1] );
+}
+
+TEST_CASE("drain stops on timeout")
+{
+    net::Poller poller;
+    tls13::ConnectionDrainer drainer;
+    tls13::ConnectionDrainer::Session session{ drainer };
+    session.set_idle( true ); // without socket nothing to close
+
+    std::optional<bool> result;
+    auto start_time = std::chrono::steady_clock::now();
+    TestTask task = wait_sessions( poller, drainer, true, std::chrono::milliseconds{20}, result );
+    task.coro.resume();
+    CHECK( drainer.draining() );
+    poller.run();
+
+    CHECK( std::chrono::steady_clock::now() - start_time >= std::chrono::milliseconds{20} );
+    CHECK( task.coro.done() );
+    REQUIRE( result.has_value() );
+    CHECK_FALSE( *result );
+    CHECK( drainer.sessions_count() == 1 );
+}
@@ -0,0 +1,69 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <libcornet/cpu_features.hpp>
+namespace net = pioneer19::cornet;
+#include <libcornet/tls/types.hpp>
+namespace record = pioneer19::cornet::tls13::record;
+#include <libcornet/tls/crypto/cipher_preference.hpp>
+namespace tls_crypto = pioneer19::cornet::tls13::crypto;
+
+TEST_CASE("ChaCha20 preferred without AES-NI")
+{
+    net::CpuFeatures no_aes{};
+    tls_crypto::CipherSuitePreference preference{ no_aes };
+
+    CHECK( preference.order()[0] == record::TLS_CHACHA20_POLY1305_SHA256 );
+    const record::CipherSuite client_suites[] = {
+            record::TLS_AES_256_GCM_SHA384, record::TLS_AES_128_GCM_SHA256
+            , record::TLS_CHACHA20_POLY1305_SHA256 };
+    CHECK( preference.select( client_suites, 3 ) == record::TLS_CHACHA20_POLY1305_SHA256 );
+}
+
+TEST_CASE("AES-GCM preferred with AES-NI")
+{
+    net::CpuFeatures aes_ni{};
+    aes_ni.aes_ni = true;
+    aes_ni.pclmulqdq = true;
+    tls_crypto::CipherSuitePreference preference{ aes_ni };
+
+    CHECK( preference.order()[0] == record::TLS_AES_128_GCM_SHA256 );
+    CHECK( preference.rank( record::TLS_AES_128_GCM_SHA256 ) == 0 );
+    CHECK( preference.rank( record::TLS_AES_128_CCM_SHA256 )
+           == tls_crypto::CipherSuitePreference::SUITES_COUNT );
+
+    SUBCASE( "server order wins over client order" )
+    {
+        const record::CipherSuite client_suites[] = {
+                record::TLS_AES_128_CCM_SHA256, record::TLS_AES_256_GCM_SHA384
+                , record::TLS_AES_128_GCM_SHA256 };
+        CHECK( preference.select( client_suites, 3 ) == record::TLS_AES_128_GCM_SHA256 );
+    }
+    SUBCASE( "client without AES hardware gets ChaCha20" )
+    {
+        const record::CipherSuite client_suites[] = {
+                record::TLS_CHACHA20_POLY1305_SHA256, record::TLS_AES_128_GCM_SHA256 };
+        CHECK( preference.select( client_suites, 2 ) == record::TLS_CHACHA20_POLY1305_SHA256 );
+    }
+    SUBCASE( "no supported suites" )
+    {
+        const record::CipherSuite client_suites[] = { record::TLS_AES_128_CCM_8_SHA256 };
+        CHECK( preference.select( client_suites, 1 ) == record::TLS_PRIVATE_CIPHER_SUITE );
+    }
+}
+
+TEST_CASE("measure_throughput keeps all suites")
+{
+    tls_crypto::CipherSuitePreference preference{ net::CpuFeatures::instance() };
+    preference.measure_throughput( 4 );
+
+    CHECK( preference.rank( record::TLS_AES_128_GCM_SHA256 )       < 3 );
+    CHECK( preference.rank( record::TLS_AES_256_GCM_SHA384 )       < 3 );
+    CHECK( preference.rank( record::TLS_CHACHA20_POLY1305_SHA256 ) < 3 );
+}
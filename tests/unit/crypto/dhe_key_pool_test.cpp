@@ -0,0 +1,81 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <cstring>
+
+#include <libcornet/tls/types.hpp>
+namespace record = pioneer19::cornet::tls13::record;
+#include <libcornet/tls/crypto/dhe_groups.hpp>
+#include <libcornet/tls/crypto/dhe_key_pool.hpp>
+namespace tls_crypto = pioneer19::cornet::tls13::crypto;
+
+TEST_CASE("empty key pool generates key and activates group")
+{
+    tls_crypto::DheKeyPool key_pool{ 4 };
+    EVP_PKEY* key_pair = key_pool.take( record::NamedGroup::X25519 );
+    REQUIRE( key_pair != nullptr );
+    EVP_PKEY_free( key_pair );
+
+    CHECK( key_pool.size( record::NamedGroup::X25519 ) == 0 );
+    CHECK( key_pool.refill( 3 ) == 3 );
+    CHECK( key_pool.refill( 3 ) == 1 );
+    CHECK( key_pool.refill( 3 ) == 0 );
+    CHECK( key_pool.size( record::NamedGroup::X25519 ) == 4 );
+    // not used groups are not filled
+    CHECK( key_pool.size( record::NamedGroup::SECP256R1 ) == 0 );
+}
+
+TEST_CASE("key pool returns distinct keys")
+{
+    tls_crypto::DheKeyPool key_pool{ 2 };
+    key_pool.fill( record::NamedGroup::SECP256R1 );
+    REQUIRE( key_pool.size( record::NamedGroup::SECP256R1 ) == 2 );
+
+    EVP_PKEY* first  = key_pool.take( record::NamedGroup::SECP256R1 );
+    EVP_PKEY* second = key_pool.take( record::NamedGroup::SECP256R1 );
+    REQUIRE( first != nullptr );
+    REQUIRE( second != nullptr );
+    CHECK( key_pool.size( record::NamedGroup::SECP256R1 ) == 0 );
+    CHECK( EVP_PKEY_eq( first, second ) != 1 );
+
+    EVP_PKEY_free( first );
+    EVP_PKEY_free( second );
+}
+
+static void check_pooled_keys_derive_same_secret( record::NamedGroup named_group )
+{
+    tls_crypto::DheKeyPool::instance().fill( named_group );
+
+    tls_crypto::DheGroup client{ named_group };
+    tls_crypto::DheGroup server;
+    server.set_dhe_group( named_group );
+
+    uint8_t client_public[256];
+    uint8_t server_public[256];
+    uint32_t client_public_size = client.copy_public_key( client_public );
+    uint32_t server_public_size = server.copy_public_key( server_public );
+
+    uint8_t client_secret[256];
+    uint8_t server_secret[256];
+    uint32_t client_secret_size = client.derive_secret(
+            named_group, server_public, server_public_size, client_secret );
+    uint32_t server_secret_size = server.derive_secret(
+            named_group, client_public, client_public_size, server_secret );
+
+    REQUIRE( client_secret_size > 0 );
+    REQUIRE( client_secret_size == server_secret_size );
+    CHECK( memcmp( client_secret, server_secret, client_secret_size ) == 0 );
+}
+
+TEST_CASE("pooled keys derive same shared secret")
+{
+    check_pooled_keys_derive_same_secret( record::NamedGroup::X25519 );
+    check_pooled_keys_derive_same_secret( record::NamedGroup::SECP256R1 );
+    check_pooled_keys_derive_same_secret( record::NamedGroup::SECP384R1 );
+}
@@ -0,0 +1,71 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <stdexcept>
+
+#include <libcornet/tls/types.hpp>
+namespace record = pioneer19::cornet::tls13::record;
+#include <libcornet/tls/crypto/named_group_preference.hpp>
+namespace tls_crypto = pioneer19::cornet::tls13::crypto;
+
+TEST_CASE("NamedGroupPreference defaults")
+{
+    tls_crypto::NamedGroupPreference preference;
+
+    CHECK( preference.groups().size() == tls_crypto::NamedGroupPreference::MAX_GROUPS );
+    CHECK( preference.groups()[0] == record::NamedGroup::X25519 );
+    REQUIRE( preference.key_shares().size() == 1 );
+    CHECK( preference.key_shares()[0] == record::NamedGroup::X25519 );
+    CHECK( preference.is_enabled( record::NamedGroup::SECP384R1 ) );
+    CHECK_FALSE( preference.is_enabled( record::NamedGroup::FFDHE2048 ) );
+}
+
+TEST_CASE("NamedGroupPreference skips unsupported and duplicate groups")
+{
+    tls_crypto::NamedGroupPreference preference;
+
+    const record::NamedGroup groups[] = {
+            record::NamedGroup::FFDHE2048, record::NamedGroup::SECP256R1
+            , record::NamedGroup::SECP256R1, record::NamedGroup::X448 };
+    preference.set_groups( groups );
+    REQUIRE( preference.groups().size() == 2 );
+    CHECK( preference.groups()[0] == record::NamedGroup::SECP256R1 );
+    CHECK( preference.groups()[1] == record::NamedGroup::X448 );
+    CHECK_FALSE( preference.is_enabled( record::NamedGroup::X25519 ) );
+    // X25519 key share removed, client sends share of most preferred group
+    REQUIRE( preference.key_shares().size() == 1 );
+    CHECK( preference.key_shares()[0] == record::NamedGroup::SECP256R1 );
+}
+
+TEST_CASE("NamedGroupPreference several key shares")
+{
+    tls_crypto::NamedGroupPreference preference;
+
+    const record::NamedGroup key_shares[] = {
+            record::NamedGroup::X25519, record::NamedGroup::FFDHE2048
+            , record::NamedGroup::SECP256R1 };
+    preference.set_key_shares( key_shares );
+    REQUIRE( preference.key_shares().size() == 2 );
+    CHECK( preference.key_shares()[1] == record::NamedGroup::SECP256R1 );
+
+    const record::NamedGroup groups[] = { record::NamedGroup::SECP384R1, record::NamedGroup::SECP256R1 };
+    preference.set_groups( groups );
+    REQUIRE( preference.key_shares().size() == 1 );
+    CHECK( preference.key_shares()[0] == record::NamedGroup::SECP256R1 );
+}
+
+TEST_CASE("NamedGroupPreference throws if nothing left")
+{
+    tls_crypto::NamedGroupPreference preference;
+
+    const record::NamedGroup groups[] = { record::NamedGroup::FFDHE2048 };
+    CHECK_THROWS_AS( preference.set_groups( groups ), std::invalid_argument );
+    CHECK_THROWS_AS( preference.set_key_shares( groups ), std::invalid_argument );
+    CHECK( preference.groups().size() == tls_crypto::NamedGroupPreference::MAX_GROUPS );
+}
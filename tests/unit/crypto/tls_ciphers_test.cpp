@@ -233,6 +233,92 @@ TEST_CASE("Tls13_chacha20_poly1305_sha256 encrypt then decrypt")
     CHECK( decrypted_size == sizeof(plaintext)-1 );
 }
 
+TEST_CASE("encrypt_records result decrypted by record")
+{
+    tls_crypto::TlsCipherSuite aes_128_gcm;
+    aes_128_gcm.set_cipher_suite( record::TLS_AES_128_GCM_SHA256 );
+    const uint8_t plaintext[] = "Hello, world! // tls aes_128_gcm batch!!!";
+    const uint8_t tail[] = { 0x17 };
+    const uint8_t aad[] = "today is good day";
+    const uint8_t key[16] = {
+            0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0a,0x0b,0x0c,0x0d,0x0e,0x0f };
+    const uint8_t iv[12] = {
+            0x00,0x01,0x02,0x03,0x04,0x05,0x06,0x07,0x08,0x09,0x0a,0x0b };
+    std::copy_n( key, sizeof(key), aes_128_gcm.sender_key_data() );
+    std::copy_n( key, sizeof(key), aes_128_gcm.receiver_key_data() );
+    std::copy_n( iv, sizeof(iv),   aes_128_gcm.sender_iv_data() );
+    std::copy_n( iv, sizeof(iv),   aes_128_gcm.receiver_iv_data() );
+
+    constexpr uint32_t RECORDS_COUNT = 4;
+    constexpr uint32_t RECORD_SIZE = sizeof(plaintext)-1 + sizeof(tail);
+    uint8_t ciphertext[RECORDS_COUNT][RECORD_SIZE];
+    uint8_t tags[RECORDS_COUNT][16];
+    tls_crypto::RecordIn  records_in [RECORDS_COUNT];
+    tls_crypto::RecordOut records_out[RECORDS_COUNT];
+    for( uint32_t i = 0; i < RECORDS_COUNT; ++i )
+    {
+        records_in[i]  = { plaintext, sizeof(plaintext)-1, tail, sizeof(tail), aad, sizeof(aad)-1 };
+        records_out[i] = { ciphertext[i], tags[i], 0 };
+    }
+    auto encrypted_count = aes_128_gcm.encrypt_records( records_in, records_out );
+    REQUIRE( encrypted_count == RECORDS_COUNT );
+
+    for( uint32_t i = 0; i < RECORDS_COUNT; ++i )
+    {
+        REQUIRE( records_out[i].ciphertext_size == RECORD_SIZE );
+        uint8_t decrypted[RECORD_SIZE];
+        uint32_t decrypted_size = aes_128_gcm.decrypt( ciphertext[i], RECORD_SIZE
+                ,aad, sizeof(aad)-1, tags[i], decrypted );
+        REQUIRE( decrypted_size == RECORD_SIZE );
+        CHECK( std::equal( plaintext, plaintext+sizeof(plaintext)-1, decrypted ) );
+        CHECK( decrypted[RECORD_SIZE-1] == tail[0] );
+    }
+}
+
+TEST_CASE("decrypt_records decrypts encrypt_records result in place")
+{
+    tls_crypto::TlsCipherSuite chacha20;
+    chacha20.set_cipher_suite( record::TLS_CHACHA20_POLY1305_SHA256 );
+    const uint8_t plaintext[] = "Hello, world! // tls chacha20 batch decrypt";
+    const uint8_t tail[] = { 0x17 };
+    const uint8_t aad[] = "today is good day";
+    std::fill_n( chacha20.sender_key_data(), chacha20.key_size(), 0x42 );
+    std::fill_n( chacha20.receiver_key_data(), chacha20.key_size(), 0x42 );
+    std::fill_n( chacha20.sender_iv_data(), chacha20.iv_size(), 0x24 );
+    std::fill_n( chacha20.receiver_iv_data(), chacha20.iv_size(), 0x24 );
+
+    constexpr uint32_t RECORDS_COUNT = 4;
+    constexpr uint32_t RECORD_SIZE = sizeof(plaintext)-1 + sizeof(tail);
+    uint8_t ciphertext[RECORDS_COUNT][RECORD_SIZE];
+    uint8_t tags[RECORDS_COUNT][16];
+    tls_crypto::RecordIn  records_in [RECORDS_COUNT];
+    tls_crypto::RecordOut records_out[RECORDS_COUNT];
+    for( uint32_t i = 0; i < RECORDS_COUNT; ++i )
+    {
+        records_in[i]  = { plaintext, sizeof(plaintext)-1, tail, sizeof(tail), aad, sizeof(aad)-1 };
+        records_out[i] = { ciphertext[i], tags[i], 0 };
+    }
+    REQUIRE( chacha20.encrypt_records( records_in, records_out ) == RECORDS_COUNT );
+
+    // third record is corrupted, batch stops on it
+    tags[2][0] ^= 0x01;
+    tls_crypto::CiphertextIn ciphertexts_in[RECORDS_COUNT];
+    tls_crypto::PlaintextOut plaintexts_out[RECORDS_COUNT];
+    for( uint32_t i = 0; i < RECORDS_COUNT; ++i )
+    {
+        ciphertexts_in[i] = { ciphertext[i], RECORD_SIZE, aad, sizeof(aad)-1, tags[i] };
+        plaintexts_out[i] = { ciphertext[i], 0 };
+    }
+    REQUIRE( chacha20.decrypt_records( ciphertexts_in, plaintexts_out ) == 2 );
+
+    for( uint32_t i = 0; i < 2; ++i )
+    {
+        REQUIRE( plaintexts_out[i].plaintext_size == RECORD_SIZE );
+        CHECK( std::equal( plaintext, plaintext+sizeof(plaintext)-1, ciphertext[i] ) );
+        CHECK( ciphertext[i][RECORD_SIZE-1] == tail[0] );
+    }
+}
+
 //TEST_CASE("hkdf_extract check rfc5869 test case 1")
 //{
 //    /*
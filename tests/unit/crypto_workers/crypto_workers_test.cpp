@@ -0,0 +1,184 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <stdexcept>
+#include <experimental/coroutine>
+
+#include <libcornet/poller.hpp>
+#include <libcornet/tls/crypto/crypto_workers.hpp>
+namespace net = pioneer19::cornet;
+namespace tls_crypto = pioneer19::cornet::tls13::crypto;
+
+/**
+ * coroutine started by resume() only, so it can be started inside Poller::run()
+ */
+struct TestTask
+{
+    struct promise_type;
+    using coro_handler = std::experimental::coroutine_handle<promise_type>;
+
+    struct promise_type
+    {
+        std::experimental::suspend_always initial_suspend() noexcept { return {}; }
+        std::experimental::suspend_always final_suspend() noexcept   { return {}; }
+        TestTask get_return_object() { return TestTask{coro_handler::from_promise(*this)}; }
+        void unhandled_exception() { std::terminate(); }
+        void return_void() {}
+    };
+
+    explicit TestTask( coro_handler coro ) noexcept : coro( coro ) {}
+    TestTask( const TestTask& ) = delete;
+    TestTask& operator=( const TestTask& ) = delete;
+    ~TestTask() { if( coro ) coro.destroy(); }
+
+    coro_handler coro;
+};
+
+struct OffloadResult
+{
+    std::thread::id job_thread;
+    std::thread::id resumed_thread;
+    bool exception_caught = false;
+};
+
+static TestTask offload_task( net::Poller& poller, OffloadResult& result )
+{
+    co_await tls_crypto::CryptoWorkers::offload(
+            [&result](){ result.job_thread = std::this_thread::get_id(); } );
+    result.resumed_thread = std::this_thread::get_id();
+
+    try
+    {
+        co_await tls_crypto::CryptoWorkers::offload( [](){ throw std::runtime_error( "job failed" ); } );
+    }
+    catch( const std::runtime_error& )
+    {
+        result.exception_caught = true;
+    }
+    poller.stop();
+}
+
+TEST_CASE("offload runs inline outside of poller")
+{
+    net::Poller poller;
+    OffloadResult result;
+    TestTask task = offload_task( poller, result );
+    task.coro.resume();
+
+    CHECK( task.coro.done() );
+    CHECK( result.job_thread == std::this_thread::get_id() );
+    CHECK( result.resumed_thread == std::this_thread::get_id() );
+    CHECK( result.exception_caught );
+}
+
+TEST_CASE("offload runs job in worker and resumes in poller thread")
+{
+    auto& crypto_workers = tls_crypto::CryptoWorkers::instance();
+    crypto_workers.start( 2 );
+
+    net::Poller poller;
+    OffloadResult result;
+    TestTask task = offload_task( poller, result );
+    // start task from poller thread
+    poller.resume_queue().post( task.coro );
+    poller.run();
+    crypto_workers.stop();
+
+    CHECK( task.coro.done() );
+    CHECK( result.job_thread != std::this_thread::get_id() );
+    CHECK( result.resumed_thread == std::this_thread::get_id() );
+    CHECK( result.exception_caught );
+}
+
+static TestTask offload_flag_task( std::atomic<bool>& started, std::atomic<bool>& finished
+                                   , std::chrono::milliseconds job_duration )
+{
+    co_await tls_crypto::CryptoWorkers::offload( [&started,&finished,job_duration]()
+    {
+        started = true;
+        std::this_thread::sleep_for( job_duration );
+        finished = true;
+    } );
+}
+
+/// coroutine is resumed by resume queue, so earlier posted coroutines are already processed
+struct ResumeQueueAwaiter
+{
+    bool await_ready() noexcept { return false; }
+    void await_suspend( std::experimental::coroutine_handle<> coro_handle ) { queue.post( coro_handle ); }
+    void await_resume() noexcept {}
+
+    net::ResumeQueue& queue;
+};
+
+struct CancelResult
+{
+    bool pending_job_started   = false;
+    bool running_job_finished  = false;
+    bool done_job_finished     = false;
+};
+
+static TestTask destroy_offloading_tasks( net::Poller& poller, CancelResult& result )
+{
+    using namespace std::chrono_literals;
+    std::atomic<bool> running_started = false, running_finished = false;
+    std::atomic<bool> pending_started = false, pending_finished = false;
+    std::atomic<bool> done_started    = false, done_finished    = false;
+
+    // single worker runs first job, second one waits in queue
+    TestTask running = offload_flag_task( running_started, running_finished, 100ms );
+    running.coro.resume();
+    TestTask pending = offload_flag_task( pending_started, pending_finished, 0ms );
+    pending.coro.resume();
+    while( !running_started )
+        std::this_thread::yield();
+
+    pending.coro.destroy();
+    pending.coro = nullptr;
+    // job uses coroutine frame, destruction waits for job end
+    running.coro.destroy();
+    running.coro = nullptr;
+    result.running_job_finished = running_finished;
+
+    // job is done and resume is posted to resume queue before coroutine destruction
+    TestTask done = offload_flag_task( done_started, done_finished, 0ms );
+    done.coro.resume();
+    while( !done_finished )
+        std::this_thread::yield();
+    std::this_thread::sleep_for( 10ms );
+    done.coro.destroy();
+    done.coro = nullptr;
+    result.done_job_finished = done_finished;
+
+    co_await ResumeQueueAwaiter{ poller.resume_queue() };
+    result.pending_job_started = pending_started;
+    poller.stop();
+}
+
+TEST_CASE("destroyed coroutine cancels offloaded job")
+{
+    auto& crypto_workers = tls_crypto::CryptoWorkers::instance();
+    crypto_workers.start( 1 );
+
+    net::Poller poller;
+    CancelResult result;
+    TestTask task = destroy_offloading_tasks( poller, result );
+    poller.resume_queue().post( task.coro );
+    poller.run();
+    crypto_workers.stop();
+
+    CHECK( task.coro.done() );
+    CHECK( result.running_job_finished );
+    CHECK( result.done_job_finished );
+    // cancelled before worker took it
+    CHECK_FALSE( result.pending_job_started );
+}
@@ -0,0 +1,164 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <cstring>
+#include <string>
+
+#include <libcornet/tls/parser.hpp>
+#include <libcornet/tls/anti_replay.hpp>
+#include <libcornet/tls/record_helpers.hpp>
+#include <libcornet/tls/session_ticket.hpp>
+#include <libcornet/tls/crypto/record_cryptor.hpp>
+#include <libcornet/tls/crypto/tls_handshake.hpp>
+
+namespace tls13  = pioneer19::cornet::tls13;
+namespace record = pioneer19::cornet::tls13::record;
+
+static void fill_hash( uint8_t* hash, uint8_t seed )
+{
+    for( uint8_t i = 0; i < 32; ++i )
+        hash[i] = static_cast<uint8_t>( seed*31 + i*7 );
+}
+
+TEST_CASE("anti replay rejects repeated ClientHello")
+{
+    tls13::EarlyDataAntiReplay anti_replay{ 1000, 1U << 12 };
+    uint8_t hash[32];
+    fill_hash( hash, 1 );
+
+    CHECK( anti_replay.check_and_insert( hash, sizeof(hash), 100'000 ) );
+    CHECK_FALSE( anti_replay.check_and_insert( hash, sizeof(hash), 100'010 ) );
+
+    uint8_t other_hash[32];
+    fill_hash( other_hash, 2 );
+    CHECK( anti_replay.check_and_insert( other_hash, sizeof(other_hash), 100'020 ) );
+}
+
+TEST_CASE("anti replay keeps previous window and drops older")
+{
+    tls13::EarlyDataAntiReplay anti_replay{ 1000, 1U << 12 };
+    uint8_t hash[32];
+    fill_hash( hash, 3 );
+
+    CHECK( anti_replay.check_and_insert( hash, sizeof(hash), 100'000 ) );
+    // next window still checks previous filter
+    CHECK_FALSE( anti_replay.check_and_insert( hash, sizeof(hash), 101'500 ) );
+    // forgotten two windows later
+    CHECK( anti_replay.check_and_insert( hash, sizeof(hash), 103'500 ) );
+}
+
+TEST_CASE("anti replay ticket age freshness")
+{
+    tls13::EarlyDataAntiReplay anti_replay{ 1000 };
+    uint64_t issue_time_ms = 100'000;
+
+    CHECK( anti_replay.fresh_ticket_age( 5000, issue_time_ms, issue_time_ms + 5000 ) );
+    CHECK( anti_replay.fresh_ticket_age( 5000, issue_time_ms, issue_time_ms + 5400 ) );
+    CHECK( anti_replay.fresh_ticket_age( 5000, issue_time_ms, issue_time_ms + 4600 ) );
+    CHECK_FALSE( anti_replay.fresh_ticket_age( 5000, issue_time_ms, issue_time_ms + 6000 ) );
+    CHECK_FALSE( anti_replay.fresh_ticket_age( 5000, issue_time_ms, issue_time_ms + 4000 ) );
+}
+
+struct EarlyDataTestHook : public record::EmptyHook
+{
+    void extension_early_data( uint32_t max_size ) { found = true; max_early_data_size = max_size; }
+    void end_of_early_data() { end_found = true; }
+
+    bool     found = false;
+    bool     end_found = false;
+    uint32_t max_early_data_size = 0;
+};
+
+TEST_CASE("NewSessionTicket with early_data extension")
+{
+    uint8_t nonce[] = { 1 };
+    uint8_t ticket[] = { 9, 8, 7, 6 };
+    uint8_t buffer[512];
+
+    uint32_t record_size = tls13::RecordHelpers::create_new_session_ticket_record(
+            3600, 1, nonce, sizeof(nonce), ticket, sizeof(ticket), 16384, buffer );
+    REQUIRE( record_size > 0 );
+
+    EarlyDataTestHook hook;
+    record::Parser parser;
+    auto [bytes_parsed, err] = parser.parse_net_record( &hook, buffer, record_size );
+    REQUIRE_FALSE( err );
+    CHECK( bytes_parsed == record_size );
+    CHECK( hook.found );
+    CHECK( hook.max_early_data_size == 16384 );
+}
+
+TEST_CASE("EndOfEarlyData create and parse")
+{
+    tls13::crypto::RecordCryptor cryptor;
+    std::string sni;
+    tls13::crypto::TlsHandshake tls_handshake{ cryptor, sni };
+    tls_handshake.set_tls_cipher_suite( record::TLS_AES_128_GCM_SHA256 );
+
+    uint8_t buffer[64];
+    uint32_t record_size = tls13::RecordHelpers::create_end_of_early_data_record( tls_handshake, buffer );
+    REQUIRE( record_size == 9 );
+
+    EarlyDataTestHook hook;
+    record::Parser parser;
+    auto [bytes_parsed, err] = parser.parse_net_record( &hook, buffer, record_size );
+    REQUIRE_FALSE( err );
+    CHECK( hook.end_found );
+
+    // EndOfEarlyData with body
+    uint8_t bad_record[] = { 22, 3, 3, 0, 5,  5, 0, 0, 1,  0 };
+    EarlyDataTestHook bad_hook;
+    auto [bad_bytes_parsed, bad_err] = parser.parse_net_record( &bad_hook, bad_record, sizeof(bad_record) );
+    CHECK( bad_err.parse_errno() == record::ParserErrno::E_END_OF_EARLY_DATA_NOT_EMPTY );
+    CHECK_FALSE( bad_hook.end_found );
+}
+
+TEST_CASE("early traffic keys of client and server match")
+{
+    uint8_t psk[32];
+    for( uint8_t i = 0; i < sizeof(psk); ++i )
+        psk[i] = i;
+    uint8_t client_hello_hash[32];
+    fill_hash( client_hello_hash, 4 );
+    auto cipher_suite = record::TLS_AES_128_GCM_SHA256;
+
+    tls13::crypto::RecordCryptor client_cryptor;
+    tls13::crypto::TlsHandshake client_handshake{ client_cryptor, "example.com", record::NamedGroup::X25519 };
+    client_handshake.set_resumption_psk( cipher_suite, psk, sizeof(psk) );
+    client_handshake.set_tls_cipher_suite( cipher_suite );
+    client_handshake.derive_client_early_traffic_secret( client_hello_hash );
+    client_handshake.set_early_data_traffic_keys( true );
+
+    tls13::crypto::RecordCryptor server_cryptor;
+    std::string sni;
+    tls13::crypto::TlsHandshake server_handshake{ server_cryptor, sni };
+    server_handshake.set_tls_cipher_suite( cipher_suite );
+    server_handshake.set_resumption_psk( cipher_suite, psk, sizeof(psk) );
+    server_handshake.derive_client_early_traffic_secret( client_hello_hash );
+    server_handshake.set_early_data_traffic_keys( false );
+
+    const char data[] = "GET / HTTP/1.1\r\n\r\n";
+    uint8_t record_buffer[256];
+    auto* plaintext = reinterpret_cast<record::TlsPlaintext*>( record_buffer );
+    plaintext->init( record::ContentType::APPLICATION_DATA );
+    plaintext->finalize( sizeof(data) );
+    uint32_t encrypted_size = client_cryptor.encrypt_record(
+            record_buffer, reinterpret_cast<const uint8_t*>(data), sizeof(data) );
+    REQUIRE( encrypted_size > sizeof(data) );
+
+    uint8_t corrupted[256];
+    memcpy( corrupted, record_buffer, encrypted_size );
+    corrupted[encrypted_size-1] ^= 1;
+    CHECK( server_cryptor.try_decrypt_record( corrupted ) == 0 );
+
+    // failed trial decryption keeps sequence number
+    uint32_t decrypted_size = server_cryptor.try_decrypt_record( record_buffer );
+    REQUIRE( decrypted_size > 0 );
+    CHECK( memcmp( record_buffer + sizeof(record::TlsPlaintext), data, sizeof(data) ) == 0 );
+}
@@ -0,0 +1,190 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include <openssl/evp.h>
+#include <openssl/ec.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+
+#include <libcornet/tls/key_store.hpp>
+
+namespace tls13 = pioneer19::cornet::tls13;
+
+/**
+ * P-256 key and self signed certificate files in temporary directory
+ */
+class TestCertsDir
+{
+public:
+    TestCertsDir()
+    {
+        char dir_template[] = "/tmp/libcornet_key_store_test.XXXXXX";
+        REQUIRE( mkdtemp( dir_template ) != nullptr );
+        m_dir = dir_template;
+    }
+    ~TestCertsDir()
+    {
+        for( auto& file_name : m_files )
+            unlink( file_name.c_str() );
+        rmdir( m_dir.c_str() );
+    }
+    /// write "<file_name>.key.pem" and "<file_name>.cert.pem" with CN common_name
+    void create( const std::string& file_name, const char* common_name )
+    {
+        EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id( EVP_PKEY_EC, nullptr );
+        EVP_PKEY* key = nullptr;
+        REQUIRE( EVP_PKEY_keygen_init( pctx ) == 1 );
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid( pctx, NID_X9_62_prime256v1 );
+        REQUIRE( EVP_PKEY_keygen( pctx, &key ) == 1 );
+        EVP_PKEY_CTX_free( pctx );
+
+        X509* cert = X509_new();
+        X509_set_version( cert, 2 );
+        X509_gmtime_adj( X509_getm_notBefore( cert ), 0 );
+        X509_gmtime_adj( X509_getm_notAfter( cert ), 3600 );
+        X509_set_pubkey( cert, key );
+        X509_NAME* name = X509_get_subject_name( cert );
+        X509_NAME_add_entry_by_txt( name, "CN", MBSTRING_ASC
+                                    , reinterpret_cast<const unsigned char*>(common_name), -1, -1, 0 );
+        X509_set_issuer_name( cert, name );
+        REQUIRE( X509_sign( cert, key, EVP_sha256() ) != 0 );
+
+        std::string key_file  = m_dir + "/" + file_name + ".key.pem";
+        std::string cert_file = m_dir + "/" + file_name + ".cert.pem";
+        m_files.push_back( key_file );
+        m_files.push_back( cert_file );
+        FILE* file = fopen( key_file.c_str(), "w" );
+        PEM_write_PrivateKey( file, key, nullptr, nullptr, 0, nullptr, nullptr );
+        fclose( file );
+        file = fopen( cert_file.c_str(), "w" );
+        PEM_write_X509( file, cert );
+        fclose( file );
+
+        X509_free( cert );
+        EVP_PKEY_free( key );
+    }
+    [[nodiscard]]
+    const std::string& dir() const noexcept { return m_dir; }
+
+private:
+    std::string m_dir;
+    std::vector<std::string> m_files;
+};
+
+static std::string common_name( tls13::DomainKeys* domain_keys )
+{
+    char buffer[256];
+    X509_NAME_get_text_by_NID( X509_get_subject_name( domain_keys->domain_cert ), NID_commonName
+                               , buffer, sizeof(buffer) );
+    return buffer;
+}
+
+TEST_CASE("MultiDomainKeyStore finds exact and wildcard names")
+{
+    TestCertsDir certs;
+    certs.create( "example.com", "example.com" );
+    certs.create( "_.example.com", "*.example.com" );
+    certs.create( "www.example.org", "www.example.org" );
+
+    tls13::MultiDomainKeyStore key_store{ certs.dir().c_str() };
+    CHECK( key_store.domains_count() == 3 );
+
+    auto* exact = key_store.find( "example.com" );
+    REQUIRE( exact != nullptr );
+    CHECK( common_name( exact ) == "example.com" );
+    CHECK_FALSE( exact->certificate_message.empty() );
+    // case insensitive, trailing dot
+    CHECK( key_store.find( "Example.COM" ) == exact );
+    CHECK( key_store.find( "example.com." ) == exact );
+
+    auto* wildcard = key_store.find( "www.example.com" );
+    REQUIRE( wildcard != nullptr );
+    CHECK( common_name( wildcard ) == "*.example.com" );
+    CHECK( key_store.find( "MAIL.example.com" ) == wildcard );
+    // wildcard matches one label only
+    CHECK( key_store.find( "a.b.example.com" ) == nullptr );
+    CHECK( key_store.find( ".example.com" ) == nullptr );
+
+    CHECK( key_store.find( "www.example.org" ) != nullptr );
+    CHECK( key_store.find( "example.org" ) == nullptr );
+    CHECK( key_store.find( "other.example.org" ) == nullptr );
+    CHECK( key_store.find( "" ) == nullptr );
+}
+
+TEST_CASE("MultiDomainKeyStore loads domain keys lazily")
+{
+    TestCertsDir certs;
+    certs.create( "lazy.example.com", "lazy.example.com" );
+    certs.create( "broken.example.com", "broken.example.com" );
+
+    tls13::MultiDomainKeyStore key_store{ certs.dir().c_str() };
+    // files are read on first find()
+    unlink( (certs.dir() + "/broken.example.com.key.pem").c_str() );
+
+    auto* domain_keys = key_store.find( "lazy.example.com" );
+    REQUIRE( domain_keys != nullptr );
+    CHECK( key_store.find( "lazy.example.com" ) == domain_keys );
+    CHECK( key_store.find( "broken.example.com" ) == nullptr );
+    CHECK( key_store.find( "broken.example.com" ) == nullptr );
+    CHECK_THROWS( key_store.load_all() );
+}
+
+TEST_CASE("MultiDomainKeyStore rejects wrong and duplicate names")
+{
+    TestCertsDir certs;
+    certs.create( "example.com", "example.com" );
+    std::string key_file  = certs.dir() + "/example.com.key.pem";
+    std::string cert_file = certs.dir() + "/example.com.cert.pem";
+
+    tls13::MultiDomainKeyStore key_store;
+    key_store.add_domain( "example.com", key_file.c_str(), cert_file.c_str() );
+    key_store.add_domain( "*.example.com", key_file.c_str(), cert_file.c_str() );
+    CHECK_THROWS( key_store.add_domain( "EXAMPLE.com", key_file.c_str(), cert_file.c_str() ) );
+    CHECK_THROWS( key_store.add_domain( "*.example.com", key_file.c_str(), cert_file.c_str() ) );
+    CHECK_THROWS( key_store.add_domain( "*.com", key_file.c_str(), cert_file.c_str() ) );
+    CHECK_THROWS( key_store.add_domain( "www.*.com", key_file.c_str(), cert_file.c_str() ) );
+    CHECK_THROWS( key_store.add_domain( "www..com", key_file.c_str(), cert_file.c_str() ) );
+    CHECK( key_store.domains_count() == 2 );
+
+    key_store.load_all();
+    CHECK( key_store.find( "example.com" ) != nullptr );
+    CHECK( key_store.find( "www.example.com" ) != nullptr );
+}
+
+TEST_CASE("MultiDomainKeyStore with many domains")
+{
+    TestCertsDir certs;
+    certs.create( "example.com", "example.com" );
+    std::string key_file  = certs.dir() + "/example.com.key.pem";
+    std::string cert_file = certs.dir() + "/example.com.cert.pem";
+
+    tls13::MultiDomainKeyStore key_store;
+    constexpr uint32_t domains = 20000;
+    for( uint32_t i = 0; i < domains; ++i )
+    {
+        std::string name = "d" + std::to_string( i ) + ".example.com";
+        key_store.add_domain( (i % 2) ? name.c_str() : ("*." + name).c_str()
+                              , key_file.c_str(), cert_file.c_str() );
+    }
+    CHECK( key_store.domains_count() == domains );
+
+    CHECK( key_store.find( "d1.example.com" ) != nullptr );
+    CHECK( key_store.find( "www.d0.example.com" ) != nullptr );
+    CHECK( key_store.find( "d0.example.com" ) == nullptr );
+    CHECK( key_store.find( "www.d1.example.com" ) == nullptr );
+    CHECK( key_store.find( "x.d19998.example.com" ) != nullptr );
+    CHECK( key_store.find( "d19999.example.com" ) != nullptr );
+    CHECK( key_store.find( "d20000.example.com" ) == nullptr );
+}
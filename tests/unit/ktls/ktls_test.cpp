@@ -0,0 +1,441 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <optional>
+#include <experimental/coroutine>
+
+#include <openssl/evp.h>
+#include <openssl/ec.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <doctest/doctest.h>
+
+#include <libcornet/tls/types.hpp>
+namespace record = pioneer19::cornet::tls13::record;
+#include <libcornet/tls/crypto/record_ciphers.hpp>
+namespace tls_crypto = pioneer19::cornet::tls13::crypto;
+#include <libcornet/tls/ktls.hpp>
+#include <libcornet/tls/tls_socket.hpp>
+#include <libcornet/tls/key_store.hpp>
+#include <libcornet/tls/session_ticket.hpp>
+#include <libcornet/tls/tls_trusted_certs.hpp>
+#include <libcornet/tls/connection_drainer.hpp>
+#include <libcornet/poller.hpp>
+namespace net   = pioneer19::cornet;
+namespace tls13 = pioneer19::cornet::tls13;
+
+/**
+ * blocking tcp connection over loopback
+ */
+struct LoopbackPair
+{
+    int client = -1;
+    int server = -1;
+
+    LoopbackPair()
+    {
+        int listener = ::socket( AF_INET, SOCK_STREAM, 0 );
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+        addr.sin_port = 0;
+        socklen_t addr_size = sizeof(addr);
+        ::bind( listener, (sockaddr*)&addr, sizeof(addr) );
+        ::listen( listener, 1 );
+        ::getsockname( listener, (sockaddr*)&addr, &addr_size );
+
+        client = ::socket( AF_INET, SOCK_STREAM, 0 );
+        ::connect( client, (sockaddr*)&addr, sizeof(addr) );
+        server = ::accept( listener, nullptr, nullptr );
+        ::close( listener );
+    }
+    ~LoopbackPair()
+    {
+        ::close( client );
+        ::close( server );
+    }
+};
+
+static void init_keys( tls_crypto::TlsCipherSuite& cipher_suite, record::CipherSuite suite )
+{
+    cipher_suite.set_cipher_suite( suite );
+    for( uint32_t i = 0; i < cipher_suite.key_size(); ++i )
+    {
+        cipher_suite.sender_key_data()[i]   = i;
+        cipher_suite.receiver_key_data()[i] = i;
+    }
+    for( uint32_t i = 0; i < cipher_suite.iv_size(); ++i )
+    {
+        cipher_suite.sender_iv_data()[i]   = 0x10+i;
+        cipher_suite.receiver_iv_data()[i] = 0x10+i;
+    }
+    cipher_suite.reset_key_counters();
+}
+
+static void check_ktls_tx_decrypted_in_user_space( record::CipherSuite suite )
+{
+    LoopbackPair loopback;
+    tls_crypto::TlsCipherSuite cipher_suite;
+    init_keys( cipher_suite, suite );
+
+    if( !tls13::ktls_enable_tx( loopback.client, cipher_suite ) )
+    {
+        std::cout << "kTLS tx not available for cipher suite 0x" << std::hex << suite.num()
+                  << std::dec << ", user space encryption will be used\n";
+        return;
+    }
+
+    const char message[] = "Hello, kernel tls!";
+    REQUIRE( ::send( loopback.client, message, sizeof(message)-1, 0 ) == sizeof(message)-1 );
+
+    // kernel record: header, data, inner content type, tag
+    uint8_t net_record[ sizeof(record::TLSCiphertext) + sizeof(message)-1 + 1 + 16 ];
+    REQUIRE( ::recv( loopback.server, net_record, sizeof(net_record), MSG_WAITALL )
+             == sizeof(net_record) );
+    CHECK( net_record[0] == static_cast<uint8_t>(record::ContentType::APPLICATION_DATA) );
+
+    uint8_t decrypted[ sizeof(message) ];
+    uint32_t encrypted_size = sizeof(message)-1 + 1;
+    uint32_t decrypted_size = cipher_suite.decrypt(
+            net_record + sizeof(record::TLSCiphertext), encrypted_size
+            , net_record, sizeof(record::TLSCiphertext)
+            , net_record + sizeof(record::TLSCiphertext) + encrypted_size, decrypted );
+    REQUIRE( decrypted_size == encrypted_size );
+    CHECK( std::equal( message, message+sizeof(message)-1, (const char*)decrypted ) );
+    CHECK( decrypted[decrypted_size-1] == static_cast<uint8_t>(record::ContentType::APPLICATION_DATA) );
+}
+
+static void check_ktls_tx_rx( record::CipherSuite suite )
+{
+    LoopbackPair loopback;
+    tls_crypto::TlsCipherSuite cipher_suite;
+    init_keys( cipher_suite, suite );
+
+    if( !tls13::ktls_enable_tx( loopback.client, cipher_suite )
+        || !tls13::ktls_enable_rx( loopback.server, cipher_suite ) )
+    {
+        std::cout << "kTLS not available for cipher suite 0x" << std::hex << suite.num()
+                  << std::dec << ", user space encryption will be used\n";
+        return;
+    }
+
+    const char message[] = "Hello, kernel tls both sides!";
+    REQUIRE( ::send( loopback.client, message, sizeof(message)-1, 0 ) == sizeof(message)-1 );
+    char received[ sizeof(message) ] = {};
+    REQUIRE( ::recv( loopback.server, received, sizeof(message)-1, MSG_WAITALL ) == sizeof(message)-1 );
+    CHECK( std::equal( message, message+sizeof(message)-1, received ) );
+}
+
+TEST_CASE("kTLS tx records decrypted by TlsCipherSuite")
+{
+    check_ktls_tx_decrypted_in_user_space( record::TLS_AES_128_GCM_SHA256 );
+    check_ktls_tx_decrypted_in_user_space( record::TLS_AES_256_GCM_SHA384 );
+    check_ktls_tx_decrypted_in_user_space( record::TLS_CHACHA20_POLY1305_SHA256 );
+}
+
+TEST_CASE("kTLS tx to kTLS rx over loopback")
+{
+    check_ktls_tx_rx( record::TLS_AES_128_GCM_SHA256 );
+    check_ktls_tx_rx( record::TLS_AES_256_GCM_SHA384 );
+    check_ktls_tx_rx( record::TLS_CHACHA20_POLY1305_SHA256 );
+}
+
+TEST_CASE("kTLS refuses not supported cipher suite")
+{
+    LoopbackPair loopback;
+    tls_crypto::TlsCipherSuite cipher_suite;
+    CHECK_FALSE( tls13::ktls_enable_tx( loopback.client, cipher_suite ) );
+}
+
+/**
+ * P-256 key and self signed "localhost" certificate in temporary directory,
+ * certificate is trusted by clients of this thread
+ */
+class LocalhostKeyStore
+{
+public:
+    LocalhostKeyStore()
+    {
+        char dir_template[] = "/tmp/libcornet_ktls_test.XXXXXX";
+        REQUIRE( mkdtemp( dir_template ) != nullptr );
+        m_dir = dir_template;
+
+        EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id( EVP_PKEY_EC, nullptr );
+        EVP_PKEY* key = nullptr;
+        REQUIRE( EVP_PKEY_keygen_init( pctx ) == 1 );
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid( pctx, NID_X9_62_prime256v1 );
+        REQUIRE( EVP_PKEY_keygen( pctx, &key ) == 1 );
+        EVP_PKEY_CTX_free( pctx );
+
+        X509* cert = X509_new();
+        X509_set_version( cert, 2 );
+        ASN1_INTEGER_set( X509_get_serialNumber( cert ), 1 );
+        X509_gmtime_adj( X509_getm_notBefore( cert ), -3600 );
+        X509_gmtime_adj( X509_getm_notAfter( cert ), 3600 );
+        X509_set_pubkey( cert, key );
+        X509_NAME* name = X509_get_subject_name( cert );
+        X509_NAME_add_entry_by_txt( name, "CN", MBSTRING_ASC
+                                    , reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0 );
+        X509_set_issuer_name( cert, name );
+        char alt_name[] = "DNS:localhost";
+        X509_EXTENSION* san = X509V3_EXT_conf_nid( nullptr, nullptr, NID_subject_alt_name, alt_name );
+        X509_add_ext( cert, san, -1 );
+        X509_EXTENSION_free( san );
+        REQUIRE( X509_sign( cert, key, EVP_sha256() ) != 0 );
+
+        m_key_file  = m_dir + "/localhost.key.pem";
+        m_cert_file = m_dir + "/localhost.cert.pem";
+        FILE* file = fopen( m_key_file.c_str(), "w" );
+        PEM_write_PrivateKey( file, key, nullptr, nullptr, 0, nullptr, nullptr );
+        fclose( file );
+        file = fopen( m_cert_file.c_str(), "w" );
+        PEM_write_X509( file, cert );
+        fclose( file );
+
+        X509_STORE_add_cert( tls13::TlsTrustedCerts::store_instance(), cert );
+        X509_free( cert );
+        EVP_PKEY_free( key );
+
+        key_store = std::make_unique<tls13::SingleDomainKeyStore>(
+                "localhost", m_key_file.c_str(), m_cert_file.c_str() );
+    }
+    ~LocalhostKeyStore()
+    {
+        unlink( m_key_file.c_str() );
+        unlink( m_cert_file.c_str() );
+        rmdir( m_dir.c_str() );
+    }
+
+    std::unique_ptr<tls13::SingleDomainKeyStore> key_store;
+
+private:
+    std::string m_dir;
+    std::string m_key_file;
+    std::string m_cert_file;
+};
+
+/// one certificate for all tests, trusted store finds issuer by subject name
+static LocalhostKeyStore& localhost_key_store()
+{
+    static LocalhostKeyStore localhost;
+    return localhost;
+}
+
+/**
+ * coroutine started by resume() only
+ */
+struct TestTask
+{
+    struct promise_type;
+    using coro_handler = std::experimental::coroutine_handle<promise_type>;
+
+    struct promise_type
+    {
+        std::experimental::suspend_always initial_suspend() noexcept { return {}; }
+        std::experimental::suspend_always final_suspend() noexcept   { return {}; }
+        TestTask get_return_object() { return TestTask{coro_handler::from_promise(*this)}; }
+        void unhandled_exception() { std::terminate(); }
+        void return_void() {}
+    };
+
+    explicit TestTask( coro_handler coro ) noexcept : coro( coro ) {}
+    TestTask( const TestTask& ) = delete;
+    TestTask& operator=( const TestTask& ) = delete;
+    ~TestTask() { if( coro ) coro.destroy(); }
+
+    coro_handler coro;
+};
+
+struct SessionResult
+{
+    std::string data;
+    std::string error;
+    bool ktls_rx = false;
+    bool close_notify_received = false;
+};
+
+static const char SERVER_MESSAGE[] = "data after NewSessionTicket";
+
+/// server session: handshake (NewSessionTicket sent), message, close_notify
+static TestTask ticket_server( net::Poller& poller, tls13::TlsSocket& listener
+                               , tls13::KeyStore* key_store, SessionResult& result )
+{
+    try
+    {
+        net::TcpSocket tcp_socket = co_await listener.async_accept_tcp( poller );
+        tls13::TlsSocket socket = co_await tls13::TlsSocket::server_handshake( std::move(tcp_socket), key_store );
+        socket.enable_ktls();
+        result.ktls_rx = socket.ktls_rx();
+        co_await socket.async_write( SERVER_MESSAGE, sizeof(SERVER_MESSAGE)-1 );
+        co_await socket.async_close_notify();
+    }
+    catch( const std::exception& ex )
+    {
+        result.error = ex.what();
+    }
+}
+
+/// client session reads until close_notify with kTLS enabled after handshake
+static TestTask ktls_client( net::Poller& poller, uint16_t port, SessionResult& result )
+{
+    try
+    {
+        tls13::TlsSocket socket;
+        if( co_await socket.async_connect( poller, "::1", port, "localhost" ))
+        {
+            socket.enable_ktls();
+            result.ktls_rx = socket.ktls_rx();
+            char buffer[1024];
+            while( auto bytes_read = co_await socket.async_read( buffer, sizeof(buffer) ))
+                result.data.append( buffer, bytes_read );
+            result.close_notify_received = socket.close_notify_received();
+        }
+    }
+    catch( const std::exception& ex )
+    {
+        result.error = ex.what();
+    }
+    poller.stop();
+}
+
+TEST_CASE("kTLS rx client reads data after server NewSessionTicket")
+{
+    constexpr uint16_t PORT = 10420;
+    LocalhostKeyStore& localhost = localhost_key_store();
+    tls13::SessionTicketKeys::instance().set_issue_tickets( true );
+    tls13::TicketCache::instance().clear();
+
+    net::Poller poller;
+    tls13::TlsSocket listener;
+    listener.bind( "::1", PORT );
+    listener.listen( poller );
+
+    SessionResult server_result;
+    SessionResult client_result;
+    TestTask server = ticket_server( poller, listener, localhost.key_store.get(), server_result );
+    server.coro.resume();
+    TestTask client = ktls_client( poller, PORT, client_result );
+    client.coro.resume();
+    poller.run();
+
+    if( !client_result.ktls_rx )
+        std::cout << "kTLS rx not available, client read in user space\n";
+    CHECK( client_result.error.empty() );
+    CHECK( server_result.error.empty() );
+    CHECK( client_result.data == SERVER_MESSAGE );
+    CHECK( client_result.close_notify_received );
+    // ticket record was processed by client
+    CHECK( tls13::TicketCache::instance().take( "localhost", tls13::SessionTicketKeys::now_ms() ).has_value() );
+}
+
+static TestTask drain_sessions( net::Poller& poller, tls13::ConnectionDrainer& drainer
+                                , std::optional<bool>& result )
+{
+    result = co_await drainer.drain( poller, std::chrono::milliseconds{2000} );
+    poller.stop();
+}
+
+/// idle server session waits for requests, drain started now sends close_notify
+static TestTask idle_server( net::Poller& poller, tls13::TlsSocket& listener, tls13::KeyStore* key_store
+                             , tls13::ConnectionDrainer& drainer, TestTask& drain_task, SessionResult& result )
+{
+    try
+    {
+        net::TcpSocket tcp_socket = co_await listener.async_accept_tcp( poller );
+        tls13::TlsSocket socket = co_await tls13::TlsSocket::server_handshake( std::move(tcp_socket), key_store );
+        socket.enable_ktls();
+        result.ktls_rx = socket.ktls_rx();
+
+        tls13::ConnectionDrainer::Session session{ drainer };
+        session.set_socket( &socket );
+        session.set_idle( true );
+        drain_task.coro.resume();
+
+        char buffer[1024];
+        while( auto bytes_read = co_await socket.async_read( buffer, sizeof(buffer) ))
+            result.data.append( buffer, bytes_read );
+        result.close_notify_received = socket.close_notify_received();
+    }
+    catch( const std::exception& ex )
+    {
+        result.error = ex.what();
+    }
+}
+
+/// client answers server close_notify by own close_notify
+static TestTask closing_client( net::Poller& poller, uint16_t port, SessionResult& result )
+{
+    try
+    {
+        tls13::TlsSocket socket;
+        if( co_await socket.async_connect( poller, "::1", port, "localhost" ))
+        {
+            socket.enable_ktls();
+            result.ktls_rx = socket.ktls_rx();
+            char buffer[1024];
+            while( auto bytes_read = co_await socket.async_read( buffer, sizeof(buffer) ))
+                result.data.append( buffer, bytes_read );
+            result.close_notify_received = socket.close_notify_received();
+            co_await socket.async_close_notify();
+        }
+    }
+    catch( const std::exception& ex )
+    {
+        result.error = ex.what();
+        poller.stop(); // server waits for client, drain is never finished
+    }
+}
+
+TEST_CASE("kTLS rx sessions half-closed by connection drain")
+{
+    constexpr uint16_t PORT = 10421;
+    LocalhostKeyStore& localhost = localhost_key_store();
+
+    net::Poller poller;
+    tls13::TlsSocket listener;
+    listener.bind( "::1", PORT );
+    listener.listen( poller );
+
+    tls13::ConnectionDrainer drainer;
+    std::optional<bool> drained;
+    SessionResult server_result;
+    SessionResult client_result;
+    TestTask drain_task = drain_sessions( poller, drainer, drained );
+    TestTask server = idle_server( poller, listener, localhost.key_store.get(), drainer, drain_task, server_result );
+    server.coro.resume();
+    TestTask client = closing_client( poller, PORT, client_result );
+    client.coro.resume();
+    poller.run();
+
+    if( !client_result.ktls_rx || !server_result.ktls_rx )
+        std::cout << "kTLS rx not available, sessions read in user space\n";
+    CHECK( server_result.error.empty() );
+    CHECK( client_result.error.empty() );
+    // both sides got close_notify as end of data, not as read error
+    CHECK( client_result.close_notify_received );
+    CHECK( server_result.close_notify_received );
+    CHECK( client_result.data.empty() );
+    CHECK( server_result.data.empty() );
+    CHECK( server.coro.done() );
+    REQUIRE( drained.has_value() );
+    CHECK( *drained );
+    CHECK( drainer.sessions_count() == 0 );
+}
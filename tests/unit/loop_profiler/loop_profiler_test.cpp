@@ -0,0 +1,139 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <chrono>
+#include <string>
+#include <experimental/coroutine>
+
+#include <libcornet/poller.hpp>
+#include <libcornet/async_file.hpp>
+#include <libcornet/loop_profiler.hpp>
+#include <libcornet/metrics.hpp>
+
+namespace net = pioneer19::cornet;
+
+/**
+ * coroutine started by resume() only
+ */
+struct TestTask
+{
+    struct promise_type;
+    using coro_handler = std::experimental::coroutine_handle<promise_type>;
+
+    struct promise_type
+    {
+        std::experimental::suspend_always initial_suspend() noexcept { return {}; }
+        std::experimental::suspend_always final_suspend() noexcept   { return {}; }
+        TestTask get_return_object() { return TestTask{coro_handler::from_promise(*this)}; }
+        void unhandled_exception() { std::terminate(); }
+        void return_void() {}
+    };
+
+    explicit TestTask( coro_handler coro ) noexcept : coro( coro ) {}
+    TestTask( const TestTask& ) = delete;
+    TestTask& operator=( const TestTask& ) = delete;
+    ~TestTask() { if( coro ) coro.destroy(); }
+
+    coro_handler coro;
+};
+
+static void busy_wait( std::chrono::microseconds duration )
+{
+    auto end_time = std::chrono::steady_clock::now() + duration;
+    while( std::chrono::steady_clock::now() < end_time )
+        ;
+}
+
+static TestTask slow_reader( net::Poller& poller, net::AsyncFile& file, std::chrono::microseconds work )
+{
+    char buffer[16];
+    co_await file.async_read( buffer, sizeof(buffer) );
+    busy_wait( work );
+    poller.stop();
+}
+
+static void run_reader( std::chrono::microseconds work, bool profiled )
+{
+    int pipe_fds[2];
+    REQUIRE( pipe2( pipe_fds, O_NONBLOCK|O_CLOEXEC ) == 0 );
+
+    net::Poller poller;
+    net::AsyncFile file{ pipe_fds[0], &poller };
+    TestTask task = slow_reader( poller, file, work );
+    task.coro.resume();
+    REQUIRE( write( pipe_fds[1], "x", 1 ) == 1 );
+
+    if( profiled )
+        poller.run<net::LogLevel::INFO>();
+    else
+        poller.run();
+    CHECK( task.coro.done() );
+    close( pipe_fds[1] );
+}
+
+TEST_CASE("loop profiler records stalled coroutine")
+{
+    auto& profiler = net::LoopProfiler::instance();
+    profiler.set_stall_threshold( std::chrono::milliseconds{2} );
+    profiler.clear_stalls();
+    auto before = net::MetricsRegistry::instance().collect();
+
+    run_reader( std::chrono::microseconds{100}, true );
+    CHECK( profiler.stalls_count() == 0 );
+
+    run_reader( std::chrono::milliseconds{5}, true );
+    REQUIRE( profiler.stalls_count() == 1 );
+    auto stalls = profiler.stalls();
+    REQUIRE( stalls.size() == 1 );
+    CHECK( stalls[0].duration_ns >= 4'000'000 );
+    CHECK( std::string{stalls[0].site} == "AsyncFile::async_read" );
+    CHECK( stalls[0].tag == nullptr );
+
+    auto after = net::MetricsRegistry::instance().collect();
+    CHECK( after.counter( net::Counter::COROUTINE_STALLS )
+           - before.counter( net::Counter::COROUTINE_STALLS ) == 1 );
+    CHECK( after.histogram( net::Histogram::EVENT_RESUME_DELAY ).count()
+           - before.histogram( net::Histogram::EVENT_RESUME_DELAY ).count() == 2 );
+    CHECK( after.histogram( net::Histogram::LOOP_ITERATION_DURATION ).count()
+           > before.histogram( net::Histogram::LOOP_ITERATION_DURATION ).count() );
+}
+
+TEST_CASE("not profiled loop does not touch profiler")
+{
+    auto& profiler = net::LoopProfiler::instance();
+    profiler.set_stall_threshold( std::chrono::microseconds{1} );
+    profiler.clear_stalls();
+    auto before = net::MetricsRegistry::instance().collect();
+
+    run_reader( std::chrono::milliseconds{1}, false );
+
+    auto after = net::MetricsRegistry::instance().collect();
+    CHECK( profiler.stalls_count() == 0 );
+    CHECK( after.histogram( net::Histogram::LOOP_ITERATION_DURATION ).count()
+           == before.histogram( net::Histogram::LOOP_ITERATION_DURATION ).count() );
+    profiler.set_stall_threshold( net::LoopProfiler::DEFAULT_STALL_THRESHOLD );
+}
+
+TEST_CASE("stall ring keeps last stalls")
+{
+    auto& profiler = net::LoopProfiler::instance();
+    profiler.set_stall_threshold( std::chrono::nanoseconds{0} );
+    profiler.clear_stalls();
+
+    for( uint32_t i = 0; i < net::LoopProfiler::STALLS_CAPACITY + 3; ++i )
+        run_reader( std::chrono::microseconds{0}, true );
+
+    CHECK( profiler.stalls_count() == net::LoopProfiler::STALLS_CAPACITY + 3 );
+    CHECK( profiler.stalls().size() == net::LoopProfiler::STALLS_CAPACITY );
+    profiler.set_stall_threshold( net::LoopProfiler::DEFAULT_STALL_THRESHOLD );
+    profiler.clear_stalls();
+}
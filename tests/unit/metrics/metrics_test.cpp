@@ -0,0 +1,117 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libcornet/metrics.hpp>
+
+namespace cornet = pioneer19::cornet;
+
+TEST_CASE("metrics of exited threads are kept")
+{
+    auto& registry = cornet::MetricsRegistry::instance();
+    auto before = registry.collect();
+
+    constexpr uint32_t THREADS_COUNT = 4;
+    std::vector<std::thread> threads;
+    for( uint32_t i = 0; i < THREADS_COUNT; ++i )
+    {
+        threads.emplace_back( [](){
+            auto& metrics = cornet::ThreadMetrics::instance();
+            for( uint32_t j = 0; j < 1000; ++j )
+                metrics.add( cornet::Counter::BYTES_IN, 10 );
+            metrics.add( cornet::Gauge::ACTIVE_CONNECTIONS, 5 );
+        } );
+    }
+    for( auto& thread : threads )
+        thread.join();
+
+    auto after = registry.collect();
+    CHECK( after.counter( cornet::Counter::BYTES_IN )
+           - before.counter( cornet::Counter::BYTES_IN ) == THREADS_COUNT*1000*10 );
+    // gauges are levels of running threads only
+    CHECK( after.gauge( cornet::Gauge::ACTIVE_CONNECTIONS )
+           == before.gauge( cornet::Gauge::ACTIVE_CONNECTIONS ) );
+}
+
+TEST_CASE("metrics of running thread are visible")
+{
+    auto& registry = cornet::MetricsRegistry::instance();
+    auto& metrics  = cornet::ThreadMetrics::instance();
+    auto before = registry.collect();
+
+    metrics.add( cornet::Counter::ACCEPTS );
+    metrics.add( cornet::Gauge::ACTIVE_CONNECTIONS, 2 );
+    metrics.add( cornet::Gauge::ACTIVE_CONNECTIONS, -1 );
+    metrics.handshake_failed( true, cornet::HandshakeFailure::IO );
+    metrics.handshake_failed( false, cornet::HandshakeFailure::CONNECT );
+
+    auto after = registry.collect();
+    CHECK( after.counter( cornet::Counter::ACCEPTS ) - before.counter( cornet::Counter::ACCEPTS ) == 1 );
+    CHECK( after.gauge( cornet::Gauge::ACTIVE_CONNECTIONS )
+           - before.gauge( cornet::Gauge::ACTIVE_CONNECTIONS ) == 1 );
+    CHECK( after.counter( cornet::Counter::SERVER_HANDSHAKE_FAILURES_IO )
+           - before.counter( cornet::Counter::SERVER_HANDSHAKE_FAILURES_IO ) == 1 );
+    CHECK( after.counter( cornet::Counter::CLIENT_HANDSHAKE_FAILURES_CONNECT )
+           - before.counter( cornet::Counter::CLIENT_HANDSHAKE_FAILURES_CONNECT ) == 1 );
+    metrics.add( cornet::Gauge::ACTIVE_CONNECTIONS, -1 );
+}
+
+TEST_CASE("histogram log2 buckets")
+{
+    cornet::ThreadMetrics metrics;
+    metrics.observe( cornet::Histogram::EVENTS_PER_WAKEUP, 0 );
+    metrics.observe( cornet::Histogram::EVENTS_PER_WAKEUP, 1 );
+    metrics.observe( cornet::Histogram::EVENTS_PER_WAKEUP, 3 );
+    metrics.observe( cornet::Histogram::EVENTS_PER_WAKEUP, 16 );
+    metrics.observe( cornet::Histogram::EVENTS_PER_WAKEUP, ~uint64_t{0} );
+
+    cornet::MetricsSnapshot snapshot;
+    metrics.add_to( snapshot );
+    const auto& histogram = snapshot.histogram( cornet::Histogram::EVENTS_PER_WAKEUP );
+    CHECK( histogram.count() == 5 );
+    CHECK( histogram.buckets[0] == 1 );
+    CHECK( histogram.buckets[1] == 1 );
+    CHECK( histogram.buckets[2] == 1 );
+    CHECK( histogram.buckets[5] == 1 );
+    CHECK( histogram.buckets[cornet::HISTOGRAM_BUCKETS-1] == 1 );
+    CHECK( cornet::HistogramSnapshot::bucket_upper_bound( 5 ) == 31 );
+}
+
+TEST_CASE("prometheus text export")
+{
+    cornet::ThreadMetrics metrics;
+    metrics.add( cornet::Counter::BYTES_OUT, 42 );
+    metrics.observe( cornet::Histogram::SERVER_HANDSHAKE_DURATION, 1000 ); // 1 ms
+
+    cornet::MetricsSnapshot snapshot;
+    metrics.add_to( snapshot );
+    cornet::PrometheusTextSink sink;
+    sink.export_metrics( snapshot );
+    const std::string& text = sink.text();
+
+    CHECK( text.find( "# TYPE cornet_bytes_total counter\n" ) != std::string::npos );
+    CHECK( text.find( "cornet_bytes_total{direction=\"out\"} 42\n" ) != std::string::npos );
+    // family header is written once
+    CHECK( text.find( "# TYPE cornet_bytes_total" ) == text.rfind( "# TYPE cornet_bytes_total" ) );
+    CHECK( text.find( "# TYPE cornet_tls_handshake_duration_seconds histogram\n" ) != std::string::npos );
+    CHECK( text.find( "cornet_tls_handshake_duration_seconds_bucket{side=\"server\",le=\"0.000511\"} 0\n" )
+           != std::string::npos );
+    CHECK( text.find( "cornet_tls_handshake_duration_seconds_bucket{side=\"server\",le=\"0.001023\"} 1\n" )
+           != std::string::npos );
+    CHECK( text.find( "cornet_tls_handshake_duration_seconds_bucket{side=\"server\",le=\"+Inf\"} 1\n" )
+           != std::string::npos );
+    CHECK( text.find( "cornet_tls_handshake_duration_seconds_sum{side=\"server\"} 0.001\n" )
+           != std::string::npos );
+    CHECK( text.find( "cornet_tls_handshake_duration_seconds_count{side=\"server\"} 1\n" )
+           != std::string::npos );
+    CHECK( text.find( "cornet_epoll_events_per_wakeup_bucket{le=\"0\"} 0\n" ) != std::string::npos );
+}
@@ -0,0 +1,401 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdexcept>
+#include <experimental/coroutine>
+
+#include <openssl/evp.h>
+#include <openssl/ec.h>
+#include <openssl/pem.h>
+#include <openssl/x509.h>
+#include <openssl/ocsp.h>
+#include <openssl/x509v3.h>
+
+#include <libcornet/tls/ocsp_stapling.hpp>
+#include <libcornet/tls/key_store.hpp>
+#include <libcornet/tls/parser.hpp>
+
+namespace tls13 = pioneer19::cornet::tls13;
+namespace record = pioneer19::cornet::tls13::record;
+
+static EVP_PKEY* create_key()
+{
+    EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id( EVP_PKEY_EC, nullptr );
+    EVP_PKEY* key = nullptr;
+    REQUIRE( EVP_PKEY_keygen_init( pctx ) == 1 );
+    EVP_PKEY_CTX_set_ec_paramgen_curve_nid( pctx, NID_X9_62_prime256v1 );
+    REQUIRE( EVP_PKEY_keygen( pctx, &key ) == 1 );
+    EVP_PKEY_CTX_free( pctx );
+
+    return key;
+}
+
+/**
+ * self signed certificate (issuer is nullptr) is CA,
+ * extension is added to issued certificate, e.g. "OCSPSigning" extended key usage
+ */
+static X509* create_cert( EVP_PKEY* key, const char* common_name, X509* issuer, EVP_PKEY* issuer_key
+                          , long serial, int extension_nid = NID_undef, const char* extension_value = nullptr )
+{
+    X509* cert = X509_new();
+    X509_set_version( cert, 2 );
+    ASN1_INTEGER_set( X509_get_serialNumber( cert ), serial );
+    X509_gmtime_adj( X509_getm_notBefore( cert ), 0 );
+    X509_gmtime_adj( X509_getm_notAfter( cert ), 3600 );
+    X509_set_pubkey( cert, key );
+    X509_NAME* name = X509_get_subject_name( cert );
+    X509_NAME_add_entry_by_txt( name, "CN", MBSTRING_ASC
+                                , reinterpret_cast<const unsigned char*>(common_name), -1, -1, 0 );
+    X509_set_issuer_name( cert, issuer ? X509_get_subject_name( issuer ) : name );
+    if( issuer == nullptr )
+    {
+        extension_nid   = NID_basic_constraints;
+        extension_value = "critical,CA:TRUE";
+    }
+    if( extension_nid != NID_undef )
+    {
+        X509V3_CTX ctx;
+        X509V3_set_ctx( &ctx, issuer ? issuer : cert, cert, nullptr, nullptr, 0 );
+        X509_EXTENSION* extension = X509V3_EXT_conf_nid( nullptr, &ctx, extension_nid, extension_value );
+        REQUIRE( extension != nullptr );
+        X509_add_ext( cert, extension, -1 );
+        X509_EXTENSION_free( extension );
+    }
+    REQUIRE( X509_sign( cert, issuer_key, EVP_sha256() ) != 0 );
+
+    return cert;
+}
+
+/**
+ * CA and domain certificate signed by CA in temporary directory,
+ * OCSP responses are signed by CA
+ */
+class TestPki
+{
+public:
+    TestPki()
+    {
+        char dir_template[] = "/tmp/libcornet_ocsp_stapling_test.XXXXXX";
+        REQUIRE( mkdtemp( dir_template ) != nullptr );
+        m_dir = dir_template;
+
+        m_ca_key  = create_key();
+        m_ca_cert = create_cert( m_ca_key, "test ca", nullptr, m_ca_key, 1 );
+        m_key  = create_key();
+        m_cert = create_cert( m_key, "example.com", m_ca_cert, m_ca_key, 2 );
+
+        FILE* file = fopen( key_file().c_str(), "w" );
+        PEM_write_PrivateKey( file, m_key, nullptr, nullptr, 0, nullptr, nullptr );
+        fclose( file );
+        file = fopen( cert_file().c_str(), "w" );
+        PEM_write_X509( file, m_cert );
+        fclose( file );
+        file = fopen( chain_file().c_str(), "w" );
+        PEM_write_X509( file, m_ca_cert );
+        fclose( file );
+    }
+    ~TestPki()
+    {
+        for( auto& file_name : { key_file(), cert_file(), chain_file(), response_file() } )
+            unlink( file_name.c_str() );
+        rmdir( m_dir.c_str() );
+        X509_free( m_cert );
+        EVP_PKEY_free( m_key );
+        X509_free( m_ca_cert );
+        EVP_PKEY_free( m_ca_key );
+    }
+
+    /**
+     * DER OCSPResponse for domain certificate
+     * @param next_update_sec nextUpdate offset from now (negative is expired response)
+     */
+    std::vector<uint8_t> create_response( int cert_status, long next_update_sec
+            , X509* signer = nullptr, EVP_PKEY* signer_key = nullptr )
+    {
+        OCSP_BASICRESP* basic_response = OCSP_BASICRESP_new();
+        OCSP_CERTID* cert_id = OCSP_cert_to_id( nullptr, m_cert, m_ca_cert );
+        ASN1_TIME* this_update = X509_gmtime_adj( nullptr, next_update_sec - 7200 );
+        ASN1_TIME* next_update = X509_gmtime_adj( nullptr, next_update_sec );
+        REQUIRE( OCSP_basic_add1_status( basic_response, cert_id, cert_status, OCSP_REVOKED_STATUS_KEYCOMPROMISE
+                 , this_update, this_update, next_update ) != nullptr );
+        // signer certificate is included in response
+        REQUIRE( OCSP_basic_sign( basic_response, signer ? signer : m_ca_cert, signer_key ? signer_key : m_ca_key
+                                  , EVP_sha256(), nullptr, 0 ) == 1 );
+        OCSP_RESPONSE* response = OCSP_response_create( OCSP_RESPONSE_STATUS_SUCCESSFUL, basic_response );
+        REQUIRE( response != nullptr );
+
+        std::vector<uint8_t> response_der( i2d_OCSP_RESPONSE( response, nullptr ) );
+        uint8_t* data = response_der.data();
+        i2d_OCSP_RESPONSE( response, &data );
+
+        OCSP_RESPONSE_free( response );
+        ASN1_TIME_free( next_update );
+        ASN1_TIME_free( this_update );
+        OCSP_CERTID_free( cert_id );
+        OCSP_BASICRESP_free( basic_response );
+
+        return response_der;
+    }
+    std::string check( const std::vector<uint8_t>& response, bool with_issuer = true )
+    {
+        return tls13::OcspStapling::check_response( response.data(), response.size()
+                                                    , m_cert, with_issuer ? m_ca_cert : nullptr );
+    }
+
+    /// responder certificate issued by CA
+    X509* create_responder_cert( EVP_PKEY* key, bool ocsp_signing )
+    {
+        return create_cert( key, "test ocsp responder", m_ca_cert, m_ca_key, 4
+                            , ocsp_signing ? NID_ext_key_usage : NID_undef, "OCSPSigning" );
+    }
+
+    [[nodiscard]]
+    std::string key_file() const { return m_dir + "/example.com.key.pem"; }
+    [[nodiscard]]
+    std::string cert_file() const { return m_dir + "/example.com.cert.pem"; }
+    [[nodiscard]]
+    std::string chain_file() const { return m_dir + "/example.com.chain.pem"; }
+    [[nodiscard]]
+    std::string response_file() const { return m_dir + "/example.com.ocsp.der"; }
+
+private:
+    std::string m_dir;
+    EVP_PKEY* m_ca_key  = nullptr;
+    X509*     m_ca_cert = nullptr;
+    EVP_PKEY* m_key  = nullptr;
+    X509*     m_cert = nullptr;
+};
+
+TEST_CASE("OCSP response check")
+{
+    TestPki pki;
+
+    auto good_response = pki.create_response( V_OCSP_CERTSTATUS_GOOD, 3600 );
+    CHECK( pki.check( good_response ).empty() );
+    CHECK( pki.check( good_response, false ).empty() );
+
+    CHECK_FALSE( pki.check( pki.create_response( V_OCSP_CERTSTATUS_REVOKED, 3600 ) ).empty() );
+    CHECK_FALSE( pki.check( pki.create_response( V_OCSP_CERTSTATUS_GOOD, -3600 ) ).empty() );
+    // response of other responder
+    EVP_PKEY* other_key = create_key();
+    X509* other_cert = create_cert( other_key, "other ca", nullptr, other_key, 3 );
+    CHECK_FALSE( pki.check( pki.create_response( V_OCSP_CERTSTATUS_GOOD, 3600, other_cert, other_key ) ).empty() );
+    X509_free( other_cert );
+    EVP_PKEY_free( other_key );
+
+    good_response.resize( good_response.size() / 2 );
+    CHECK_FALSE( pki.check( good_response ).empty() );
+}
+
+TEST_CASE("OCSP response of delegated responder")
+{
+    TestPki pki;
+    EVP_PKEY* responder_key = create_key();
+
+    X509* responder_cert = pki.create_responder_cert( responder_key, true );
+    CHECK( pki.check( pki.create_response( V_OCSP_CERTSTATUS_GOOD, 3600, responder_cert, responder_key ) ).empty() );
+    CHECK_FALSE( pki.check( pki.create_response( V_OCSP_CERTSTATUS_REVOKED, 3600
+                                                 , responder_cert, responder_key ) ).empty() );
+    X509_free( responder_cert );
+
+    // responder certificate of CA without OCSPSigning usage can't sign responses
+    responder_cert = pki.create_responder_cert( responder_key, false );
+    CHECK_FALSE( pki.check( pki.create_response( V_OCSP_CERTSTATUS_GOOD, 3600
+                                                 , responder_cert, responder_key ) ).empty() );
+    X509_free( responder_cert );
+    EVP_PKEY_free( responder_key );
+}
+
+TEST_CASE("OCSP response file")
+{
+    TestPki pki;
+
+    CHECK( tls13::OcspStapling::load_response( pki.response_file().c_str() ).empty() );
+    auto response = pki.create_response( V_OCSP_CERTSTATUS_GOOD, 3600 );
+    tls13::OcspStapling::write_response( pki.response_file(), response );
+    CHECK( tls13::OcspStapling::load_response( pki.response_file().c_str() ) == response );
+}
+
+struct CertificateStatusTestHook : record::EmptyHook
+{
+    void cert_data( record::CertificateType, const uint8_t*, uint32_t ) { ++m_certs_count; }
+    void certificate_status( record::CertificateStatusType status_type, const uint8_t* response, uint32_t size )
+    {
+        CHECK( status_type == record::CertificateStatusType::OCSP );
+        m_status_cert = m_certs_count;
+        m_response.assign( response, response + size );
+    }
+
+    uint32_t m_certs_count = 0;
+    uint32_t m_status_cert = 0; ///< number of certificate with status
+    std::vector<uint8_t> m_response;
+};
+
+static std::vector<uint8_t> certificate_record( const std::vector<uint8_t>& message )
+{
+    std::vector<uint8_t> tls_record( sizeof(record::TlsPlaintext) + message.size() );
+    auto* plaintext_record = reinterpret_cast<record::TlsPlaintext*>( tls_record.data() );
+    plaintext_record->init( record::ContentType::HANDSHAKE );
+    std::memcpy( tls_record.data() + sizeof(record::TlsPlaintext), message.data(), message.size() );
+    plaintext_record->finalize( message.size() );
+
+    return tls_record;
+}
+
+TEST_CASE("Certificate message with stapled OCSP response")
+{
+    TestPki pki;
+    auto response = pki.create_response( V_OCSP_CERTSTATUS_GOOD, 3600 );
+    tls13::OcspStapling::write_response( pki.response_file(), response );
+
+    tls13::DomainKeys domain_keys;
+    tls13::KeyStore::load_domain_keys( domain_keys, pki.key_file().c_str(), pki.cert_file().c_str()
+                                       , pki.chain_file().c_str(), pki.response_file().c_str() );
+    CHECK( domain_keys.ocsp_response == response );
+    REQUIRE_FALSE( domain_keys.stapled_certificate_message.empty() );
+    CHECK( domain_keys.stapled_certificate_message.size() > domain_keys.certificate_message.size() );
+
+    record::Parser parser;
+    CertificateStatusTestHook hook;
+    auto tls_record = certificate_record( domain_keys.stapled_certificate_message );
+    auto[bytes_parsed, err] = parser.parse_net_record( &hook, tls_record.data(), tls_record.size() );
+    REQUIRE_FALSE( err );
+    CHECK( bytes_parsed == tls_record.size() );
+    CHECK( hook.m_certs_count == 2 );
+    CHECK( hook.m_status_cert == 1 );
+    CHECK( hook.m_response == response );
+
+    // not stapled message has no status
+    CertificateStatusTestHook plain_hook;
+    tls_record = certificate_record( domain_keys.certificate_message );
+    auto[plain_bytes_parsed, plain_err] = parser.parse_net_record( &plain_hook, tls_record.data(), tls_record.size() );
+    REQUIRE_FALSE( plain_err );
+    CHECK( plain_hook.m_certs_count == 2 );
+    CHECK( plain_hook.m_response.empty() );
+    tls13::KeyStore::free_domain_keys( domain_keys );
+
+    // expired response is not stapled, keys are loaded
+    tls13::OcspStapling::write_response( pki.response_file(), pki.create_response( V_OCSP_CERTSTATUS_GOOD, -3600 ) );
+    tls13::KeyStore::load_domain_keys( domain_keys, pki.key_file().c_str(), pki.cert_file().c_str()
+                                       , pki.chain_file().c_str(), pki.response_file().c_str() );
+    CHECK( domain_keys.key != nullptr );
+    CHECK( domain_keys.ocsp_response.empty() );
+    CHECK( domain_keys.stapled_certificate_message.empty() );
+    tls13::KeyStore::free_domain_keys( domain_keys );
+
+    // too big response file is not stapled, keys are loaded
+    std::vector<uint8_t> big_response( tls13::OcspStapling::MAX_RESPONSE_SIZE + 1 );
+    tls13::OcspStapling::write_response( pki.response_file(), big_response );
+    tls13::KeyStore::load_domain_keys( domain_keys, pki.key_file().c_str(), pki.cert_file().c_str()
+                                       , pki.chain_file().c_str(), pki.response_file().c_str() );
+    CHECK( domain_keys.key != nullptr );
+    CHECK( domain_keys.ocsp_response.empty() );
+    CHECK( domain_keys.stapled_certificate_message.empty() );
+    tls13::KeyStore::free_domain_keys( domain_keys );
+}
+
+/**
+ * coroutine started by resume() only
+ */
+struct TestTask
+{
+    struct promise_type;
+    using coro_handler = std::experimental::coroutine_handle<promise_type>;
+
+    struct promise_type
+    {
+        std::experimental::suspend_always initial_suspend() noexcept { return {}; }
+        std::experimental::suspend_always final_suspend() noexcept   { return {}; }
+        TestTask get_return_object() { return TestTask{coro_handler::from_promise(*this)}; }
+        void unhandled_exception() { std::terminate(); }
+        void return_void() {}
+    };
+
+    explicit TestTask( coro_handler coro ) noexcept : coro( coro ) {}
+    TestTask( const TestTask& ) = delete;
+    TestTask& operator=( const TestTask& ) = delete;
+    ~TestTask() { if( coro ) coro.destroy(); }
+
+    coro_handler coro;
+};
+
+/**
+ * local responder: returns prepared response or throws if it is empty
+ */
+class StubFetcher : public tls13::OcspFetcher
+{
+public:
+    pioneer19::CoroutineAwaiter<std::vector<uint8_t>> fetch(
+            const std::string& responder_url, const std::vector<uint8_t>& request ) override
+    {
+        CHECK( responder_url == "http://ocsp.example.com" );
+        CHECK_FALSE( request.empty() );
+        ++m_fetch_count;
+        if( m_response.empty() )
+            throw std::runtime_error( "responder is not available" );
+        co_return m_response;
+    }
+
+    std::vector<uint8_t> m_response;
+    uint32_t m_fetch_count = 0;
+};
+
+static TestTask refresh_task( tls13::OcspRefresher& refresher, uint32_t& updated )
+{
+    updated = co_await refresher.refresh();
+}
+
+TEST_CASE("OcspRefresher replaces response file by good response only")
+{
+    TestPki pki;
+    StubFetcher fetcher;
+    uint32_t updated_calls = 0;
+    tls13::OcspRefresher refresher{ fetcher, [&updated_calls](){ ++updated_calls; } };
+    refresher.add_certificate( pki.cert_file().c_str(), pki.chain_file().c_str()
+                               , pki.response_file(), "http://ocsp.example.com" );
+
+    uint32_t updated = 0;
+    {
+        TestTask task = refresh_task( refresher, updated );
+        task.coro.resume();
+        CHECK( task.coro.done() );
+    }
+    CHECK( fetcher.m_fetch_count == 1 );
+    CHECK( updated == 0 );
+    CHECK( updated_calls == 0 );
+    CHECK( tls13::OcspStapling::load_response( pki.response_file().c_str() ).empty() );
+
+    auto good_response = pki.create_response( V_OCSP_CERTSTATUS_GOOD, 3600 );
+    fetcher.m_response = good_response;
+    {
+        TestTask task = refresh_task( refresher, updated );
+        task.coro.resume();
+        CHECK( task.coro.done() );
+    }
+    CHECK( updated == 1 );
+    CHECK( updated_calls == 1 );
+    CHECK( tls13::OcspStapling::load_response( pki.response_file().c_str() ) == good_response );
+
+    // revoked response does not replace good one
+    fetcher.m_response = pki.create_response( V_OCSP_CERTSTATUS_REVOKED, 3600 );
+    {
+        TestTask task = refresh_task( refresher, updated );
+        task.coro.resume();
+        CHECK( task.coro.done() );
+    }
+    CHECK( updated == 0 );
+    CHECK( updated_calls == 1 );
+    CHECK( tls13::OcspStapling::load_response( pki.response_file().c_str() ) == good_response );
+}
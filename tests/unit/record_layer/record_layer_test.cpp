@@ -0,0 +1,291 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <experimental/coroutine>
+
+#include <openssl/ec.h>
+#include <openssl/evp.h>
+#include <openssl/ssl.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <doctest/doctest.h>
+
+#include <libcornet/poller.hpp>
+#include <libcornet/metrics.hpp>
+#include <libcornet/tls/types.hpp>
+#include <libcornet/tls/tls_socket.hpp>
+#include <libcornet/tls/tls_trusted_certs.hpp>
+#include <libcornet/tls/crypto/hkdf.hpp>
+#include <libcornet/tls/crypto/record_ciphers.hpp>
+
+namespace net        = pioneer19::cornet;
+namespace tls13      = pioneer19::cornet::tls13;
+namespace record     = pioneer19::cornet::tls13::record;
+namespace tls_crypto = pioneer19::cornet::tls13::crypto;
+
+/**
+ * coroutine started by resume() only
+ */
+struct TestTask
+{
+    struct promise_type;
+    using coro_handler = std::experimental::coroutine_handle<promise_type>;
+
+    struct promise_type
+    {
+        std::experimental::suspend_always initial_suspend() noexcept { return {}; }
+        std::experimental::suspend_always final_suspend() noexcept   { return {}; }
+        TestTask get_return_object() { return TestTask{coro_handler::from_promise(*this)}; }
+        void unhandled_exception() { std::terminate(); }
+        void return_void() {}
+    };
+
+    explicit TestTask( coro_handler coro ) noexcept : coro( coro ) {}
+    TestTask( const TestTask& ) = delete;
+    TestTask& operator=( const TestTask& ) = delete;
+    ~TestTask() { if( coro ) coro.destroy(); }
+
+    coro_handler coro;
+};
+
+/**
+ * OpenSSL TLS 1.3 server with P-256 self signed "localhost" certificate (trusted
+ * by clients of this thread), server application traffic secret is taken from keylog.
+ * Without session tickets first server application record has sequence number 0.
+ */
+class OpensslServer
+{
+public:
+    OpensslServer()
+    {
+        EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id( EVP_PKEY_EC, nullptr );
+        REQUIRE( EVP_PKEY_keygen_init( pctx ) == 1 );
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid( pctx, NID_X9_62_prime256v1 );
+        REQUIRE( EVP_PKEY_keygen( pctx, &m_key ) == 1 );
+        EVP_PKEY_CTX_free( pctx );
+
+        m_cert = X509_new();
+        X509_set_version( m_cert, 2 );
+        ASN1_INTEGER_set( X509_get_serialNumber( m_cert ), 1 );
+        X509_gmtime_adj( X509_getm_notBefore( m_cert ), -3600 );
+        X509_gmtime_adj( X509_getm_notAfter( m_cert ), 3600 );
+        X509_set_pubkey( m_cert, m_key );
+        X509_NAME* name = X509_get_subject_name( m_cert );
+        X509_NAME_add_entry_by_txt( name, "CN", MBSTRING_ASC
+                                    , reinterpret_cast<const unsigned char*>("localhost"), -1, -1, 0 );
+        X509_set_issuer_name( m_cert, name );
+        char alt_name[] = "DNS:localhost";
+        X509_EXTENSION* san = X509V3_EXT_conf_nid( nullptr, nullptr, NID_subject_alt_name, alt_name );
+        X509_add_ext( m_cert, san, -1 );
+        X509_EXTENSION_free( san );
+        REQUIRE( X509_sign( m_cert, m_key, EVP_sha256() ) != 0 );
+        X509_STORE_add_cert( tls13::TlsTrustedCerts::store_instance(), m_cert );
+
+        m_ctx = SSL_CTX_new( TLS_server_method() );
+        SSL_CTX_set_min_proto_version( m_ctx, TLS1_3_VERSION );
+        SSL_CTX_set_ciphersuites( m_ctx, "TLS_AES_128_GCM_SHA256" );
+        SSL_CTX_set_num_tickets( m_ctx, 0 );
+        SSL_CTX_use_certificate( m_ctx, m_cert );
+        SSL_CTX_use_PrivateKey( m_ctx, m_key );
+        SSL_CTX_set_keylog_callback( m_ctx, keylog );
+
+        m_listener = ::socket( AF_INET6, SOCK_STREAM, 0 );
+        int reuse = 1;
+        ::setsockopt( m_listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse) );
+        sockaddr_in6 addr{};
+        addr.sin6_family = AF_INET6;
+        addr.sin6_addr   = in6addr_loopback;
+        socklen_t addr_size = sizeof(addr);
+        REQUIRE( ::bind( m_listener, (sockaddr*)&addr, sizeof(addr) ) == 0 );
+        REQUIRE( ::listen( m_listener, 1 ) == 0 );
+        ::getsockname( m_listener, (sockaddr*)&addr, &addr_size );
+        port = ntohs( addr.sin6_port );
+    }
+    ~OpensslServer()
+    {
+        if( m_thread.joinable() )
+            m_thread.join();
+        ::close( m_listener );
+        SSL_CTX_free( m_ctx );
+        X509_free( m_cert );
+        EVP_PKEY_free( m_key );
+    }
+
+    /**
+     * accept one connection, make handshake and send records (encrypted by application
+     * keys) by one write, then wait for client to close connection
+     */
+    void start( std::vector<std::pair<record::ContentType,std::string>> records )
+    {
+        m_thread = std::thread( [this,records=std::move(records)]() { serve( records ); } );
+    }
+
+    uint16_t port = 0;
+
+    OpensslServer( const OpensslServer& ) = delete;
+    OpensslServer& operator=( const OpensslServer& ) = delete;
+
+private:
+    static void keylog( const SSL*, const char* line )
+    {
+        static const char label[] = "SERVER_TRAFFIC_SECRET_0 ";
+        if( strncmp( line, label, sizeof(label)-1 ) == 0 )
+            s_server_secret = strchr( line + sizeof(label)-1, ' ' ) + 1;
+    }
+
+    void serve( const std::vector<std::pair<record::ContentType,std::string>>& records )
+    {
+        int fd = ::accept( m_listener, nullptr, nullptr );
+        SSL* ssl = SSL_new( m_ctx );
+        SSL_set_fd( ssl, fd );
+        if( SSL_accept( ssl ) == 1 )
+        {
+            std::vector<uint8_t> data = encrypt_records( records );
+            ::send( fd, data.data(), data.size(), 0 );
+        }
+        char buffer[256];
+        while( ::recv( fd, buffer, sizeof(buffer), 0 ) > 0 )
+            ;
+        SSL_free( ssl );
+        ::close( fd );
+    }
+
+    static std::vector<uint8_t> encrypt_records(
+            const std::vector<std::pair<record::ContentType,std::string>>& records )
+    {
+        uint8_t secret[32];
+        for( uint32_t i = 0; i < sizeof(secret); ++i )
+            secret[i] = std::stoul( s_server_secret.substr( i*2, 2 ), nullptr, 16 );
+
+        tls_crypto::TlsCipherSuite cipher_suite;
+        cipher_suite.set_cipher_suite( record::TLS_AES_128_GCM_SHA256 );
+        static const uint8_t key_label[] = "key";
+        static const uint8_t iv_label[]  = "iv";
+        tls_crypto::hkdf_expand_label( EVP_sha256(), secret, sizeof(secret), key_label, sizeof(key_label)-1
+                                       , nullptr, 0, cipher_suite.sender_key_data(), cipher_suite.key_size() );
+        tls_crypto::hkdf_expand_label( EVP_sha256(), secret, sizeof(secret), iv_label, sizeof(iv_label)-1
+                                       , nullptr, 0, cipher_suite.sender_iv_data(), cipher_suite.iv_size() );
+        cipher_suite.reset_key_counters();
+
+        std::vector<uint8_t> data;
+        for( const auto& [content_type, content] : records )
+        {
+            // TLSInnerPlaintext: content | content type, without padding
+            std::vector<uint8_t> inner_plaintext( content.begin(), content.end() );
+            inner_plaintext.push_back( static_cast<uint8_t>(content_type) );
+            uint16_t length = inner_plaintext.size() + cipher_suite.tag_size();
+
+            size_t offset = data.size();
+            data.resize( offset + sizeof(record::TLSCiphertext) + length );
+            uint8_t* header = data.data() + offset;
+            header[0] = static_cast<uint8_t>(record::ContentType::APPLICATION_DATA);
+            header[1] = 0x03;
+            header[2] = 0x03;
+            header[3] = length >> 8;
+            header[4] = length & 0xFF;
+            uint8_t* ciphertext = header + sizeof(record::TLSCiphertext);
+            cipher_suite.encrypt( inner_plaintext.data(), inner_plaintext.size()
+                                  , header, sizeof(record::TLSCiphertext)
+                                  , ciphertext, ciphertext + inner_plaintext.size() );
+        }
+        return data;
+    }
+
+    static inline std::string s_server_secret;
+
+    EVP_PKEY* m_key  = nullptr;
+    X509*     m_cert = nullptr;
+    SSL_CTX*  m_ctx  = nullptr;
+    int       m_listener = -1;
+    std::thread m_thread;
+};
+
+struct ClientResult
+{
+    std::string data;
+    std::string error;
+    uint32_t reads_count = 0;
+    bool close_notify_received = false;
+};
+
+static TestTask read_until_close( net::Poller& poller, uint16_t port, ClientResult& result
+                                  , const char* hostname = "localhost" )
+{
+    try
+    {
+        tls13::TlsSocket socket;
+        if( co_await socket.async_connect( poller, "::1", port, hostname ))
+        {
+            char buffer[1024];
+            while( auto bytes_read = co_await socket.async_read( buffer, sizeof(buffer) ))
+            {
+                result.data.append( buffer, bytes_read );
+                ++result.reads_count;
+            }
+            result.close_notify_received = socket.close_notify_received();
+            // reads after close_notify return 0, nothing left from trailing records
+            if( co_await socket.async_read( buffer, sizeof(buffer) ) != 0 )
+                result.error = "data returned after close_notify";
+        }
+    }
+    catch( const std::exception& ex )
+    {
+        result.error = ex.what();
+    }
+    poller.stop();
+}
+
+TEST_CASE("records received after close_notify in the same read are ignored")
+{
+    const std::string close_notify( "\x01\x00", 2 ); // level warning, description close_notify
+    OpensslServer server;
+    server.start( { { record::ContentType::APPLICATION_DATA, "data before close_notify" }
+                    , { record::ContentType::ALERT, close_notify }
+                    , { record::ContentType::APPLICATION_DATA, "trailing data" }
+                    , { record::ContentType::APPLICATION_DATA, "more trailing data" } } );
+
+    net::Poller poller;
+    ClientResult result;
+    TestTask client = read_until_close( poller, server.port, result );
+    client.coro.resume();
+    poller.run();
+
+    CHECK( result.error.empty() );
+    // all records are sent by one write and decrypted by one batch
+    CHECK( result.reads_count == 1 );
+    CHECK( result.data == "data before close_notify" );
+    CHECK( result.close_notify_received );
+}
+
+TEST_CASE("server certificate not matching hostname fails handshake")
+{
+    OpensslServer server;
+    server.start( { { record::ContentType::APPLICATION_DATA, "not expected data" } } );
+
+    auto before = net::MetricsRegistry::instance().collect();
+    net::Poller poller;
+    ClientResult result;
+    TestTask client = read_until_close( poller, server.port, result, "example.com" );
+    client.coro.resume();
+    poller.run();
+    auto after = net::MetricsRegistry::instance().collect();
+
+    CHECK( !result.error.empty() );
+    CHECK( result.data.empty() );
+    CHECK( after.counter( net::Counter::CERT_VERIFY_FAILURES )
+           - before.counter( net::Counter::CERT_VERIFY_FAILURES ) == 1 );
+}
@@ -0,0 +1,147 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <string>
+#include <thread>
+#include <future>
+#include <stdexcept>
+
+#include <libcornet/poller.hpp>
+#include <libcornet/tls/reloadable_key_store.hpp>
+
+namespace net = pioneer19::cornet;
+namespace tls13 = pioneer19::cornet::tls13;
+
+/**
+ * KeyStore of one domain without certificate, generation is kept in max_early_data_size
+ */
+class TestKeyStore : public tls13::KeyStore
+{
+public:
+    explicit TestKeyStore( uint32_t generation, uint32_t& alive_count )
+        :m_alive_count{ alive_count }
+    {
+        m_keys.max_early_data_size = generation;
+        ++m_alive_count;
+    }
+    ~TestKeyStore() override { --m_alive_count; }
+
+    tls13::DomainKeys* find( const char* domain_name ) noexcept override
+    {
+        return std::string_view{ domain_name } == "example.com" ? &m_keys : nullptr;
+    }
+
+private:
+    uint32_t& m_alive_count;
+    tls13::DomainKeys m_keys;
+};
+
+TEST_CASE("ReloadableKeyStore keeps snapshot of handshake")
+{
+    uint32_t generation = 0;
+    uint32_t alive_count = 0;
+    bool fail_load = false;
+    tls13::ReloadableKeyStore key_store{ [&]() -> std::unique_ptr<tls13::KeyStore> {
+        if( fail_load )
+            throw std::runtime_error( "test load failed" );
+        return std::make_unique<TestKeyStore>( ++generation, alive_count );
+    } };
+    CHECK( alive_count == 1 );
+
+    tls13::KeyStoreSnapshotRef first_ref;
+    auto* first_keys = key_store.acquire( "example.com", first_ref );
+    REQUIRE( first_keys != nullptr );
+    CHECK( first_keys->max_early_data_size == 1 );
+    tls13::KeyStoreSnapshotRef not_found_ref;
+    CHECK( key_store.acquire( "other.com", not_found_ref ) == nullptr );
+
+    uint64_t version = key_store.version();
+    REQUIRE( key_store.reload() );
+    CHECK( key_store.version() == version + 1 );
+    CHECK( alive_count == 2 );
+
+    tls13::KeyStoreSnapshotRef second_ref;
+    auto* second_keys = key_store.acquire( "example.com", second_ref );
+    REQUIRE( second_keys != nullptr );
+    CHECK( second_keys->max_early_data_size == 2 );
+    // in flight handshake keeps old keys
+    CHECK( alive_count == 2 );
+    CHECK( first_keys->max_early_data_size == 1 );
+
+    // old snapshot is freed on next lookup after handshake finished
+    first_ref.reset();
+    CHECK( key_store.find( "example.com" ) == second_keys );
+    CHECK( alive_count == 1 );
+
+    // failed reload keeps current snapshot
+    fail_load = true;
+    CHECK_FALSE( key_store.reload() );
+    CHECK( key_store.version() == version + 1 );
+    CHECK( key_store.find( "example.com" ) == second_keys );
+    fail_load = false;
+
+    // other thread keeps own snapshot until its next lookup
+    tls13::KeyStoreSnapshotRef thread_ref;
+    std::promise<void> acquired;
+    std::promise<void> released;
+    std::thread thread{ [&](){
+        key_store.acquire( "example.com", thread_ref );
+        acquired.set_value();
+        released.get_future().wait();
+        thread_ref.reset();
+        key_store.find( "example.com" );
+    } };
+    acquired.get_future().wait();
+    REQUIRE( key_store.reload() );
+    second_ref.reset();
+    CHECK( key_store.find( "example.com" )->max_early_data_size == 3 );
+    CHECK( alive_count == 2 ); // snapshot 2 is kept by other thread
+    released.set_value();
+    thread.join();
+    CHECK( alive_count == 1 );
+}
+
+TEST_CASE("ReloadableKeyStore reloads on file change")
+{
+    char dir_template[] = "/tmp/libcornet_reload_test.XXXXXX";
+    REQUIRE( mkdtemp( dir_template ) != nullptr );
+    std::string dir{ dir_template };
+
+    uint32_t generation = 0;
+    uint32_t alive_count = 0;
+    tls13::ReloadableKeyStore key_store{ [&](){
+        return std::make_unique<TestKeyStore>( ++generation, alive_count );
+    } };
+
+    net::Poller poller;
+    key_store.reload_on_change( poller, { dir } );
+    uint64_t version = key_store.version();
+
+    std::string file_name = dir + "/cert.pem";
+    int fd = open( file_name.c_str(), O_WRONLY|O_CREAT|O_CLOEXEC, 0600 );
+    REQUIRE( fd != -1 );
+    REQUIRE( write( fd, "cert", 4 ) == 4 );
+    close( fd );
+
+    poller.run_on_idle( [&](){
+        if( key_store.version() != version )
+            poller.stop();
+        return false;
+    } );
+    poller.run();
+
+    CHECK( key_store.version() > version );
+    CHECK( key_store.find( "example.com" )->max_early_data_size == generation );
+
+    unlink( file_name.c_str() );
+    rmdir( dir.c_str() );
+}
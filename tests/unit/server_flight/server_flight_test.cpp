@@ -0,0 +1,247 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <unistd.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <experimental/coroutine>
+
+#include <openssl/evp.h>
+#include <openssl/ec.h>
+#include <openssl/pem.h>
+#include <openssl/rand.h>
+#include <openssl/x509.h>
+#include <openssl/x509v3.h>
+
+#include <doctest/doctest.h>
+
+#include <libcornet/tls/types.hpp>
+#include <libcornet/tls/tls_socket.hpp>
+#include <libcornet/tls/key_store.hpp>
+#include <libcornet/tls/tls_trusted_certs.hpp>
+#include <libcornet/tls/session_ticket.hpp>
+#include <libcornet/poller.hpp>
+#include <libcornet/trace.hpp>
+
+namespace net    = pioneer19::cornet;
+namespace tls13  = pioneer19::cornet::tls13;
+namespace record = pioneer19::cornet::tls13::record;
+
+/**
+ * P-256 key and self signed certificate for "localhost" in temporary directory,
+ * certificate is padded by not compressible private extension of padding_size bytes
+ * and trusted by clients of this thread (subject is unique by common_name)
+ */
+class PaddedKeyStore
+{
+public:
+    PaddedKeyStore( const char* common_name, uint32_t padding_size )
+    {
+        char dir_template[] = "/tmp/libcornet_flight_test.XXXXXX";
+        REQUIRE( mkdtemp( dir_template ) != nullptr );
+        m_dir = dir_template;
+
+        EVP_PKEY_CTX* pctx = EVP_PKEY_CTX_new_id( EVP_PKEY_EC, nullptr );
+        EVP_PKEY* key = nullptr;
+        REQUIRE( EVP_PKEY_keygen_init( pctx ) == 1 );
+        EVP_PKEY_CTX_set_ec_paramgen_curve_nid( pctx, NID_X9_62_prime256v1 );
+        REQUIRE( EVP_PKEY_keygen( pctx, &key ) == 1 );
+        EVP_PKEY_CTX_free( pctx );
+
+        X509* cert = X509_new();
+        X509_set_version( cert, 2 );
+        ASN1_INTEGER_set( X509_get_serialNumber( cert ), 1 );
+        X509_gmtime_adj( X509_getm_notBefore( cert ), -3600 );
+        X509_gmtime_adj( X509_getm_notAfter( cert ), 3600 );
+        X509_set_pubkey( cert, key );
+        X509_NAME* name = X509_get_subject_name( cert );
+        X509_NAME_add_entry_by_txt( name, "CN", MBSTRING_ASC
+                                    , reinterpret_cast<const unsigned char*>(common_name), -1, -1, 0 );
+        X509_set_issuer_name( cert, name );
+        char alt_name[] = "DNS:localhost";
+        X509_EXTENSION* san = X509V3_EXT_conf_nid( nullptr, nullptr, NID_subject_alt_name, alt_name );
+        X509_add_ext( cert, san, -1 );
+        X509_EXTENSION_free( san );
+        // random bytes are not compressed, so Certificate message is sent as is
+        std::vector<uint8_t> padding( padding_size );
+        REQUIRE( RAND_bytes( padding.data(), padding.size() ) == 1 );
+        ASN1_OCTET_STRING* padding_data = ASN1_OCTET_STRING_new();
+        ASN1_OCTET_STRING_set( padding_data, padding.data(), padding.size() );
+        ASN1_OBJECT* padding_oid = OBJ_txt2obj( "1.3.6.1.4.1.55555.1", 1 );
+        X509_EXTENSION* padding_ext = X509_EXTENSION_create_by_OBJ( nullptr, padding_oid, 0, padding_data );
+        X509_add_ext( cert, padding_ext, -1 );
+        X509_EXTENSION_free( padding_ext );
+        ASN1_OBJECT_free( padding_oid );
+        ASN1_OCTET_STRING_free( padding_data );
+        REQUIRE( X509_sign( cert, key, EVP_sha256() ) != 0 );
+
+        m_key_file  = m_dir + "/localhost.key.pem";
+        m_cert_file = m_dir + "/localhost.cert.pem";
+        FILE* file = fopen( m_key_file.c_str(), "w" );
+        PEM_write_PrivateKey( file, key, nullptr, nullptr, 0, nullptr, nullptr );
+        fclose( file );
+        file = fopen( m_cert_file.c_str(), "w" );
+        PEM_write_X509( file, cert );
+        fclose( file );
+
+        X509_STORE_add_cert( tls13::TlsTrustedCerts::store_instance(), cert );
+        X509_free( cert );
+        EVP_PKEY_free( key );
+
+        key_store = std::make_unique<tls13::SingleDomainKeyStore>(
+                "localhost", m_key_file.c_str(), m_cert_file.c_str() );
+    }
+    ~PaddedKeyStore()
+    {
+        unlink( m_key_file.c_str() );
+        unlink( m_cert_file.c_str() );
+        rmdir( m_dir.c_str() );
+    }
+
+    std::unique_ptr<tls13::SingleDomainKeyStore> key_store;
+
+    PaddedKeyStore( const PaddedKeyStore& ) = delete;
+    PaddedKeyStore& operator=( const PaddedKeyStore& ) = delete;
+
+private:
+    std::string m_dir;
+    std::string m_key_file;
+    std::string m_cert_file;
+};
+
+/**
+ * coroutine started by resume() only
+ */
+struct TestTask
+{
+    struct promise_type;
+    using coro_handler = std::experimental::coroutine_handle<promise_type>;
+
+    struct promise_type
+    {
+        std::experimental::suspend_always initial_suspend() noexcept { return {}; }
+        std::experimental::suspend_always final_suspend() noexcept   { return {}; }
+        TestTask get_return_object() { return TestTask{coro_handler::from_promise(*this)}; }
+        void unhandled_exception() { std::terminate(); }
+        void return_void() {}
+    };
+
+    explicit TestTask( coro_handler coro ) noexcept : coro( coro ) {}
+    TestTask( const TestTask& ) = delete;
+    TestTask& operator=( const TestTask& ) = delete;
+    ~TestTask() { if( coro ) coro.destroy(); }
+
+    coro_handler coro;
+};
+
+struct SessionResult
+{
+    std::string data;
+    std::string error;
+};
+
+static const char SERVER_MESSAGE[] = "data after big server flight";
+
+static TestTask server_session( net::Poller& poller, tls13::TlsSocket& listener
+                                , tls13::KeyStore* key_store, SessionResult& result )
+{
+    try
+    {
+        net::TcpSocket tcp_socket = co_await listener.async_accept_tcp( poller );
+        tls13::TlsSocket socket = co_await tls13::TlsSocket::server_handshake( std::move(tcp_socket), key_store );
+        co_await socket.async_write( SERVER_MESSAGE, sizeof(SERVER_MESSAGE)-1 );
+        co_await socket.async_close_notify();
+    }
+    catch( const std::exception& ex )
+    {
+        result.error = ex.what();
+    }
+}
+
+static TestTask client_session( net::Poller& poller, uint16_t port, SessionResult& result )
+{
+    try
+    {
+        tls13::TlsSocket socket;
+        if( co_await socket.async_connect( poller, "::1", port, "localhost" ))
+        {
+            char buffer[1024];
+            while( auto bytes_read = co_await socket.async_read( buffer, sizeof(buffer) ))
+                result.data.append( buffer, bytes_read );
+        }
+        else
+        {
+            result.error = "handshake failed";
+        }
+    }
+    catch( const std::exception& ex )
+    {
+        result.error = ex.what();
+    }
+    poller.stop();
+}
+
+/// full handshake (not resumed by ticket of previous session) with key_store
+static void run_session( uint16_t port, tls13::KeyStore* key_store
+                         , SessionResult& server_result, SessionResult& client_result )
+{
+    tls13::TicketCache::instance().clear();
+    net::Poller poller;
+    tls13::TlsSocket listener;
+    listener.bind( "::1", port );
+    listener.listen( poller );
+
+    TestTask server = server_session( poller, listener, key_store, server_result );
+    server.coro.resume();
+    TestTask client = client_session( poller, port, client_result );
+    client.coro.resume();
+    poller.run();
+}
+
+TEST_CASE("server flight with certificate over 16K is sent by two records")
+{
+    PaddedKeyStore localhost( "flight.localhost", 17*1024 );
+    const tls13::DomainKeys* domain_keys = localhost.key_store->find( "localhost" );
+    REQUIRE( domain_keys != nullptr );
+    REQUIRE( domain_keys->certificate_message.size() > 16*1024 );
+
+    net::TraceRing::set_enabled( true );
+    net::TraceRing::instance().clear();
+    SessionResult server_result;
+    SessionResult client_result;
+    run_session( 10440, localhost.key_store.get(), server_result, client_result );
+
+    CHECK( server_result.error.empty() );
+    CHECK( client_result.error.empty() );
+    CHECK( client_result.data == SERVER_MESSAGE );
+
+    // EncryptedExtensions..Finished are encrypted to first record of 16K content and second one
+    // with the rest, client decrypts them as handshake records
+    auto records = net::TraceRing::instance().records();
+    auto full_records = std::count_if( records.begin(), records.end(), []( const net::TraceRecord& trace ) {
+        return trace.event == net::TraceEvent::RECORD_DECRYPTED
+               && trace.content_type == static_cast<uint8_t>(record::ContentType::HANDSHAKE)
+               && trace.size == 16*1024; } );
+    CHECK( full_records == 1 );
+}
+
+TEST_CASE("server flight not fitting write buffer fails handshake")
+{
+    PaddedKeyStore localhost( "big.localhost", 21*1024 );
+
+    SessionResult server_result;
+    SessionResult client_result;
+    run_session( 10441, localhost.key_store.get(), server_result, client_result );
+
+    CHECK( server_result.error.find( "does not fit write buffer" ) != std::string::npos );
+    CHECK( !client_result.error.empty() );
+    CHECK( client_result.data.empty() );
+}
@@ -0,0 +1,264 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <libcornet/tls/parser.hpp>
+#include <libcornet/tls/record_helpers.hpp>
+#include <libcornet/tls/session_ticket.hpp>
+#include <libcornet/tls/crypto/record_cryptor.hpp>
+#include <libcornet/tls/crypto/tls_handshake.hpp>
+
+namespace tls13  = pioneer19::cornet::tls13;
+namespace record = pioneer19::cornet::tls13::record;
+
+static tls13::SessionTicketState make_state( uint64_t now_ms )
+{
+    tls13::SessionTicketState state{};
+    state.cipher_suite   = record::TLS_AES_128_GCM_SHA256;
+    state.ticket_age_add = 0x01020304;
+    state.issue_time_ms  = now_ms;
+    state.set_server_name( "a.example.com" );
+    state.psk_size       = 32;
+    for( uint8_t i = 0; i < state.psk_size; ++i )
+        state.psk[i] = i;
+    return state;
+}
+
+TEST_CASE("session ticket seal and open")
+{
+    tls13::SessionTicketKeys keys{ 60 };
+    uint64_t now = 1'000'000;
+    auto state = make_state( now );
+
+    uint8_t ticket[tls13::SessionTicketKeys::TICKET_SIZE];
+    REQUIRE( keys.seal( state, ticket, now ) == sizeof(ticket) );
+
+    tls13::SessionTicketState opened{};
+    REQUIRE( keys.open( ticket, sizeof(ticket), opened, now+1000 ) );
+    CHECK( opened.cipher_suite   == state.cipher_suite );
+    CHECK( opened.ticket_age_add == state.ticket_age_add );
+    CHECK( opened.psk_size == state.psk_size );
+    CHECK( memcmp( opened.psk, state.psk, state.psk_size ) == 0 );
+
+    SUBCASE("tampered ticket rejected")
+    {
+        ticket[tls13::SessionTicketKeys::KEY_NAME_SIZE+tls13::SessionTicketKeys::IV_SIZE] ^= 0x01;
+        CHECK_FALSE( keys.open( ticket, sizeof(ticket), opened, now+1000 ) );
+    }
+    SUBCASE("short ticket rejected")
+    {
+        CHECK_FALSE( keys.open( ticket, sizeof(ticket)-1, opened, now+1000 ) );
+    }
+    SUBCASE("expired ticket rejected")
+    {
+        CHECK_FALSE( keys.open( ticket, sizeof(ticket), opened, now+61*1000 ) );
+    }
+    SUBCASE("other process keys can not open ticket")
+    {
+        tls13::SessionTicketKeys other_keys{ 60 };
+        CHECK_FALSE( other_keys.open( ticket, sizeof(ticket), opened, now+1000 ) );
+    }
+}
+
+TEST_CASE("session ticket resumes for issuing server name only")
+{
+    tls13::SessionTicketKeys keys{ 60 };
+    uint64_t now = 1'000'000;
+    auto state = make_state( now );
+
+    uint8_t ticket[tls13::SessionTicketKeys::TICKET_SIZE];
+    REQUIRE( keys.seal( state, ticket, now ) == sizeof(ticket) );
+
+    tls13::SessionTicketState opened{};
+    REQUIRE( keys.open( ticket, sizeof(ticket), opened, now+1000 ) );
+    CHECK( opened.server_name_equal( "a.example.com" ) );
+    CHECK_FALSE( opened.server_name_equal( "b.example.com" ) );
+    CHECK_FALSE( opened.server_name_equal( "" ) );
+}
+
+TEST_CASE("session ticket key rotation")
+{
+    tls13::SessionTicketKeys keys{ 3600 };
+    uint64_t now = 1'000'000;
+    auto state = make_state( now );
+
+    uint8_t ticket[tls13::SessionTicketKeys::TICKET_SIZE];
+    REQUIRE( keys.seal( state, ticket, now ) == sizeof(ticket) );
+
+    tls13::SessionTicketState opened{};
+    keys.rotate( now+1 );
+    CHECK( keys.open( ticket, sizeof(ticket), opened, now+2 ) );
+    keys.rotate( now+3 );
+    CHECK_FALSE( keys.open( ticket, sizeof(ticket), opened, now+4 ) );
+}
+
+static tls13::ClientTicket make_client_ticket( uint8_t id, uint64_t now_ms, uint32_t lifetime = 60 )
+{
+    tls13::ClientTicket ticket;
+    ticket.ticket.assign( 8, id );
+    ticket.ticket_lifetime = lifetime;
+    ticket.receive_time_ms = now_ms;
+    return ticket;
+}
+
+TEST_CASE("client ticket is single use")
+{
+    tls13::TicketCache cache{ 2 };
+    uint64_t now = 1'000'000;
+
+    cache.store( "a.com", make_client_ticket( 1, now ) );
+    auto ticket = cache.take( "a.com", now );
+    REQUIRE( ticket );
+    CHECK( ticket->ticket[0] == 1 );
+    CHECK_FALSE( cache.take( "a.com", now ) );
+    CHECK( cache.size() == 0 );
+}
+
+TEST_CASE("client ticket cache takes newest not expired ticket")
+{
+    tls13::TicketCache cache{ 2 };
+    uint64_t now = 1'000'000;
+
+    cache.store( "a.com", make_client_ticket( 1, now, 100 ) );
+    cache.store( "a.com", make_client_ticket( 2, now, 1 ) );
+    auto ticket = cache.take( "a.com", now+2000 );
+    REQUIRE( ticket );
+    CHECK( ticket->ticket[0] == 1 );
+}
+
+TEST_CASE("client ticket cache limits tickets per server")
+{
+    tls13::TicketCache cache{ 2 };
+    uint64_t now = 1'000'000;
+
+    for( uint8_t i = 0; i < tls13::TicketCache::TICKETS_PER_SERVER+2; ++i )
+        cache.store( "a.com", make_client_ticket( i, now ) );
+    uint32_t count = 0;
+    while( cache.take( "a.com", now ) )
+        ++count;
+    CHECK( count == tls13::TicketCache::TICKETS_PER_SERVER );
+}
+
+TEST_CASE("client ticket cache evicts least recently used server")
+{
+    tls13::TicketCache cache{ 2 };
+    uint64_t now = 1'000'000;
+
+    cache.store( "a.com", make_client_ticket( 1, now ) );
+    cache.store( "b.com", make_client_ticket( 2, now ) );
+    cache.store( "a.com", make_client_ticket( 3, now ) );
+    cache.store( "c.com", make_client_ticket( 4, now ) );
+    CHECK( cache.size() == 2 );
+    CHECK_FALSE( cache.take( "b.com", now ) );
+    CHECK( cache.take( "a.com", now ) );
+    CHECK( cache.take( "c.com", now ) );
+}
+
+struct NewSessionTicketTestHook : public record::EmptyHook
+{
+    void new_session_ticket( const record::NewSessionTicket* new_session_ticket
+            , const uint8_t* nonce, uint8_t nonce_size, const uint8_t* ticket, uint16_t ticket_size )
+    {
+        lifetime = new_session_ticket->ticket_lifetime();
+        age_add  = new_session_ticket->ticket_age_add();
+        this->nonce.assign( nonce, nonce+nonce_size );
+        this->ticket.assign( ticket, ticket+ticket_size );
+    }
+    uint32_t lifetime = 0;
+    uint32_t age_add  = 0;
+    std::vector<uint8_t> nonce;
+    std::vector<uint8_t> ticket;
+};
+
+TEST_CASE("NewSessionTicket create and parse")
+{
+    const uint8_t nonce[] = { 7 };
+    uint8_t ticket[tls13::SessionTicketKeys::TICKET_SIZE];
+    for( uint32_t i = 0; i < sizeof(ticket); ++i )
+        ticket[i] = static_cast<uint8_t>( i );
+
+    uint8_t buffer[512];
+    uint32_t record_size = tls13::RecordHelpers::create_new_session_ticket_record(
+            3600, 0xaabbccdd, nonce, sizeof(nonce), ticket, sizeof(ticket), 0, buffer );
+    REQUIRE( record_size > 0 );
+
+    NewSessionTicketTestHook hook;
+    record::Parser parser;
+    auto [bytes_parsed, err] = parser.parse_net_record( &hook, buffer, record_size );
+    REQUIRE_FALSE( err );
+    CHECK( bytes_parsed == record_size );
+    CHECK( hook.lifetime == 3600 );
+    CHECK( hook.age_add == 0xaabbccdd );
+    CHECK( hook.nonce == std::vector<uint8_t>( nonce, nonce+sizeof(nonce) ) );
+    CHECK( hook.ticket == std::vector<uint8_t>( ticket, ticket+sizeof(ticket) ) );
+}
+
+struct PskClientHelloTestHook : public record::EmptyHook
+{
+    void tls_handshake( const record::Handshake* handshake )
+    { client_hello = reinterpret_cast<const uint8_t*>( handshake ); }
+    void psk_identity( const uint8_t* identity, uint16_t identity_size, uint32_t obfuscated_age )
+    {
+        this->identity.assign( identity, identity+identity_size );
+        obfuscated_ticket_age = obfuscated_age;
+    }
+    void psk_binders( const uint8_t* binders_vector ) { binders = binders_vector; }
+    void psk_binder( const uint8_t* binder_data, uint8_t binder_size )
+    { binder.assign( binder_data, binder_data+binder_size ); }
+
+    const uint8_t* client_hello = nullptr;
+    const uint8_t* binders = nullptr;
+    std::vector<uint8_t> identity;
+    std::vector<uint8_t> binder;
+    uint32_t obfuscated_ticket_age = 0;
+};
+
+TEST_CASE("ClientHello pre_shared_key binder verified by server")
+{
+    auto state = make_state( 0 );
+    tls13::ClientTicket client_ticket = make_client_ticket( 5, tls13::SessionTicketKeys::now_ms(), 3600 );
+    client_ticket.cipher_suite   = state.cipher_suite;
+    client_ticket.ticket_age_add = state.ticket_age_add;
+    client_ticket.psk_size       = state.psk_size;
+    memcpy( client_ticket.psk, state.psk, state.psk_size );
+
+    tls13::crypto::RecordCryptor client_cryptor;
+    tls13::crypto::TlsHandshake client_handshake{ client_cryptor, "example.com", record::NamedGroup::X25519 };
+    client_handshake.m_hello_type = tls13::crypto::TlsHandshake::HelloType::ClientHello;
+    client_handshake.psk_ticket = &client_ticket;
+    client_handshake.set_resumption_psk( client_ticket.cipher_suite, client_ticket.psk, client_ticket.psk_size );
+
+    uint8_t buffer[2048];
+    uint32_t record_size = tls13::RecordHelpers::create_client_hello_record( client_handshake, buffer );
+    REQUIRE( record_size > 0 );
+
+    PskClientHelloTestHook hook;
+    record::Parser parser;
+    auto [bytes_parsed, err] = parser.parse_net_record( &hook, buffer, record_size );
+    REQUIRE_FALSE( err );
+    REQUIRE( hook.client_hello != nullptr );
+    REQUIRE( hook.binders != nullptr );
+    CHECK( hook.identity == client_ticket.ticket );
+    CHECK( hook.obfuscated_ticket_age - client_ticket.ticket_age_add < 1000 );
+
+    tls13::crypto::RecordCryptor server_cryptor;
+    std::string sni;
+    tls13::crypto::TlsHandshake server_handshake{ server_cryptor, sni };
+    server_handshake.set_tls_cipher_suite( state.cipher_suite );
+    server_handshake.set_resumption_psk( state.cipher_suite, state.psk, state.psk_size );
+
+    uint8_t binder[EVP_MAX_MD_SIZE];
+    uint32_t binder_size = server_handshake.psk_binder(
+            hook.client_hello, hook.binders - hook.client_hello, binder );
+    REQUIRE( binder_size == hook.binder.size() );
+    CHECK( memcmp( binder, hook.binder.data(), binder_size ) == 0 );
+}
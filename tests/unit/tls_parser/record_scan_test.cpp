@@ -0,0 +1,54 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <array>
+#include <vector>
+
+#include <libcornet/tls/record_scan.hpp>
+
+namespace record = pioneer19::cornet::tls13::record;
+
+TEST_CASE( "trim_zero_tail finds last non zero byte" )
+{
+    std::vector<uint8_t> data( 200 );
+    CHECK( record::trim_zero_tail( data.data(), data.size() ) == 0 );
+    CHECK( record::trim_zero_tail( data.data(), 0 ) == 0 );
+
+    // every position in vector blocks and in scalar head
+    for( uint32_t size : { 1u, 15u, 16u, 17u, 31u, 32u, 33u, 200u } )
+    {
+        for( uint32_t position = 0; position < size; ++position )
+        {
+            std::fill( data.begin(), data.end(), 0 );
+            data[position] = 23;
+            if( position > 0 )
+                data[0] = 1;
+            CHECK( record::trim_zero_tail( data.data(), size ) == position + 1 );
+        }
+    }
+}
+
+TEST_CASE( "scan_complete_records finds record boundaries" )
+{
+    const uint8_t stream[] = { 23, 0x03, 0x03, 0x00, 0x02, 1, 2
+                               ,23, 0x03, 0x03, 0x00, 0x00
+                               ,23, 0x03, 0x03, 0x00, 0x03, 1, 2 };
+    std::array<uint32_t,4> record_sizes = {};
+
+    REQUIRE( record::scan_complete_records( stream, sizeof(stream), record_sizes ) == 2 );
+    CHECK( record_sizes[0] == 7 );
+    CHECK( record_sizes[1] == 5 );
+    // partial header is not a record
+    CHECK( record::scan_complete_records( stream, 10, record_sizes ) == 1 );
+    // output is full
+    CHECK( record::scan_complete_records( stream, sizeof(stream), std::span( record_sizes ).first( 1 )) == 1 );
+
+    const uint8_t too_long[] = { 23, 0x03, 0x03, 0x41, 0x01 };
+    CHECK( record::scan_complete_records( too_long, sizeof(too_long), record_sizes ) == 0 );
+}
@@ -0,0 +1,133 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <vector>
+
+#include <libcornet/tls/parser.hpp>
+#include <libcornet/tls/handshake_chain.hpp>
+#include <libcornet/tls/record_stream_parser.hpp>
+
+namespace tls13  = pioneer19::cornet::tls13;
+namespace record = pioneer19::cornet::tls13::record;
+
+TEST_CASE( "RecordStreamParser keeps position between feeds" )
+{
+    // two records: 3 and 1 bytes of data
+    const uint8_t stream[] = { 23, 0x03, 0x03, 0x00, 0x03, 1, 2, 3
+                               ,23, 0x03, 0x03, 0x00, 0x01, 4 };
+    record::RecordStreamParser parser;
+
+    // header split between reads
+    CHECK( parser.feed( stream, 2 ) == 2 );
+    CHECK_FALSE( parser.record_ready() );
+    CHECK( parser.record_size() == 0 );
+    CHECK( parser.bytes_needed() == 3 );
+    CHECK( parser.feed( stream + 2, 4 ) == 4 );
+    CHECK( parser.record_size() == 8 );
+    CHECK( parser.bytes_needed() == 2 );
+    // next record bytes are not consumed
+    CHECK( parser.feed( stream + 6, sizeof(stream) - 6 ) == 2 );
+    CHECK( parser.record_ready() );
+    CHECK( parser.parsed_size() == 8 );
+
+    parser.reset();
+    CHECK( parser.feed( stream + 8, sizeof(stream) - 8 ) == 6 );
+    CHECK( parser.record_ready() );
+    CHECK( parser.record_size() == 6 );
+}
+
+TEST_CASE( "RecordStreamParser detects too long record by header" )
+{
+    const uint8_t header[] = { 23, 0x03, 0x03, 0x41, 0x01 }; // 2^14 + 257
+    record::RecordStreamParser parser;
+
+    CHECK( parser.feed( header, sizeof(header) ) == sizeof(header) );
+    CHECK( parser.overflow() );
+    CHECK_FALSE( parser.record_ready() );
+    CHECK( parser.bytes_needed() == 0 );
+}
+
+TEST_CASE( "HandshakeChain contiguous data" )
+{
+    const uint8_t first[]  = { 11, 0, 0, 4, 1 };
+    const uint8_t second[] = { 2, 3, 4 };
+    tls13::HandshakeChain chain;
+    chain.append( first, sizeof(first) );
+    chain.append( second, sizeof(second) );
+
+    CHECK( chain.size() == 8 );
+    CHECK( chain.message_size() == 8 );
+    // data inside fragment is not copied
+    CHECK( chain.contiguous( 1, 4 ) == first + 1 );
+    CHECK( chain.contiguous( 5, 3 ) == second );
+    CHECK( chain.contiguous( 8, 0 ) != nullptr );
+    CHECK( chain.contiguous( 6, 3 ) == nullptr );
+
+    const uint8_t* border_data = chain.contiguous( 3, 4 );
+    REQUIRE( border_data != nullptr );
+    const std::vector<uint8_t> expected_data = { 4, 1, 2, 3 };
+    CHECK( std::vector<uint8_t>( border_data, border_data + 4 ) == expected_data );
+
+    chain.clear();
+    CHECK( chain.empty() );
+    CHECK( chain.message_size() == 0 );
+}
+
+struct CertificateTestHook : record::EmptyHook
+{
+    void cert_data( record::CertificateType, const uint8_t* data, uint32_t size )
+    { m_certs.emplace_back( data, data + size ); }
+
+    std::vector<std::vector<uint8_t>> m_certs;
+};
+
+TEST_CASE( "Parser parses Certificate from chained fragments" )
+{
+    const std::vector<uint8_t> cert1( 300, 0xa1 );
+    const std::vector<uint8_t> cert2( 200, 0xb2 );
+    std::vector<uint8_t> message = { 11, 0, 0, 0   // Handshake header
+                                     ,0            // certificate_request_context
+                                     ,0, 0, 0 };   // certificate_list
+    for( const auto* cert : { &cert1, &cert2 } )
+    {
+        message.insert( message.end(), { 0, static_cast<uint8_t>(cert->size() >> 8u)
+                                         ,static_cast<uint8_t>(cert->size()) } );
+        message.insert( message.end(), cert->begin(), cert->end() );
+        message.insert( message.end(), { 0, 0 } ); // extensions
+    }
+    uint32_t list_size = message.size() - 8;
+    message[6] = list_size >> 8u;
+    message[7] = list_size;
+    uint32_t handshake_size = message.size() - sizeof(record::Handshake);
+    message[2] = handshake_size >> 8u;
+    message[3] = handshake_size;
+
+    // second fragment starts inside first certificate, third inside second length
+    tls13::HandshakeChain chain;
+    chain.append( message.data(), 100 );
+    chain.append( message.data() + 100, 215 );
+    chain.append( message.data() + 315, message.size() - 315 );
+
+    CertificateTestHook hook;
+    record::Parser parser;
+    auto err = parser.parse_handshake_chain( &hook, chain );
+
+    REQUIRE_FALSE( err );
+    REQUIRE( hook.m_certs.size() == 2 );
+    CHECK( hook.m_certs[0] == cert1 );
+    CHECK( hook.m_certs[1] == cert2 );
+
+    SUBCASE( "not complete message" )
+    {
+        tls13::HandshakeChain short_chain;
+        short_chain.append( message.data(), 100 );
+        CHECK( parser.parse_handshake_chain( &hook, short_chain ).parse_errno()
+               == record::ParserErrno::W_LOW_DATA_IN_HANDSHAKE );
+    }
+}
@@ -7,8 +7,15 @@
 
 #include <doctest/doctest.h>
 
+#include <cstring>
+
+#include <vector>
+
 #include <libcornet/tls/parser.hpp>
+#include <libcornet/tls/record_helpers.hpp>
+#include <libcornet/tls/certificate_compression.hpp>
 
+namespace tls13  = pioneer19::cornet::tls13;
 namespace record = pioneer19::cornet::tls13::record;
 
 TEST_CASE("Parser test with empty plaintext data")
@@ -69,6 +76,86 @@ TEST_CASE( "Parser test with empty handshake" )
     CHECK( err );
     REQUIRE( err.parse_errno() == record::ParserErrno::W_LOW_DATA_IN_HANDSHAKE );
 }
+
+struct CompressedCertificateTestHook : record::EmptyHook
+{
+    void compressed_certificate( record::CertificateCompressionAlgorithm algorithm
+            , uint32_t uncompressed_length, const uint8_t* data, uint32_t data_size )
+    {
+        m_algorithm = algorithm;
+        m_uncompressed_length = uncompressed_length;
+        m_data.assign( data, data + data_size );
+    }
+
+    record::CertificateCompressionAlgorithm m_algorithm = record::CertificateCompressionAlgorithm::NONE;
+    uint32_t m_uncompressed_length = 0;
+    std::vector<uint8_t> m_data;
+};
+
+TEST_CASE( "Parser test with compressed certificate" )
+{
+    const uint8_t compressed_data[] = { 1, 2, 3, 4, 5 };
+    uint32_t message_size = tls13::RecordHelpers::compressed_certificate_message_size( sizeof(compressed_data) );
+    std::vector<uint8_t> tls_record( sizeof(record::TlsPlaintext) + message_size );
+    const uint8_t plaintext_header[] = { 22 // handshake type
+                                         ,0x03,0x03 // legacy_version
+                                         ,0x00, static_cast<uint8_t>(message_size) // data length
+    };
+    std::memcpy( tls_record.data(), plaintext_header, sizeof(plaintext_header) );
+    uint32_t created_size = tls13::RecordHelpers::create_compressed_certificate_message(
+            record::CertificateCompressionAlgorithm::BROTLI, 1000
+            , compressed_data, sizeof(compressed_data), tls_record.data() + sizeof(record::TlsPlaintext) );
+    REQUIRE( created_size == message_size );
+
+    CompressedCertificateTestHook hook;
+    record::Parser parser;
+    auto[bytes_parsed, err] = parser.parse_net_record( &hook, tls_record.data(), tls_record.size() );
+
+    REQUIRE_FALSE( err );
+    CHECK( bytes_parsed == tls_record.size() );
+    CHECK( hook.m_algorithm == record::CertificateCompressionAlgorithm::BROTLI );
+    CHECK( hook.m_uncompressed_length == 1000 );
+    CHECK( hook.m_data == std::vector<uint8_t>( std::begin(compressed_data), std::end(compressed_data) ) );
+
+    SUBCASE( "empty compressed data is error" )
+    {
+        message_size = tls13::RecordHelpers::compressed_certificate_message_size( 0 );
+        tls_record.resize( sizeof(record::TlsPlaintext) + message_size );
+        tls_record[4] = static_cast<uint8_t>(message_size);
+        tls13::RecordHelpers::create_compressed_certificate_message(
+                record::CertificateCompressionAlgorithm::ZLIB, 1000
+                , compressed_data, 0, tls_record.data() + sizeof(record::TlsPlaintext) );
+
+        auto[empty_bytes_parsed, empty_err] = parser.parse_net_record( &hook, tls_record.data(), tls_record.size() );
+        CHECK( empty_err );
+        CHECK( empty_err.parse_errno() == record::ParserErrno::E_COMPRESSED_CERTIFICATE_NO_SPACE );
+    }
+}
+
+TEST_CASE( "Certificate compression roundtrip" )
+{
+    std::vector<uint8_t> data( 4000 );
+    for( size_t i = 0; i < data.size(); ++i )
+        data[i] = static_cast<uint8_t>( i % 61 );
+
+    for( auto algorithm : tls13::CertificateCompression::algorithms() )
+    {
+        CHECK( tls13::CertificateCompression::is_supported( algorithm ) );
+        auto compressed = tls13::CertificateCompression::compress( algorithm, data.data(), data.size() );
+        REQUIRE( !compressed.empty() );
+        CHECK( compressed.size() < data.size() );
+
+        std::vector<uint8_t> decompressed( data.size() );
+        CHECK( tls13::CertificateCompression::decompress( algorithm, compressed.data(), compressed.size()
+                                                          , decompressed.data(), decompressed.size() ) );
+        CHECK( decompressed == data );
+        // uncompressed_length must match exactly
+        CHECK_FALSE( tls13::CertificateCompression::decompress( algorithm, compressed.data(), compressed.size()
+                                                                , decompressed.data(), decompressed.size() - 1 ) );
+    }
+    CHECK_FALSE( tls13::CertificateCompression::is_supported( record::CertificateCompressionAlgorithm::NONE ) );
+}
+
 // ParserErrno::E_CLIENT_HELLO_NO_SPACE_FOR_RANDOM
 
 
@@ -0,0 +1,128 @@
+/*
+ * Copyright 2020 Alex Syrnikov <pioneer19@post.cz>
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * This file is part of libcornet (https://github.com/pioneer19/libcornet).
+ */
+
+#include <doctest/doctest.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <libcornet/trace.hpp>
+
+namespace net = pioneer19::cornet;
+
+TEST_CASE("trace ring keeps last events")
+{
+    auto& trace_ring = net::TraceRing::instance();
+    trace_ring.clear();
+
+    constexpr uint32_t EXTRA_EVENTS = 5;
+    for( uint32_t i = 0; i < net::TraceRing::DEFAULT_CAPACITY + EXTRA_EVENTS; ++i )
+        trace_ring.add( net::TraceEvent::BYTES_SENT, 7, i );
+
+    CHECK( trace_ring.count() == net::TraceRing::DEFAULT_CAPACITY + EXTRA_EVENTS );
+    auto records = trace_ring.records();
+    REQUIRE( records.size() == net::TraceRing::DEFAULT_CAPACITY );
+    CHECK( records.front().size == EXTRA_EVENTS );
+    CHECK( records.back().size == net::TraceRing::DEFAULT_CAPACITY + EXTRA_EVENTS - 1 );
+    CHECK( records.front().tsc <= records.back().tsc );
+    trace_ring.clear();
+}
+
+TEST_CASE("net record event takes types and size from record header")
+{
+    auto& trace_ring = net::TraceRing::instance();
+    trace_ring.clear();
+
+    // handshake record with 0x0123 bytes of finished message
+    const uint8_t record[] = { 22, 0x03, 0x03, 0x01, 0x23, 20, 0x00, 0x01, 0x1f };
+    trace_ring.add_net_record( net::TraceEvent::HANDSHAKE_MESSAGE, 42, record, 3 );
+
+    auto records = trace_ring.records();
+    REQUIRE( records.size() == 1 );
+    CHECK( records[0].event == net::TraceEvent::HANDSHAKE_MESSAGE );
+    CHECK( records[0].connection_id == 42 );
+    CHECK( records[0].size == 0x0123 );
+    CHECK( records[0].extra == 3 );
+    CHECK( records[0].content_type == 22 );
+    CHECK( records[0].handshake_type == 20 );
+    trace_ring.clear();
+}
+
+TEST_CASE("disabled tracing adds nothing")
+{
+    auto& trace_ring = net::TraceRing::instance();
+    trace_ring.clear();
+
+    net::TraceRing::set_enabled( false );
+    trace_ring.add( net::TraceEvent::CONNECTION_CLOSED, 1 );
+    net::TraceRing::set_enabled( true );
+
+    CHECK( trace_ring.count() == 0 );
+}
+
+TEST_CASE("dump writes header and records")
+{
+    auto& trace_ring = net::TraceRing::instance();
+    trace_ring.clear();
+    trace_ring.add( net::TraceEvent::CONNECTION_ACCEPTED, 1 );
+    trace_ring.add( net::TraceEvent::HANDSHAKE_STARTED, 1, 0, 1 );
+    trace_ring.add( net::TraceEvent::CONNECTION_CLOSED, 1 );
+
+    char file_name[] = "/tmp/cornet_trace_test_XXXXXX";
+    int fd = mkstemp( file_name );
+    REQUIRE( fd != -1 );
+    CHECK( trace_ring.dump( fd ) );
+
+    REQUIRE( lseek( fd, 0, SEEK_SET ) == 0 );
+    net::TraceFileHeader header{};
+    REQUIRE( read( fd, &header, sizeof(header) ) == sizeof(header) );
+    CHECK( memcmp( header.magic, net::TraceFileHeader::MAGIC, sizeof(header.magic) ) == 0 );
+    CHECK( header.version == net::TraceFileHeader::VERSION );
+    CHECK( header.record_size == sizeof(net::TraceRecord) );
+    CHECK( header.records_count == 3 );
+    CHECK( header.lost_count == 0 );
+    CHECK( header.thread_index == trace_ring.thread_index() );
+    CHECK( header.ns_per_cycle > 0 );
+
+    net::TraceRecord records[3];
+    REQUIRE( read( fd, records, sizeof(records) ) == sizeof(records) );
+    CHECK( records[0].event == net::TraceEvent::CONNECTION_ACCEPTED );
+    CHECK( records[1].extra == 1 );
+    CHECK( records[2].event == net::TraceEvent::CONNECTION_CLOSED );
+    CHECK( records[2].tsc <= header.dump_tsc );
+
+    close( fd );
+    unlink( file_name );
+    trace_ring.clear();
+}
+
+TEST_CASE("connection ids are unique across threads")
+{
+    constexpr uint32_t THREADS_COUNT = 4;
+    constexpr uint32_t IDS_PER_THREAD = 100;
+    std::vector<uint64_t> ids( THREADS_COUNT * IDS_PER_THREAD );
+
+    std::vector<std::thread> threads;
+    for( uint32_t i = 0; i < THREADS_COUNT; ++i )
+    {
+        threads.emplace_back( [&ids,i](){
+            for( uint32_t j = 0; j < IDS_PER_THREAD; ++j )
+                ids[i*IDS_PER_THREAD + j] = net::TraceRing::next_connection_id();
+        } );
+    }
+    for( auto& thread : threads )
+        thread.join();
+
+    std::set<uint64_t> unique_ids( ids.begin(), ids.end() );
+    CHECK( unique_ids.size() == ids.size() );
+    CHECK( unique_ids.count( 0 ) == 0 );
+}